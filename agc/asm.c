@@ -315,10 +315,12 @@ static void decode_extra_opcode_bit(agc_insn_t *insn, ut16 value) {
 			insn->operand = (value - 1) & LOWER_WIDE;
 			break;
 		case 050000: // i = 101
-			// see above
+			// extended INDEX: adds the contents of a memory location
+			// to the next instruction, which is decoded as extended
+			// too. No quarter code here, all the low 12 bits are the
+			// address, taken as is (no -1 like DCA and DCS)
 			insn->type = AGC_INSN_INDEX;
-			insn->operand = (value - 1) & LOWER_WIDE;
-			// reset bit
+			insn->operand = value & LOWER_WIDE;
 			break;
 		case 060000: // i = 110
 			if (value & HIGHER) {
@@ -342,6 +344,17 @@ static void decode_extra_opcode_bit(agc_insn_t *insn, ut16 value) {
 	}
 }
 
+void decode_agc_insn(agc_insn_t *insn, ut16 value, bool extended) {
+	// stateless decoding of a 15 bit word, used to build the emulator's
+	// decode tables. NOOP is never reported: it is a `TCF` to the next word
+	// or a `CA A`, and executes as such.
+	if (extended) {
+		decode_extra_opcode_bit (insn, value);
+	} else {
+		decode_no_extra_opcode_bit (insn, value, 010000);
+	}
+}
+
 void disasm_agc_insn(agc_insn_t *insn, unsigned int address, ut16 value, bool shift) {
 	// See http://www.ibiblio.org/apollo/assembly_language_manual.html
 	// for instruction set documentation and other valuable info.
@@ -72,7 +72,7 @@ typedef enum agc_insn_type {
 } agc_insn_type;
 
 // mnemonic lookup table
-const char *agc_mnemonics[59];
+extern const char *agc_mnemonics[59];
 
 // instruction representation
 typedef struct agc_insn_t {
@@ -80,6 +80,9 @@ typedef struct agc_insn_t {
 	ut16 operand;
 } agc_insn_t;
 
+// decode a single word, without any extracode state
+void decode_agc_insn(agc_insn_t *insn, ut16 value, bool extended);
+
 // actual disassembly logic
 void disasm_agc_insn(
 		agc_insn_t *op, unsigned int address, ut16 value, bool shift);
@@ -0,0 +1,686 @@
+/* radare2 - GPL3 - Copyright 2018 */
+
+/*
+  Block II AGC interpreter, see the instruction set documentation at
+  http://www.ibiblio.org/apollo/assembly_language_manual.html
+
+  Every 15 bit word is decoded once per mode (normal and extracode) into a
+  table, using the disassembler's decoder with the special mnemonics folded
+  back into the instruction they are an alias of (`COM` is `CS A`, `DTCF` is
+  `DXCH FB`, ...), so the interpreter only has to handle the real opcodes.
+
+  Arithmetic is ones' complement. `A` and `Q` keep the 16 bit adder value,
+  whose two top bits differ on overflow; memory words are 15 bits and get
+  sign extended when read and overflow corrected when written.
+*/
+
+#include <string.h>
+#include <r_util.h>
+#include "asm.h"
+#include "cpu.h"
+
+typedef struct agc_op_t {
+	ut8 type;
+	ut8 mct; // memory cycles
+	ut16 k;
+} agc_op_t;
+
+static agc_op_t agc_ops[2][0100000];
+static bool agc_ops_ready = false;
+
+static const ut8 agc_mct[] = {
+	[AGC_INSN_TC] = 1, [AGC_INSN_TCF] = 1, [AGC_INSN_CCS] = 2,
+	[AGC_INSN_DAS] = 3, [AGC_INSN_LXCH] = 2, [AGC_INSN_INCR] = 2,
+	[AGC_INSN_ADS] = 2, [AGC_INSN_CA] = 2, [AGC_INSN_CS] = 2,
+	[AGC_INSN_INDEX] = 2, [AGC_INSN_DXCH] = 3, [AGC_INSN_TS] = 2,
+	[AGC_INSN_XCH] = 2, [AGC_INSN_AD] = 2, [AGC_INSN_MASK] = 2,
+	[AGC_INSN_EXTEND] = 1, [AGC_INSN_INHINT] = 1, [AGC_INSN_RELINT] = 1,
+	[AGC_INSN_RESUME] = 2, [AGC_INSN_READ] = 2, [AGC_INSN_WRITE] = 2,
+	[AGC_INSN_RAND] = 2, [AGC_INSN_WAND] = 2, [AGC_INSN_ROR] = 2,
+	[AGC_INSN_WOR] = 2, [AGC_INSN_RXOR] = 2, [AGC_INSN_EDRUPT] = 3,
+	[AGC_INSN_DV] = 6, [AGC_INSN_BZF] = 1, [AGC_INSN_MSU] = 2,
+	[AGC_INSN_QXCH] = 2, [AGC_INSN_AUG] = 2, [AGC_INSN_DIM] = 2,
+	[AGC_INSN_DCA] = 3, [AGC_INSN_DCS] = 3, [AGC_INSN_SU] = 2,
+	[AGC_INSN_BZMF] = 1, [AGC_INSN_MP] = 3,
+};
+
+// rewrite the special mnemonics as the instruction they encode
+static void fold_alias(agc_insn_t *insn) {
+	switch (insn->type) {
+	case AGC_INSN_COM:
+		insn->type = AGC_INSN_CS;
+		insn->operand = AGC_REG_A;
+		break;
+	case AGC_INSN_DDOUBL:
+		insn->type = AGC_INSN_DAS;
+		insn->operand = AGC_REG_A;
+		break;
+	case AGC_INSN_DOUBLE:
+		insn->type = AGC_INSN_AD;
+		insn->operand = AGC_REG_A;
+		break;
+	case AGC_INSN_DTCB:
+		insn->type = AGC_INSN_DXCH;
+		insn->operand = AGC_REG_Z;
+		break;
+	case AGC_INSN_DTCF:
+		insn->type = AGC_INSN_DXCH;
+		insn->operand = AGC_REG_FB;
+		break;
+	case AGC_INSN_OVSK:
+		insn->type = AGC_INSN_TS;
+		insn->operand = AGC_REG_A;
+		break;
+	case AGC_INSN_TCAA:
+		insn->type = AGC_INSN_TS;
+		insn->operand = AGC_REG_Z;
+		break;
+	case AGC_INSN_ZL:
+		insn->type = AGC_INSN_LXCH;
+		insn->operand = AGC_REG_ZERO;
+		break;
+	case AGC_INSN_XXALQ:
+		insn->type = AGC_INSN_TC;
+		insn->operand = AGC_REG_A;
+		break;
+	case AGC_INSN_XLQ:
+		insn->type = AGC_INSN_TC;
+		insn->operand = AGC_REG_L;
+		break;
+	case AGC_INSN_RETURN:
+		insn->type = AGC_INSN_TC;
+		insn->operand = AGC_REG_Q;
+		break;
+	case AGC_INSN_DCOM:
+		insn->type = AGC_INSN_DCS;
+		insn->operand = AGC_REG_A;
+		break;
+	case AGC_INSN_SQUARE:
+		insn->type = AGC_INSN_MP;
+		insn->operand = AGC_REG_A;
+		break;
+	case AGC_INSN_ZQ:
+		insn->type = AGC_INSN_QXCH;
+		insn->operand = AGC_REG_ZERO;
+		break;
+	default:
+		break;
+	}
+}
+
+void agc_cpu_init(void) {
+	agc_insn_t insn;
+	int ext, word;
+	if (agc_ops_ready) {
+		return;
+	}
+	for (ext = 0; ext < 2; ext++) {
+		for (word = 0; word < 0100000; word++) {
+			memset (&insn, 0, sizeof (insn));
+			decode_agc_insn (&insn, word, ext);
+			fold_alias (&insn);
+			agc_ops[ext][word].type = insn.type;
+			agc_ops[ext][word].mct = agc_mct[insn.type];
+			agc_ops[ext][word].k = insn.operand & 07777;
+		}
+	}
+	agc_ops_ready = true;
+}
+
+// 15 bit word to 16 bit adder value
+static inline ut16 sx(ut16 v) {
+	v &= 077777;
+	return v | ((v & 040000) << 1);
+}
+
+// 16 bit adder value to 15 bit word, keeping the real sign
+static inline ut16 oc(ut16 v) {
+	return (v & 037777) | ((v >> 1) & 040000);
+}
+
+static inline bool ovf(ut16 v) {
+	return ((v >> 1) ^ v) & 040000;
+}
+
+static inline ut16 neg(ut16 v) {
+	return ~v & 0177777;
+}
+
+// ones' complement addition with end around carry
+static inline ut16 add16(ut16 a, ut16 b) {
+	ut32 s = (ut32)a + b;
+	if (s & 0200000) {
+		s++;
+	}
+	return s & 0177777;
+}
+
+static inline ut16 add15(ut16 a, ut16 b) {
+	ut32 s = (ut32)a + b;
+	if (s & 0100000) {
+		s++;
+	}
+	return s & 077777;
+}
+
+// magnitude of a 15 bit word
+static inline ut32 mag(ut16 v) {
+	return (v & 040000)? (~v & 037777): v;
+}
+
+static inline ut16 signed15(ut32 mag, bool negative) {
+	return negative? (~mag & 077777): (mag & 037777);
+}
+
+static inline ut16 *cell(agc_cpu_t *cpu, ut16 k) {
+	ut16 *r = cpu->erasable[0];
+	int bank;
+	k &= 07777;
+	if (k < 01400) {
+		return &cpu->erasable[k >> 8][k & 0377];
+	}
+	if (k < 02000) {
+		return &cpu->erasable[(r[AGC_REG_EB] >> 8) & 7][k & 0377];
+	}
+	if (k < 04000) {
+		bank = (r[AGC_REG_FB] >> 10) & 037;
+		// channel 7 selects the superbank for banks 030-037
+		if (bank >= 030 && (cpu->channels[7] & 0100)) {
+			bank += 010;
+		}
+		return &cpu->fixed[bank][k & 01777];
+	}
+	return &cpu->fixed[k >> 10][k & 01777];
+}
+
+static inline ut16 rd(agc_cpu_t *cpu, ut16 k) {
+	switch (k) {
+	case AGC_REG_A:
+	case AGC_REG_Q:
+		return cpu->erasable[0][k];
+	case AGC_REG_ZERO:
+		return 0;
+	}
+	return sx (*cell (cpu, k));
+}
+
+static inline void wr(agc_cpu_t *cpu, ut16 k, ut16 value) {
+	ut16 *r = cpu->erasable[0];
+	ut16 v;
+	if (k >= 02000) {
+		// fixed memory
+		return;
+	}
+	switch (k) {
+	case AGC_REG_A:
+	case AGC_REG_Q:
+		r[k] = value;
+		return;
+	case AGC_REG_ZERO:
+		return;
+	}
+	v = oc (value);
+	switch (k) {
+	case AGC_REG_EB:
+		r[AGC_REG_EB] = v & 03400;
+		r[AGC_REG_BB] = (r[AGC_REG_BB] & 076000) | (r[AGC_REG_EB] >> 8);
+		return;
+	case AGC_REG_FB:
+		r[AGC_REG_FB] = v & 076000;
+		r[AGC_REG_BB] = (r[AGC_REG_BB] & 7) | r[AGC_REG_FB];
+		return;
+	case AGC_REG_BB:
+		r[AGC_REG_BB] = v & 076007;
+		r[AGC_REG_FB] = v & 076000;
+		r[AGC_REG_EB] = (v & 7) << 8;
+		return;
+	case AGC_REG_Z:
+		r[AGC_REG_Z] = v & 07777;
+		return;
+	// the editing registers transform what is written to them
+	case AGC_REG_CYR:
+		v = (v >> 1) | ((v & 1) << 14);
+		break;
+	case AGC_REG_SR:
+		v = (v >> 1) | (v & 040000);
+		break;
+	case AGC_REG_CYL:
+		v = ((v << 1) & 077777) | (v >> 14);
+		break;
+	case AGC_REG_EDOP:
+		v = (v >> 7) & 0177;
+		break;
+	}
+	*cell (cpu, k) = v;
+}
+
+// channels 1 and 2 are the `L` and `Q` registers
+static inline ut16 rdch(agc_cpu_t *cpu, ut16 ch) {
+	switch (ch) {
+	case 1:
+		return rd (cpu, AGC_REG_L);
+	case 2:
+		return cpu->erasable[0][AGC_REG_Q];
+	}
+	return sx (cpu->channels[ch]);
+}
+
+static inline void wrch(agc_cpu_t *cpu, ut16 ch, ut16 value) {
+	switch (ch) {
+	case 1:
+		cpu->erasable[0][AGC_REG_L] = oc (value);
+		break;
+	case 2:
+		cpu->erasable[0][AGC_REG_Q] = value;
+		break;
+	default:
+		cpu->channels[ch] = oc (value);
+		break;
+	}
+}
+
+ut16 agc_cpu_read(agc_cpu_t *cpu, ut16 address) {
+	return address == AGC_REG_ZERO? 0: *cell (cpu, address);
+}
+
+void agc_cpu_write(agc_cpu_t *cpu, ut16 address, ut16 value) {
+	switch (address & 07777) {
+	case AGC_REG_A:
+	case AGC_REG_Q:
+		wr (cpu, address, value);
+		break;
+	default:
+		wr (cpu, address & 07777, sx (value));
+		break;
+	}
+}
+
+void agc_cpu_reset(agc_cpu_t *cpu) {
+	agc_cpu_init ();
+	cpu->erasable[0][AGC_REG_Z] = 04000;
+	cpu->extracode = false;
+	cpu->indexed = false;
+	cpu->resume = false;
+	cpu->inhint = false;
+	cpu->isr = false;
+	cpu->pending = 0;
+	cpu->scaler = 0;
+	cpu->ticks = 0;
+	cpu->mct = 0;
+	cpu->insns = 0;
+}
+
+int agc_cpu_load_rope(agc_cpu_t *cpu, const ut8 *buf, int len, bool yabin) {
+	int i, bank, n = len / 2;
+	if (n > AGC_FIXED_BANKS * AGC_BANK_WORDS) {
+		n = AGC_FIXED_BANKS * AGC_BANK_WORDS;
+	}
+	for (i = 0; i < n; i++) {
+		bank = i / AGC_BANK_WORDS;
+		if (yabin) {
+			// the two unswitched banks come first
+			if (bank < 4) {
+				bank ^= 2;
+			}
+			cpu->fixed[bank][i % AGC_BANK_WORDS] = (r_read_be16 (buf + 2 * i) >> 1) & 077777;
+		} else {
+			cpu->fixed[bank][i % AGC_BANK_WORDS] = r_read_le16 (buf + 2 * i) & 077777;
+		}
+	}
+	return n;
+}
+
+// counter increment, true when the counter overflows to +0
+static inline bool pinc(agc_cpu_t *cpu, int reg) {
+	ut16 *r = cpu->erasable[0];
+	ut16 v = r[reg] + 1;
+	if (v == 0100000) {
+		// -0 + 1
+		v = 1;
+	}
+	if (v == 040000) {
+		r[reg] = 0;
+		return true;
+	}
+	r[reg] = v;
+	return false;
+}
+
+static inline void rupt_request(agc_cpu_t *cpu, int n) {
+	cpu->pending |= 1 << n;
+}
+
+// one 1600Hz tick: TIME6 counts down at full rate when enabled by channel
+// 13, the others count up at 100Hz, TIME4 half a period after the rest
+static void tick(agc_cpu_t *cpu) {
+	ut16 *r = cpu->erasable[0];
+	ut16 v;
+	if (cpu->channels[013] & 040000) {
+		v = r[AGC_REG_TIME6];
+		if (!mag (v)) {
+			cpu->channels[013] &= ~040000;
+			rupt_request (cpu, AGC_RUPT_T6);
+		} else {
+			r[AGC_REG_TIME6] = (v & 040000)? v + 1: v - 1;
+		}
+	}
+	cpu->ticks++;
+	switch (cpu->ticks & 017) {
+	case 0:
+		if (pinc (cpu, AGC_REG_TIME1)) {
+			pinc (cpu, AGC_REG_TIME2);
+		}
+		if (pinc (cpu, AGC_REG_TIME3)) {
+			rupt_request (cpu, AGC_RUPT_T3);
+		}
+		if (pinc (cpu, AGC_REG_TIME5)) {
+			rupt_request (cpu, AGC_RUPT_T5);
+		}
+		break;
+	case 010:
+		if (pinc (cpu, AGC_REG_TIME4)) {
+			rupt_request (cpu, AGC_RUPT_T4);
+		}
+		break;
+	}
+}
+
+// the interrupted instruction is saved in `BRUPT` and executed again by
+// `RESUME`, which continues at `ZRUPT`
+static void take_rupt(agc_cpu_t *cpu) {
+	ut16 *r = cpu->erasable[0];
+	ut16 z = r[AGC_REG_Z];
+	int n;
+	for (n = AGC_RUPT_T6; n < AGC_RUPT_HAND; n++) {
+		if (cpu->pending & (1 << n)) {
+			break;
+		}
+	}
+	cpu->pending &= ~(1 << n);
+	r[AGC_REG_ZRUPT] = (z + 1) & 07777;
+	r[AGC_REG_BRUPT] = *cell (cpu, z) & 077777;
+	r[AGC_REG_Z] = 04000 + 4 * n;
+	cpu->isr = true;
+	cpu->mct += 3;
+}
+
+void agc_cpu_step(agc_cpu_t *cpu) {
+	ut16 *r = cpu->erasable[0];
+	const agc_op_t *op;
+	ut16 word, k, t, u, z;
+	ut32 p, d;
+	bool ext, negative;
+
+	if (cpu->resume) {
+		word = r[AGC_REG_BRUPT];
+		cpu->resume = false;
+	} else {
+		z = r[AGC_REG_Z];
+		word = *cell (cpu, z);
+		r[AGC_REG_Z] = (z + 1) & 07777;
+	}
+	if (cpu->indexed) {
+		word = add15 (word & 077777, cpu->index);
+		cpu->indexed = false;
+	}
+	ext = cpu->extracode;
+	cpu->extracode = false;
+	op = &agc_ops[ext][word & 077777];
+	k = op->k;
+
+	switch (op->type) {
+	case AGC_INSN_TC:
+		if (k != AGC_REG_Q) {
+			r[AGC_REG_Q] = r[AGC_REG_Z];
+		}
+		r[AGC_REG_Z] = k;
+		break;
+	case AGC_INSN_TCF:
+		r[AGC_REG_Z] = k;
+		break;
+	case AGC_INSN_CCS:
+		// diminished absolute value, and skip by sign
+		t = rd (cpu, k);
+		if (t == 0) {
+			r[AGC_REG_A] = 0;
+			r[AGC_REG_Z] += 1;
+		} else if (t == 0177777) {
+			r[AGC_REG_A] = 0;
+			r[AGC_REG_Z] += 3;
+		} else if (t & 0100000) {
+			r[AGC_REG_A] = neg (t) - 1;
+			r[AGC_REG_Z] += 2;
+		} else {
+			r[AGC_REG_A] = t - 1;
+		}
+		r[AGC_REG_Z] &= 07777;
+		break;
+	case AGC_INSN_DAS:
+		u = add16 (rd (cpu, AGC_REG_L), rd (cpu, k + 1));
+		t = add16 (r[AGC_REG_A], rd (cpu, k));
+		if (ovf (u)) {
+			t = add16 (t, (u & 0100000)? 0177776: 1);
+		}
+		wr (cpu, k + 1, u);
+		wr (cpu, k, t);
+		if (k != AGC_REG_A) {
+			r[AGC_REG_A] = ovf (t)? ((t & 0100000)? 0177776: 1): 0;
+			r[AGC_REG_L] = 0;
+		}
+		break;
+	case AGC_INSN_LXCH:
+		t = rd (cpu, k);
+		wr (cpu, k, rd (cpu, AGC_REG_L));
+		wr (cpu, AGC_REG_L, t);
+		break;
+	case AGC_INSN_INCR:
+		wr (cpu, k, add16 (rd (cpu, k), 1));
+		break;
+	case AGC_INSN_ADS:
+		r[AGC_REG_A] = add16 (r[AGC_REG_A], rd (cpu, k));
+		wr (cpu, k, r[AGC_REG_A]);
+		break;
+	case AGC_INSN_CA:
+		r[AGC_REG_A] = rd (cpu, k);
+		break;
+	case AGC_INSN_CS:
+		r[AGC_REG_A] = neg (rd (cpu, k));
+		break;
+	case AGC_INSN_INDEX:
+		cpu->index = oc (rd (cpu, k));
+		cpu->indexed = true;
+		// an extended INDEX indexes an extracode
+		cpu->extracode = ext;
+		break;
+	case AGC_INSN_DXCH:
+		t = rd (cpu, k + 1);
+		wr (cpu, k + 1, rd (cpu, AGC_REG_L));
+		wr (cpu, AGC_REG_L, t);
+		t = rd (cpu, k);
+		wr (cpu, k, r[AGC_REG_A]);
+		r[AGC_REG_A] = t;
+		break;
+	case AGC_INSN_TS:
+		t = r[AGC_REG_A];
+		if (k != AGC_REG_A) {
+			wr (cpu, k, t);
+		}
+		if (ovf (t)) {
+			if (k != AGC_REG_A) {
+				r[AGC_REG_A] = (t & 0100000)? 0177776: 1;
+			}
+			r[AGC_REG_Z] = (r[AGC_REG_Z] + 1) & 07777;
+		}
+		break;
+	case AGC_INSN_XCH:
+		t = rd (cpu, k);
+		wr (cpu, k, r[AGC_REG_A]);
+		r[AGC_REG_A] = t;
+		break;
+	case AGC_INSN_AD:
+		r[AGC_REG_A] = add16 (r[AGC_REG_A], rd (cpu, k));
+		break;
+	case AGC_INSN_MASK:
+		r[AGC_REG_A] &= rd (cpu, k);
+		break;
+	case AGC_INSN_EXTEND:
+		cpu->extracode = true;
+		break;
+	case AGC_INSN_INHINT:
+		cpu->inhint = true;
+		break;
+	case AGC_INSN_RELINT:
+		cpu->inhint = false;
+		break;
+	case AGC_INSN_RESUME:
+		r[AGC_REG_Z] = r[AGC_REG_ZRUPT] & 07777;
+		cpu->resume = true;
+		cpu->isr = false;
+		break;
+	case AGC_INSN_READ:
+		r[AGC_REG_A] = rdch (cpu, k & 0777);
+		break;
+	case AGC_INSN_WRITE:
+		wrch (cpu, k & 0777, r[AGC_REG_A]);
+		break;
+	case AGC_INSN_RAND:
+		r[AGC_REG_A] &= rdch (cpu, k & 0777);
+		break;
+	case AGC_INSN_WAND:
+		r[AGC_REG_A] &= rdch (cpu, k & 0777);
+		wrch (cpu, k & 0777, r[AGC_REG_A]);
+		break;
+	case AGC_INSN_ROR:
+		r[AGC_REG_A] |= rdch (cpu, k & 0777);
+		break;
+	case AGC_INSN_WOR:
+		r[AGC_REG_A] |= rdch (cpu, k & 0777);
+		wrch (cpu, k & 0777, r[AGC_REG_A]);
+		break;
+	case AGC_INSN_RXOR:
+		r[AGC_REG_A] ^= rdch (cpu, k & 0777);
+		break;
+	case AGC_INSN_EDRUPT:
+		r[AGC_REG_ZRUPT] = r[AGC_REG_Z];
+		r[AGC_REG_Z] = 0;
+		cpu->isr = true;
+		break;
+	case AGC_INSN_DV:
+		{
+			// sign and magnitude division of the double word `A`, `L`;
+			// the dividend takes the sign of `A` unless `A` is zero
+			ut16 a = oc (r[AGC_REG_A]), l = r[AGC_REG_L];
+			ut16 dv = oc (rd (cpu, k));
+			st64 n = (st64)((a & 040000)? -(st64)mag (a): mag (a)) * 040000
+				+ ((l & 040000)? -(st64)mag (l): mag (l));
+			bool dneg = n? n < 0: (mag (a)? (a & 040000): (l & 040000)) != 0;
+			ut64 m = n < 0? -n: n;
+			d = mag (dv);
+			negative = dneg ^ ((dv & 040000) != 0);
+			if (!d || m >= (ut64)d * 040000) {
+				// undefined result, saturate
+				r[AGC_REG_A] = sx (signed15 (037777, negative));
+				r[AGC_REG_L] = signed15 (0, dneg);
+			} else {
+				r[AGC_REG_A] = sx (signed15 (m / d, negative));
+				r[AGC_REG_L] = signed15 (m % d, dneg);
+			}
+		}
+		break;
+	case AGC_INSN_BZF:
+		t = r[AGC_REG_A];
+		if (t == 0 || t == 0177777) {
+			r[AGC_REG_Z] = k;
+		}
+		break;
+	case AGC_INSN_BZMF:
+		t = r[AGC_REG_A];
+		if (t == 0 || (t & 0100000)) {
+			r[AGC_REG_Z] = k;
+		}
+		break;
+	case AGC_INSN_MSU:
+		// the operands are two's complement, the result ones' complement
+		t = (oc (r[AGC_REG_A]) - oc (rd (cpu, k))) & 077777;
+		if (t & 040000) {
+			t = (t - 1) & 077777;
+		}
+		r[AGC_REG_A] = sx (t);
+		break;
+	case AGC_INSN_QXCH:
+		t = rd (cpu, k);
+		wr (cpu, k, r[AGC_REG_Q]);
+		r[AGC_REG_Q] = t;
+		break;
+	case AGC_INSN_AUG:
+		t = rd (cpu, k);
+		wr (cpu, k, add16 (t, (t & 0100000)? 0177776: 1));
+		break;
+	case AGC_INSN_DIM:
+		t = rd (cpu, k);
+		if (t != 0 && t != 0177777) {
+			wr (cpu, k, add16 (t, (t & 0100000)? 1: 0177776));
+		}
+		break;
+	case AGC_INSN_DCA:
+		wr (cpu, AGC_REG_L, rd (cpu, k + 1));
+		r[AGC_REG_A] = rd (cpu, k);
+		break;
+	case AGC_INSN_DCS:
+		wr (cpu, AGC_REG_L, neg (rd (cpu, k + 1)));
+		r[AGC_REG_A] = neg (rd (cpu, k));
+		break;
+	case AGC_INSN_SU:
+		r[AGC_REG_A] = add16 (r[AGC_REG_A], neg (rd (cpu, k)));
+		break;
+	case AGC_INSN_MP:
+		// sign and magnitude product, split in two 14 bit halves
+		t = oc (r[AGC_REG_A]);
+		u = oc (rd (cpu, k));
+		negative = ((t ^ u) & 040000) != 0;
+		p = mag (t) * mag (u);
+		r[AGC_REG_A] = sx (signed15 (p >> 14, negative));
+		r[AGC_REG_L] = signed15 (p & 037777, negative);
+		break;
+	}
+
+	cpu->insns++;
+	cpu->mct += op->mct;
+	cpu->scaler += 3 * op->mct;
+	while (cpu->scaler >= 160) {
+		cpu->scaler -= 160;
+		tick (cpu);
+	}
+	if (cpu->pending && !cpu->inhint && !cpu->isr && !cpu->extracode
+			&& !cpu->indexed && !cpu->resume && !ovf (r[AGC_REG_A])) {
+		take_rupt (cpu);
+	}
+}
+
+static void trace_insn(agc_cpu_t *cpu) {
+	ut16 *r = cpu->erasable[0];
+	// a resumed instruction comes from `BRUPT`, it was at `ZRUPT` - 1
+	ut16 z = cpu->resume? (r[AGC_REG_Z] - 1) & 07777: r[AGC_REG_Z];
+	ut16 word = cpu->resume? r[AGC_REG_BRUPT]: *cell (cpu, z);
+	fprintf (cpu->trace, "%02o,%04o %05o A=%06o L=%05o Q=%06o%s\n",
+		r[AGC_REG_FB] >> 10, z, word & 077777,
+		r[AGC_REG_A], r[AGC_REG_L], r[AGC_REG_Q],
+		cpu->extracode? " ext": "");
+}
+
+int agc_cpu_run(agc_cpu_t *cpu, ut64 budget, const ut8 *breakpoints) {
+	ut64 n;
+	ut16 z;
+	for (n = 0; !budget || n < budget; n++) {
+		z = cpu->erasable[0][AGC_REG_Z];
+		// the first instruction steps off the breakpoint we stopped at
+		if (n && breakpoints && (breakpoints[z >> 3] & (1 << (z & 7)))) {
+			return AGC_STOP_BREAKPOINT;
+		}
+		if (cpu->trace) {
+			trace_insn (cpu);
+		}
+		agc_cpu_step (cpu);
+	}
+	return AGC_STOP_BUDGET;
+}
@@ -0,0 +1,106 @@
+#ifndef AGC_CPU_H
+#define AGC_CPU_H
+
+#include <stdio.h>
+#include <r_types.h>
+
+// memory geometry of the Block II AGC
+#define AGC_ERASABLE_BANKS 8
+#define AGC_FIXED_BANKS 36
+#define AGC_BANK_WORDS 02000
+#define AGC_EBANK_WORDS 0400
+#define AGC_CHANNELS 01000
+
+// the first words of erasable memory are the central, interrupt save,
+// editing and counter registers
+enum agc_reg {
+	AGC_REG_A = 000,
+	AGC_REG_L = 001,
+	AGC_REG_Q = 002,
+	AGC_REG_EB = 003,
+	AGC_REG_FB = 004,
+	AGC_REG_Z = 005,
+	AGC_REG_BB = 006,
+	AGC_REG_ZERO = 007,
+	AGC_REG_ARUPT = 010,
+	AGC_REG_LRUPT = 011,
+	AGC_REG_QRUPT = 012,
+	AGC_REG_ZRUPT = 015,
+	AGC_REG_BBRUPT = 016,
+	AGC_REG_BRUPT = 017,
+	AGC_REG_CYR = 020,
+	AGC_REG_SR = 021,
+	AGC_REG_CYL = 022,
+	AGC_REG_EDOP = 023,
+	AGC_REG_TIME2 = 024,
+	AGC_REG_TIME1 = 025,
+	AGC_REG_TIME3 = 026,
+	AGC_REG_TIME4 = 027,
+	AGC_REG_TIME5 = 030,
+	AGC_REG_TIME6 = 031,
+};
+
+// interrupt numbers, the vector of interrupt n is at 04000 + 4 * n
+enum agc_rupt {
+	AGC_RUPT_T6 = 1,
+	AGC_RUPT_T5,
+	AGC_RUPT_T3,
+	AGC_RUPT_T4,
+	AGC_RUPT_KEY1,
+	AGC_RUPT_KEY2,
+	AGC_RUPT_UP,
+	AGC_RUPT_DOWN,
+	AGC_RUPT_RADAR,
+	AGC_RUPT_HAND,
+};
+
+// why agc_cpu_run() returned
+enum agc_stop {
+	AGC_STOP_BUDGET,
+	AGC_STOP_BREAKPOINT,
+};
+
+typedef struct agc_cpu_t {
+	// `A` and `Q` hold 16 bit values (with the overflow bit), everything
+	// else holds 15 bit words
+	ut16 erasable[AGC_ERASABLE_BANKS][AGC_EBANK_WORDS];
+	// room for the superbank 4 banks which the Block II rope doesn't have
+	ut16 fixed[40][AGC_BANK_WORDS];
+	ut16 channels[AGC_CHANNELS];
+	bool extracode; // the next instruction is an extracode
+	bool indexed; // the next instruction gets `index` added to it
+	bool resume; // the next instruction is taken from `BRUPT`
+	bool inhint; // interrupts inhibited by INHINT
+	bool isr; // running an interrupt service routine
+	ut16 index;
+	ut32 pending; // requested interrupts, bit n is interrupt n
+	int scaler; // 1600Hz scaler phase
+	int ticks; // 1600Hz ticks, the 100Hz counters run every 16
+	ut64 mct; // memory cycles elapsed
+	ut64 insns; // instructions executed
+	FILE *trace; // per instruction trace, when set
+} agc_cpu_t;
+
+// build the decode tables, called by agc_cpu_reset()
+void agc_cpu_init(void);
+
+// power on reset, memory is kept
+void agc_cpu_reset(agc_cpu_t *cpu);
+
+// load a rope image: either 36 banks of little endian words in bank order,
+// or a yaAGC .bin rope (big endian, shifted left, banks 2, 3, 0, 1, 4...).
+// Returns the number of words loaded.
+int agc_cpu_load_rope(agc_cpu_t *cpu, const ut8 *buf, int len, bool yabin);
+
+// read or write a 12 bit address, using the current bank registers
+ut16 agc_cpu_read(agc_cpu_t *cpu, ut16 address);
+void agc_cpu_write(agc_cpu_t *cpu, ut16 address, ut16 value);
+
+// execute one instruction, taking a pending interrupt first if allowed
+void agc_cpu_step(agc_cpu_t *cpu);
+
+// execute up to `budget` instructions (0 means no limit), stopping before
+// any `Z` value set in the 4096 bit `breakpoints` map
+int agc_cpu_run(agc_cpu_t *cpu, ut64 budget, const ut8 *breakpoints);
+
+#endif
@@ -0,0 +1,265 @@
+/* radare2 - GPL3 - Copyright 2018 */
+
+#include <r_debug.h>
+#include <r_lib.h>
+#include "cpu.h"
+
+/*
+  Emulates the AGC natively. The rope is read from the opened file (36 banks
+  of 1024 little endian words, as the asm and anal plugins decode them), or
+  from the yaAGC .bin file named by $R2_AGC_ROPE. Breakpoints and `Z` are
+  12 bit AGC addresses, so a breakpoint in switched fixed memory stops in
+  every bank. `dk n` requests interrupt n (1 = T6RUPT ... 10 = HANDRUPT).
+
+  $R2_AGC_BUDGET  max instructions per continue (default 100M, 0 = no limit)
+  $R2_AGC_TRACE   file receiving one line per executed instruction
+*/
+
+#define AGC_DEFAULT_BUDGET 100000000
+
+static agc_cpu_t *agc = NULL;
+static ut8 agc_bps[010000 / 8];
+static ut64 agc_budget = AGC_DEFAULT_BUDGET;
+static RDebugReasonType agc_reason = R_DEBUG_REASON_NONE;
+
+// registers in profile order, two bytes each
+static const ut16 agc_regs[] = {
+	AGC_REG_A, AGC_REG_L, AGC_REG_Q, AGC_REG_EB, AGC_REG_FB, AGC_REG_Z,
+	AGC_REG_BB, AGC_REG_ARUPT, AGC_REG_LRUPT, AGC_REG_QRUPT,
+	AGC_REG_ZRUPT, AGC_REG_BBRUPT, AGC_REG_BRUPT, AGC_REG_CYR,
+	AGC_REG_SR, AGC_REG_CYL, AGC_REG_EDOP, AGC_REG_TIME2, AGC_REG_TIME1,
+	AGC_REG_TIME3, AGC_REG_TIME4, AGC_REG_TIME5, AGC_REG_TIME6
+};
+#define AGC_NREGS ((int)(sizeof (agc_regs) / sizeof (agc_regs[0])))
+
+static bool agc_load_rope(RDebug *dbg) {
+	int size, len = AGC_FIXED_BANKS * AGC_BANK_WORDS * 2;
+	char *path = r_sys_getenv ("R2_AGC_ROPE");
+	ut8 *buf;
+	bool yabin = path && *path;
+	if (yabin) {
+		buf = (ut8 *)r_file_slurp (path, &size);
+		if (!buf) {
+			eprintf ("Cannot open rope %s\n", path);
+			free (path);
+			return false;
+		}
+		len = size;
+	} else {
+		if (!(buf = malloc (len))) {
+			free (path);
+			return false;
+		}
+		dbg->iob.read_at (dbg->iob.io, 0, buf, len);
+	}
+	free (path);
+	len = agc_cpu_load_rope (agc, buf, len, yabin);
+	eprintf ("AGC rope: %d banks\n", len / AGC_BANK_WORDS);
+	free (buf);
+	return true;
+}
+
+static int r_debug_agc_attach(RDebug *dbg, int pid) {
+	char *env;
+	if (!agc && !(agc = R_NEW0 (agc_cpu_t))) {
+		return false;
+	}
+	if (agc->trace) {
+		fclose (agc->trace);
+	}
+	memset (agc, 0, sizeof (agc_cpu_t));
+	if (!agc_load_rope (dbg)) {
+		R_FREE (agc);
+		return false;
+	}
+	agc_cpu_reset (agc);
+	env = r_sys_getenv ("R2_AGC_BUDGET");
+	agc_budget = env? r_num_get (NULL, env): AGC_DEFAULT_BUDGET;
+	free (env);
+	env = r_sys_getenv ("R2_AGC_TRACE");
+	if (env && *env && !(agc->trace = fopen (env, "w"))) {
+		eprintf ("Cannot open %s\n", env);
+	}
+	free (env);
+	agc_reason = R_DEBUG_REASON_NONE;
+	return true;
+}
+
+static int r_debug_agc_detach(RDebug *dbg, int pid) {
+	if (agc) {
+		if (agc->trace) {
+			fclose (agc->trace);
+		}
+		R_FREE (agc);
+	}
+	return true;
+}
+
+static int r_debug_agc_step(RDebug *dbg) {
+	if (!agc) {
+		return false;
+	}
+	agc_cpu_run (agc, 1, NULL);
+	agc_reason = R_DEBUG_REASON_STEP;
+	return true;
+}
+
+static int r_debug_agc_continue(RDebug *dbg, int pid, int tid, int sig) {
+	ut64 insns, t0, elapsed;
+	if (!agc) {
+		return false;
+	}
+	insns = agc->insns;
+	t0 = r_sys_now ();
+	if (agc_cpu_run (agc, agc_budget, agc_bps) == AGC_STOP_BREAKPOINT) {
+		agc_reason = R_DEBUG_REASON_BREAKPOINT;
+	} else {
+		agc_reason = R_DEBUG_REASON_NONE;
+		elapsed = r_sys_now () - t0;
+		insns = agc->insns - insns;
+		eprintf ("AGC budget of %"PFMT64d" instructions reached in %.3fs (%.2f MIPS, %.3fs of AGC time)\n",
+			insns, elapsed / 1000000.0, elapsed? (double)insns / elapsed: 0.0,
+			agc->mct * 0.00001172);
+	}
+	return tid;
+}
+
+static RDebugReasonType r_debug_agc_wait(RDebug *dbg, int pid) {
+	return agc_reason;
+}
+
+static int r_debug_agc_breakpoint(struct r_bp_t *bp, RBreakpointItem *b, bool set) {
+	ut16 z;
+	if (!b || b->addr > 07777) {
+		return false;
+	}
+	z = b->addr;
+	if (set) {
+		agc_bps[z >> 3] |= 1 << (z & 7);
+	} else {
+		agc_bps[z >> 3] &= ~(1 << (z & 7));
+	}
+	return true;
+}
+
+static int r_debug_agc_reg_read(RDebug *dbg, int type, ut8 *buf, int size) {
+	int i;
+	if (!agc || size < AGC_NREGS * 2) {
+		return 0;
+	}
+	for (i = 0; i < AGC_NREGS; i++) {
+		r_write_le16 (buf + 2 * i, agc->erasable[0][agc_regs[i]]);
+	}
+	return AGC_NREGS * 2;
+}
+
+static int r_debug_agc_reg_write(RDebug *dbg, int type, const ut8 *buf, int size) {
+	ut16 reg, v;
+	int i;
+	if (!agc || size < AGC_NREGS * 2) {
+		return false;
+	}
+	// the whole profile is written back, only apply what changed so the
+	// editing registers aren't shifted again
+	for (i = 0; i < AGC_NREGS; i++) {
+		reg = agc_regs[i];
+		v = r_read_le16 (buf + 2 * i);
+		if (v == agc->erasable[0][reg]) {
+			continue;
+		}
+		switch (reg) {
+		case AGC_REG_EB:
+		case AGC_REG_FB:
+		case AGC_REG_BB:
+			// keeps the bank registers mirrored
+			agc_cpu_write (agc, reg, v);
+			break;
+		case AGC_REG_A:
+		case AGC_REG_Q:
+			agc->erasable[0][reg] = v;
+			break;
+		case AGC_REG_Z:
+			agc->erasable[0][reg] = v & 07777;
+			break;
+		default:
+			agc->erasable[0][reg] = v & 077777;
+			break;
+		}
+	}
+	return true;
+}
+
+static const char *r_debug_agc_reg_profile(RDebug *dbg) {
+	return strdup (
+		"=PC	Z\n"
+		"=SP	Q\n"
+		"gpr	A	.16	0	0\n"
+		"gpr	L	.16	2	0\n"
+		"gpr	Q	.16	4	0\n"
+		"seg	EB	.15	6	0\n"
+		"seg	FB	.15	8	0\n"
+		"gpr	Z	.12	10	0\n"
+		"seg	BB	.15	12	0\n"
+		"gpr	ARUPT	.15	14	0\n"
+		"gpr	LRUPT	.15	16	0\n"
+		"gpr	QRUPT	.15	18	0\n"
+		"gpr	ZRUPT	.15	20	0\n"
+		"gpr	BBRUPT	.15	22	0\n"
+		"gpr	BRUPT	.15	24	0\n"
+		"gpr	CYR	.15	26	0\n"
+		"gpr	SR	.15	28	0\n"
+		"gpr	CYL	.15	30	0\n"
+		"gpr	EDOP	.15	32	0\n"
+		"gpr	TIME2	.15	34	0\n"
+		"gpr	TIME1	.15	36	0\n"
+		"gpr	TIME3	.15	38	0\n"
+		"gpr	TIME4	.15	40	0\n"
+		"gpr	TIME5	.15	42	0\n"
+		"gpr	TIME6	.15	44	0\n"
+	);
+}
+
+// dk n requests interrupt n
+static bool r_debug_agc_kill(RDebug *dbg, int pid, int tid, int sig) {
+	if (!agc || sig < AGC_RUPT_T6 || sig > AGC_RUPT_HAND) {
+		return false;
+	}
+	agc->pending |= 1 << sig;
+	return true;
+}
+
+static RList* r_debug_agc_threads(RDebug *dbg, int pid) {
+	return NULL;
+}
+
+static int r_debug_agc_select(int pid, int tid) {
+	return true;
+}
+
+RDebugPlugin r_debug_plugin_agc = {
+	.name = "agc",
+	.license = "GPL3",
+	.arch = "agc",
+	.bits = R_SYS_BITS_16,
+	.canstep = 1,
+	.step = r_debug_agc_step,
+	.cont = r_debug_agc_continue,
+	.wait = &r_debug_agc_wait,
+	.attach = &r_debug_agc_attach,
+	.detach = (void *)&r_debug_agc_detach,
+	.threads = &r_debug_agc_threads,
+	.select = &r_debug_agc_select,
+	.kill = &r_debug_agc_kill,
+	.breakpoint = r_debug_agc_breakpoint,
+	.reg_read = r_debug_agc_reg_read,
+	.reg_write = r_debug_agc_reg_write,
+	.reg_profile = (void *)r_debug_agc_reg_profile,
+};
+
+#ifndef CORELIB
+RLibStruct radare_plugin = {
+	.type = R_LIB_TYPE_DBG,
+	.data = &r_debug_plugin_agc,
+	.version = R2_VERSION
+};
+#endif
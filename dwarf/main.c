@@ -11,6 +11,8 @@
 
 #include "dwarf.h"
 #include "libdwarf.h"
+#include <libelf.h>
+#include <gelf.h>
 
 #define NRM_FORMAT  0
 #define JSON_FORMAT 1
@@ -29,9 +31,20 @@
 
 #define DEBUG_MODE 1
 
+/* The type index is saved in the radare2 cache directory and reused as long
+ * as the build-id matches; bump the version when the key layout changes. */
+#ifndef R2_HOME_CACHEDIR
+#define R2_HOME_CACHEDIR ".cache" R_SYS_DIR "radare2"
+#endif
+#define DWARF_INDEX_KEY     "dwarf.index"
+#define DWARF_INDEX_VERSION "1"
+
 
-static Dwarf_Debug dbg = 0;
-static Sdb *s = NULL;
+/* dbg and s are per thread: the index is built by several workers, each
+ * with its own libdwarf handle and sdb (see read_cu_list). The main thread
+ * keeps the ones used by the commands. */
+static __thread Dwarf_Debug dbg = 0;
+static __thread Sdb *s = NULL;
 static int fd = -1;
 
 //baseoff in below two is ignored unless type == (JSON_FORMAT | C_FORMAT) == 3
@@ -889,285 +902,210 @@ static int get_address_and_die (RCore *core, Dwarf_Die die, Dwarf_Unsigned start
 	return res;
 }
 
-/* load_globals
- * load the global variables and their address in memory
- * Return Value: (In the current version of code, return value is ignored)
- *   DW_DLV_OK: Success
+/* index_global
+ * store the address and size of a global variable in the index as
+ * "glob.<name>" => "size@addr[,size@addr...]"
+ * Return Value:
+ *   DW_DLV_OK: Success or nothing to store
  *   DW_DLV_ERROR: Error in traversing dwarf file
- *   DW_DLV_NO_ENTRY: compilation unit die passed as argument does not have any child
  */
-static int load_globals (Dwarf_Die in_die) {
+static int index_global (Dwarf_Die cur_die) {
 	int res = DW_DLV_ERROR;
-	Dwarf_Die cur_die = in_die;
-	Dwarf_Die nextdie = 0;
+	Dwarf_Locdesc *locdesc = 0;
+	Dwarf_Signed lcnt = 0;
+	Dwarf_Bool ret = 0;
+	Dwarf_Attribute attr = 0;
+	int i;
+	ut64 size;
+	int inbits;
+	char *diename = NULL;
+	char key[512];
+	char val[64];
 
-	res = dwarf_child (cur_die, &nextdie, NULL);
-	if (res == DW_DLV_ERROR || res == DW_DLV_NO_ENTRY) {
-		if (res == DW_DLV_ERROR) {
-			print_error ("load_globals :: dwarf_child", __LINE__);
-		}
-		dwarf_dealloc (dbg, nextdie, DW_DLA_DIE);
+	res = dwarf_hasattr (cur_die, DW_AT_location, &ret, NULL);
+	if (res == DW_DLV_ERROR) {
+		print_error ("index_global :: dwarf_hasattr", __LINE__);
 		return res;
 	}
+	if (!ret) {
+		return DW_DLV_OK;
+	}
 
-	cur_die = nextdie;
-	while (true) {
-		Dwarf_Half tag = 0;
-		nextdie = 0;
-
-		res = dwarf_tag (cur_die, &tag, NULL);
-		if (res == DW_DLV_ERROR) {
-			print_error ("load_globals :: dwarf_tag", __LINE__);
-			goto badres;
-		}
-
-		if (tag == DW_TAG_variable && !is_declaration (cur_die)) {
-			Dwarf_Locdesc *locdesc = 0;
-			Dwarf_Signed lcnt = 0;
-			Dwarf_Bool ret = 0;
-			Dwarf_Attribute attr = 0;
-
-			res = dwarf_hasattr (cur_die, DW_AT_location, &ret, NULL);
-			if (res == DW_DLV_ERROR) {
-				print_error ("load_globals :: dwarf_hasattr", __LINE__);
-				goto badres;
-			}
-
-			if (ret) {
-				int i;
-				ut64 size;
-				int inbits;
-				char *diename = NULL;
-
-				res = dwarf_attr (cur_die, DW_AT_location, &attr, NULL);
-				if (res != DW_DLV_OK) {
-					dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
-					goto badres;
-				}
-
-				res = dwarf_loclist (attr, &locdesc, &lcnt, NULL);
-				if (res != DW_DLV_OK) {
-					dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
-					print_error ("load_globals :: dwarf_loclist", __LINE__);
-					goto badres;
-				}
-
-				res = get_dwarf_diename (cur_die, &diename, NULL);
-				if (res != DW_DLV_OK) {
-					diename = "";
-				}
-
-				res = get_size (cur_die, &size, &inbits);
-				if (res != DW_DLV_OK) {
-					size = 0;
-				}
+	res = dwarf_attr (cur_die, DW_AT_location, &attr, NULL);
+	if (res != DW_DLV_OK) {
+		dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
+		return res;
+	}
 
-				for (i = 0; i < lcnt; i++) {
-					if (locdesc[i].ld_s->lr_atom == DW_OP_addr) {
-						r_cons_printf ("f sym.%s %llu @ 0x%llx\n", diename, size, locdesc[i].ld_s->lr_number);
-					}
-				}
+	res = dwarf_loclist (attr, &locdesc, &lcnt, NULL);
+	if (res != DW_DLV_OK) {
+		dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
+		print_error ("index_global :: dwarf_loclist", __LINE__);
+		return res;
+	}
 
-				if (strcmp (diename, "")) {
-					dwarf_dealloc (dbg, diename, DW_DLA_STRING);
-				}
-				dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
-			}
-		}
-	badres:
-		res = dwarf_siblingof (dbg, cur_die, &nextdie, NULL);
-		if (res == DW_DLV_ERROR) {
-			print_error ("load_globals :: dwarf_siblingof", __LINE__);
-			break;
-		}
+	res = get_dwarf_diename (cur_die, &diename, NULL);
+	if (res != DW_DLV_OK) {
+		diename = "";
+	}
 
-		if (res == DW_DLV_NO_ENTRY) {
-			res = DW_DLV_OK;
-			break;
-		}
+	res = get_size (cur_die, &size, &inbits);
+	if (res != DW_DLV_OK) {
+		size = 0;
+	}
 
-		if (cur_die != in_die) {
-			dwarf_dealloc (dbg, cur_die, DW_DLA_DIE);
+	snprintf (key, sizeof (key), "glob.%s", diename);
+	for (i = 0; i < lcnt; i++) {
+		if (locdesc[i].ld_s->lr_atom == DW_OP_addr) {
+			snprintf (val, sizeof (val), "%"PFMT64u"@0x%"PFMT64x, size, (ut64)locdesc[i].ld_s->lr_number);
+			sdb_array_push (s, key, val, 0);
 		}
-
-		cur_die = nextdie;
 	}
 
-	if (cur_die != in_die) {
-		dwarf_dealloc (dbg, cur_die, DW_DLA_DIE);
+	if (strcmp (diename, "")) {
+		dwarf_dealloc (dbg, diename, DW_DLA_STRING);
 	}
-
-	return res;
+	dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
+	return DW_DLV_OK;
 }
 
-/* load_functions
- * load the funtion name and their address in memory
- * Return Value: (In the current version of code, return value is ignored)
- *   DW_DLV_OK: Success
+/* index_function
+ * store the address and size of a function in the index as
+ * "func.<name>" => "size@addr[,size@addr...]"
+ * Return Value:
+ *   DW_DLV_OK: Success or nothing to store
  *   DW_DLV_ERROR: Error in traversing dwarf file
- *   DW_DLV_NO_ENTRY: compilation unit die passed as argument does not have any child
  */
-static int load_functions (Dwarf_Die in_die) {
+static int index_function (Dwarf_Die cur_die) {
 	int res = DW_DLV_ERROR;
-	Dwarf_Die cur_die = in_die;
-	Dwarf_Die nextdie = 0;
+	Dwarf_Bool ret = 0;
+	Dwarf_Attribute attr = 0;
+	ut64 size = 0;
+	char *diename = NULL;
+	Dwarf_Addr low_pc = 0;
+	Dwarf_Addr high_pc = 0;
+	Dwarf_Half attr_form = 0;
+	char key[512];
+	char val[64];
 
-	res = dwarf_child (cur_die, &nextdie, NULL);
-	if (res == DW_DLV_ERROR || res == DW_DLV_NO_ENTRY) {
-		if (res == DW_DLV_ERROR) {
-			print_error ("load_globals :: dwarf_child", __LINE__);
-		}
-		dwarf_dealloc (dbg, nextdie, DW_DLA_DIE);
+	res = dwarf_hasattr (cur_die, DW_AT_low_pc, &ret, NULL);
+	if (res == DW_DLV_ERROR) {
+		print_error ("index_function :: dwarf_hasattr", __LINE__);
 		return res;
 	}
+	if (!ret) {
+		return DW_DLV_OK;
+	}
 
-	cur_die = nextdie;
-	while (true) {
-		Dwarf_Half tag = 0;
-		nextdie = 0;
+	res = get_dwarf_diename (cur_die, &diename, NULL);
+	if (res == DW_DLV_ERROR) {
+		dwarf_dealloc (dbg, diename, DW_DLA_STRING);
+		return res;
+	} else if (res == DW_DLV_NO_ENTRY) {
+		Dwarf_Off offset = 0;
+		Dwarf_Die offdie = 0;
 
-		res = dwarf_tag (cur_die, &tag, NULL);
-		if (res == DW_DLV_ERROR) {
-			print_error ("load_functions :: dwarf_tag", __LINE__);
-			goto badres;
+		res = dwarf_attr (cur_die, DW_AT_abstract_origin, &attr, NULL);
+		if (res != DW_DLV_OK) {
+			goto out; //// REALLY????
 		}
 
-		if (tag == DW_TAG_subprogram) {
-			Dwarf_Bool ret = 0;
-			Dwarf_Attribute attr = 0;
-
-			res = dwarf_hasattr (cur_die, DW_AT_low_pc, &ret, NULL);
-			if (res == DW_DLV_ERROR) {
-				print_error ("load_functions :: dwarf_hasattr", __LINE__);
-				goto badres;
-			}
-
-			if (ret) {
-				ut64 size = 0;
-				char *diename = NULL;
-				Dwarf_Addr low_pc = 0;
-				Dwarf_Addr high_pc = 0;
-				Dwarf_Half attr_form = 0;
-
-				res = get_dwarf_diename (cur_die, &diename, NULL);
-				if (res == DW_DLV_ERROR) {
-					dwarf_dealloc (dbg, diename, DW_DLA_STRING);
-					goto badres;
-				} else if (res == DW_DLV_NO_ENTRY) {
-					ut64 size = 0;
-					Dwarf_Off offset = 0;
-					Dwarf_Die offdie = 0;
-
-					res = dwarf_attr (cur_die, DW_AT_abstract_origin, &attr, NULL);
-					if (res != DW_DLV_OK) {
-						goto out; //// REALLY????
-					}
-
-					res = dwarf_global_formref (attr, &offset, NULL);
-					dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
-					if (res != DW_DLV_OK) {
-						print_error (" ", __LINE__);
-						goto out; //// REALLY?
-					}
-
-					res = dwarf_offdie (dbg, offset, &offdie, NULL);
-					if (res != DW_DLV_OK) {
-						print_error (" ", __LINE__);
-						dwarf_dealloc (dbg, offdie, DW_DLA_DIE);
-						goto out; //// REALLY?
-					}
-
-					dwarf_dealloc (dbg, diename, DW_DLA_STRING);
-					res = get_dwarf_diename (offdie, &diename, NULL);
-					if (res != DW_DLV_OK) {
-						print_error (" ", __LINE__);
-						dwarf_dealloc (dbg, diename, DW_DLA_STRING);
-						dwarf_dealloc (dbg, offdie, DW_DLA_DIE);
-						goto out;
-					}
-					dwarf_dealloc (dbg, offdie, DW_DLA_DIE);
-					dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
-
-				}
+		res = dwarf_global_formref (attr, &offset, NULL);
+		dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
+		attr = 0;
+		if (res != DW_DLV_OK) {
+			print_error (" ", __LINE__);
+			goto out; //// REALLY?
+		}
 
-				res = dwarf_attr (cur_die, DW_AT_low_pc, &attr, NULL);
-				if (res != DW_DLV_OK) {
-					print_error (" ", __LINE__);
-					goto out;
-				}
+		res = dwarf_offdie (dbg, offset, &offdie, NULL);
+		if (res != DW_DLV_OK) {
+			print_error (" ", __LINE__);
+			dwarf_dealloc (dbg, offdie, DW_DLA_DIE);
+			goto out; //// REALLY?
+		}
 
-				res = dwarf_formaddr (attr, &low_pc, NULL);
-				if (res != DW_DLV_OK) {
-					print_error (" ", __LINE__);
-					goto out;
-				}
+		dwarf_dealloc (dbg, diename, DW_DLA_STRING);
+		res = get_dwarf_diename (offdie, &diename, NULL);
+		if (res != DW_DLV_OK) {
+			print_error (" ", __LINE__);
+			dwarf_dealloc (dbg, diename, DW_DLA_STRING);
+			dwarf_dealloc (dbg, offdie, DW_DLA_DIE);
+			diename = NULL;
+			goto out;
+		}
+		dwarf_dealloc (dbg, offdie, DW_DLA_DIE);
+	}
 
-				//res = dwarf_lowpc (cur_die, &low_pc, NULL);
-				//if (res == DW_DLV_ERROR) {
-				//	print_error (" ", __LINE__);
-				//	goto out;
-				//}
+	res = dwarf_attr (cur_die, DW_AT_low_pc, &attr, NULL);
+	if (res != DW_DLV_OK) {
+		print_error (" ", __LINE__);
+		goto out;
+	}
 
-				dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
+	res = dwarf_formaddr (attr, &low_pc, NULL);
+	if (res != DW_DLV_OK) {
+		print_error (" ", __LINE__);
+		goto out;
+	}
 
-				res = dwarf_attr (cur_die, DW_AT_high_pc, &attr, NULL);
-				if (res != DW_DLV_OK) {
-					print_error (" ", __LINE__);
-					goto out;
-				}
+	dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
 
-				res = dwarf_whatform (attr, &attr_form, NULL);
-				if (res != DW_DLV_OK) {
-					print_error (" ", __LINE__);
-					goto out;
-				}
+	res = dwarf_attr (cur_die, DW_AT_high_pc, &attr, NULL);
+	if (res != DW_DLV_OK) {
+		print_error (" ", __LINE__);
+		goto out;
+	}
 
-				//res = dwarf_highpc (cur_die, &high_pc, NULL);
-				//if (res == DW_DLV_ERROR) {
-				//	print_error (" ", __LINE__);
-				//	goto out;
-				//}
-
-				if (attr_form == DW_FORM_addr) { // if (res == DW_DLV_OK) {
-					res = dwarf_formaddr (attr, &high_pc, NULL);
-					size = (res != DW_DLV_OK) ? 0 : (high_pc - low_pc);
-				} else { //if (res == DW_DLV_NO_ENTRY)
-					res = get_num_from_attr (attr, &size, NULL);
-					if (res != DW_DLV_OK) {
-						size = 0;
-					}
-				}
+	res = dwarf_whatform (attr, &attr_form, NULL);
+	if (res != DW_DLV_OK) {
+		print_error (" ", __LINE__);
+		goto out;
+	}
 
-				r_cons_printf ("f sym.%s %llu @ 0x%llx\n", diename, size, (ut64) low_pc);
-			out:
-				dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
-				dwarf_dealloc (dbg, diename, DW_DLA_STRING);
-			}
-		}
-	badres:
-		res = dwarf_siblingof (dbg, cur_die, &nextdie, NULL);
-		if (res == DW_DLV_ERROR) {
-			print_error ("load_globals :: dwarf_siblingof", __LINE__);
-			break;
+	if (attr_form == DW_FORM_addr) {
+		res = dwarf_formaddr (attr, &high_pc, NULL);
+		size = (res != DW_DLV_OK) ? 0 : (high_pc - low_pc);
+	} else {
+		res = get_num_from_attr (attr, &size, NULL);
+		if (res != DW_DLV_OK) {
+			size = 0;
 		}
+	}
 
-		if (res == DW_DLV_NO_ENTRY) {
-			res = DW_DLV_OK;
-			break;
-		}
+	snprintf (key, sizeof (key), "func.%s", diename);
+	snprintf (val, sizeof (val), "%"PFMT64u"@0x%"PFMT64x, size, (ut64)low_pc);
+	sdb_array_push (s, key, val, 0);
+	res = DW_DLV_OK;
+out:
+	dwarf_dealloc (dbg, attr, DW_DLA_ATTR);
+	dwarf_dealloc (dbg, diename, DW_DLA_STRING);
+	return res;
+}
 
-		if (cur_die != in_die) {
-			dwarf_dealloc (dbg, cur_die, DW_DLA_DIE);
-		}
+/* print_flags_cb
+ * sdb_foreach callback printing the "glob." or "func." entries of the index
+ * as r2 flags
+ */
+static int print_flags_cb (void *user, const char *k, const char *v) {
+	const char *prefix = (const char *)user;
+	const int plen = strlen (prefix);
+	const char *item = v;
 
-		cur_die = nextdie;
+	if (strncmp (k, prefix, plen)) {
+		return 1;
 	}
-
-	if (cur_die != in_die) {
-		dwarf_dealloc (dbg, cur_die, DW_DLA_DIE);
+	while (item && *item) {
+		ut64 size = 0, addr = 0;
+		if (sscanf (item, "%"PFMT64u"@0x%"PFMT64x, &size, &addr) == 2) {
+			r_cons_printf ("f sym.%s %"PFMT64u" @ 0x%"PFMT64x"\n", k + plen, size, addr);
+		}
+		item = strchr (item, ',');
+		if (item) {
+			item++;
+		}
 	}
-
-	return res;
+	return 1;
 }
 
 /*
@@ -1824,57 +1762,48 @@ static int print_type_and_size (RCore *core, ut64 sdboffset, ut64 startaddr, cha
 }
 
 /* store_die_offset
- * stores the struct name and its offset in Sdb if struct entry is not empty and not anon
+ * stores the type name (prefixed with prefix) and the DIE offset in Sdb if the entry is not empty and not anon
  * Return Value:
  * 	-1: cannot retreive offset
  * 	 0: Success OR Empty struct entry
  * 	 1: Does not have name entry
  */
-static int store_die_offset (Dwarf_Die die) {
+static int store_die_offset (Dwarf_Die die, const char *prefix, Dwarf_Off off) {
 	int res = DW_DLV_ERROR;
 	char *diename = NULL;
-	Dwarf_Off off;
+	char key[512];
 
 	res = get_dwarf_diename (die, &diename, NULL);
 	if (res == DW_DLV_ERROR || res == DW_DLV_NO_ENTRY) {
 		return 1;
 	}
 
-	res = DW_DLV_ERROR;
-	res = dwarf_dieoffset (die, &off, NULL);
-	if (res == DW_DLV_ERROR) {
-		printf ("ERROR: store_die_offset\n");
-		return -1;
+	if (!off) {
+		res = dwarf_dieoffset (die, &off, NULL);
+		if (res == DW_DLV_ERROR) {
+			printf ("ERROR: store_die_offset\n");
+			dwarf_dealloc (dbg, diename, DW_DLA_STRING);
+			return -1;
+		}
 	}
 
-	sdb_num_add (s, (const char *)diename, off, 0);
+	snprintf (key, sizeof (key), "%s%s", prefix, diename);
+	sdb_num_add (s, key, off, 0);
 
 	dwarf_dealloc (dbg, diename, DW_DLA_STRING);
 	return 0;
 }
 
-/*
- * is_struct_type
- * if the tag of die has DW_TAG_structure_type, return 1 else return 0
- */
-static int is_struct_type (Dwarf_Die die) {
-	int res = DW_DLV_ERROR;
-	Dwarf_Half tag;
-
-	res = dwarf_tag (die, &tag, NULL);
-	if (res == DW_DLV_ERROR) {
-		printf ("ERROR: is_struct_type\n");
-	}
-
-	return (res == DW_DLV_OK && tag == DW_TAG_structure_type) ? 1 : 0;
-}
-
-/* First parse
+/* index_cu
  * > Parse through all the DIEs which are directly the child of CU
  * > Does not look at the child DIE's
- * > Store the struct names along with their DIE offset in sdb
+ * > Store in sdb, in a single pass:
+ *   - struct names => DIE offset
+ *   - "union.<name>" => DIE offset
+ *   - "typedef.<name>" => DIE offset of the aliased type
+ *   - "glob.<name>" and "func.<name>" => size@addr list (see index_global)
  */
-static int first_parse (Dwarf_Die in_die) {
+static int index_cu (Dwarf_Die in_die) {
 	Dwarf_Die cur_die = in_die;
 	Dwarf_Die nextdie = 0;	//can be child or sibling
 	int res = DW_DLV_ERROR;
@@ -1888,10 +1817,47 @@ static int first_parse (Dwarf_Die in_die) {
 
 	cur_die = nextdie;
 	while (1) {
+		Dwarf_Half tag = 0;
+		Dwarf_Off typeoff = 0;
 		nextdie = 0;
-		
-		if (is_struct_type (cur_die) && !is_declaration (cur_die)) {
-			store_die_offset (cur_die);
+
+		if (dwarf_tag (cur_die, &tag, NULL) == DW_DLV_OK) {
+			switch (tag) {
+			case DW_TAG_structure_type:
+				if (!is_declaration (cur_die)) {
+					store_die_offset (cur_die, "", 0);
+				}
+				break;
+			case DW_TAG_union_type:
+				if (!is_declaration (cur_die)) {
+					store_die_offset (cur_die, "union.", 0);
+				}
+				break;
+			case DW_TAG_typedef:
+				// only typedefs of structs/unions can be printed by idd
+				if (get_type_die_offset (cur_die, &typeoff, NULL) == DW_DLV_OK) {
+					Dwarf_Die typedie = 0;
+					Dwarf_Half typetag = 0;
+					if (dwarf_offdie (dbg, typeoff, &typedie, NULL) == DW_DLV_OK) {
+						if (dwarf_tag (typedie, &typetag, NULL) == DW_DLV_OK
+							&& (typetag == DW_TAG_structure_type || typetag == DW_TAG_union_type)) {
+							store_die_offset (cur_die, "typedef.", typeoff);
+						}
+						dwarf_dealloc (dbg, typedie, DW_DLA_DIE);
+					}
+				}
+				break;
+			case DW_TAG_variable:
+				if (!is_declaration (cur_die)) {
+					index_global (cur_die);
+				}
+				break;
+			case DW_TAG_subprogram:
+				index_function (cur_die);
+				break;
+			}
+		} else {
+			printf ("ERROR: index_cu :: dwarf_tag\n");
 		}
 
 		res = dwarf_siblingof (dbg, cur_die, &nextdie, NULL);
@@ -1915,8 +1881,13 @@ static int first_parse (Dwarf_Die in_die) {
 	return 0;
 }
 
-static int read_cu_list (int flag) {
+/* enumerate_cus
+ * collect the DIE offset of every compilation unit. Only the CU headers and
+ * CU DIEs are read, the children are parsed later by the workers.
+ */
+static int enumerate_cus (Dwarf_Off **cus, int *ncus) {
 	int res;
+	int cap = 0;
 	Dwarf_Half address_size = 0;
 	Dwarf_Half version_stamp = 0;
 	Dwarf_Unsigned abbrev_offset = 0;
@@ -1925,7 +1896,10 @@ static int read_cu_list (int flag) {
 
 	Dwarf_Die cu_die = 0;
 
+	*cus = NULL;
+	*ncus = 0;
 	for (;;) {
+		Dwarf_Off off = 0;
 		cu_die = 0;
 		res = DW_DLV_ERROR;
 
@@ -1950,15 +1924,247 @@ static int read_cu_list (int flag) {
 			return -1;
 		}
 
-		if (flag == 0) {
-			first_parse (cu_die);
-		} else if (flag == 1) {
-			load_globals (cu_die);
-		} else if (flag == 2) {
-			load_functions (cu_die);
-		}
+		res = dwarf_dieoffset (cu_die, &off, NULL);
 		dwarf_dealloc (dbg, cu_die, DW_DLA_DIE);
+		if (res != DW_DLV_OK) {
+			printf ("ERROR: enumerate_cus :: dwarf_dieoffset\n");
+			continue;
+		}
+		if (*ncus == cap) {
+			Dwarf_Off *tmp;
+			cap = cap ? cap * 2 : 1024;
+			tmp = realloc (*cus, cap * sizeof (Dwarf_Off));
+			if (!tmp) {
+				return -1;
+			}
+			*cus = tmp;
+		}
+		(*cus)[(*ncus)++] = off;
+	}
+}
+
+#define INDEX_MAX_WORKERS 64
+#define INDEX_CHUNKS_PER_WORKER 8
+
+typedef struct {
+	const char *path;
+	Dwarf_Off *cus;
+	int ncus;
+	Sdb **chunks;
+	int nchunks;
+	int chunksize;
+	int first;
+	int step;
+	int res;
+} IndexWorker;
+
+/* index_worker
+ * parse the CUs of the chunks first, first + step, ... with a libdwarf handle
+ * of its own, each chunk going to its own sdb.
+ */
+static int index_worker (RThread *th) {
+	IndexWorker *w = (IndexWorker *)th->user;
+	int wfd, c, i;
+
+	wfd = open (w->path, O_RDONLY);
+	if (wfd < 0 || dwarf_init (wfd, DW_DLC_READ, 0, 0, &dbg, NULL) != DW_DLV_OK) {
+		if (wfd >= 0) {
+			close (wfd);
+		}
+		w->res = -1;
+		return 0;
+	}
+	for (c = w->first; c < w->nchunks; c += w->step) {
+		int end = R_MIN (w->ncus, (c + 1) * w->chunksize);
+		s = w->chunks[c] = sdb_new0 ();
+		for (i = c * w->chunksize; i < end; i++) {
+			Dwarf_Die cu_die = 0;
+			if (dwarf_offdie (dbg, w->cus[i], &cu_die, NULL) != DW_DLV_OK) {
+				printf ("ERROR: index_worker :: dwarf_offdie\n");
+				continue;
+			}
+			index_cu (cu_die);
+			dwarf_dealloc (dbg, cu_die, DW_DLA_DIE);
+		}
+	}
+	s = NULL;
+	dwarf_finish (dbg, NULL);
+	dbg = NULL;
+	close (wfd);
+	return 0;
+}
+
+/* merge_cb
+ * copy one chunk entry into the shared index: the first definition of a
+ * type wins, like with a sequential walk, and address lists are appended.
+ */
+static int merge_cb (void *user, const char *k, const char *v) {
+	Sdb *dst = (Sdb *)user;
+	const char *old = sdb_const_get (dst, k, 0);
+
+	if (!old) {
+		sdb_set (dst, k, v, 0);
+	} else if (!strncmp (k, "glob.", 5) || !strncmp (k, "func.", 5)) {
+		char *both = r_str_newf ("%s,%s", old, v);
+		sdb_set (dst, k, both, 0);
+		free (both);
+	}
+	return 1;
+}
+
+static int index_nworkers () {
+	int n = 1;
+#if __UNIX__
+	n = (int)sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+	return R_MAX (1, R_MIN (n, INDEX_MAX_WORKERS));
+}
+
+/* read_cu_list
+ * build the index in s: the CU offsets are enumerated first, then the CUs
+ * are parsed in chunks by a pool of workers and the per chunk results are
+ * merged in CU order.
+ */
+static int read_cu_list (const char *path) {
+	RThread *threads[INDEX_MAX_WORKERS] = { 0 };
+	IndexWorker workers[INDEX_MAX_WORKERS];
+	Dwarf_Off *cus = NULL;
+	Sdb **chunks = NULL;
+	int i, ncus = 0, nchunks, chunksize, nworkers = index_nworkers ();
+	int res;
+	ut64 t0, t1, t2, t3;
+
+	t0 = r_sys_now ();
+	res = enumerate_cus (&cus, &ncus);
+	if (res != 0 || ncus < 1) {
+		free (cus);
+		return res;
+	}
+	t1 = r_sys_now ();
+
+	nworkers = R_MIN (nworkers, ncus);
+	chunksize = R_MAX (1, ncus / (nworkers * INDEX_CHUNKS_PER_WORKER));
+	nchunks = (ncus + chunksize - 1) / chunksize;
+	chunks = calloc (nchunks, sizeof (Sdb *));
+	if (!chunks) {
+		free (cus);
+		return -1;
+	}
+	for (i = 0; i < nworkers; i++) {
+		IndexWorker *w = &workers[i];
+		w->path = path;
+		w->cus = cus;
+		w->ncus = ncus;
+		w->chunks = chunks;
+		w->nchunks = nchunks;
+		w->chunksize = chunksize;
+		w->first = i;
+		w->step = nworkers;
+		w->res = 0;
+		threads[i] = r_th_new (index_worker, w, 0);
+	}
+	for (i = 0; i < nworkers; i++) {
+		if (threads[i]) {
+			r_th_wait (threads[i]);
+			r_th_free (threads[i]);
+		} else {
+			res = -1;
+		}
+		if (workers[i].res) {
+			res = workers[i].res;
+		}
 	}
+	t2 = r_sys_now ();
+
+	for (i = 0; i < nchunks; i++) {
+		if (chunks[i]) {
+			sdb_foreach (chunks[i], merge_cb, s);
+			sdb_free (chunks[i]);
+		}
+	}
+	t3 = r_sys_now ();
+
+	eprintf ("DWARF: %d CUs indexed with %d threads: enumerate %.3fs, parse %.3fs, merge %.3fs\n",
+		ncus, nworkers, (t1 - t0) / 1000000.0, (t2 - t1) / 1000000.0, (t3 - t2) / 1000000.0);
+	free (chunks);
+	free (cus);
+	return res;
+}
+
+/* get_index_key
+ * name of the on-disk index: the GNU build-id of the binary when present,
+ * else a hash of its path, size and modification time.
+ */
+static char *get_index_key (const char *path, int infd) {
+	char *key = NULL;
+	Elf *elf;
+	Elf_Scn *scn = NULL;
+	struct stat st;
+
+	elf_version (EV_CURRENT);
+	elf = elf_begin (infd, ELF_C_READ, NULL);
+	while (elf && !key && (scn = elf_nextscn (elf, scn))) {
+		GElf_Shdr shdr;
+		Elf_Data *data;
+		GElf_Nhdr nhdr;
+		size_t off = 0, name_off, desc_off;
+
+		if (!gelf_getshdr (scn, &shdr) || shdr.sh_type != SHT_NOTE) {
+			continue;
+		}
+		data = elf_getdata (scn, NULL);
+		while (data && !key && (off = gelf_getnote (data, off, &nhdr, &name_off, &desc_off)) > 0) {
+			if (nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4
+				&& !memcmp ((char *)data->d_buf + name_off, "GNU", 4)) {
+				const ut8 *id = (const ut8 *)data->d_buf + desc_off;
+				size_t i;
+				key = calloc (1, nhdr.n_descsz * 2 + 1);
+				for (i = 0; key && i < nhdr.n_descsz; i++) {
+					sprintf (key + i * 2, "%02x", id[i]);
+				}
+			}
+		}
+	}
+	if (elf) {
+		elf_end (elf);
+	}
+	if (!key && !fstat (infd, &st)) {
+		key = r_str_newf ("%08x-%"PFMT64x"-%"PFMT64x, sdb_hash (path),
+			(ut64)st.st_size, (ut64)st.st_mtime);
+	}
+	return key;
+}
+
+/* open_index
+ * load the on-disk index for the file, building it with a single pass
+ * over all the CUs when missing or stale.
+ */
+static int open_index (const char *path) {
+	char *key = get_index_key (path, fd);
+	char *dir = r_str_home (R2_HOME_CACHEDIR R_SYS_DIR "dwarf");
+	char *file = key ? r_str_newf ("%s%s%s.sdb", dir, R_SYS_DIR, key) : NULL;
+	const char *version;
+	int res = 0;
+
+	s = sdb_new (NULL, file, 0);
+	version = sdb_const_get (s, DWARF_INDEX_KEY, 0);
+	if (!version || strcmp (version, DWARF_INDEX_VERSION)) {
+		ut64 t0;
+		sdb_reset (s);
+		res = read_cu_list (path);
+		if (!res && file) {
+			t0 = r_sys_now ();
+			sdb_set (s, DWARF_INDEX_KEY, DWARF_INDEX_VERSION, 0);
+			if (r_sys_mkdirp (dir)) {
+				sdb_sync (s);
+			}
+			eprintf ("DWARF: index saved in %.3fs\n", (r_sys_now () - t0) / 1000000.0);
+		}
+	}
+	free (key);
+	free (dir);
+	free (file);
+	return res;
 }
 
 static const char* getargpos (const char *buf, int pos) {
@@ -1982,8 +2188,6 @@ static int r_cmd_dwarf_init (void *user, const char *input) {
 	Dwarf_Handler errhand = 0;
 	Dwarf_Ptr errarg = 0;
 
-	s = sdb_new0 ();
-
 	fd = open (input, O_RDONLY);
 	if (fd < 0) {
 		return false;
@@ -1996,10 +2200,14 @@ static int r_cmd_dwarf_init (void *user, const char *input) {
 		return false;
 	}
 
-	res = read_cu_list (0);
+	res = open_index (input);
 	if (res != 0) {
 		close (fd);
+		fd = -1;
 		res = dwarf_finish (dbg, NULL);
+		dbg = NULL;
+		sdb_free (s);
+		s = NULL;
 		return false;
 	}
 
@@ -2058,6 +2266,16 @@ static int r_cmd_dwarf_call (void *user, const char *input) {
 		}
 
 		sdboffset = sdb_num_get (s, structname, 0);
+		if (!sdboffset) {
+			char *key = r_str_newf ("union.%s", structname);
+			sdboffset = sdb_num_get (s, key, 0);
+			free (key);
+		}
+		if (!sdboffset) {
+			char *key = r_str_newf ("typedef.%s", structname);
+			sdboffset = sdb_num_get (s, key, 0);
+			free (key);
+		}
 		if ((*input != 't') && sdboffset == 0) {
 			printf ("DWARF: invalid offset for struct %s\n", structname);
 		    return true;
@@ -2143,10 +2361,10 @@ static int r_cmd_dwarf_call (void *user, const char *input) {
 		{
 			switch (*(input + 1)) {
 			case 'f':
-				read_cu_list (2);
+				sdb_foreach (s, print_flags_cb, "func.");
 				break;
 			case 'g':
-				read_cu_list (1);
+				sdb_foreach (s, print_flags_cb, "glob.");
 				break;
 			default:
 				eprintf ("invalid usage\n");
@@ -2221,7 +2439,7 @@ static int r_cmd_dwarf_fini () {
 			printf ("dwarf_finish failed\n");
 		}
 
-		sdb_close (s);
+		sdb_free (s);
 		close (fd);
 
 		fd = -1;
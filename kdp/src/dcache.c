@@ -17,22 +17,21 @@
    You should have received a copy of the GNU General Public License
    along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
 #include "defs.h"
 #include "dcache.h"
-#include "gdbcmd.h"
-#include "gdbcore.h"
-#include "target-dcache.h"
-#include "inferior.h"
 #include "splay-tree.h"
 
-/* Commands with a prefix of `{set,show} dcache'.  */
-static struct cmd_list_element *dcache_set_list = NULL;
-static struct cmd_list_element *dcache_show_list = NULL;
+#define xmalloc malloc
+#define xfree free
 
 /* The data cache could lead to incorrect results because it doesn't
    know about volatile variables, thus making it impossible to debug
-   functions which use memory mapped I/O devices.  Set the nocache
-   memory region attribute in those cases.
+   functions which use memory mapped I/O devices.  Flush it (or turn it
+   off) when looking at those.
 
    In general the dcache speeds up performance.  Some speed improvement
    comes from the actual caching mechanism, but the major gain is in
@@ -56,31 +55,17 @@ static struct cmd_list_element *dcache_show_list = NULL;
    line is valid or not depends on where it is stored in the dcache_struct;
    there is no per-block valid flag.  */
 
-/* NOTE: Interaction of dcache and memory region attributes
-
-   As there is no requirement that memory region attributes be aligned
-   to or be a multiple of the dcache page size, dcache_read_line() and
-   dcache_write_line() must break up the page by memory region.  If a
-   chunk does not have the cache attribute set, an invalid memory type
-   is set, etc., then the chunk is skipped.  Those chunks are handled
-   in target_xfer_memory() (or target_xfer_memory_partial()).
-
-   This doesn't occur very often.  The most common occurance is when
-   the last bit of the .text segment and the first bit of the .data
-   segment fall within the same dcache page with a ro/cacheable memory
-   region defined for the .text segment and a rw/non-cacheable memory
-   region defined for the .data segment.  */
-
-/* The maximum number of lines stored.  The total size of the cache is
-   equal to DCACHE_SIZE times LINE_SIZE.  */
+/* The default maximum number of lines stored.  The total size of the
+   cache is equal to DCACHE_SIZE times LINE_SIZE.  */
 #define DCACHE_DEFAULT_SIZE 4096
-static unsigned dcache_size = DCACHE_DEFAULT_SIZE;
 
 /* The default size of a cache line.  Smaller values reduce the time taken to
    read a single byte and make the cache more granular, but increase
    overhead and reduce the effectiveness of the cache as a prefetcher.  */
 #define DCACHE_DEFAULT_LINE_SIZE 64
-static unsigned dcache_line_size = DCACHE_DEFAULT_LINE_SIZE;
+
+/* Largest line size accepted; lines never span more than a page.  */
+#define DCACHE_MAX_LINE_SIZE 4096
 
 /* Each cache block holds LINE_SIZE bytes of data
    starting at a multiple-of-LINE_SIZE address.  */
@@ -110,34 +95,25 @@ struct dcache_struct
   struct dcache_block *freelist;
 
   /* The number of in-use lines in the cache.  */
-  int size;
+  unsigned size;
+  unsigned max_size;	/* maximum number of lines.  */
   CORE_ADDR line_size;  /* current line_size.  */
 
-  /* The ptid of last inferior to use cache or null_ptid.  */
-  ptid_t ptid;
+  /* Where lines come from.  */
+  dcache_read_func *read_func;
+  void *data;
+
+  /* Lines served from the cache and lines fetched from the target.  */
+  unsigned long hits;
+  unsigned long misses;
 };
 
 typedef void (block_func) (struct dcache_block *block, void *param);
 
 static struct dcache_block *dcache_hit (DCACHE *dcache, CORE_ADDR addr);
 
-static int dcache_read_line (DCACHE *dcache, struct dcache_block *db);
-
 static struct dcache_block *dcache_alloc (DCACHE *dcache, CORE_ADDR addr);
 
-static void dcache_info (char *exp, int tty);
-
-void _initialize_dcache (void);
-
-static int dcache_enabled_p = 0; /* OBSOLETE */
-
-static void
-show_dcache_enabled_p (struct ui_file *file, int from_tty,
-		       struct cmd_list_element *c, const char *value)
-{
-  fprintf_filtered (file, _("Deprecated remotecache flag is %s.\n"), value);
-}
-
 /* Add BLOCK to circular block list BLIST, behind the block at *BLIST.
    *BLIST is not updated (unless it was previously NULL of course).
    This is for the least-recently-allocated list's sake:
@@ -251,17 +227,39 @@ dcache_invalidate (DCACHE *dcache)
 
   dcache->oldest = NULL;
   dcache->size = 0;
-  dcache->ptid = null_ptid;
+}
+
+/* Set the maximum number of lines in DCACHE.  */
+
+int
+dcache_set_size (DCACHE *dcache, unsigned size)
+{
+  if (size == 0)
+    return 0;
+  dcache_invalidate (dcache);
+  dcache->max_size = size;
+  return 1;
+}
+
+/* Set the line size of DCACHE.  */
 
-  if (dcache->line_size != dcache_line_size)
+int
+dcache_set_line_size (DCACHE *dcache, unsigned line_size)
+{
+  if (line_size < 2 || line_size > DCACHE_MAX_LINE_SIZE
+      || (line_size & (line_size - 1)) != 0)
+    return 0;
+
+  dcache_invalidate (dcache);
+  if (dcache->line_size != line_size)
     {
-      /* We've been asked to use a different line size.
-	 All of our freelist blocks are now the wrong size, so free them.  */
+      /* All of our freelist blocks are now the wrong size, so free them.  */
 
       for_each_block (&dcache->freelist, free_block, dcache);
       dcache->freelist = NULL;
-      dcache->line_size = dcache_line_size;
+      dcache->line_size = line_size;
     }
+  return 1;
 }
 
 /* Invalidate the line associated with ADDR.  */
@@ -299,53 +297,33 @@ dcache_hit (DCACHE *dcache, CORE_ADDR addr)
   return db;
 }
 
-/* Fill a cache line from target memory.
-   The result is 1 for success, 0 if the (entire) cache line
-   wasn't readable.  */
+/* Fill NLINES consecutive cache lines starting at line address ADDR
+   with a single read from the target.  Returns the number of lines
+   filled; lines past a short read are left out of the cache.  */
 
 static int
-dcache_read_line (DCACHE *dcache, struct dcache_block *db)
+dcache_read_lines (DCACHE *dcache, CORE_ADDR addr, int nlines)
 {
-  CORE_ADDR memaddr;
-  gdb_byte *myaddr;
-  int len;
-  int res;
-  int reg_len;
-  struct mem_region *region;
-
-  len = dcache->line_size;
-  memaddr = db->addr;
-  myaddr  = db->data;
-
-  while (len > 0)
-    {
-      /* Don't overrun if this block is right at the end of the region.  */
-      region = lookup_mem_region (memaddr);
-      if (region->hi == 0 || memaddr + len < region->hi)
-	reg_len = len;
-      else
-	reg_len = region->hi - memaddr;
+  int len = nlines * dcache->line_size;
+  gdb_byte *buf;
+  int got, i;
 
-      /* Skip non-readable regions.  The cache attribute can be ignored,
-         since we may be loading this for a stack access.  */
-      if (region->attrib.mode == MEM_WO)
-	{
-	  memaddr += reg_len;
-	  myaddr  += reg_len;
-	  len     -= reg_len;
-	  continue;
-	}
+  buf = xmalloc (len);
+  if (buf == NULL)
+    return 0;
 
-      res = target_read_raw_memory (memaddr, myaddr, reg_len);
-      if (res != 0)
-	return 0;
+  got = (*dcache->read_func) (dcache->data, addr, buf, len);
+
+  for (i = 0; (i + 1) * (int) dcache->line_size <= got; i++)
+    {
+      struct dcache_block *db = dcache_alloc (dcache, addr + (i * dcache->line_size));
 
-      memaddr += reg_len;
-      myaddr += reg_len;
-      len -= reg_len;
+      memcpy (db->data, buf + (i * dcache->line_size), dcache->line_size);
+      dcache->misses++;
     }
 
-  return 1;
+  xfree (buf);
+  return i;
 }
 
 /* Get a free cache block, put or keep it on the valid list,
@@ -356,7 +334,7 @@ dcache_alloc (DCACHE *dcache, CORE_ADDR addr)
 {
   struct dcache_block *db;
 
-  if (dcache->size >= dcache_size)
+  if (dcache->size >= dcache->max_size)
     {
       /* Evict the least recently allocated line.  */
       db = dcache->oldest;
@@ -388,28 +366,6 @@ dcache_alloc (DCACHE *dcache, CORE_ADDR addr)
   return db;
 }
 
-/* Using the data cache DCACHE, store in *PTR the contents of the byte at
-   address ADDR in the remote machine.  
-
-   Returns 1 for success, 0 for error.  */
-
-static int
-dcache_peek_byte (DCACHE *dcache, CORE_ADDR addr, gdb_byte *ptr)
-{
-  struct dcache_block *db = dcache_hit (dcache, addr);
-
-  if (!db)
-    {
-      db = dcache_alloc (dcache, addr);
-
-      if (!dcache_read_line (dcache, db))
-         return 0;
-    }
-
-  *ptr = db->data[XFORM (dcache, addr)];
-  return 1;
-}
-
 /* Write the byte at PTR into ADDR in the data cache.
 
    The caller should have written the data through to target memory
@@ -442,11 +398,13 @@ dcache_splay_tree_compare (splay_tree_key a, splay_tree_key b)
 /* Allocate and initialize a data cache.  */
 
 DCACHE *
-dcache_init (void)
+dcache_init (dcache_read_func *read_func, void *data)
 {
   DCACHE *dcache;
 
   dcache = (DCACHE *) xmalloc (sizeof (*dcache));
+  if (dcache == NULL)
+    return NULL;
 
   dcache->tree = splay_tree_new (dcache_splay_tree_compare,
 				 NULL,
@@ -455,82 +413,100 @@ dcache_init (void)
   dcache->oldest = NULL;
   dcache->freelist = NULL;
   dcache->size = 0;
-  dcache->line_size = dcache_line_size;
-  dcache->ptid = null_ptid;
+  dcache->max_size = DCACHE_DEFAULT_SIZE;
+  dcache->line_size = DCACHE_DEFAULT_LINE_SIZE;
+  dcache->read_func = read_func;
+  dcache->data = data;
+  dcache->hits = 0;
+  dcache->misses = 0;
 
   return dcache;
 }
 
 
 /* Read LEN bytes from dcache memory at MEMADDR, transferring to
-   debugger address MYADDR.  If the data is presently cached, this
-   fills the cache.  Arguments/return are like the target_xfer_partial
-   interface.  */
+   debugger address MYADDR.  If the data is not presently cached, this
+   fills the cache.
 
-enum target_xfer_status
-dcache_read_memory_partial (struct target_ops *ops, DCACHE *dcache,
+   Runs of missing lines are fetched with one call to the read
+   function rather than a line at a time, so a cold `px 4096' costs
+   one (pipelined) transfer instead of one round trip per line.  A run
+   never exceeds half the cache, so a large read cannot evict the lines
+   it has just brought in.  */
+
+int
+dcache_read_memory_partial (DCACHE *dcache,
 			    CORE_ADDR memaddr, gdb_byte *myaddr,
 			    ULONGEST len, ULONGEST *xfered_len)
 {
-  ULONGEST i;
+  ULONGEST i = 0;
+  int max_run = dcache->max_size / 2;
 
-  /* If this is a different inferior from what we've recorded,
-     flush the cache.  */
+  if (max_run < 1)
+    max_run = 1;
 
-  if (! ptid_equal (inferior_ptid, dcache->ptid))
+  while (i < len)
     {
-      dcache_invalidate (dcache);
-      dcache->ptid = inferior_ptid;
-    }
+      CORE_ADDR addr = memaddr + i;
+      struct dcache_block *db = dcache_hit (dcache, addr);
+      ULONGEST n;
 
-  for (i = 0; i < len; i++)
-    {
-      if (!dcache_peek_byte (dcache, memaddr + i, myaddr + i))
+      if (!db)
 	{
-	  /* That failed.  Discard its cache line so we don't have a
-	     partially read line.  */
-	  dcache_invalidate_line (dcache, memaddr + i);
-	  break;
+	  CORE_ADDR line = MASK (dcache, addr);
+	  CORE_ADDR end = memaddr + len;
+	  int nlines = 1;
+
+	  while (nlines < max_run
+		 && line + (nlines * dcache->line_size) < end
+		 && !splay_tree_lookup (dcache->tree,
+					(splay_tree_key) (line + (nlines * dcache->line_size))))
+	    nlines++;
+
+	  if (dcache_read_lines (dcache, line, nlines) == 0)
+	    break;
+	  continue;
 	}
+
+      dcache->hits++;
+      n = dcache->line_size - XFORM (dcache, addr);
+      if (n > len - i)
+	n = len - i;
+      memcpy (myaddr + i, db->data + XFORM (dcache, addr), n);
+      i += n;
     }
 
   if (i == 0)
     {
       /* Even though reading the whole line failed, we may be able to
 	 read a piece starting where the caller wanted.  */
-      return ops->to_xfer_partial (ops, TARGET_OBJECT_MEMORY, NULL,
-				   myaddr, NULL, memaddr, len,
-				   xfered_len);
-    }
-  else
-    {
-      *xfered_len = i;
-      return TARGET_XFER_OK;
+      int got = (*dcache->read_func) (dcache->data, memaddr, myaddr, len);
+      if (got <= 0)
+	return 0;
+      i = got;
     }
+
+  *xfered_len = i;
+  return 1;
 }
 
 /* FIXME: There would be some benefit to making the cache write-back and
    moving the writeback operation to a higher layer, as it could occur
    after a sequence of smaller writes have been completed (as when a stack
-   frame is constructed for an inferior function call).  Note that only
-   moving it up one level to target_xfer_memory[_partial]() is not
-   sufficient since we want to coalesce memory transfers that are
-   "logically" connected but not actually a single call to one of the
-   memory transfer functions.  */
+   frame is constructed for an inferior function call).  */
 
 /* Just update any cache lines which are already present.  This is
-   called by the target_xfer_partial machinery when writing raw
-   memory.  */
+   called after writing raw memory.  */
 
 void
-dcache_update (DCACHE *dcache, enum target_xfer_status status,
+dcache_update (DCACHE *dcache, int ok,
 	       CORE_ADDR memaddr, const gdb_byte *myaddr,
 	       ULONGEST len)
 {
   ULONGEST i;
 
   for (i = 0; i < len; i++)
-    if (status == TARGET_XFER_OK)
+    if (ok)
       dcache_poke_byte (dcache, memaddr + i, myaddr + i);
     else
       {
@@ -540,198 +516,16 @@ dcache_update (DCACHE *dcache, enum target_xfer_status status,
       }
 }
 
-/* Print DCACHE line INDEX.  */
-
-static void
-dcache_print_line (DCACHE *dcache, int index)
-{
-  splay_tree_node n;
-  struct dcache_block *db;
-  int i, j;
-
-  if (dcache == NULL)
-    {
-      printf_filtered (_("No data cache available.\n"));
-      return;
-    }
-
-  n = splay_tree_min (dcache->tree);
-
-  for (i = index; i > 0; --i)
-    {
-      if (!n)
-	break;
-      n = splay_tree_successor (dcache->tree, n->key);
-    }
-
-  if (!n)
-    {
-      printf_filtered (_("No such cache line exists.\n"));
-      return;
-    }
-    
-  db = (struct dcache_block *) n->value;
-
-  printf_filtered (_("Line %d: address %s [%d hits]\n"),
-		   index, paddress (target_gdbarch (), db->addr), db->refs);
-
-  for (j = 0; j < dcache->line_size; j++)
-    {
-      printf_filtered ("%02x ", db->data[j]);
-
-      /* Print a newline every 16 bytes (48 characters).  */
-      if ((j % 16 == 15) && (j != dcache->line_size - 1))
-	printf_filtered ("\n");
-    }
-  printf_filtered ("\n");
-}
-
-/* Parse EXP and show the info about DCACHE.  */
-
-static void
-dcache_info_1 (DCACHE *dcache, char *exp)
-{
-  splay_tree_node n;
-  int i, refcount;
-
-  if (exp)
-    {
-      char *linestart;
-
-      i = strtol (exp, &linestart, 10);
-      if (linestart == exp || i < 0)
-	{
-	  printf_filtered (_("Usage: info dcache [linenumber]\n"));
-          return;
-	}
-
-      dcache_print_line (dcache, i);
-      return;
-    }
-
-  printf_filtered (_("Dcache %u lines of %u bytes each.\n"),
-		   dcache_size,
-		   dcache ? (unsigned) dcache->line_size
-		   : dcache_line_size);
-
-  if (dcache == NULL || ptid_equal (dcache->ptid, null_ptid))
-    {
-      printf_filtered (_("No data cache available.\n"));
-      return;
-    }
-
-  printf_filtered (_("Contains data for %s\n"),
-		   target_pid_to_str (dcache->ptid));
-
-  refcount = 0;
-
-  n = splay_tree_min (dcache->tree);
-  i = 0;
-
-  while (n)
-    {
-      struct dcache_block *db = (struct dcache_block *) n->value;
-
-      printf_filtered (_("Line %d: address %s [%d hits]\n"),
-		       i, paddress (target_gdbarch (), db->addr), db->refs);
-      i++;
-      refcount += db->refs;
-
-      n = splay_tree_successor (dcache->tree, n->key);
-    }
-
-  printf_filtered (_("Cache state: %d active lines, %d hits\n"), i, refcount);
-}
-
-static void
-dcache_info (char *exp, int tty)
-{
-  dcache_info_1 (target_dcache_get (), exp);
-}
-
-static void
-set_dcache_size (char *args, int from_tty,
-		 struct cmd_list_element *c)
-{
-  if (dcache_size == 0)
-    {
-      dcache_size = DCACHE_DEFAULT_SIZE;
-      error (_("Dcache size must be greater than 0."));
-    }
-  target_dcache_invalidate ();
-}
-
-static void
-set_dcache_line_size (char *args, int from_tty,
-		      struct cmd_list_element *c)
-{
-  if (dcache_line_size < 2
-      || (dcache_line_size & (dcache_line_size - 1)) != 0)
-    {
-      unsigned d = dcache_line_size;
-      dcache_line_size = DCACHE_DEFAULT_LINE_SIZE;
-      error (_("Invalid dcache line size: %u (must be power of 2)."), d);
-    }
-  target_dcache_invalidate ();
-}
-
-static void
-set_dcache_command (char *arg, int from_tty)
-{
-  printf_unfiltered (
-     "\"set dcache\" must be followed by the name of a subcommand.\n");
-  help_list (dcache_set_list, "set dcache ", all_commands, gdb_stdout);
-}
-
-static void
-show_dcache_command (char *args, int from_tty)
-{
-  cmd_show_list (dcache_show_list, from_tty, "");
-}
+/* Show the info about DCACHE.  */
 
 void
-_initialize_dcache (void)
+dcache_info (DCACHE *dcache, FILE *fp)
 {
-  add_setshow_boolean_cmd ("remotecache", class_support,
-			   &dcache_enabled_p, _("\
-Set cache use for remote targets."), _("\
-Show cache use for remote targets."), _("\
-This used to enable the data cache for remote targets.  The cache\n\
-functionality is now controlled by the memory region system and the\n\
-\"stack-cache\" flag; \"remotecache\" now does nothing and\n\
-exists only for compatibility reasons."),
-			   NULL,
-			   show_dcache_enabled_p,
-			   &setlist, &showlist);
-
-  add_info ("dcache", dcache_info,
-	    _("\
-Print information on the dcache performance.\n\
-With no arguments, this command prints the cache configuration and a\n\
-summary of each line in the cache.  Use \"info dcache <lineno> to dump\"\n\
-the contents of a given line."));
-
-  add_prefix_cmd ("dcache", class_obscure, set_dcache_command, _("\
-Use this command to set number of lines in dcache and line-size."),
-		  &dcache_set_list, "set dcache ", /*allow_unknown*/0, &setlist);
-  add_prefix_cmd ("dcache", class_obscure, show_dcache_command, _("\
-Show dcachesettings."),
-		  &dcache_show_list, "show dcache ", /*allow_unknown*/0, &showlist);
-
-  add_setshow_zuinteger_cmd ("line-size", class_obscure,
-			     &dcache_line_size, _("\
-Set dcache line size in bytes (must be power of 2)."), _("\
-Show dcache line size."),
-			     NULL,
-			     set_dcache_line_size,
-			     NULL,
-			     &dcache_set_list, &dcache_show_list);
-  add_setshow_zuinteger_cmd ("size", class_obscure,
-			     &dcache_size, _("\
-Set number of dcache lines."), _("\
-Show number of dcache lines."),
-			     NULL,
-			     set_dcache_size,
-			     NULL,
-			     &dcache_set_list, &dcache_show_list);
+  unsigned long total = dcache->hits + dcache->misses;
+
+  fprintf (fp, "Dcache %u lines of %u bytes each.\n",
+	   dcache->max_size, (unsigned) dcache->line_size);
+  fprintf (fp, "Cache state: %u active lines, %lu hits, %lu misses (%.1f%% hit rate)\n",
+	   dcache->size, dcache->hits, dcache->misses,
+	   total ? (100.0 * dcache->hits) / total : 0.0);
 }
@@ -21,29 +21,49 @@
 #ifndef DCACHE_H
 #define DCACHE_H
 
-#include "target.h"	/* for enum target_xfer_status */
+#include <stdio.h>
+#include "defs.h"
 
 #define ULONGEST unsigned long
 #define gdb_byte unsigned char
 
 typedef struct dcache_struct DCACHE;
 
+/* Read LEN bytes of target memory at MEMADDR into MYADDR.  Returns the
+   number of bytes read, which is short (possibly 0) on error.  The
+   cache calls this with runs of whole lines, so a transport that can
+   pipeline large reads should.  */
+typedef int (dcache_read_func) (void *data, CORE_ADDR memaddr,
+				gdb_byte *myaddr, int len);
+
 /* Invalidate DCACHE.  */
 void dcache_invalidate (DCACHE *dcache);
 
-/* Initialize DCACHE.  */
-DCACHE *dcache_init (void);
+/* Initialize DCACHE, filling lines with READ_FUNC.  */
+DCACHE *dcache_init (dcache_read_func *read_func, void *data);
 
 /* Free a DCACHE.  */
 void dcache_free (DCACHE *);
 
-enum target_xfer_status
-  dcache_read_memory_partial (struct target_ops *ops, DCACHE *dcache,
-			      CORE_ADDR memaddr, gdb_byte *myaddr,
-			      ULONGEST len, ULONGEST *xfered_len);
+/* Change the maximum number of lines, or the size of each line (a
+   power of 2).  Both invalidate the cache; return 0 if the value is
+   rejected.  */
+int dcache_set_size (DCACHE *dcache, unsigned size);
+int dcache_set_line_size (DCACHE *dcache, unsigned line_size);
+
+/* Returns 1 and sets *XFERED_LEN if at least one byte at MEMADDR could
+   be read, 0 otherwise.  */
+int dcache_read_memory_partial (DCACHE *dcache,
+				CORE_ADDR memaddr, gdb_byte *myaddr,
+				ULONGEST len, ULONGEST *xfered_len);
 
-void dcache_update (DCACHE *dcache, enum target_xfer_status status,
+/* Update cached lines after LEN bytes were written at MEMADDR.  OK is
+   zero if the write failed, which discards the affected lines.  */
+void dcache_update (DCACHE *dcache, int ok,
 		    CORE_ADDR memaddr, const gdb_byte *myaddr,
 		    ULONGEST len);
 
+/* Print the cache configuration and hit rate to FP.  */
+void dcache_info (DCACHE *dcache, FILE *fp);
+
 #endif /* DCACHE_H */
@@ -0,0 +1,122 @@
+/*
+ * kdp-dump.c - read a memory range over KDP and report throughput.
+ *
+ *	kdp-dump [-p port] [-w window] [-v] host address length [file]
+ *
+ * The range is fetched with kdp_read_memory_pipelined; -w 1 gives the
+ * old one-request-at-a-time behaviour for comparison.  With -v the data
+ * is checked against the pattern served by kdp-stub.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "defs.h"
+#include "kdp-udp.c"
+#include "kdp-transactions.c"
+#include "kdp-protocol.c"
+#include "kdp-stub.h"
+
+static int verbose = 0;
+
+static void
+dump_logger (kdp_log_level l, const char *format, ...)
+{
+  va_list ap;
+
+  if (l > (verbose > 1 ? KDP_LOG_DEBUG : KDP_LOG_WARNING)) { return; }
+
+  va_start (ap, format);
+  vfprintf (stderr, format, ap);
+  va_end (ap);
+}
+
+int
+main (int argc, char **argv)
+{
+  kdp_connection c;
+  kdp_return_t kdpret;
+  unsigned long long t0, t1;
+  unsigned long addr;
+  unsigned char *buf;
+  size_t len, nread = 0, i;
+  int port = 41139, window = KDP_DEFAULT_WINDOW * 4;
+  int opt, bad = 0;
+  double secs;
+
+  while ((opt = getopt (argc, argv, "p:w:v")) != -1) {
+    switch (opt) {
+    case 'p': port = atoi (optarg); break;
+    case 'w': window = atoi (optarg); break;
+    case 'v': verbose++; break;
+    default: argc = 0; break;
+    }
+  }
+  if (argc - optind < 3) {
+    eprintf ("usage: kdp-dump [-p port] [-w window] [-v] host address length [file]\n");
+    return 1;
+  }
+
+  addr = strtoul (argv[optind + 1], NULL, 0);
+  len = strtoul (argv[optind + 2], NULL, 0);
+  buf = (unsigned char *) malloc (len ? len : 1);
+  if (buf == NULL) { return 1; }
+
+  memset (&c, 0, sizeof (c));
+  kdpret = kdp_create (&c, dump_logger, argv[optind], port, 5000, 10);
+  if (kdpret != RR_SUCCESS) {
+    eprintf ("kdp-dump: unable to create connection: %s\n", kdp_return_string (kdpret));
+    return 1;
+  }
+  kdp_set_little_endian (&c);
+  kdp_set_window (&c, window);
+
+  kdpret = kdp_connect (&c);
+  if (kdpret != RR_SUCCESS) {
+    eprintf ("kdp-dump: unable to connect: %s\n", kdp_return_string (kdpret));
+    return 1;
+  }
+
+  t0 = kdp_now_us ();
+  kdpret = kdp_read_memory_pipelined (&c, addr, buf, len, &nread);
+  t1 = kdp_now_us ();
+  secs = (t1 - t0) / 1000000.0;
+
+  printf ("read %lu of %lu bytes in %.3fs (%.1f KiB/s)\n",
+	  (unsigned long) nread, (unsigned long) len, secs,
+	  secs > 0 ? (nread / 1024.0) / secs : 0.0);
+  printf ("%lu requests, %lu retransmitted, window %u, rtt %uus\n",
+	  c.sent, c.resent, c.window, c.srtt);
+  if (kdpret != RR_SUCCESS) {
+    eprintf ("kdp-dump: %s\n", kdp_return_string (kdpret));
+  }
+
+  if (verbose) {
+    for (i = 0; i < nread; i++) {
+      unsigned long a = addr + i;
+      if (buf[i] != KDP_STUB_BYTE (a)) {
+	if (bad++ < 8) {
+	  eprintf ("kdp-dump: mismatch at 0x%lx: 0x%02x\n", a, buf[i]);
+	}
+      }
+    }
+    printf ("verify: %s\n", bad ? "FAILED" : "ok");
+  }
+
+  if (argc - optind > 3) {
+    FILE *fp = fopen (argv[optind + 3], "wb");
+    if (fp == NULL || fwrite (buf, 1, nread, fp) != nread) {
+      eprintf ("kdp-dump: unable to write %s\n", argv[optind + 3]);
+      bad++;
+    }
+    if (fp != NULL) { fclose (fp); }
+  }
+
+  kdp_disconnect (&c);
+  kdp_destroy (&c);
+  free (buf);
+
+  return (kdpret != RR_SUCCESS || nread != len || bad) ? 1 : 0;
+}
@@ -357,6 +357,7 @@ kdp_return_t kdp_marshal
     case KDP_READMEM:
       len = 12 + p->readmem_reply.nbytes;
       CHECK_LEN_MAX (len, maxlen);
+      write32u (s + 8, p->readmem_reply.error, c->bigendian);
       memcpy (s + 12, p->readmem_reply.data, len - 12);
       break;
     case KDP_WRITEMEM:
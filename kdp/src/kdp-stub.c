@@ -0,0 +1,229 @@
+/*
+ * kdp-stub.c - minimal KDP target for exercising the client side.
+ *
+ * Answers CONNECT, DISCONNECT, HOSTINFO, SUSPEND, RESUMECPUS and
+ * READMEM on a UDP port.
+ * Memory reads return KDP_STUB_BYTE (address) for every byte.  Replies
+ * can be delayed and requests dropped to emulate a slow or lossy link:
+ *
+ *	kdp-stub [-p port] [-l latency-ms] [-j jitter-ms] [-d drop-%] [-v]
+ *
+ * With jitter, replies overtake each other just as they would on a
+ * congested network.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "defs.h"
+#include "kdp-udp.c"
+#include "kdp-protocol.c"
+#include "kdp-stub.h"
+
+#define STUB_QUEUE 512
+
+typedef struct {
+  unsigned long long due;	/* usec */
+  struct sockaddr_in to;
+  size_t len;
+  unsigned char data[KDP_MAX_PACKET_SIZE];
+} stub_reply;
+
+static stub_reply queue[STUB_QUEUE];
+static int queued = 0;
+static int verbose = 0;
+
+static void
+stub_logger (kdp_log_level l, const char *format, ...)
+{
+  va_list ap;
+
+  if (l > (verbose ? KDP_LOG_DEBUG : KDP_LOG_WARNING)) { return; }
+
+  va_start (ap, format);
+  vfprintf (stderr, format, ap);
+  va_end (ap);
+}
+
+static unsigned long long
+stub_now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return ((unsigned long long) tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+/* Build the reply to REQ in REP.  Returns 0 for requests the stub
+   does not answer. */
+
+static int
+stub_answer (kdp_pkt_t *req, kdp_pkt_t *rep, unsigned int *session_key)
+{
+  size_t i;
+
+  memset (rep, 0, KDP_MAX_PACKET_SIZE);
+  rep->hdr.request = req->hdr.request;
+  rep->hdr.is_reply = 1;
+  rep->hdr.seq = req->hdr.seq;
+  rep->hdr.key = *session_key;
+
+  switch (req->hdr.request) {
+  case KDP_CONNECT:
+    *session_key = (*session_key * 1103515245) + 12345;
+    rep->hdr.key = *session_key;
+    rep->connect_reply.error = KDP_PROTERR_SUCCESS;
+    break;
+  case KDP_DISCONNECT:
+  case KDP_SUSPEND:
+  case KDP_RESUMECPUS:
+    break;
+  case KDP_HOSTINFO:
+    rep->hostinfo_reply.cpu_mask = 1;
+    rep->hostinfo_reply.cpu_type = 7;	/* CPU_TYPE_I386 */
+    rep->hostinfo_reply.cpu_subtype = 3;
+    break;
+  case KDP_READMEM:
+    if (req->readmem_req.nbytes > KDP_MAX_DATA_SIZE) {
+      rep->readmem_reply.error = KDP_PROTERR_BAD_NBYTES;
+      rep->readmem_reply.nbytes = 0;
+      break;
+    }
+    rep->readmem_reply.error = KDP_PROTERR_SUCCESS;
+    rep->readmem_reply.nbytes = req->readmem_req.nbytes;
+    for (i = 0; i < req->readmem_req.nbytes; i++) {
+      unsigned long a = req->readmem_req.address + i;
+      rep->readmem_reply.data[i] = KDP_STUB_BYTE (a);
+    }
+    break;
+  default:
+    return 0;
+  }
+
+  return 1;
+}
+
+int
+main (int argc, char **argv)
+{
+  kdp_connection c;
+  kdp_pkt_t *req, *rep;
+  struct sockaddr_in local;
+  unsigned int session_key = 0x4b4450;
+  unsigned long received = 0, dropped = 0;
+  int port = 41139, latency = 0, jitter = 0, drop = 0;
+  int fd, opt;
+
+  while ((opt = getopt (argc, argv, "p:l:j:d:v")) != -1) {
+    switch (opt) {
+    case 'p': port = atoi (optarg); break;
+    case 'l': latency = atoi (optarg); break;
+    case 'j': jitter = atoi (optarg); break;
+    case 'd': drop = atoi (optarg); break;
+    case 'v': verbose = 1; break;
+    default:
+      eprintf ("usage: kdp-stub [-p port] [-l latency-ms] [-j jitter-ms] [-d drop-%%] [-v]\n");
+      return 1;
+    }
+  }
+
+  kdp_reset (&c);
+  c.logger = stub_logger;
+  c.bigendian = 0;
+
+  req = (kdp_pkt_t *) malloc (KDP_MAX_PACKET_SIZE);
+  rep = (kdp_pkt_t *) malloc (KDP_MAX_PACKET_SIZE);
+  if (req == NULL || rep == NULL) { return 1; }
+
+  fd = socket (AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) { perror ("socket"); return 1; }
+  memset (&local, 0, sizeof (local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = INADDR_ANY;
+  local.sin_port = htons (port);
+  if (bind (fd, (struct sockaddr *) &local, sizeof (local)) < 0) {
+    perror ("bind");
+    return 1;
+  }
+
+  srand (port);
+  eprintf ("kdp-stub: listening on udp port %d (latency %dms, jitter %dms, drop %d%%)\n",
+	   port, latency, jitter, drop);
+
+  for (;;) {
+
+    unsigned long long now = stub_now (), next = 0;
+    struct timeval tv, *ptv = NULL;
+    fd_set readfds;
+    int i, j;
+
+    /* Flush replies that are due; sleep until the next one is. */
+
+    for (i = 0, j = 0; i < queued; i++) {
+      if (queue[i].due <= now) {
+	sendto (fd, queue[i].data, queue[i].len, 0,
+		(struct sockaddr *) &queue[i].to, sizeof (queue[i].to));
+	continue;
+      }
+      if (next == 0 || queue[i].due < next) { next = queue[i].due; }
+      if (i != j) { queue[j] = queue[i]; }
+      j++;
+    }
+    queued = j;
+
+    if (next) {
+      tv.tv_sec = (next - now) / 1000000;
+      tv.tv_usec = (next - now) % 1000000;
+      ptv = &tv;
+    }
+
+    FD_ZERO (&readfds);
+    FD_SET (fd, &readfds);
+    if (select (fd + 1, &readfds, NULL, NULL, ptv) <= 0) { continue; }
+
+    {
+      unsigned char buf[KDP_MAX_PACKET_SIZE];
+      struct sockaddr_in from;
+      socklen_t fromlen = sizeof (from);
+      stub_reply *r;
+      int rlen;
+
+      rlen = recvfrom (fd, buf, sizeof (buf), 0, (struct sockaddr *) &from, &fromlen);
+      if (rlen <= 0) { continue; }
+      received++;
+
+      if (drop > 0 && (rand () % 100) < drop) {
+	dropped++;
+	continue;
+      }
+      if (kdp_unmarshal (&c, req, buf, rlen) != RR_SUCCESS) { continue; }
+      if (req->hdr.is_reply) { continue; }
+      kdp_log_packet (c.logger, KDP_LOG_DEBUG, req);
+
+      if (req->hdr.request == KDP_DISCONNECT) {
+	eprintf ("kdp-stub: disconnect after %lu requests, %lu dropped\n",
+		 received, dropped);
+      }
+      if (! stub_answer (req, rep, &session_key)) {
+	eprintf ("kdp-stub: ignoring %s request\n", kdp_req_string (req->hdr.request));
+	continue;
+      }
+      if (queued == STUB_QUEUE) {
+	dropped++;
+	continue;
+      }
+
+      r = &queue[queued];
+      if (kdp_marshal (&c, rep, r->data, KDP_MAX_PACKET_SIZE, &r->len) != RR_SUCCESS) {
+	continue;
+      }
+      r->to = from;
+      r->due = stub_now () + ((unsigned long long) latency * 1000);
+      if (jitter > 0) { r->due += (unsigned long long) (rand () % (jitter * 1000 + 1)); }
+      queued++;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef _KDB_DEBUG_STUB_H_
+#define _KDB_DEBUG_STUB_H_
+
+/* Contents of the memory served by kdp-stub: every byte is derived
+   from its own address, so a client can check what it was sent. */
+
+#define KDP_STUB_BYTE(addr) \
+  ((unsigned char) (((addr) ^ ((addr) >> 8) ^ ((addr) >> 16) ^ ((addr) >> 24)) & 0xff))
+
+#endif /* _KDB_DEBUG_STUB_H_ */
@@ -19,9 +19,28 @@
 #include "kdp-protocol.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
 
 #include "defs.h"
 
+/* kdp_return_t reuses the protocol error values; map them one by one
+   rather than converting between the two enums. */
+static kdp_return_t kdp_reply_error (kdp_error_t error)
+{
+  switch (error) {
+  case KDP_PROTERR_SUCCESS:
+    return RR_SUCCESS;
+  case KDP_PROTERR_ALREADY_CONNECTED:
+    return RR_ALREADY_CONNECTED;
+  case KDP_PROTERR_BAD_NBYTES:
+    return RR_BAD_NBYTES;
+  case KDP_PROTERR_BADFLAVOR:
+    return RR_BADFLAVOR;
+  }
+  return RR_INTERNAL;
+}
+
 static kdp_return_t kdp_exception_reply
 (kdp_connection *c, kdp_pkt_t *response)
 {
@@ -45,6 +64,50 @@ static kdp_return_t kdp_exception_reply
   return kdpret;
 }
 
+/* Acknowledge an exception that arrived while waiting for a reply and
+   stash it for kdp_exception_wait. */
+
+static kdp_return_t kdp_exception_save
+(kdp_connection *c, kdp_pkt_t *response, const char *name)
+{
+  kdp_return_t kdpret;
+
+  kdpret = kdp_exception_reply (c, response);
+  if (kdpret != RR_SUCCESS) { 
+    c->logger (KDP_LOG_ERROR, "%s: error from kdp_exception_reply: %s\n",
+	       name, kdp_return_string (kdpret));
+    return kdpret;
+  }
+	
+  if (response->hdr.seq == c->exc_seqno) {
+    c->exc_seqno = (c->exc_seqno + 1) % 256;
+    /* save for future processing */
+    if (c->saved_exception_pending) {
+      c->logger (KDP_LOG_ERROR, "%s: "
+		 "unable to save exception for future processing; ignoring\n", name);
+      c->logger (KDP_LOG_ERROR, "%s: "
+		 "exception had sequence number %d\n", name, response->hdr.seq);
+      return RR_IP_ERROR;
+    }
+    c->logger (KDP_LOG_DEBUG, "%s: "
+	       "saving exception for future processing (sequence number is %d)\n",
+	       name, response->hdr.seq);
+    memcpy (c->saved_exception, response, KDP_MAX_PACKET_SIZE);
+    c->saved_exception_pending = 1;
+  } else if (((response->hdr.seq + 1) % 256) == c->exc_seqno) {
+    /* duplicate of previous exception */
+    c->logger (KDP_LOG_DEBUG, "%s: "
+	       "ignoring duplicate of previous exception (sequence number was %d)\n",
+	       name, response->hdr.seq);
+  } else {
+    c->logger (KDP_LOG_ERROR, "%s: "
+	       "unexpected sequence number for exception (expected %d, got %d)\n",
+	       name, c->exc_seqno, response->hdr.seq);
+  }
+
+  return RR_SUCCESS;
+}
+
 kdp_return_t kdp_exception_wait
 (kdp_connection *c, kdp_pkt_t *response, int timeout)
 {
@@ -106,41 +169,9 @@ kdp_return_t kdp_reply_wait
     
     if (response->hdr.request == KDP_EXCEPTION) {
 
-      kdpret = kdp_exception_reply (c, response);
-      if (kdpret != RR_SUCCESS) { 
-	c->logger (KDP_LOG_ERROR, "kdp_reply_wait: error from kdp_exception_reply: %s\n",
-		   kdp_return_string (kdpret));
-	return kdpret;
-      }
-	
-      if (response->hdr.seq == c->exc_seqno) {
-	c->exc_seqno = (c->exc_seqno + 1) % 256;
-	/* save for future processing */
-	if (c->saved_exception_pending) {
-	  c->logger (KDP_LOG_ERROR, "kdp_reply_wait: "
-		     "unable to save exception for future processing; ignoring\n");
-	  c->logger (KDP_LOG_ERROR, "kdp_reply_wait: "
-		     "exception had sequence number %d\n", response->hdr.seq);
-	  return RR_IP_ERROR;
-	}
-	c->logger (KDP_LOG_DEBUG, "kdp_reply_wait: "
-		   "saving exception for future processing (sequence number is %d)\n",
-		   response->hdr.seq);
-	memcpy (c->saved_exception, response, KDP_MAX_PACKET_SIZE);
-	c->saved_exception_pending = 1;
-	continue;
-      } else if (((response->hdr.seq + 1) % 256) == c->exc_seqno) {
-	/* duplicate of previous exception */
-	c->logger (KDP_LOG_DEBUG, "kdp_reply_wait: "
-		   "ignoring duplicate of previous exception (sequence number was %d)\n",
-		   response->hdr.seq);
-	continue;
-      } else {
-	c->logger (KDP_LOG_ERROR, "kdp_reply_wait: "
-		   "unexpected sequence number for exception (expected %d, got %d)\n",
-		   c->exc_seqno, response->hdr.seq);
-	continue;
-      }
+      kdpret = kdp_exception_save (c, response, "kdp_reply_wait");
+      if (kdpret != RR_SUCCESS) { return kdpret; }
+      continue;
 
     } else {
 
@@ -271,7 +302,7 @@ kdp_return_t kdp_connect
 
   if (c->response->writemem_reply.error) {
     c->logger (KDP_LOG_ERROR, "kdp_connect: %s\n",
-	       kdp_return_string (c->response->connect_reply.error));
+	       kdp_return_string (kdp_reply_error (c->response->connect_reply.error)));
     return RR_CONNECT;
   }
 
@@ -295,3 +326,378 @@ kdp_return_t kdp_disconnect (kdp_connection *c)
 
   return RR_SUCCESS;
 }
+
+/* Pipelined memory reads.
+
+   kdp_transaction keeps a single request outstanding, so reading a
+   large region costs one round trip per KDP_MAX_DATA_SIZE bytes.  The
+   reader below keeps up to c->window READMEM requests in flight.
+   Replies are matched to chunks by sequence number and copied into
+   place in whatever order they arrive.  A request is presumed lost
+   when three requests sent after it have been answered, or when it
+   has been outstanding for longer than the retransmission timeout;
+   only that chunk is asked for again, under a fresh sequence number.
+
+   The window is halved on loss (at most once per window's worth of
+   requests) and grows by one for every window's worth of clean
+   replies, so a lossy or strictly sequential target degrades to the
+   one-request-at-a-time behaviour of kdp_transaction. */
+
+#define KDP_SEQ_SPACE 256
+#define KDP_MIN_RTO 10000	/* usec */
+
+typedef struct {
+  int chunk;			/* chunk this sequence number asked for; -1 if none */
+  int live;			/* still counted against the window */
+  int passed;			/* later requests answered before this one */
+  int resent;			/* chunk had been requested before */
+  unsigned long order;		/* transmission order */
+  unsigned long long sent_us;
+} kdp_pipe_slot;
+
+typedef struct {
+  kdp_pipe_slot slot[KDP_SEQ_SPACE];
+  int *live_seq;		/* per chunk: sequence number in flight, or -1 */
+  unsigned char *tries;		/* per chunk: requests sent so far */
+  unsigned char *state;		/* per chunk: 0 missing, 1 read, 2 failed */
+  int *retx;			/* chunks waiting to be re-requested */
+  int nretx;
+  unsigned int inflight;
+  unsigned int credit;		/* clean replies since the window last grew */
+  unsigned long order;		/* requests sent during this read */
+  unsigned long recover;	/* losses before this order share one halving */
+} kdp_pipe;
+
+static unsigned long long kdp_now_us (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return ((unsigned long long) tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+static unsigned long long kdp_pipe_rto (kdp_connection *c)
+{
+  unsigned long long rto = (unsigned long long) c->srtt * 4;
+  unsigned long long max = (unsigned long long) c->receive_timeout * 1000;
+
+  if (rto < KDP_MIN_RTO) { rto = KDP_MIN_RTO; }
+  if (max > 0 && rto > max) { rto = max; }
+  return rto;
+}
+
+static void kdp_pipe_lost
+(kdp_connection *c, kdp_pipe *p, int seq)
+{
+  kdp_pipe_slot *s = &p->slot[seq];
+
+  s->live = 0;
+  p->inflight--;
+  p->live_seq[s->chunk] = -1;
+  p->retx[p->nretx++] = s->chunk;
+
+  if (s->order >= p->recover) {
+    c->window = (c->window > 1) ? (c->window / 2) : 1;
+    p->recover = p->order;
+    p->credit = 0;
+    c->logger (KDP_LOG_DEBUG, "kdp_read_memory_pipelined: "
+	       "lost request %d for chunk %d; window is now %u\n",
+	       seq, s->chunk, c->window);
+  }
+}
+
+kdp_return_t kdp_read_memory_pipelined
+(kdp_connection *c, unsigned long addr, unsigned char *buf, size_t len, size_t *nread)
+{
+  kdp_return_t ret = RR_SUCCESS, err = RR_SUCCESS;
+  kdp_pipe *p;
+  size_t nchunks, next = 0, ndone = 0, i;
+  unsigned long long now, progress;
+
+  CHECK_FATAL (kdp_is_connected (c));
+  CHECK_FATAL (nread != NULL);
+
+  *nread = 0;
+  if (len == 0) { return RR_SUCCESS; }
+
+  nchunks = (len + KDP_MAX_DATA_SIZE - 1) / KDP_MAX_DATA_SIZE;
+
+  p = (kdp_pipe *) calloc (1, sizeof (kdp_pipe));
+  if (p == NULL) { return RR_RESOURCE; }
+  p->live_seq = (int *) malloc (nchunks * sizeof (int));
+  p->tries = (unsigned char *) calloc (nchunks, 1);
+  p->state = (unsigned char *) calloc (nchunks, 1);
+  p->retx = (int *) malloc (nchunks * sizeof (int));
+  if (p->live_seq == NULL || p->tries == NULL || p->state == NULL || p->retx == NULL) {
+    ret = RR_RESOURCE;
+    goto done;
+  }
+  for (i = 0; i < nchunks; i++) { p->live_seq[i] = -1; }
+  for (i = 0; i < KDP_SEQ_SPACE; i++) { p->slot[i].chunk = -1; }
+
+  if (c->window < 1) { c->window = 1; }
+  if (c->window > c->max_window) { c->window = c->max_window; }
+
+  progress = kdp_now_us ();
+
+  while (ndone < nchunks) {
+
+    unsigned long long rto, oldest;
+    kdp_pipe_slot *s;
+    int chunk, seq, wait;
+
+    /* Fill the window, retransmissions first. */
+
+    while (p->inflight < c->window) {
+
+      size_t off;
+
+      if (p->nretx > 0) {
+	chunk = p->retx[--p->nretx];
+      } else if (next < nchunks) {
+	chunk = next++;
+      } else {
+	break;
+      }
+      if (p->state[chunk] != 0) {
+	/* answered late, after it had been queued for retransmission */
+	continue;
+      }
+
+      if (p->tries[chunk] >= c->retries) {
+	c->logger (KDP_LOG_INFO, "kdp_read_memory_pipelined: "
+		   "giving up on 0x%lx after %d attempts\n",
+		   addr + (unsigned long) chunk * KDP_MAX_DATA_SIZE, p->tries[chunk]);
+	ret = RR_RECV_TIMEOUT;
+	goto done;
+      }
+
+      off = (size_t) chunk * KDP_MAX_DATA_SIZE;
+      seq = c->seqno;
+      c->seqno = (c->seqno + 1) % 256;
+
+      c->request->readmem_req.hdr.request = KDP_READMEM;
+      c->request->readmem_req.hdr.seq = seq;
+      c->request->readmem_req.hdr.key = c->session_key;
+      c->request->readmem_req.hdr.is_reply = 0;
+      c->request->readmem_req.address = addr + off;
+      c->request->readmem_req.nbytes = ((len - off) > KDP_MAX_DATA_SIZE)
+	? KDP_MAX_DATA_SIZE : (len - off);
+
+      ret = kdp_transmit_debug (c, c->request);
+      if (ret != RR_SUCCESS) { goto done; }
+
+      /* A reply for a sequence number being reused is no longer
+	 trustworthy; if that request was still live, count it lost. */
+      s = &p->slot[seq];
+      if (s->live) { kdp_pipe_lost (c, p, seq); }
+
+      s->chunk = chunk;
+      s->live = 1;
+      s->passed = 0;
+      s->resent = (p->tries[chunk] > 0);
+      s->order = p->order++;
+      s->sent_us = kdp_now_us ();
+
+      if (s->resent) { c->resent++; }
+      c->sent++;
+      p->tries[chunk]++;
+      p->live_seq[chunk] = seq;
+      p->inflight++;
+    }
+
+    /* Wait no longer than it takes the oldest request to expire. */
+
+    rto = kdp_pipe_rto (c);
+    now = kdp_now_us ();
+    oldest = now;
+    for (i = 0; i < KDP_SEQ_SPACE; i++) {
+      if (p->slot[i].live && p->slot[i].sent_us < oldest) { oldest = p->slot[i].sent_us; }
+    }
+    wait = (oldest + rto > now) ? (int) ((oldest + rto - now + 999) / 1000) : 1;
+
+    ret = kdp_receive (c, c->response, wait);
+    now = kdp_now_us ();
+
+    if (ret == RR_RECV_TIMEOUT || ret == RR_RECV_INTR) {
+      for (i = 0; i < KDP_SEQ_SPACE; i++) {
+	if (p->slot[i].live && (now - p->slot[i].sent_us) >= rto) {
+	  kdp_pipe_lost (c, p, i);
+	}
+      }
+      /* Back off exponentially while nothing is getting through. */
+      if (c->srtt < c->receive_timeout * 1000 / 4) { c->srtt *= 2; }
+      if ((now - progress) >= (unsigned long long) c->receive_timeout * 1000) {
+	c->logger (KDP_LOG_INFO, "kdp_read_memory_pipelined: host not responding\n");
+	c->timed_out = 1;
+	ret = RR_RECV_TIMEOUT;
+	goto done;
+      }
+      continue;
+    }
+    if (ret != RR_SUCCESS) { goto done; }
+
+    if (c->response->hdr.request == KDP_EXCEPTION) {
+      ret = kdp_exception_save (c, c->response, "kdp_read_memory_pipelined");
+      if (ret != RR_SUCCESS) { goto done; }
+      continue;
+    }
+
+    if (! c->response->hdr.is_reply
+	|| c->response->hdr.request != KDP_READMEM
+	|| c->response->hdr.key != c->session_key) {
+      c->logger (KDP_LOG_DEBUG, "kdp_read_memory_pipelined: "
+		 "ignoring unexpected packet (sequence number %d)\n",
+		 c->response->hdr.seq);
+      continue;
+    }
+
+    seq = c->response->hdr.seq;
+    s = &p->slot[seq];
+    chunk = s->chunk;
+    if (chunk < 0 || p->state[chunk] != 0) {
+      /* duplicate, or answer to a request already satisfied */
+      continue;
+    }
+
+    /* A late answer to a request we already gave up on is as good as
+       the retransmission; retire whichever request is still live. */
+    if (p->live_seq[chunk] >= 0) {
+      kdp_pipe_slot *l = &p->slot[p->live_seq[chunk]];
+      l->live = 0;
+      p->inflight--;
+      p->live_seq[chunk] = -1;
+    }
+    progress = now;
+    ndone++;
+
+    if (c->response->readmem_reply.error != KDP_PROTERR_SUCCESS) {
+      c->logger (KDP_LOG_DEBUG, "kdp_read_memory_pipelined: unable to fetch 0x%lx: %s\n",
+		 addr + (unsigned long) chunk * KDP_MAX_DATA_SIZE,
+		 kdp_error_string (c->response->readmem_reply.error));
+      p->state[chunk] = 2;
+      err = kdp_reply_error (c->response->readmem_reply.error);
+      continue;
+    }
+
+    {
+      size_t off = (size_t) chunk * KDP_MAX_DATA_SIZE;
+      size_t want = ((len - off) > KDP_MAX_DATA_SIZE) ? KDP_MAX_DATA_SIZE : (len - off);
+
+      if (c->response->readmem_reply.nbytes != want) {
+	c->logger (KDP_LOG_DEBUG, "kdp_read_memory_pipelined: "
+		   "kdp read only %lu bytes of data (expected %lu)\n",
+		   (unsigned long) c->response->readmem_reply.nbytes, (unsigned long) want);
+	p->state[chunk] = 2;
+	err = RR_BYTE_COUNT;
+	continue;
+      }
+      memcpy (buf + off, c->response->readmem_reply.data, want);
+      p->state[chunk] = 1;
+    }
+
+    /* Karn: only requests sent once give a usable round trip sample. */
+    if (! s->resent) {
+      unsigned int sample = (unsigned int) (now - s->sent_us);
+      c->srtt = c->srtt ? ((c->srtt * 7) + sample) / 8 : sample;
+    }
+
+    /* Anything sent before this request and still unanswered has been
+       overtaken; three strikes and it is presumed lost. */
+    for (i = 0; i < KDP_SEQ_SPACE; i++) {
+      kdp_pipe_slot *o = &p->slot[i];
+      if (o->live && o->order < s->order && ++o->passed >= 3) {
+	kdp_pipe_lost (c, p, i);
+      }
+    }
+
+    if (++p->credit >= c->window) {
+      p->credit = 0;
+      if (c->window < c->max_window) { c->window++; }
+    }
+  }
+
+ done:
+  if (p->state != NULL) {
+    for (i = 0; i < nchunks && p->state[i] == 1; i++) { }
+    *nread = (i == nchunks) ? len : i * KDP_MAX_DATA_SIZE;
+  }
+  if (ret == RR_SUCCESS) { ret = err; }
+
+  free (p->live_seq);
+  free (p->tries);
+  free (p->state);
+  free (p->retx);
+  free (p);
+
+  return ret;
+}
+
+/* Read or write LEN bytes of target memory at MEMADDR.  Reads larger
+   than one packet are pipelined unless the window has been set to 1;
+   everything else goes one KDP_MAX_DATA_SIZE transaction at a time.
+   Returns the number of bytes transferred, which is short on error.  */
+
+int kdp_transfer_memory
+(kdp_connection *c, unsigned long memaddr, unsigned char *myaddr, int len, int write)
+{
+  kdp_return_t kdpret;
+  int done = 0;
+
+  CHECK_FATAL (kdp_is_connected (c));
+
+  if (! write && len > KDP_MAX_DATA_SIZE && c->max_window > 1) {
+    size_t nread = 0;
+    kdpret = kdp_read_memory_pipelined (c, memaddr, myaddr, len, &nread);
+    if (kdpret != RR_SUCCESS) {
+      c->logger (KDP_LOG_DEBUG, "kdp_transfer_memory: fetched %lu of %d bytes from 0x%lx: %s\n",
+		 (unsigned long) nread, len, memaddr, kdp_return_string (kdpret));
+    }
+    return nread;
+  }
+
+  while (done < len) {
+
+    int n = ((len - done) > KDP_MAX_DATA_SIZE) ? KDP_MAX_DATA_SIZE : (len - done);
+
+    if (write) {
+      c->request->writemem_req.hdr.request = KDP_WRITEMEM;
+      c->request->writemem_req.address = memaddr + done;
+      c->request->writemem_req.nbytes = n;
+      memcpy (c->request->writemem_req.data, myaddr + done, n);
+
+      kdpret = kdp_transaction (c, c->request, c->response, "kdp_transfer_memory");
+      if (kdpret == RR_SUCCESS && c->response->writemem_reply.error != KDP_PROTERR_SUCCESS) {
+	kdpret = kdp_reply_error (c->response->writemem_reply.error);
+      }
+      if (kdpret != RR_SUCCESS) {
+	c->logger (KDP_LOG_DEBUG, "kdp_transfer_memory: unable to store %d bytes at 0x%lx: %s\n", 
+		   n, memaddr + done, kdp_return_string (kdpret));
+	break;
+      }
+    } else {
+      c->request->readmem_req.hdr.request = KDP_READMEM;
+      c->request->readmem_req.address = memaddr + done;
+      c->request->readmem_req.nbytes = n;
+
+      kdpret = kdp_transaction (c, c->request, c->response, "kdp_transfer_memory");
+      if (kdpret == RR_SUCCESS && c->response->readmem_reply.error != KDP_PROTERR_SUCCESS) {
+	kdpret = kdp_reply_error (c->response->readmem_reply.error);
+      }
+      if (kdpret != RR_SUCCESS) {
+	c->logger (KDP_LOG_DEBUG, "kdp_transfer_memory: unable to fetch %d bytes from 0x%lx: %s\n", 
+		   n, memaddr + done, kdp_return_string (kdpret));
+	break;
+      }
+      if (c->response->readmem_reply.nbytes != (size_t) n) {
+	c->logger (KDP_LOG_DEBUG, "kdp_transfer_memory: kdp read only %d bytes of data (expected %d)\n", 
+		   (int) c->response->readmem_reply.nbytes, n);
+	break;
+      }
+      memcpy (myaddr + done, c->response->readmem_reply.data, n);
+    }
+
+    done += n;
+  }
+
+  return done;
+}
@@ -12,6 +12,12 @@ kdp_return_t kdp_reply_wait
 kdp_return_t kdp_transaction
   (kdp_connection *c, kdp_pkt_t *request, kdp_pkt_t *response, char *name);
 
+kdp_return_t kdp_read_memory_pipelined
+  (kdp_connection *c, unsigned long addr, unsigned char *buf, size_t len, size_t *nread);
+
+int kdp_transfer_memory
+  (kdp_connection *c, unsigned long memaddr, unsigned char *myaddr, int len, int write);
+
 kdp_return_t kdp_connect (kdp_connection *c);
 
 kdp_return_t kdp_disconnect (kdp_connection *c);
@@ -28,6 +28,7 @@
 #include <sys/param.h>
 
 #include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "kdp-udp.h"
 
@@ -315,6 +316,20 @@ void kdp_reset (kdp_connection *c)
   c->connected = 0;
   c->bound = 0;
   c->timed_out = 0;
+
+  c->window = KDP_DEFAULT_WINDOW;
+  c->max_window = KDP_MAX_WINDOW;
+  c->srtt = 0;
+  c->sent = 0;
+  c->resent = 0;
+}
+
+void kdp_set_window (kdp_connection *c, int window)
+{
+  if (window < 1) { window = 1; }
+  if (window > KDP_MAX_WINDOW) { window = KDP_MAX_WINDOW; }
+  c->max_window = window;
+  if (c->window > c->max_window) { c->window = c->max_window; }
 }
 
 void kdp_set_big_endian (kdp_connection *c)
@@ -7,6 +7,13 @@
 
 #include "kdp-protocol.h"
 
+/* Pipelined READMEM: requests are keyed by their 8-bit sequence
+   number, so the window must stay well below half the sequence space
+   for late replies to be told apart from current ones. */
+
+#define KDP_DEFAULT_WINDOW 8
+#define KDP_MAX_WINDOW 64
+
 struct kdp_connection {
 
   /* connection information */
@@ -43,6 +50,14 @@ struct kdp_connection {
   int connected;
   int bound;
   int timed_out;
+
+  /* READMEM pipeline state, kept across calls */
+
+  unsigned int window;		 /* current number of requests in flight */
+  unsigned int max_window;	 /* upper bound; 1 disables pipelining */
+  unsigned int srtt;		 /* smoothed round trip time (usec) */
+  unsigned long sent;		 /* READMEM requests transmitted */
+  unsigned long resent;		 /* ... of which were retransmissions */
 };
 
 typedef struct kdp_connection kdp_connection;
@@ -82,6 +97,9 @@ kdp_return_t kdp_destroy
 void kdp_set_timeouts
   (kdp_connection *c, int timeout, int retries);
 
+void kdp_set_window
+  (kdp_connection *c, int window);
+
 void kdp_set_big_endian (kdp_connection *c);
 void kdp_set_little_endian (kdp_connection *c);
 
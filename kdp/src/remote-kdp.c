@@ -90,6 +90,7 @@ static int kdp_host_type = -1;
 static int kdp_stopped = 0;
 static int kdp_timeout = 5000;
 static int kdp_retries = 10;
+static int kdp_window = KDP_DEFAULT_WINDOW * 4;
 
 //struct target_ops kdp_ops;
 
@@ -102,6 +103,15 @@ set_timeouts (args, from_tty, cmd)
   kdp_set_timeouts (&c, kdp_timeout, kdp_retries);
 }
 
+static void
+set_window (args, from_tty, cmd)
+     char *args;
+     int from_tty;
+     struct cmd_list_element *cmd;
+{
+  kdp_set_window (&c, kdp_window);
+}
+
 static int 
 parse_host_type (const char *host)
 {
@@ -265,6 +275,7 @@ kdp_attach (args, from_tty)
 
   c.seqno = old_seqno;
   c.exc_seqno = old_exc_seqno;
+  kdp_set_window (&c, kdp_window);
 
 #if 0
 #if TARGET_POWERPC
@@ -831,53 +842,12 @@ kdp_xfer_memory (memaddr, myaddr, len, write)
      int len;
      int write;
 {
-  kdp_return_t kdpret;
-
   if (! kdp_is_connected (&c)) {
     logger (KDP_LOG_DEBUG, "kdp: unable to transfer memory (not connected)");
     return 0;
   }
 
-  if (len > KDP_MAX_DATA_SIZE) { len = KDP_MAX_DATA_SIZE; }
-
-  if (write) {
-    c.request->writemem_req.hdr.request = KDP_WRITEMEM;
-    c.request->writemem_req.address = memaddr;
-    c.request->writemem_req.nbytes = len;
-    memcpy (c.request->writemem_req.data, myaddr, len);
-    
-    kdpret = kdp_transaction (&c, c.request, c.response, "kdp_xfer_memory");
-    if (c.response->writemem_reply.error != RR_SUCCESS) {
-      kdpret = c.response->writemem_reply.error;
-    }
-    if (kdpret != RR_SUCCESS) {
-      logger (KDP_LOG_DEBUG, "kdp_xfer_memory: unable to store %d bytes at 0x%lx: %s\n", 
-	      len, memaddr, kdp_return_string (kdpret));
-      return 0;
-    }
-  } else {
-    c.request->readmem_req.hdr.request = KDP_READMEM;
-    c.request->readmem_req.address = memaddr;
-    c.request->readmem_req.nbytes = len;
-
-    kdpret = kdp_transaction (&c, c.request, c.response, "kdp_xfer_memory");
-    if (c.response->readmem_reply.error != RR_SUCCESS) {
-      kdpret = c.response->readmem_reply.error;
-    }
-    if (kdpret != RR_SUCCESS) {
-      logger (KDP_LOG_DEBUG, "kdp_xfer_memory: unable to fetch %d bytes from 0x%lx: %s\n", 
-	      len, memaddr, kdp_return_string (kdpret));
-      return 0;
-    }
-    if (c.response->readmem_reply.nbytes != len) {
-      logger (KDP_LOG_DEBUG, "kdp_xfer_memory: kdp read only %d bytes of data (expected %d)\n", 
-	      c.response->readmem_reply.nbytes, len);
-      return 0;
-    } 
-    memcpy (myaddr, c.response->readregs_reply.data, len);
-  }
-  
-  return len;
+  return kdp_transfer_memory (&c, memaddr, (unsigned char *) myaddr, len, write);
 }
 
 static void
@@ -1200,6 +1170,14 @@ _initialize_remote_kdp ()
   add_show_from_set (cmd, &showlist);		
   cmd->function.sfunc = set_timeouts;
 
+  cmd = add_set_cmd
+    ("kdp-window", class_obscure, var_zinteger,
+     (char *) &kdp_window,
+     "Set maximum number of KDP memory read requests kept in flight (1 disables pipelining).",
+     &setlist);
+  add_show_from_set (cmd, &showlist);		
+  cmd->function.sfunc = set_window;
+
   cmd = add_set_cmd
     ("kdp-default-port", class_obscure, var_zinteger,
      (char *) &kdp_default_port,
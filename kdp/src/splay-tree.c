@@ -0,0 +1,279 @@
+/* A splay-tree datatype.
+   Copyright (C) 1998-2015 Free Software Foundation, Inc.
+
+   This file is part of GDB.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.  */
+
+/* For an easily readable description of splay-trees, see:
+
+     Lewis, Harry R. and Denenberg, Larry.  Data Structures and Their
+     Algorithms.  Harper-Collins, Inc.  1991.
+
+   This is the top-down variant: splaying KEY leaves either the node
+   with that key or one of its neighbours at the root.  */
+
+#include <stdlib.h>
+
+#include "splay-tree.h"
+
+static void
+splay_tree_delete_helper (splay_tree sp, splay_tree_node node)
+{
+  while (node)
+    {
+      splay_tree_node left = node->left;
+
+      splay_tree_delete_helper (sp, node->right);
+      if (sp->delete_key)
+	(*sp->delete_key) (node->key);
+      if (sp->delete_value)
+	(*sp->delete_value) (node->value);
+      free (node);
+      node = left;
+    }
+}
+
+/* Bring the node with KEY, or the last node visited looking for it,
+   to the root of SP.  */
+
+static void
+splay_tree_splay (splay_tree sp, splay_tree_key key)
+{
+  struct splay_tree_node_s header;
+  splay_tree_node l, r, t, y;
+  int cmp;
+
+  t = sp->root;
+  if (t == NULL)
+    return;
+
+  header.left = header.right = NULL;
+  l = r = &header;
+
+  for (;;)
+    {
+      cmp = (*sp->comp) (key, t->key);
+      if (cmp < 0)
+	{
+	  if (t->left == NULL)
+	    break;
+	  if ((*sp->comp) (key, t->left->key) < 0)
+	    {
+	      /* rotate right */
+	      y = t->left;
+	      t->left = y->right;
+	      y->right = t;
+	      t = y;
+	      if (t->left == NULL)
+		break;
+	    }
+	  /* link right */
+	  r->left = t;
+	  r = t;
+	  t = t->left;
+	}
+      else if (cmp > 0)
+	{
+	  if (t->right == NULL)
+	    break;
+	  if ((*sp->comp) (key, t->right->key) > 0)
+	    {
+	      /* rotate left */
+	      y = t->right;
+	      t->right = y->left;
+	      y->left = t;
+	      t = y;
+	      if (t->right == NULL)
+		break;
+	    }
+	  /* link left */
+	  l->right = t;
+	  l = t;
+	  t = t->right;
+	}
+      else
+	break;
+    }
+
+  /* assemble */
+  l->right = t->left;
+  r->left = t->right;
+  t->left = header.right;
+  t->right = header.left;
+  sp->root = t;
+}
+
+splay_tree
+splay_tree_new (splay_tree_compare_fn compare_fn,
+		splay_tree_delete_key_fn delete_key_fn,
+		splay_tree_delete_value_fn delete_value_fn)
+{
+  splay_tree sp = (splay_tree) malloc (sizeof (struct splay_tree_s));
+
+  if (sp == NULL)
+    return NULL;
+  sp->root = NULL;
+  sp->comp = compare_fn;
+  sp->delete_key = delete_key_fn;
+  sp->delete_value = delete_value_fn;
+  return sp;
+}
+
+void
+splay_tree_delete (splay_tree sp)
+{
+  splay_tree_delete_helper (sp, sp->root);
+  free (sp);
+}
+
+/* Insert a new node (associating KEY with VALUE) into SP.  If a
+   previous node with the indicated KEY exists, its data is replaced
+   with the new value.  Returns the new node.  */
+
+splay_tree_node
+splay_tree_insert (splay_tree sp, splay_tree_key key, splay_tree_value value)
+{
+  splay_tree_node node;
+  int cmp = 0;
+
+  splay_tree_splay (sp, key);
+
+  if (sp->root)
+    cmp = (*sp->comp) (sp->root->key, key);
+
+  if (sp->root && cmp == 0)
+    {
+      /* If the root of the tree already has the indicated KEY, just
+	 replace the value with VALUE.  */
+      if (sp->delete_value)
+	(*sp->delete_value) (sp->root->value);
+      sp->root->value = value;
+      return sp->root;
+    }
+
+  node = (splay_tree_node) malloc (sizeof (struct splay_tree_node_s));
+  if (node == NULL)
+    return NULL;
+  node->key = key;
+  node->value = value;
+
+  if (!sp->root)
+    node->left = node->right = NULL;
+  else if (cmp < 0)
+    {
+      node->left = sp->root;
+      node->right = node->left->right;
+      node->left->right = NULL;
+    }
+  else
+    {
+      node->right = sp->root;
+      node->left = node->right->left;
+      node->right->left = NULL;
+    }
+
+  sp->root = node;
+  return node;
+}
+
+/* Remove KEY from SP.  It is not an error if it did not exist.  */
+
+void
+splay_tree_remove (splay_tree sp, splay_tree_key key)
+{
+  splay_tree_node left, right;
+
+  splay_tree_splay (sp, key);
+
+  if (sp->root == NULL || (*sp->comp) (sp->root->key, key) != 0)
+    return;
+
+  left = sp->root->left;
+  right = sp->root->right;
+
+  if (sp->delete_value)
+    (*sp->delete_value) (sp->root->value);
+  free (sp->root);
+
+  /* One of the children is now the root.  Doesn't matter much which,
+     so long as we preserve the properties of the tree.  */
+  if (left)
+    {
+      sp->root = left;
+      /* If there was a right child as well, hang it off the right-most
+	 leaf of the left child.  */
+      if (right)
+	{
+	  while (left->right)
+	    left = left->right;
+	  left->right = right;
+	}
+    }
+  else
+    sp->root = right;
+}
+
+/* Lookup KEY in SP, returning its node if present, and NULL
+   otherwise.  */
+
+splay_tree_node
+splay_tree_lookup (splay_tree sp, splay_tree_key key)
+{
+  splay_tree_splay (sp, key);
+
+  if (sp->root && (*sp->comp) (sp->root->key, key) == 0)
+    return sp->root;
+  return NULL;
+}
+
+/* Return the node in SP with the smallest key.  */
+
+splay_tree_node
+splay_tree_min (splay_tree sp)
+{
+  splay_tree_node n = sp->root;
+
+  if (!n)
+    return NULL;
+
+  while (n->left)
+    n = n->left;
+
+  return n;
+}
+
+/* Return the immediate successor of KEY, or NULL if there is no
+   successor.  KEY need not be present in the tree.  */
+
+splay_tree_node
+splay_tree_successor (splay_tree sp, splay_tree_key key)
+{
+  splay_tree_node node;
+
+  if (sp->root == NULL)
+    return NULL;
+
+  /* Splay the tree around KEY.  That will leave either the KEY
+     itself, its predecessor, or its successor at the root.  */
+  splay_tree_splay (sp, key);
+  if ((*sp->comp) (sp->root->key, key) > 0)
+    return sp->root;
+
+  /* Otherwise, the successor is the leftmost node in the right
+     subtree.  */
+  node = sp->root->right;
+  if (node)
+    while (node->left)
+      node = node->left;
+
+  return node;
+}
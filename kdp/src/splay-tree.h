@@ -0,0 +1,64 @@
+/* A splay-tree datatype.
+   Copyright (C) 1998-2015 Free Software Foundation, Inc.
+
+   This file is part of GDB.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.  */
+
+/* The subset of libiberty's splay tree interface used by dcache.c.
+   Keys are wide enough to hold a CORE_ADDR and values a pointer.  */
+
+#ifndef _SPLAY_TREE_H
+#define _SPLAY_TREE_H
+
+#include <stdint.h>
+
+typedef unsigned long long splay_tree_key;
+typedef uintptr_t splay_tree_value;
+
+typedef struct splay_tree_node_s *splay_tree_node;
+typedef struct splay_tree_s *splay_tree;
+
+/* Returns <0, 0 or >0 as the first key sorts before, equal to or after
+   the second.  */
+typedef int (*splay_tree_compare_fn) (splay_tree_key, splay_tree_key);
+
+/* Called on keys and values of deleted nodes; may be NULL.  */
+typedef void (*splay_tree_delete_key_fn) (splay_tree_key);
+typedef void (*splay_tree_delete_value_fn) (splay_tree_value);
+
+struct splay_tree_node_s
+{
+  splay_tree_key key;
+  splay_tree_value value;
+  splay_tree_node left;
+  splay_tree_node right;
+};
+
+struct splay_tree_s
+{
+  splay_tree_node root;
+  splay_tree_compare_fn comp;
+  splay_tree_delete_key_fn delete_key;
+  splay_tree_delete_value_fn delete_value;
+};
+
+splay_tree splay_tree_new (splay_tree_compare_fn,
+			   splay_tree_delete_key_fn,
+			   splay_tree_delete_value_fn);
+void splay_tree_delete (splay_tree);
+splay_tree_node splay_tree_insert (splay_tree, splay_tree_key, splay_tree_value);
+void splay_tree_remove (splay_tree, splay_tree_key);
+splay_tree_node splay_tree_lookup (splay_tree, splay_tree_key);
+splay_tree_node splay_tree_min (splay_tree);
+splay_tree_node splay_tree_successor (splay_tree, splay_tree_key);
+
+#endif /* _SPLAY_TREE_H */
@@ -8,15 +8,50 @@
 #include <r_asm.h>
 #include <r_anal.h>
 #include <r_util.h>
-#include <sdb.h>
 
 #include "evm.h"
 
-struct evm_anal_info {
-	Sdb *pushs_db;
-};
-
-static struct evm_anal_info *evm_ai = NULL;
+/* Flat open addressing table keyed by ut64, used for push targets and
+ * found signatures. Keys are stored biased by one so that a zero key
+ * marks an empty slot. */
+typedef struct {
+	ut64 key;
+	ut64 val;
+} EvmSlot;
+
+typedef struct {
+	EvmSlot *slots;
+	ut32 size; /* power of two */
+	ut32 count;
+} EvmTable;
+
+/* Function selectors are 32 bit; names live in one shared string pool
+ * and slots point at them by offset (biased by one, zero is empty). */
+typedef struct {
+	ut32 sel;
+	ut32 name;
+} EvmSigSlot;
+
+typedef struct {
+	EvmSigSlot *slots;
+	ut32 size;
+	ut32 count;
+	char *names;
+	size_t names_len;
+	size_t names_cap;
+} EvmSigMap;
+
+/* Analysis state, one per RAnal using the plugin */
+typedef struct evm_anal_info {
+	RAnal *anal;
+	void *user;
+	EvmTable pushs; /* jump/jumpi address -> pushed destination */
+	EvmTable found; /* push4 address -> selector */
+	struct evm_anal_info *next;
+} EvmAnalInfo;
+
+static EvmAnalInfo *evm_ais = NULL;
+static EvmAnalInfo *evm_ai_last = NULL;
 
 static unsigned opcodes_types[] = {
 	[EVM_OP_STOP] = R_ANAL_OP_TYPE_RET,
@@ -161,18 +196,156 @@ static unsigned opcodes_types[] = {
 	[EVM_OP_SELFDESTRUCT] = R_ANAL_OP_TYPE_CRYPTO,
 };
 
-struct evm_sigs_info {
-	RIO *rio;
-	RIODesc *riodesc;
-	ut8 *contents;
-	size_t contents_len;
-	json_t *root;
+/* Signature map loaded with a!l; read-only once loaded, so it can be
+ * shared by every RAnal instance and by batch workers */
+static EvmSigMap *evm_sigs = NULL;
 
-	Sdb	*sigs_db;
-	Sdb *found_sigs_db;
-};
+static inline ut32 evm_hash64(ut64 k) {
+	k *= 0x9E3779B97F4A7C15ULL;
+	return (ut32)(k >> 32);
+}
+
+static inline ut32 evm_hash32(ut32 k) {
+	return k * 2654435761U;
+}
+
+static void evm_table_fini(EvmTable *t) {
+	R_FREE (t->slots);
+	t->size = t->count = 0;
+}
 
-static struct evm_sigs_info *sigs_info = 0;
+static bool evm_table_set(EvmTable *t, ut64 key, ut64 val);
+
+static bool evm_table_grow(EvmTable *t) {
+	EvmTable n = { 0 };
+	ut32 i;
+	n.size = t->size? t->size * 2: 256;
+	n.slots = calloc (n.size, sizeof (EvmSlot));
+	if (!n.slots) {
+		return false;
+	}
+	for (i = 0; i < t->size; i++) {
+		if (t->slots[i].key) {
+			evm_table_set (&n, t->slots[i].key - 1, t->slots[i].val);
+		}
+	}
+	free (t->slots);
+	*t = n;
+	return true;
+}
+
+static bool evm_table_set(EvmTable *t, ut64 key, ut64 val) {
+	ut32 i;
+	if ((t->count + 1) * 4 > t->size * 3 && !evm_table_grow (t)) {
+		return false;
+	}
+	for (i = evm_hash64 (key) & (t->size - 1);; i = (i + 1) & (t->size - 1)) {
+		EvmSlot *s = &t->slots[i];
+		if (!s->key) {
+			s->key = key + 1;
+			s->val = val;
+			t->count++;
+			return true;
+		}
+		if (s->key == key + 1) {
+			s->val = val;
+			return true;
+		}
+	}
+}
+
+static bool evm_table_get(const EvmTable *t, ut64 key, ut64 *val) {
+	ut32 i;
+	if (!t->size) {
+		return false;
+	}
+	for (i = evm_hash64 (key) & (t->size - 1);; i = (i + 1) & (t->size - 1)) {
+		const EvmSlot *s = &t->slots[i];
+		if (!s->key) {
+			return false;
+		}
+		if (s->key == key + 1) {
+			*val = s->val;
+			return true;
+		}
+	}
+}
+
+static void evm_sigmap_free(EvmSigMap *m) {
+	if (m) {
+		free (m->slots);
+		free (m->names);
+		free (m);
+	}
+}
+
+static const char *evm_sigmap_get(const EvmSigMap *m, ut32 sel) {
+	ut32 i;
+	if (!m || !m->size) {
+		return NULL;
+	}
+	for (i = evm_hash32 (sel) & (m->size - 1);; i = (i + 1) & (m->size - 1)) {
+		const EvmSigSlot *s = &m->slots[i];
+		if (!s->name) {
+			return NULL;
+		}
+		if (s->sel == sel) {
+			return m->names + s->name - 1;
+		}
+	}
+}
+
+/* the table is sized upfront from the number of signatures, the first
+ * name seen for a selector is kept so duplicates take no pool space */
+static bool evm_sigmap_add(EvmSigMap *m, ut32 sel, const char *name) {
+	size_t len = strlen (name) + 1;
+	EvmSigSlot *s;
+	ut32 i;
+	for (i = evm_hash32 (sel) & (m->size - 1);; i = (i + 1) & (m->size - 1)) {
+		s = &m->slots[i];
+		if (!s->name) {
+			break;
+		}
+		if (s->sel == sel) {
+			return true;
+		}
+	}
+	if (m->names_len + len > m->names_cap) {
+		size_t cap = R_MAX (m->names_cap * 2, m->names_len + len + 4096);
+		char *names = realloc (m->names, cap);
+		if (!names) {
+			return false;
+		}
+		m->names = names;
+		m->names_cap = cap;
+	}
+	memcpy (m->names + m->names_len, name, len);
+	s->sel = sel;
+	s->name = m->names_len + 1;
+	m->names_len += len;
+	m->count++;
+	return true;
+}
+
+static EvmAnalInfo *evm_anal_info(RAnal *anal) {
+	EvmAnalInfo *ai;
+	if (evm_ai_last && evm_ai_last->anal == anal) {
+		return evm_ai_last;
+	}
+	for (ai = evm_ais; ai; ai = ai->next) {
+		if (ai->anal == anal) {
+			return evm_ai_last = ai;
+		}
+	}
+	if (!(ai = R_NEW0 (EvmAnalInfo))) {
+		return NULL;
+	}
+	ai->anal = anal;
+	ai->user = anal->user;
+	ai->next = evm_ais;
+	evm_ais = ai;
+	return evm_ai_last = ai;
+}
 
 static int evm_oplen(ut8 opcode) {
 	int ret;
@@ -297,53 +470,44 @@ static int evm_oplen(ut8 opcode) {
  * addr of the push instruction, but at the addr of next jumpi instruction.
  * So in our example we are inserting (0xf, 0x42)
  */
-static int evm_add_push_to_db(ut64 addr, const ut8 *buf, int len) {
+static int evm_add_push_to_db(EvmTable *pushs, ut64 addr, const ut8 *buf, int len) {
 	ut8 opcode = buf[0];
 	ut64 next_cmd_addr = addr + evm_oplen (opcode);
 	ut64 dst_addr = 0;
 	size_t i, push_size;
-	char key[16] = {0}, value[16] = {0};
 
 	push_size = opcode - EVM_OP_PUSH1;
+	if (len < push_size + 2) {
+		return -1;
+	}
 
 	for (i = 0; i < push_size + 1; i++) {
 		dst_addr <<= 8;
 		dst_addr |= buf[i + 1];
 	}
 
-	if (evm_ai) {
-		snprintf (key, sizeof(key) - 1, "%08x", (unsigned) next_cmd_addr);
-		snprintf (value, sizeof(value) - 1, "%08x", (unsigned) dst_addr);
-		sdb_set (evm_ai->pushs_db, key, value, 0);
-	}
+	evm_table_set (pushs, next_cmd_addr, dst_addr);
 
 	return 0;
 }
 
-static st64 evm_get_jmp_addr(ut64 addr) {
-	char key[16] = {0};
-	const char *value;
-	unsigned ret;
-
-	snprintf (key, sizeof(key) - 1, "%08x", (unsigned) addr);
-
-	value = sdb_const_get (evm_ai->pushs_db, key, 0);
-
-	if (value) {
-		sscanf(value, "%08x", &ret);
+static st64 evm_get_jmp_addr(EvmTable *pushs, ut64 addr) {
+	ut64 ret;
 
+	if (evm_table_get (pushs, addr, &ret)) {
 		return ret;
-	} else {
-		return -1;
 	}
+	return -1;
 }
 
 static int evm_op(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *buf, int len) {
-	ut32 *push4op;
+	EvmAnalInfo *ai = evm_anal_info (anal);
 	st64 ret;
 	ut8 opcode;
-	char sig[64] = {0};
 
+	if (!ai || len < 1) {
+		return -1;
+	}
 	opcode = buf[0];
 
 	memset (op, 0, sizeof(RAnalOp));
@@ -369,7 +533,7 @@ static int evm_op(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *buf, int len)
 			op->type = R_ANAL_OP_TYPE_CJMP;
 		}
 
-		ret = evm_get_jmp_addr(addr);
+		ret = evm_get_jmp_addr (&ai->pushs, addr);
 
 		if (ret >= 0) {
 			op->jump = ret;
@@ -391,30 +555,15 @@ static int evm_op(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *buf, int len)
 	case EVM_OP_PUSH2:
 	case EVM_OP_PUSH3:
 	case EVM_OP_PUSH4:
-		evm_add_push_to_db (addr, buf, len);
-
-		if (opcode == EVM_OP_PUSH4 && sigs_info && sigs_info->sigs_db) {
-			push4op = (ut32 *)(buf + 1);
+		evm_add_push_to_db (&ai->pushs, addr, buf, len);
 
-			snprintf(sig, sizeof(sig) - 1, "0x%08x", ntohl((unsigned)(*push4op)));
-
-			const char *data = sdb_const_get (sigs_info->sigs_db, sig, 0);
+		if (opcode == EVM_OP_PUSH4 && evm_sigs && len >= 5) {
+			ut32 sel = r_read_be32 (buf + 1);
+			const char *data = evm_sigmap_get (evm_sigs, sel);
 
 			if (data) {
-				char addr_str[16];
-				char value[1024];
-
-				snprintf(addr_str, sizeof(addr_str) - 1, "0x%08x", (unsigned int)addr);
-
-				addr_str[16 - 1] = '\0';
-
-				snprintf(value, sizeof(value) - 1, "calls a function %s with signature %s",
-						data, sig);
-
-				value[1023] = '\0';
-
-				sdb_set(sigs_info->found_sigs_db, addr_str, value, 0);
-				r_meta_set_string(anal, 'C', addr, data);
+				evm_table_set (&ai->found, addr, sel);
+				r_meta_set_string (anal, 'C', addr, data);
 			}
 		}
 
@@ -428,143 +577,458 @@ static int evm_op(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *buf, int len)
 }
 
 
-static int evm_load_symbol_map (RAnal *anal, const char *file) {
-	size_t i;
-	int ret = 0;
-	bool rc;
-
-	if (sigs_info) {
-		r_io_close (sigs_info->rio);
-		r_io_free (sigs_info->rio);
-		sdb_free (sigs_info->sigs_db);
-		sdb_free (sigs_info->found_sigs_db);
+static EvmSigMap *evm_load_sigmap(const char *file) {
+	EvmSigMap *m = NULL;
+	json_error_t error;
+	json_t *root;
+	char *contents;
+	size_t i, n;
 
-		free (sigs_info->contents);
-		free (sigs_info);
+	contents = r_file_slurp (file, NULL);
+	if (!contents) {
+		printf ("Failed to open %s: %s\n", file, strerror (errno));
+		return NULL;
+	}
+	root = json_loads (contents, 0, &error);
+	free (contents);
+	if (!root) {
+		printf ("Failed to parse json document on line %d: %s\n",
+				error.line, error.text);
+		return NULL;
 	}
 
-	sigs_info = malloc(sizeof(*sigs_info));
-	memset(sigs_info, 0, sizeof(*sigs_info));
-
-	if (!sigs_info) {
-		ret = -1;
+	n = json_array_size (root);
+	m = R_NEW0 (EvmSigMap);
+	if (!m) {
+		goto out;
+	}
+	for (m->size = 256; m->size < n * 2; m->size *= 2) {
+		;
+	}
+	m->slots = calloc (m->size, sizeof (EvmSigSlot));
+	if (!m->slots) {
+		evm_sigmap_free (m);
+		m = NULL;
 		goto out;
 	}
 
-	if (sigs_info) {
-		sigs_info->rio = r_io_new ();
-		sigs_info->riodesc = r_io_open (sigs_info->rio, file, R_PERM_R, 0644);
-
-		if (!sigs_info->riodesc) {
-			printf ("Failed to open %s: %s\n", file, strerror (errno));
-			ret = -1;
+	for (i = 0; i < n; i++) {
+		json_t *elem, *sig, *args, *name;
+		const char *sig_str, *name_str, *args_str;
+		char value[1024];
 
-			goto out_free;
-		} else {
-			json_error_t error;
-			sigs_info->contents_len = r_io_size (sigs_info->rio);
-			sigs_info->contents = malloc(sigs_info->contents_len + 1);
+		elem = json_array_get (root, i);
 
-			rc = r_io_read (sigs_info->rio, sigs_info->contents, sigs_info->contents_len);
+		if (!elem) {
+			continue;
+		}
 
-			if (rc == false) {
-				printf ("Failed to read file\n");
-				ret = -1;
+		sig = json_object_get (elem, "sig");
+		name = json_object_get (elem, "name");
+		args = json_object_get (elem, "args");
 
-				goto out_close;
-			}
+		if (!sig || !name || !args) {
+			continue;
+		}
 
-			sigs_info->contents[sigs_info->contents_len] = '\0';
+		sig_str = json_string_value (sig);
+		name_str = json_string_value (name);
+		args_str = json_string_value (args);
+		if (!sig_str || !name_str || !args_str) {
+			continue;
+		}
 
-			sigs_info->root = json_loads ((const char*)sigs_info->contents, 0, &error);
+		snprintf (value, sizeof (value), "%s(%s)", name_str, args_str);
+		evm_sigmap_add (m, (ut32)strtoul (sig_str, NULL, 16), value);
+	}
 
-			if (!sigs_info->root) {
-				printf ("Failed to parse json document on line %d: %s\n",
-						error.line, error.text);
-			} else {
-				printf ("Parsed successfully\n");
-				sigs_info->sigs_db = sdb_new0 ();
-				sigs_info->found_sigs_db = sdb_new0 ();
+out:
+	json_decref (root);
+	return m;
+}
 
-				for (i = 0; i < json_array_size (sigs_info->root); i++) {
-					json_t *elem, *sig, *args, *name;
-					char *name_str, *sig_str, *args_str, *value;
-					size_t value_size;
+static int evm_load_symbol_map (RAnal *anal, const char *file) {
+	EvmSigMap *m = evm_load_sigmap (file);
 
-					elem = json_array_get (sigs_info->root, i);
+	if (!m) {
+		return -1;
+	}
+	printf ("Parsed successfully, %u signatures\n", m->count);
+	evm_sigmap_free (evm_sigs);
+	evm_sigs = m;
 
-					if (!elem) {
-						continue;
-					}
+	return 0;
+}
 
-					sig = json_object_get (elem, "sig");
-					name = json_object_get (elem, "name");
-					args = json_object_get (elem, "args");
+static int evm_cmp_slot(const void *a, const void *b) {
+	ut64 ka = ((const EvmSlot *)a)->key;
+	ut64 kb = ((const EvmSlot *)b)->key;
 
-					if (!sig || !name || !args) {
-						continue;
-					}
+	return (ka > kb) - (ka < kb);
+}
 
-					sig_str = strdup (json_string_value (sig));
-					name_str = strdup (json_string_value (name));
-					args_str = strdup (json_string_value (args));
+static int evm_list_found_symbols (RAnal *anal) {
+	EvmAnalInfo *ai = evm_anal_info (anal);
+	EvmSlot *found;
+	ut32 i, n = 0;
 
-					value_size = strlen(name_str) + strlen(args_str) + 8;
+	if (!ai || !ai->found.count) {
+		return 0;
+	}
+	found = malloc (ai->found.count * sizeof (EvmSlot));
+	if (!found) {
+		return -1;
+	}
+	for (i = 0; i < ai->found.size; i++) {
+		if (ai->found.slots[i].key) {
+			found[n++] = ai->found.slots[i];
+		}
+	}
+	qsort (found, n, sizeof (EvmSlot), evm_cmp_slot);
+	for (i = 0; i < n; i++) {
+		ut32 sel = (ut32)found[i].val;
+		// the signatures may have been reloaded with a!l since
+		const char *name = evm_sigmap_get (evm_sigs, sel);
+
+		printf ("0x%08x | calls a function %s with signature 0x%08x\n",
+				(unsigned int)(found[i].key - 1),
+				name? name: "(unknown)", sel);
+	}
+	free (found);
 
-					value = malloc(sizeof(char) * value_size);
+	return 0;
+}
 
-					snprintf(value, value_size - 1, "%s(%s)", name_str, args_str);
+/* Batch mode: analyse many contracts without a session each. Contracts
+ * are read upfront, workers only touch their own contracts and the
+ * shared (read-only) signature map. */
+typedef struct {
+	char *name;
+	ut8 *code;
+	int len;
+	char *json;
+} EvmContract;
+
+typedef struct {
+	EvmContract *cs;
+	int count;
+	int cap;
+} EvmBatch;
+
+typedef struct {
+	EvmBatch *b;
+	int first;
+	int step;
+} EvmBatchWorker;
+
+#define EVM_MARK_DEST 1
+#define EVM_MARK_BLOCK 2
+
+static bool evm_is_terminator(ut8 opcode) {
+	switch (opcode) {
+	case EVM_OP_STOP:
+	case EVM_OP_JUMP:
+	case EVM_OP_JUMPI:
+	case EVM_OP_RETURN:
+	case EVM_OP_REVERT:
+	case EVM_OP_SELFDESTRUCT:
+	case 0xfe: /* INVALID */
+		return true;
+	}
+	return false;
+}
 
-					sdb_set (sigs_info->sigs_db, sig_str, value, 0);
+static void evm_json_str(RStrBuf *sb, const char *s) {
+	r_strbuf_append (sb, "\"");
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			r_strbuf_appendf (sb, "\\%c", *s);
+		} else if ((ut8)*s < 0x20) {
+			r_strbuf_appendf (sb, "\\u%04x", *s);
+		} else {
+			r_strbuf_appendf (sb, "%c", *s);
+		}
+	}
+	r_strbuf_append (sb, "\"");
+}
 
-					free (value);
+static void evm_batch_analyze(EvmContract *c) {
+	EvmTable pushs = { 0 };
+	EvmTable seen = { 0 };
+	RStrBuf *sb;
+	ut8 *marks;
+	int i, n, blocks = 0, jumps = 0, resolved = 0, nsel = 0;
+
+	marks = calloc (c->len + 1, 1);
+	sb = r_strbuf_new ("{\"name\":");
+	if (!marks || !sb) {
+		free (marks);
+		r_strbuf_free (sb);
+		return;
+	}
+	/* first pass: jump destinations, block leaders and pushed values */
+	marks[0] |= EVM_MARK_BLOCK;
+	for (i = 0; i < c->len; i += n) {
+		ut8 opcode = c->code[i];
+
+		n = evm_oplen (opcode);
+		if (opcode == EVM_OP_JUMPDEST) {
+			marks[i] |= EVM_MARK_DEST | EVM_MARK_BLOCK;
+		} else if (opcode >= EVM_OP_PUSH1 && opcode <= EVM_OP_PUSH4) {
+			evm_add_push_to_db (&pushs, i, c->code + i, c->len - i);
+		}
+		if (evm_is_terminator (opcode) && i + n <= c->len) {
+			marks[i + n] |= EVM_MARK_BLOCK;
+		}
+	}
+	/* second pass: resolve PUSH/JUMP pairs and collect selectors */
+	evm_json_str (sb, c->name);
+	r_strbuf_appendf (sb, ",\"size\":%d,\"selectors\":[", c->len);
+	for (i = 0; i < c->len; i += n) {
+		ut8 opcode = c->code[i];
+		ut64 dst;
+
+		n = evm_oplen (opcode);
+		if (marks[i] & EVM_MARK_BLOCK) {
+			blocks++;
+		}
+		if (opcode == EVM_OP_JUMP || opcode == EVM_OP_JUMPI) {
+			jumps++;
+			if (evm_table_get (&pushs, i, &dst) && dst < c->len
+					&& (marks[dst] & EVM_MARK_DEST)) {
+				resolved++;
+			}
+		} else if (opcode == EVM_OP_PUSH4 && i + 5 <= c->len) {
+			ut32 sel = r_read_be32 (c->code + i + 1);
+			const char *name = evm_sigmap_get (evm_sigs, sel);
 
-					free (args_str);
-					free (name_str);
-					free (sig_str);
-				}
+			/* known signatures, or the dispatcher's PUSH4 sel; EQ */
+			if (!name && (i + 5 >= c->len || c->code[i + 5] != EVM_OP_EQ)) {
+				continue;
+			}
+			if (evm_table_get (&seen, sel, &dst)) {
+				continue;
+			}
+			evm_table_set (&seen, sel, i);
+			r_strbuf_appendf (sb, "%s{\"addr\":%d,\"selector\":\"0x%08x\"",
+					nsel++? ",": "", i, sel);
+			if (name) {
+				r_strbuf_append (sb, ",\"signature\":");
+				evm_json_str (sb, name);
+			}
+			r_strbuf_append (sb, "}");
+		}
+	}
+	r_strbuf_appendf (sb, "],\"blocks\":%d,\"jumps\":%d,\"resolved\":%d}",
+			blocks, jumps, resolved);
+	c->json = r_strbuf_drain (sb);
+	evm_table_fini (&pushs);
+	evm_table_fini (&seen);
+	free (marks);
+}
 
-				json_decref (sigs_info->root);
-				free (sigs_info->contents);
+static int evm_batch_worker(RThread *th) {
+	EvmBatchWorker *w = th? th->user: NULL;
+	int i;
 
-				sigs_info->root = 0;
-				sigs_info->contents = 0;
-			}
+	if (w) {
+		for (i = w->first; i < w->b->count; i += w->step) {
+			evm_batch_analyze (&w->b->cs[i]);
 		}
 	}
+	return 0;
+}
 
-	goto out;
+static bool evm_batch_add(EvmBatch *b, char *name, ut8 *code, int len) {
+	if (b->count == b->cap) {
+		int cap = b->cap? b->cap * 2: 256;
+		EvmContract *cs = realloc (b->cs, cap * sizeof (EvmContract));
+		if (!cs) {
+			free (name);
+			free (code);
+			return false;
+		}
+		b->cs = cs;
+		b->cap = cap;
+	}
+	b->cs[b->count].name = name;
+	b->cs[b->count].code = code;
+	b->cs[b->count].len = len;
+	b->cs[b->count].json = NULL;
+	b->count++;
+	return true;
+}
 
-out_close:
-	r_io_close (sigs_info->rio);
+static int evm_hexval(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	c |= 0x20;
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	return -1;
+}
 
-out_free:
-	r_io_free (sigs_info->rio);
-	sigs_info->rio = NULL;
-	free (sigs_info);
-	sigs_info = NULL;
+static bool evm_is_hex_text(const char *s, int len) {
+	int i;
 
-out:
-	return ret;
+	for (i = 0; i < len; i++) {
+		if (evm_hexval (s[i]) < 0 && s[i] != 'x' && !isspace ((ut8)s[i])) {
+			return false;
+		}
+	}
+	return true;
 }
 
-static int evm_list_found_symbols_cb (void *user, const char *k, const char *v) {
-	printf ("%s | %s\n", k, v);
+/* A binary file is one contract; a text file holds one hex encoded
+ * contract per line, optionally prefixed with 0x. */
+static void evm_batch_load_file(EvmBatch *b, const char *file) {
+	const char *line, *end;
+	char *data;
+	int size = 0, lineno = 0;
+
+	data = r_file_slurp (file, &size);
+	if (!data || size < 1) {
+		free (data);
+		return;
+	}
+	if (!evm_is_hex_text (data, size)) {
+		evm_batch_add (b, strdup (file), (ut8 *)data, size);
+		return;
+	}
+	for (line = data; line < data + size; line = end + 1) {
+		ut8 *code;
+		int len = 0;
+
+		lineno++;
+		end = memchr (line, '\n', data + size - line);
+		if (!end) {
+			end = data + size;
+		}
+		while (line < end && isspace ((ut8)*line)) {
+			line++;
+		}
+		if (end - line >= 2 && line[0] == '0' && line[1] == 'x') {
+			line += 2;
+		}
+		code = malloc ((end - line) / 2 + 1);
+		if (!code) {
+			break;
+		}
+		for (; line + 1 < end; line += 2) {
+			int hi = evm_hexval (line[0]);
+			int lo = evm_hexval (line[1]);
+			if (hi < 0 || lo < 0) {
+				break;
+			}
+			code[len++] = (hi << 4) | lo;
+		}
+		if (len < 1) {
+			free (code);
+			continue;
+		}
+		evm_batch_add (b, r_str_newf ("%s:%d", file, lineno), code, len);
+	}
+	free (data);
+}
 
-	return 1;
+static int evm_batch_nthreads(int n, int count) {
+	if (n < 1) {
+#if __UNIX__
+		n = (int)sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+		if (n < 1) {
+			n = 1;
+		}
+	}
+	return R_MAX (1, R_MIN (n, count));
 }
 
-static int evm_list_found_symbols (RAnal *anal) {
-	if (sigs_info && sigs_info->found_sigs_db) {
-		sdb_foreach (sigs_info->found_sigs_db, evm_list_found_symbols_cb, NULL);
+static int evm_batch (const char *path, int nthreads) {
+	EvmBatch b = { 0 };
+	EvmBatchWorker *workers;
+	RThread **threads;
+	ut64 t0, elapsed;
+	int i;
+
+	if (r_file_is_directory (path)) {
+		RListIter *iter;
+		RList *files = r_sys_dir (path);
+		char *file;
+
+		r_list_foreach (files, iter, file) {
+			char *fpath;
+
+			if (*file == '.') {
+				continue;
+			}
+			fpath = r_str_newf ("%s/%s", path, file);
+			if (fpath && !r_file_is_directory (fpath)) {
+				evm_batch_load_file (&b, fpath);
+			}
+			free (fpath);
+		}
+		r_list_free (files);
+	} else {
+		evm_batch_load_file (&b, path);
+	}
+	if (!b.count) {
+		eprintf ("No contracts found in %s\n", path);
+		free (b.cs);
+		return -1;
 	}
 
+	nthreads = evm_batch_nthreads (nthreads, b.count);
+	workers = R_NEWS0 (EvmBatchWorker, nthreads);
+	threads = R_NEWS0 (RThread *, nthreads);
+	if (workers && threads) {
+		for (i = 0; i < nthreads; i++) {
+			workers[i].b = &b;
+			workers[i].first = i;
+			workers[i].step = nthreads;
+		}
+		t0 = r_sys_now ();
+		for (i = 1; i < nthreads; i++) {
+			threads[i] = r_th_new (evm_batch_worker, &workers[i], 0);
+		}
+		/* the calling thread takes the first share */
+		for (i = 0; i < b.count; i += nthreads) {
+			evm_batch_analyze (&b.cs[i]);
+		}
+		for (i = 1; i < nthreads; i++) {
+			if (threads[i]) {
+				r_th_wait (threads[i]);
+				r_th_free (threads[i]);
+			}
+		}
+		elapsed = r_sys_now () - t0;
+
+		for (i = 0; i < b.count; i++) {
+			if (b.cs[i].json) {
+				printf ("%s\n", b.cs[i].json);
+			}
+		}
+		eprintf ("%d contracts in %.3fs on %d threads (%.0f contracts/s)\n",
+				b.count, elapsed / 1000000.0, nthreads,
+				elapsed? b.count * 1000000.0 / elapsed: 0.0);
+	}
+	for (i = 0; i < b.count; i++) {
+		free (b.cs[i].name);
+		free (b.cs[i].code);
+		free (b.cs[i].json);
+	}
+	free (b.cs);
+	free (workers);
+	free (threads);
+
 	return 0;
 }
 
 static void evm_cmd_ext_help () {
 	printf ("a!l <file path> 	- Read a JSON file with function signatures\n"
 			"a!f				- List found function signatures\n"
+			"a!b <path> [threads]	- Analyse every contract in a file or directory\n"
 			"a!h				- Show this help message\n");
 }
 
@@ -584,6 +1048,24 @@ static int evm_cmd_ext (RAnal *anal, const char *input) {
 	case 'f':
 		evm_list_found_symbols (anal);
 		break;
+	case 'b': {
+		char *path = strdup (arg);
+		char *threads;
+		int ret;
+
+		if (!path || !*path) {
+			free (path);
+			evm_cmd_ext_help ();
+			return -1;
+		}
+		threads = strchr (path, ' ');
+		if (threads) {
+			*threads++ = 0;
+		}
+		ret = evm_batch (path, threads? atoi (threads): 0);
+		free (path);
+		return ret;
+	}
 	case 'h':
 	default:
 		evm_cmd_ext_help ();
@@ -594,23 +1076,25 @@ static int evm_cmd_ext (RAnal *anal, const char *input) {
 }
 
 static int evm_anal_init (void *user) {
-	if (!evm_ai) {
-		evm_ai = (struct evm_anal_info*)malloc (sizeof(*evm_ai));
-
-		evm_ai->pushs_db = sdb_new0 ();
-	}
-
+	/* state is created on first use by evm_anal_info () */
 	return 0;
 }
 
 static int evm_anal_fini (void *user) {
-	if (evm_ai) {
-		if (evm_ai->pushs_db) {
-			sdb_free (evm_ai->pushs_db);
-		}
+	EvmAnalInfo **pai = &evm_ais;
+
+	evm_ai_last = NULL;
+	while (*pai) {
+		EvmAnalInfo *ai = *pai;
 
-		free(evm_ai);
-		evm_ai = NULL;
+		if (ai->user == user) {
+			*pai = ai->next;
+			evm_table_fini (&ai->pushs);
+			evm_table_fini (&ai->found);
+			free (ai);
+		} else {
+			pai = &ai->next;
+		}
 	}
 
 	return 0;
@@ -9,160 +9,89 @@
 #define R_IPI static
 #include "../../asm/arch/m68k/m68k_disasm/m68k_disasm.c"
 
-static int instlen(const ut8 *buf, int len) {
+static const int m68k_optype[] = {
+	[M68K_INSN_OTHER] = R_ANAL_OP_TYPE_UNK,
+	[M68K_INSN_ILLEGAL] = R_ANAL_OP_TYPE_ILL,
+	[M68K_INSN_NOP] = R_ANAL_OP_TYPE_NOP,
+	[M68K_INSN_MOV] = R_ANAL_OP_TYPE_MOV,
+	[M68K_INSN_LEA] = R_ANAL_OP_TYPE_LEA,
+	[M68K_INSN_PUSH] = R_ANAL_OP_TYPE_PUSH,
+	[M68K_INSN_POP] = R_ANAL_OP_TYPE_POP,
+	[M68K_INSN_ADD] = R_ANAL_OP_TYPE_ADD,
+	[M68K_INSN_SUB] = R_ANAL_OP_TYPE_SUB,
+	[M68K_INSN_MUL] = R_ANAL_OP_TYPE_MUL,
+	[M68K_INSN_DIV] = R_ANAL_OP_TYPE_DIV,
+	[M68K_INSN_CMP] = R_ANAL_OP_TYPE_CMP,
+	[M68K_INSN_AND] = R_ANAL_OP_TYPE_AND,
+	[M68K_INSN_OR] = R_ANAL_OP_TYPE_OR,
+	[M68K_INSN_XOR] = R_ANAL_OP_TYPE_XOR,
+	[M68K_INSN_NOT] = R_ANAL_OP_TYPE_NOT,
+	[M68K_INSN_SHL] = R_ANAL_OP_TYPE_SHL,
+	[M68K_INSN_SHR] = R_ANAL_OP_TYPE_SHR,
+	[M68K_INSN_SAL] = R_ANAL_OP_TYPE_SAL,
+	[M68K_INSN_SAR] = R_ANAL_OP_TYPE_SAR,
+	[M68K_INSN_ROL] = R_ANAL_OP_TYPE_ROL,
+	[M68K_INSN_ROR] = R_ANAL_OP_TYPE_ROR,
+	[M68K_INSN_XCHG] = R_ANAL_OP_TYPE_MOV,
+	[M68K_INSN_JMP] = R_ANAL_OP_TYPE_JMP,
+	[M68K_INSN_UJMP] = R_ANAL_OP_TYPE_UJMP,
+	[M68K_INSN_CJMP] = R_ANAL_OP_TYPE_CJMP,
+	[M68K_INSN_CALL] = R_ANAL_OP_TYPE_CALL,
+	[M68K_INSN_UCALL] = R_ANAL_OP_TYPE_UCALL,
+	[M68K_INSN_RET] = R_ANAL_OP_TYPE_RET,
+	[M68K_INSN_TRAP] = R_ANAL_OP_TYPE_SWI,
+	[M68K_INSN_CTRAP] = R_ANAL_OP_TYPE_TRAP,
+	[M68K_INSN_LINE] = R_ANAL_OP_TYPE_SWI,
+};
+
+static int m68k_op(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *b, int len) {
 	m68k_word bof[8] = {0};
-	char opcode[256], operands[256];
-	const unsigned char *buf2;
-	static struct DisasmPara_68k dp;
-	/* initialize DisasmPara */
-	*operands = *opcode = 0;
-	memcpy (bof, buf, R_MIN(len, sizeof(bof)));
-	dp.opcode = opcode;
-	dp.operands = operands;
-	dp.iaddr = 0LL;
-	dp.instr = bof;
-	buf2 = (const ut8*)M68k_Disassemble (&dp);
-	if (!buf2) {
-		// invalid instruction
+	struct m68k_insn insn;
+
+	if (!op) {
 		return 2;
 	}
-	return (buf2-(const ut8*)bof);
-}
-
-static int m68k_op(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *b, int len) {
-	int sz = 2;
-	if (!op)
-		return sz;
 	memset (op, 0, sizeof (RAnalOp));
 	op->type = R_ANAL_OP_TYPE_NULL;
 	op->nopcode = 1;
-	sz = instlen (b, len);
-	op->size = sz;
-// TODO: Use disasm string to detect type?
-	if (len>=2) {
-		if (!memcmp (b, "\xff\xff", 2)) {
-			op->type = R_ANAL_OP_TYPE_ILL;
-			op->size = sz;
-			return -1;
-
-		}
-	}
-	switch (b[0] & 0xf0) {
-	case 0xB0:
-		op->type = R_ANAL_OP_TYPE_CMP;
-		break;
-	case 0xe0:
-		// TODO:
-		op->type = R_ANAL_OP_TYPE_SHL;
-		op->type = R_ANAL_OP_TYPE_SHR;
-		break;
-	case 0x80:
-		op->type = R_ANAL_OP_TYPE_OR;
-		break;
-	case 0x60: {
-			   int off = 0;
-			   off = (st8)b[1];
-			   if (off==0)
-				   off = (st16)((b[2]<<8) | b[3]);
-			   else if (off==-1)
-				   off = (b[2]<<24) | (b[3]<<16) | (b[4]<<8) | b[5];
-			   op->type = R_ANAL_OP_TYPE_CJMP;
-			   op->jump = addr + 2 + off;
-			   op->fail = addr + op->size;
-			   op->eob = true;
-		   } break;
-	case 0x30:
-		  op->type = R_ANAL_OP_TYPE_MOV;
-		  break;
+	if (len >= 2 && !memcmp (b, "\xff\xff", 2)) {
+		op->type = R_ANAL_OP_TYPE_ILL;
+		op->size = 2;
+		return -1;
 	}
+	/* decode only: no disassembly text is built for analysis */
+	memcpy (bof, b, R_MIN (len, sizeof (bof)));
+	op->size = M68k_Decode (&insn, bof, (ut32)addr);
+	op->type = m68k_optype[insn.cls];
 
-	switch(b[0]) {
-	case 0x4e:
-		if (b[1]==0x75){
-			op->type = R_ANAL_OP_TYPE_RET;
-			op->eob = true;
-			break;
-		}
-		if (b[1]==0x71){
-			op->type = R_ANAL_OP_TYPE_NOP;
-			break;
-		}
-		if (b[1]==0xF8 || b[1]==0xF9 || b[1]==0xB8 || b[1]==0xB9){
-			op->type = (b[1]&0xf0) == 0xf0 ? R_ANAL_OP_TYPE_JMP : R_ANAL_OP_TYPE_CALL;
-
-			int off = 0;
-			if (op->size == 4)
-				off = (b[2]<<8) | b[3] ;
-			if (op->size == 6)
-				off = (b[2]<<24) | (b[3]<<16) | (b[4]<<8) | b[5];
-
-			op->jump += off;
-			op->fail = addr + op->size;
-			op->eob = true;
-			break;
-		}
-		break;
-	case 0x04:
-	case 0x53:
-	case 0x90:
-	case 0x93:
-	case 0x9D:
-		op->type = R_ANAL_OP_TYPE_SUB;
+	switch (insn.cls) {
+	case M68K_INSN_JMP:
+		op->jump = insn.addr;
+		op->eob = true;
 		break;
-	case 0x06:
-	case 0x50:
-	case 0x52:
-	case 0x54:
-	case 0x58:
-	case 0xD1:
-	case 0xD3:
-		op->type = R_ANAL_OP_TYPE_ADD;
+	case M68K_INSN_CJMP:
+	case M68K_INSN_CALL:
+		op->jump = insn.addr;
+		op->fail = addr + op->size;
+		op->eob = insn.cls == M68K_INSN_CJMP;
 		break;
-	case 0x0c:
-	case 0xB0:
-	case 0xB8:
-		op->type = R_ANAL_OP_TYPE_CMP;
+	case M68K_INSN_UJMP:
+	case M68K_INSN_RET:
+	case M68K_INSN_ILLEGAL:
+		op->eob = true;
 		break;
-	case 0x41:
-	case 0x43:
-	case 0x45:
-	case 0x47:
-	case 0x4D:
-		op->type = R_ANAL_OP_TYPE_LEA;
+	case M68K_INSN_UCALL:
+		op->fail = addr + op->size;
 		break;
-	case 0x02:
-	case 0xC0:
-		op->type = R_ANAL_OP_TYPE_AND;
+	case M68K_INSN_TRAP:
+		op->val = b[1] & 0xf;
 		break;
-	case 0x03:
-	case 0x10:
-	case 0x12:
-	case 0x15:
-	case 0x17:
-	case 0x18:
-	case 0x19:
-	case 0x1B:
-	case 0x1D:
-	case 0x20:
-	case 0x22:
-	case 0x26:
-	case 0x28:
-	case 0x2B:
-	case 0x2D:
-	case 0x30:
-	case 0x35:
-	case 0x38:
-	case 0x3B:
-	case 0x3C:
-	case 0x3D:
-	case 0x70:
-	case 0x72:
-	case 0x74:
-	case 0x7C:
-		op->type = R_ANAL_OP_TYPE_MOV;
+	default:
+		if (insn.has_addr) {
+			op->ptr = insn.addr;
+		}
 		break;
 	}
-
 	return op->size;
 }
 
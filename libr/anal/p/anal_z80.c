@@ -0,0 +1,376 @@
+/* radare - NC-GPL2 - Copyright 2018 */
+
+#include <string.h>
+#include <r_types.h>
+#include <r_lib.h>
+#include <r_asm.h>
+#include <r_anal.h>
+
+#define R_API_I static
+#include "../../asm/arch/z80/disasm.c"
+#undef ut8
+
+/* Whole ROM classifier. This is the ParseOpcodes() design described at
+ * the top of disasm.c (walk from the RST and NMI vectors, mark opcodes
+ * and jump targets in OpcodesFlags) done with an explicit worklist
+ * instead of recursion, so every byte is decoded at most once. */
+
+#define Z80_SPACE 0x10000
+
+/* OpcodesFlags bits; a byte with none of them set is data */
+#define Z80_OPCODE 1  /* first byte of an instruction */
+#define Z80_OPERAND 2 /* other bytes of an instruction */
+#define Z80_LABEL 4   /* jump target */
+#define Z80_FUNC 8    /* call target or vector */
+#define Z80_QUEUED 16 /* already on the worklist */
+
+enum {
+	Z80_FLOW_SEQ = 0,
+	Z80_FLOW_JMP,   /* JP nn, JR e */
+	Z80_FLOW_CJMP,  /* JP cc,nn  JR cc,e  DJNZ e */
+	Z80_FLOW_CALL,  /* CALL nn, RST n */
+	Z80_FLOW_CCALL, /* CALL cc,nn */
+	Z80_FLOW_RET,   /* RET, RETI, RETN */
+	Z80_FLOW_CRET,  /* RET cc */
+	Z80_FLOW_UJMP,  /* JP (HL), JP (IX), JP (IY) */
+};
+
+/* control flow of the instruction at b (located at addr), target in *dst */
+static int z80_flow(const ut8 *b, ut16 addr, ut16 *dst) {
+	switch (b[0]) {
+	case 0xC3:
+		*dst = r_read_le16 (b + 1);
+		return Z80_FLOW_JMP;
+	case 0xC2: case 0xCA: case 0xD2: case 0xDA:
+	case 0xE2: case 0xEA: case 0xF2: case 0xFA:
+		*dst = r_read_le16 (b + 1);
+		return Z80_FLOW_CJMP;
+	case 0x18:
+		*dst = addr + 2 + (st8)b[1];
+		return Z80_FLOW_JMP;
+	case 0x10:
+	case 0x20: case 0x28: case 0x30: case 0x38:
+		*dst = addr + 2 + (st8)b[1];
+		return Z80_FLOW_CJMP;
+	case 0xCD:
+		*dst = r_read_le16 (b + 1);
+		return Z80_FLOW_CALL;
+	case 0xC4: case 0xCC: case 0xD4: case 0xDC:
+	case 0xE4: case 0xEC: case 0xF4: case 0xFC:
+		*dst = r_read_le16 (b + 1);
+		return Z80_FLOW_CCALL;
+	case 0xC7: case 0xCF: case 0xD7: case 0xDF:
+	case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+		*dst = b[0] & 0x38;
+		return Z80_FLOW_CALL;
+	case 0xC9:
+		return Z80_FLOW_RET;
+	case 0xC0: case 0xC8: case 0xD0: case 0xD8:
+	case 0xE0: case 0xE8: case 0xF0: case 0xF8:
+		return Z80_FLOW_CRET;
+	case 0xE9:
+		return Z80_FLOW_UJMP;
+	case 0xDD:
+	case 0xFD:
+		return b[1] == 0xE9? Z80_FLOW_UJMP: Z80_FLOW_SEQ;
+	case 0xED:
+		return (b[1] == 0x4D || b[1] == 0x45)? Z80_FLOW_RET: Z80_FLOW_SEQ;
+	}
+	return Z80_FLOW_SEQ;
+}
+
+static const int z80_alu_types[8] = {
+	R_ANAL_OP_TYPE_ADD, R_ANAL_OP_TYPE_ADD, /* ADD, ADC */
+	R_ANAL_OP_TYPE_SUB, R_ANAL_OP_TYPE_SUB, /* SUB, SBC */
+	R_ANAL_OP_TYPE_AND, R_ANAL_OP_TYPE_XOR,
+	R_ANAL_OP_TYPE_OR, R_ANAL_OP_TYPE_CMP
+};
+
+static int z80_op(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *data, int len) {
+	ut8 b[4] = {0};
+	ut16 dst = 0;
+
+	if (!op) {
+		return 1;
+	}
+	memset (op, 0, sizeof (RAnalOp));
+	memcpy (b, data, R_MIN (len, sizeof (b)));
+	op->addr = addr;
+	op->nopcode = 1;
+	op->size = OpcodeLen (0, b);
+	if (len < op->size) {
+		op->type = R_ANAL_OP_TYPE_ILL;
+		return -1;
+	}
+	switch (z80_flow (b, addr, &dst)) {
+	case Z80_FLOW_JMP:
+		op->type = R_ANAL_OP_TYPE_JMP;
+		op->jump = dst;
+		op->eob = true;
+		break;
+	case Z80_FLOW_CJMP:
+		op->type = R_ANAL_OP_TYPE_CJMP;
+		op->jump = dst;
+		op->fail = addr + op->size;
+		break;
+	case Z80_FLOW_CALL:
+		op->type = R_ANAL_OP_TYPE_CALL;
+		op->jump = dst;
+		op->fail = addr + op->size;
+		break;
+	case Z80_FLOW_CCALL:
+		op->type = R_ANAL_OP_TYPE_CCALL;
+		op->jump = dst;
+		op->fail = addr + op->size;
+		break;
+	case Z80_FLOW_RET:
+		op->type = R_ANAL_OP_TYPE_RET;
+		op->eob = true;
+		break;
+	case Z80_FLOW_CRET:
+		op->type = R_ANAL_OP_TYPE_CRET;
+		break;
+	case Z80_FLOW_UJMP:
+		op->type = R_ANAL_OP_TYPE_UJMP;
+		op->eob = true;
+		break;
+	default:
+		if (b[0] == 0x00) {
+			op->type = R_ANAL_OP_TYPE_NOP;
+		} else if (b[0] == 0x76) {
+			op->type = R_ANAL_OP_TYPE_TRAP; /* HALT */
+		} else if (b[0] >= 0x40 && b[0] < 0x80) {
+			op->type = R_ANAL_OP_TYPE_MOV;
+		} else if (b[0] >= 0x80 && b[0] < 0xC0) {
+			op->type = z80_alu_types[(b[0] >> 3) & 7];
+		} else if ((b[0] & 0xCF) == 0xC5) {
+			op->type = R_ANAL_OP_TYPE_PUSH;
+		} else if ((b[0] & 0xCF) == 0xC1) {
+			op->type = R_ANAL_OP_TYPE_POP;
+		} else {
+			op->type = R_ANAL_OP_TYPE_UNK;
+		}
+		break;
+	}
+	return op->size;
+}
+
+typedef struct {
+	ut8 *rom;     /* Z80_SPACE bytes plus padding for OpcodeLen */
+	ut8 *flags;   /* OpcodesFlags, one per address */
+	ut16 *work;   /* worklist; an address is queued at most once */
+	int nwork;
+	ut32 size;
+	int ujmps;    /* computed jumps seen (JP (HL) and friends) */
+	int overlaps; /* instructions decoded over an earlier one's operands */
+} Z80Rom;
+
+static void z80_queue(Z80Rom *z, ut32 addr, ut8 mark) {
+	if (addr >= z->size) {
+		return;
+	}
+	z->flags[addr] |= mark;
+	if (!(z->flags[addr] & Z80_QUEUED)) {
+		z->flags[addr] |= Z80_QUEUED;
+		z->work[z->nwork++] = addr;
+	}
+}
+
+static void z80_parse(Z80Rom *z) {
+	while (z->nwork > 0) {
+		ut32 addr = z->work[--z->nwork];
+
+		while (addr < z->size && !(z->flags[addr] & Z80_OPCODE)) {
+			ut32 i, len = OpcodeLen (addr, z->rom);
+			ut16 dst = 0;
+			int flow;
+
+			if (addr + len > z->size) {
+				break;
+			}
+			if (z->flags[addr] & Z80_OPERAND) {
+				z->overlaps++;
+			}
+			z->flags[addr] |= Z80_OPCODE;
+			for (i = 1; i < len; i++) {
+				z->flags[addr + i] |= Z80_OPERAND;
+			}
+			flow = z80_flow (z->rom + addr, addr, &dst);
+			switch (flow) {
+			case Z80_FLOW_JMP:
+			case Z80_FLOW_CJMP:
+				z80_queue (z, dst, Z80_LABEL);
+				break;
+			case Z80_FLOW_CALL:
+			case Z80_FLOW_CCALL:
+				z80_queue (z, dst, Z80_FUNC);
+				break;
+			case Z80_FLOW_UJMP:
+				z->ujmps++;
+				break;
+			}
+			if (flow == Z80_FLOW_JMP || flow == Z80_FLOW_RET || flow == Z80_FLOW_UJMP) {
+				break;
+			}
+			addr += len;
+		}
+	}
+}
+
+/* Create functions, flags and data marks for everything z80_parse found.
+ * A function spans the code following its entry up to the next function
+ * entry or the first data byte. */
+static void z80_apply(RAnal *anal, Z80Rom *z, int *nfcn, int *nlbl, ut32 *ncode) {
+	char name[32];
+	ut32 addr, end, data = UT32_MAX;
+
+	for (addr = 0; addr < z->size; addr++) {
+		ut8 f = z->flags[addr];
+
+		if (!(f & (Z80_OPCODE | Z80_OPERAND))) {
+			if (data == UT32_MAX) {
+				data = addr;
+			}
+			continue;
+		}
+		(*ncode)++;
+		if (data != UT32_MAX) {
+			r_meta_add (anal, R_META_TYPE_DATA, data, addr, NULL);
+			data = UT32_MAX;
+		}
+		if (f & Z80_FUNC) {
+			for (end = addr + 1; end < z->size; end++) {
+				ut8 g = z->flags[end];
+				if ((g & Z80_FUNC) || !(g & (Z80_OPCODE | Z80_OPERAND))) {
+					break;
+				}
+			}
+			if (addr == 0x66) {
+				snprintf (name, sizeof (name), "nmi");
+			} else if (addr < 0x40 && !(addr & 7)) {
+				snprintf (name, sizeof (name), "rst.%02x", addr);
+			} else {
+				snprintf (name, sizeof (name), "fcn.%04x", addr);
+			}
+			r_anal_fcn_add (anal, addr, end - addr, name, R_ANAL_FCN_TYPE_FCN, NULL);
+			if (anal->flb.set) {
+				anal->flb.set (anal->flb.f, name, addr, end - addr);
+			}
+			(*nfcn)++;
+		} else if ((f & Z80_LABEL) && anal->flb.set) {
+			snprintf (name, sizeof (name), "loc.%04x", addr);
+			anal->flb.set (anal->flb.f, name, addr, 1);
+			(*nlbl)++;
+		}
+	}
+	if (data != UT32_MAX) {
+		r_meta_add (anal, R_META_TYPE_DATA, data, z->size, NULL);
+	}
+}
+
+static int z80_classify(RAnal *anal, const char *arg) {
+	Z80Rom z = {0};
+	int i, nfcn = 0, nlbl = 0;
+	ut32 ncode = 0;
+	ut64 t0 = r_sys_now ();
+	char *args = strdup (arg), *s, *next;
+
+	z.size = Z80_SPACE;
+	z.rom = calloc (1, Z80_SPACE + 4);
+	z.flags = calloc (1, Z80_SPACE);
+	z.work = calloc (Z80_SPACE, sizeof (ut16));
+	if (!args || !z.rom || !z.flags || !z.work) {
+		eprintf ("Cannot allocate ROM maps\n");
+		goto beach;
+	}
+	/* a!c [size] [entry ...] */
+	s = r_str_trim_head (args);
+	if (*s) {
+		next = strchr (s, ' ');
+		if (next) {
+			*next++ = 0;
+		}
+		z.size = R_MIN (r_num_math (NULL, s), Z80_SPACE);
+		s = next;
+	}
+	if (!z.size) {
+		eprintf ("Invalid ROM size\n");
+		goto beach;
+	}
+	if (!anal->iob.read_at) {
+		eprintf ("No IO to read the ROM from\n");
+		goto beach;
+	}
+	anal->iob.read_at (anal->iob.io, 0, z.rom, z.size);
+
+	for (i = 0; i < 0x40; i += 8) {
+		z80_queue (&z, i, Z80_FUNC);
+	}
+	z80_queue (&z, 0x66, Z80_FUNC);
+	while (s && *s) {
+		s = r_str_trim_head (s);
+		next = strchr (s, ' ');
+		if (next) {
+			*next++ = 0;
+		}
+		if (*s) {
+			z80_queue (&z, r_num_math (NULL, s), Z80_FUNC);
+		}
+		s = next;
+	}
+	z80_parse (&z);
+	z80_apply (anal, &z, &nfcn, &nlbl, &ncode);
+
+	eprintf ("%u code bytes, %u data bytes, %d functions, %d labels in %d ms\n",
+		ncode, z.size - ncode, nfcn, nlbl, (int)((r_sys_now () - t0) / 1000));
+	if (z.ujmps) {
+		eprintf ("%d computed jumps (JP (HL)/(IX)/(IY)): "
+			"pass jump table entries to a!c to follow them\n", z.ujmps);
+	}
+	if (z.overlaps) {
+		eprintf ("%d instructions overlap the operands of others\n", z.overlaps);
+	}
+beach:
+	free (z.rom);
+	free (z.flags);
+	free (z.work);
+	free (args);
+	return 0;
+}
+
+static void z80_cmd_ext_help () {
+	printf ("a!c [size] [entry ...]	- Classify the ROM at 0 into code and data from the\n"
+			"			  RST/NMI vectors and the given entries, creating\n"
+			"			  functions, flags and data marks\n"
+			"a!h			- Show this help message\n");
+}
+
+static int z80_cmd_ext (RAnal *anal, const char *input) {
+	switch (input[0]) {
+	case 'c':
+		return z80_classify (anal, input + 1);
+	case 'h':
+	default:
+		z80_cmd_ext_help ();
+		return -1;
+	}
+	return 0;
+}
+
+RAnalPlugin r_anal_plugin_z80 = {
+	.name = "z80",
+	.desc = "Zilog Z80 code analysis plugin",
+	.license = "NC-GPL2",
+	.arch = "z80",
+	.bits = 8,
+	.op = &z80_op,
+	.cmd_ext = z80_cmd_ext,
+};
+
+#ifndef CORELIB
+struct r_lib_struct_t radare_plugin = {
+	.type = R_LIB_TYPE_ANAL,
+	.data = &r_anal_plugin_z80,
+	.version = R2_VERSION
+};
+#endif
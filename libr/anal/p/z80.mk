@@ -0,0 +1,9 @@
+OBJ_Z80=anal_z80.o
+
+STATIC_OBJ+=${OBJ_Z80}
+TARGET_Z80=anal_z80.${LIBEXT}
+
+ALL_TARGETS+=${TARGET_Z80}
+
+${TARGET_Z80}: ${OBJ_Z80}
+	${CC} $(call libname,anal_z80) ${LDFLAGS} ${CFLAGS} -o anal_z80.${LIBEXT} ${OBJ_Z80}
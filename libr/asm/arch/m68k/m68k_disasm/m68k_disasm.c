@@ -134,9 +134,14 @@ static void opcode_fmove_ext (dis_buffer_t *, ut16, ut16);
 static void opcode_pmove (dis_buffer_t *, ut16, ut16);
 static void opcode_pflush (dis_buffer_t *, ut16, ut16);
 
-#define addchar(ch) (*dbuf->casm++ = ch)
-#define iaddchar(ch) (*dbuf->cinfo++ = ch)
-#define addcomma() { (*dbuf->casm++ = ',');(*dbuf->casm++ = ' '); }
+/* decode-only support */
+static void decode_ea (dis_buffer_t *, int, int, int);
+static void classify (dis_buffer_t *, ut16, ut32);
+
+/* in decode-only mode (dbuf->insn set) nothing is written */
+#define addchar(ch) (dbuf->insn ? 0 : (*dbuf->casm++ = ch))
+#define iaddchar(ch) (dbuf->insn ? 0 : (*dbuf->cinfo++ = ch))
+#define addcomma() { if (!dbuf->insn) { (*dbuf->casm++ = ',');(*dbuf->casm++ = ' '); } }
 
 
 typedef void dis_func_t (dis_buffer_t *, ut16);
@@ -255,6 +260,300 @@ R_IPI m68k_word *M68k_Disassemble(struct DisasmPara_68k *dp) {
 }
 
 
+/* Decode the M68k instruction at ``instr'' (located at ``addr'') */
+/* into ``insn'', without producing any text. Returns its length */
+/* in bytes. */
+R_IPI int M68k_Decode(struct m68k_insn *insn, m68k_word *instr, ut32 addr) {
+  char scratch[4];
+  ut16 opc;
+  dis_buffer_t dbuf = {0};
+
+  memset(insn, 0, sizeof(*insn));
+  dbuf.casm = dbuf.dasm = scratch;
+  dbuf.cinfo = dbuf.info = scratch;
+  dbuf.val = (short *)instr;
+  dbuf.sval = (short *)(size_t)addr;
+  dbuf.insn = insn;
+
+  opc = read16(dbuf.val);
+  dbuf.used++;
+
+  opcode_map[OPCODE_MAP(opc)](&dbuf, opc);
+  classify(&dbuf, opc, addr);
+
+  insn->size = dbuf.used * 2;
+  return insn->size;
+}
+
+
+/*
+ * record the effective address about to be decoded by get_modregstr()
+ */
+static void decode_ea(dis_buffer_t *dbuf, int bit, int mod, int dd) {
+	struct m68k_insn *insn = dbuf->insn;
+	int reg, ea;
+
+	if (mod != GETMOD_BEFORE && mod != GETMOD_AFTER)
+		reg = BITFIELD(read16(dbuf->val), bit, bit-2);
+	else if (mod == GETMOD_BEFORE) {
+		mod = BITFIELD(read16(dbuf->val), bit, bit-2);
+		reg = BITFIELD(read16(dbuf->val), bit-3, bit-5);
+	} else {
+		reg = BITFIELD(read16(dbuf->val), bit, bit-2);
+		mod = BITFIELD(read16(dbuf->val), bit-3, bit-5);
+	}
+	if (mod != MOD_SPECIAL)
+		ea = M68K_EA_DN + mod;
+	else if (reg <= 4)
+		ea = M68K_EA_ABSW + reg;
+	else
+		ea = M68K_EA_NONE;
+
+	if (!insn->has_addr) {
+		switch (ea) {
+		case M68K_EA_ABSW:
+			insn->addr = (st16)read16(dbuf->val + 1 + dd);
+			insn->has_addr = 1;
+			break;
+		case M68K_EA_ABSL:
+			insn->addr = read32(dbuf->val + 1 + dd);
+			insn->has_addr = 1;
+			break;
+		case M68K_EA_PCDISP:
+			insn->addr = (size_t)dbuf->sval + 2*(dd+1) +
+			    (st16)read16(dbuf->val + 1 + dd);
+			insn->has_addr = 1;
+			break;
+		}
+	}
+	if (insn->nea < 2) {
+		insn->ea[insn->nea] = ea;
+		insn->ea_reg[insn->nea] = reg;
+		insn->nea++;
+	}
+}
+
+
+/* -(sp) destination / (sp)+ source */
+#define EA_PUSH(insn,i) ((insn)->ea[i] == M68K_EA_DEC && (insn)->ea_reg[i] == 7)
+#define EA_POP(insn,i) ((insn)->ea[i] == M68K_EA_INC && (insn)->ea_reg[i] == 7)
+
+/*
+ * classify an instruction decoded by M68k_Decode() by its opcode word
+ * (and the effective addresses recorded by decode_ea()).
+ */
+static void classify(dis_buffer_t *dbuf, ut16 opc, ut32 addr) {
+	struct m68k_insn *insn = dbuf->insn;
+	int disp, cls = M68K_INSN_OTHER;
+
+	switch (OPCODE_MAP(opc)) {
+	case 0x0:
+		if (BITFIELD(opc,7,6) == 3)
+			break;  /* CAS, CAS2, CHK2/CMP2, CALLM, RTM */
+		if (ISBITSET(opc,8)) {
+			if (IS_INST(MOVEP,opc))
+				cls = M68K_INSN_MOV;
+			else if (IS_INST(BTSTD,opc))
+				cls = M68K_INSN_CMP;
+			break;
+		}
+		switch (BITFIELD(opc,11,9)) {
+		case 0: cls = M68K_INSN_OR; break;
+		case 1: cls = M68K_INSN_AND; break;
+		case 2: cls = M68K_INSN_SUB; break;
+		case 3: cls = M68K_INSN_ADD; break;
+		case 4:
+			if (IS_INST(BTSTS,opc))
+				cls = M68K_INSN_CMP;
+			break;
+		case 5: cls = M68K_INSN_XOR; break;
+		case 6: cls = M68K_INSN_CMP; break;
+		case 7: cls = M68K_INSN_MOV; break;  /* MOVES */
+		}
+		break;
+	case 0x1:
+	case 0x2:
+	case 0x3:
+		if (EA_PUSH(insn,1))
+			cls = M68K_INSN_PUSH;
+		else if (EA_POP(insn,0))
+			cls = M68K_INSN_POP;
+		else
+			cls = M68K_INSN_MOV;
+		break;
+	case 0x4:
+		switch (opc) {
+		case ILLEGAL_INST:
+			insn->cls = M68K_INSN_ILLEGAL;
+			return;
+		case NOP_INST:
+			insn->cls = M68K_INSN_NOP;
+			return;
+		case RTD_INST:
+		case RTE_INST:
+		case RTR_INST:
+		case RTS_INST:
+			insn->cls = M68K_INSN_RET;
+			return;
+		case TRAPV_INST:
+			insn->cls = M68K_INSN_CTRAP;
+			return;
+		}
+		if (IS_INST(TRAP,opc))
+			cls = M68K_INSN_TRAP;
+		else if (IS_INST(JMP,opc))
+			cls = insn->has_addr ? M68K_INSN_JMP : M68K_INSN_UJMP;
+		else if (IS_INST(JSR,opc))
+			cls = insn->has_addr ? M68K_INSN_CALL : M68K_INSN_UCALL;
+		else if (IS_INST(LINKW,opc) || IS_INST(LINKL,opc))
+			cls = M68K_INSN_PUSH;
+		else if (IS_INST(UNLK,opc))
+			cls = M68K_INSN_POP;
+		else if (IS_INST(SWAP,opc) || IS_INST(BKPT,opc))
+			break;
+		else if (IS_INST(EXTBW,opc) || IS_INST(EXTWL,opc) ||
+		    IS_INST(EXTBL,opc))
+			cls = M68K_INSN_MOV;
+		else if ((opc & 0xf1c0) == 0x41c0)
+			cls = M68K_INSN_LEA;
+		else if ((opc & 0xf140) == 0x4100)
+			cls = M68K_INSN_CTRAP;  /* CHK */
+		else if ((opc & 0xffc0) == 0x4840)
+			cls = M68K_INSN_PUSH;  /* PEA */
+		else if ((opc & 0xfb80) == 0x4880) {
+			/* MOVEM */
+			if (!ISBITSET(opc,10) && EA_PUSH(insn,0))
+				cls = M68K_INSN_PUSH;
+			else if (ISBITSET(opc,10) && EA_POP(insn,0))
+				cls = M68K_INSN_POP;
+			else
+				cls = M68K_INSN_MOV;
+		} else if (BITFIELD(opc,7,6) == 3)
+			/* MOVE from/to SR/CCR, TAS */
+			cls = BITFIELD(opc,11,8) == 0xa ? M68K_INSN_CMP : M68K_INSN_MOV;
+		else switch (BITFIELD(opc,11,8)) {
+		case 0x0:  /* NEGX */
+		case 0x4:  /* NEG */
+			cls = M68K_INSN_SUB;
+			break;
+		case 0x2:  /* CLR */
+			cls = M68K_INSN_MOV;
+			break;
+		case 0x6:
+			cls = M68K_INSN_NOT;
+			break;
+		case 0xa:  /* TST */
+			cls = M68K_INSN_CMP;
+			break;
+		case 0xc:  /* MULx.L, DIVx.L */
+			cls = ISBITSET(opc,6) ? M68K_INSN_DIV : M68K_INSN_MUL;
+			break;
+		}
+		break;
+	case 0x5:
+		if (IS_INST(DBcc,opc)) {
+			insn->addr = addr + 2 + (st16)read16(dbuf->val + 1);
+			insn->has_addr = 1;
+			cls = M68K_INSN_CJMP;
+		} else if (IS_INST(TRAPcc,opc) && BITFIELD(opc,2,0) > 1)
+			cls = M68K_INSN_CTRAP;
+		else if (IS_INST(Scc,opc))
+			cls = M68K_INSN_MOV;
+		else
+			cls = ISBITSET(opc,8) ? M68K_INSN_SUB : M68K_INSN_ADD;
+		break;
+	case 0x6:
+		disp = (st8)BITFIELD(opc,7,0);
+		if (disp == 0)
+			disp = (st16)read16(dbuf->val + 1);
+		else if (disp == -1)
+			disp = (st32)read32(dbuf->val + 1);
+		insn->addr = addr + 2 + disp;
+		insn->has_addr = 1;
+		if (IS_INST(BRA,opc))
+			cls = M68K_INSN_JMP;
+		else if (IS_INST(BSR,opc))
+			cls = M68K_INSN_CALL;
+		else
+			cls = M68K_INSN_CJMP;
+		break;
+	case 0x7:
+		cls = M68K_INSN_MOV;
+		break;
+	case 0x8:
+		if (BITFIELD(opc,7,6) == 3)
+			cls = M68K_INSN_DIV;
+		else if ((opc & 0x1f0) == 0x100)
+			cls = M68K_INSN_SUB;  /* SBCD */
+		else if ((opc & 0x1f0) != 0x140 && (opc & 0x1f0) != 0x180)
+			cls = M68K_INSN_OR;   /* not PACK/UNPK */
+		break;
+	case 0x9:
+		cls = M68K_INSN_SUB;
+		break;
+	case 0xa:
+		cls = M68K_INSN_LINE;
+		break;
+	case 0xb:
+		if (ISBITSET(opc,8) && BITFIELD(opc,7,6) != 3 &&
+		    BITFIELD(opc,5,3) != AR_DIR)
+			cls = M68K_INSN_XOR;
+		else
+			cls = M68K_INSN_CMP;
+		break;
+	case 0xc:
+		if (BITFIELD(opc,7,6) == 3)
+			cls = M68K_INSN_MUL;
+		else if ((opc & 0x1f0) == 0x100)
+			cls = M68K_INSN_ADD;  /* ABCD */
+		else if ((opc & 0x1f8) == 0x140 || (opc & 0x1f8) == 0x148 ||
+		    (opc & 0x1f8) == 0x188)
+			cls = M68K_INSN_XCHG;
+		else
+			cls = M68K_INSN_AND;
+		break;
+	case 0xd:
+		cls = M68K_INSN_ADD;
+		break;
+	case 0xe: {
+		static const unsigned char shifts[4][2] = {
+			{ M68K_INSN_SAR, M68K_INSN_SAL },
+			{ M68K_INSN_SHR, M68K_INSN_SHL },
+			{ M68K_INSN_ROR, M68K_INSN_ROL },
+			{ M68K_INSN_ROR, M68K_INSN_ROL }
+		};
+		if (BITFIELD(opc,7,6) == 3) {
+			if (!ISBITSET(opc,11))  /* else bit field */
+				cls = shifts[BITFIELD(opc,10,9)][BITFIELD(opc,8,8)];
+		} else
+			cls = shifts[BITFIELD(opc,4,3)][BITFIELD(opc,8,8)];
+		break;
+	}
+	case 0xf:
+		if ((opc & 0xf180) == 0xf080) {
+			/* cpBcc.w/.l */
+			if (ISBITSET(opc,6))
+				disp = (st32)read32(dbuf->val + 1);
+			else
+				disp = (st16)read16(dbuf->val + 1);
+			insn->addr = addr + 2 + disp;
+			insn->has_addr = 1;
+			cls = M68K_INSN_CJMP;
+		} else if ((opc & 0xf1f8) == 0xf048) {
+			/* cpDBcc */
+			insn->addr = addr + 4 + (st16)read16(dbuf->val + 2);
+			insn->has_addr = 1;
+			cls = M68K_INSN_CJMP;
+		} else if ((opc & 0xf1f8) == 0xf078 && BITFIELD(opc,2,0) > 1)
+			cls = M68K_INSN_CTRAP;
+		else if (BITFIELD(opc,11,9) > 3)
+			cls = M68K_INSN_LINE;
+		break;
+	}
+	insn->cls = cls;
+}
+
+
 /*
  * Bit manipulation/MOVEP/Immediate.
  */
@@ -2143,6 +2442,8 @@ static void print_reglist(dis_buffer_t *dbuf, int mod, ut16 rl) {
 		"a0","a1","a2","a3","a4","a5","a6","a7" };
 	int bit, list;
 
+	if (dbuf->insn)
+		return;
 	if (mod == AR_DEC) {
 		list = rl;
 		rl = 0;
@@ -2183,6 +2484,8 @@ static void print_freglist(dis_buffer_t *dbuf, int mod, ut16 rl, int cntl) {
 	const char *const * regs;
 	int bit, list, upper;
 
+	if (dbuf->insn)
+		return;
 	regs = cntl ? fpcregs : fpregs;
 	upper = cntl ? 3 : 8;
 
@@ -2391,6 +2694,8 @@ static void opcode_move16(dis_buffer_t *dbuf, ut16 opc) {
  * copy const string 's' into ``dbuf''->casm
  */
 static void addstr(dis_buffer_t *dbuf, const char *s) {
+	if (dbuf->insn)
+		return;
 	if (s)
 		while ((*dbuf->casm++ = *s++))
 			;
@@ -2402,6 +2707,8 @@ static void addstr(dis_buffer_t *dbuf, const char *s) {
  * copy const string 's' into ``dbuf''->cinfo
  */
 static void iaddstr(dis_buffer_t *dbuf, const char *s) {
+	if (dbuf->insn)
+		return;
 	while ((*dbuf->cinfo++ = *s++))
 		;
 	dbuf->cinfo--;
@@ -2848,6 +3155,8 @@ static void get_modregstr_mit(dis_buffer_t *dbuf,int bit, int mod, int sz, int d
  * the mod|reg pair.
  */
 static void get_modregstr(dis_buffer_t *dbuf, int bit, int mod, int sz, int dispdisp) {
+	if (dbuf->insn)
+		decode_ea(dbuf,bit,mod,dispdisp);
 	if (dbuf->mit)
 		get_modregstr_mit(dbuf,bit,mod,sz,dispdisp);
 	else
@@ -2997,7 +3306,7 @@ static void print_disp(dis_buffer_t *dbuf, int disp, int sz, int rel, int dd) {
 	ut32 nv = 0;
 	ut32i diff = INT_MAX;
 
-	if (!dbuf)
+	if (!dbuf || dbuf->insn)
 		return;
 
 	if (sz == SIZE_WORD)
@@ -3028,6 +3337,8 @@ static void print_addr(dis_buffer_t *dbuf, ut32 addr) {
 	ut32i diff = INT_MAX;
 	char *symname = NULL;
 
+	if (dbuf->insn)
+		return;
 	if (dbuf->dp->find_symbol) {
 		if (symname == dbuf->dp->find_symbol(addr, &diff)) {
 			if (diff == 0)
@@ -3052,6 +3363,8 @@ static void print_addr(dis_buffer_t *dbuf, ut32 addr) {
 
 
 static void prints(dis_buffer_t *dbuf, int val, int sz) {
+	if (dbuf->insn)
+		return;
 	if (val == 0) {
 		dbuf->casm[0] = '0';
 		dbuf->casm[1] = 0;
@@ -3085,6 +3398,8 @@ static void iprints(dis_buffer_t *dbuf, int val, int sz)
 
 
 static void printu(dis_buffer_t *dbuf, ut32i val, int sz) {
+	if (dbuf->insn)
+		return;
 	if (val == 0) {
 		dbuf->casm[0] = '0';
 		dbuf->casm[1] = 0;
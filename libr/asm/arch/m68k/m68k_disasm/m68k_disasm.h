@@ -452,6 +452,46 @@ struct DisasmPara_68k {
 };
 
 
+/* Decode-only interface: M68k_Decode() fills a m68k_insn without */
+/* producing any text, for analysis which only needs the length */
+/* and the control flow of an instruction. */
+
+enum m68k_insn_class {
+  M68K_INSN_OTHER = 0, M68K_INSN_ILLEGAL, M68K_INSN_NOP,
+  M68K_INSN_MOV, M68K_INSN_LEA, M68K_INSN_PUSH, M68K_INSN_POP,
+  M68K_INSN_ADD, M68K_INSN_SUB, M68K_INSN_MUL, M68K_INSN_DIV,
+  M68K_INSN_CMP, M68K_INSN_AND, M68K_INSN_OR, M68K_INSN_XOR,
+  M68K_INSN_NOT, M68K_INSN_SHL, M68K_INSN_SHR, M68K_INSN_SAL,
+  M68K_INSN_SAR, M68K_INSN_ROL, M68K_INSN_ROR, M68K_INSN_XCHG,
+  M68K_INSN_JMP,                /* BRA, JMP abs/pc-relative */
+  M68K_INSN_UJMP,               /* JMP through a register */
+  M68K_INSN_CJMP,               /* Bcc, DBcc, cpBcc, cpDBcc */
+  M68K_INSN_CALL,               /* BSR, JSR abs/pc-relative */
+  M68K_INSN_UCALL,              /* JSR through a register */
+  M68K_INSN_RET,                /* RTS, RTE, RTR, RTD */
+  M68K_INSN_TRAP,               /* TRAP #n */
+  M68K_INSN_CTRAP,              /* TRAPV, TRAPcc, CHK, cpTRAPcc */
+  M68K_INSN_LINE                /* A-line/F-line emulator trap */
+};
+
+enum m68k_ea_mode {
+  M68K_EA_NONE = 0, M68K_EA_DN, M68K_EA_AN, M68K_EA_IND, M68K_EA_INC,
+  M68K_EA_DEC, M68K_EA_DISP, M68K_EA_IDX, M68K_EA_ABSW, M68K_EA_ABSL,
+  M68K_EA_PCDISP, M68K_EA_PCIDX, M68K_EA_IMM
+};
+
+struct m68k_insn {
+  unsigned char size;           /* length in bytes */
+  unsigned char cls;            /* enum m68k_insn_class */
+  unsigned char nea;            /* effective addresses decoded (max. 2) */
+  unsigned char ea[2];          /* enum m68k_ea_mode, source first */
+  unsigned char ea_reg[2];      /* register number of each ea */
+  unsigned char has_addr;       /* addr is valid */
+  ut32 addr;                    /* branch target, or the absolute or */
+                                /*  pc-relative address of an operand */
+};
+
+
 struct dis_buffer {
   struct DisasmPara_68k *dp;  /* link to DisasmPara */
   short *val;   /* (real) pointer to memory. */
@@ -462,6 +502,7 @@ struct dis_buffer {
   char *cinfo;  /* current position in info. */
   int   used;   /* length used. */
   int   mit;    /* use mit syntax. */
+  struct m68k_insn *insn;  /* decode only: skip all text output */
 };
 typedef struct dis_buffer dis_buffer_t;
 
@@ -492,6 +533,7 @@ typedef const char *db_sym_t;  /*@@@*/
 /* m68k_disasm.o prototypes */
 #ifndef M68K_DISASM_C
 extern m68k_word *M68k_Disassemble(struct DisasmPara_68k *);
+extern int M68k_Decode(struct m68k_insn *, m68k_word *, ut32);
 
 #if 0
 extern void get_modregstr_moto(dis_buffer_t *dbuf, int bit, int mod,
@@ -176,6 +176,7 @@ static swf_tag_t swf_tag[] = {
 {TAG_FILEATTRIBUTES, "FileAttributes"},
 {TAG_PLACEOBJECT3, "PlaceObject3"},
 {TAG_IMPORTASSETS2, "ImportAssets2"},
+{TAG_DOABC, "DoABC"},
 {TAG_DEFINEFONTINFO3, "DefineFontInfo3"},
 {TAG_DEFINETEXTINFO, "DefineTextInfo"},
 {TAG_DEFINEFONT3, "DefineFont3"},
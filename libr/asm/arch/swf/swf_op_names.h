@@ -186,6 +186,7 @@ TAG_DEFINESHAPE4					= 67,
 TAG_FILEATTRIBUTES					= 69,
 TAG_PLACEOBJECT3					= 70, /* possibly onClipEvents inside */
 TAG_IMPORTASSETS2					= 71,
+TAG_DOABC							= 72, /* AVM2 bytecode */
 TAG_DEFINEFONTINFO3					= 73,
 TAG_DEFINETEXTINFO					= 74,
 TAG_DEFINEFONT3						= 75,
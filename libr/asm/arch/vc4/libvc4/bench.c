@@ -0,0 +1,160 @@
+#define _GNU_SOURCE         /* See feature_test_macros(7) */
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "vc4.h"
+
+/* Decode throughput over a synthetic firmware image: a random stream
+ * of the arch file's own encodings, with the don't-care bits random. */
+
+static uint32_t rnd_state = 0x12345678;
+
+static uint32_t rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void put_le16(uint8_t *b, uint16_t v)
+{
+	b[0] = v & 0xff;
+	b[1] = v >> 8;
+}
+
+static uint8_t *make_image(const struct vc4_info *info, size_t count, size_t *lenp)
+{
+	const struct vc4_opcode *op;
+	const struct vc4_opcode **ops;
+	size_t nops = 0, i, j, len = 0;
+	uint8_t *buf;
+
+	for (op = info->all_opcodes; op != NULL; op = op->next)
+		nops++;
+	ops = malloc(nops * sizeof(*ops));
+	buf = malloc(count * 10);
+	if (ops == NULL || buf == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0, op = info->all_opcodes; op != NULL; op = op->next)
+		ops[i++] = op;
+
+	for (i = 0; i < count; i++) {
+		op = ops[rnd() % nops];
+		for (j = 0; j < op->length; j++) {
+			uint16_t w = rnd();
+			if (j < 2)
+				w = (w & ~op->ins_mask[j]) | op->ins[j];
+			put_le16(buf + len + j * 2, w);
+		}
+		len += op->length * 2;
+	}
+
+	free(ops);
+	*lenp = len;
+	return buf;
+}
+
+/* The plain scan vc4_get_opcode() does without an index */
+static const struct vc4_opcode *get_opcode_linear(const struct vc4_info *info,
+						 const uint8_t *b, size_t l)
+{
+	const struct vc4_opcode_tab *t = info->opcodes[vc4_get_le16(b)];
+	uint16_t b1 = l < 4 ? 0 : vc4_get_le16(b + 2);
+	size_t i;
+
+	if (t == NULL)
+		return NULL;
+	if (t->count == 1)
+		return t->tab[0];
+	for (i = 0; i < t->count; i++) {
+		if ((t->tab[i]->ins_mask[1] == 0) ||
+		    (b1 & t->tab[i]->ins_mask[1]) == t->tab[i]->ins[1])
+			return t->tab[i];
+	}
+	return NULL;
+}
+
+static size_t run(const struct vc4_info *info, const uint8_t *buf, size_t len,
+		  int mode, size_t *bad)
+{
+	const struct vc4_opcode *op;
+	char line[256];
+	size_t off = 0, n = 0;
+
+	while (off + 2 <= len) {
+		if (mode == 0) {
+			op = get_opcode_linear(info, buf + off, len - off);
+		} else {
+			op = vc4_get_opcode(info, buf + off, len - off);
+			if (bad != NULL && op != get_opcode_linear(info, buf + off, len - off))
+				(*bad)++;
+		}
+		if (op == NULL) {
+			off += 2;
+			continue;
+		}
+		if (mode == 2)
+			vc4_display_buf(op, off, buf + off, len - off, line, sizeof(line));
+		off += op->length * 2;
+		n++;
+	}
+
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *names[] = { "lookup (linear)", "lookup (indexed)", "lookup + display" };
+	char *arch = getenv("VC4_ARCH");
+	struct vc4_info *info;
+	size_t count = 1000000, len, n = 0, bad = 0;
+	int rounds = 5, mode, r;
+	uint8_t *buf;
+	double t0, t;
+
+	if (arch == NULL) {
+		fprintf(stderr, "usage: VC4_ARCH=videocoreiv.arch %s [instructions] [rounds]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		rounds = atoi(argv[2]);
+
+	info = vc4_read_arch_file(arch);
+	vc4_get_opcodes(info);
+
+	buf = make_image(info, count, &len);
+
+	run(info, buf, len, 1, &bad);
+	printf("%zu bytes, %zu index mismatches\n", len, bad);
+
+	for (mode = 0; mode < 3; mode++) {
+		t0 = now();
+		for (r = 0; r < rounds; r++)
+			n = run(info, buf, len, mode, NULL);
+		t = (now() - t0) / rounds;
+		printf("%-18s %8.2f Minsn/s %8.2f MB/s\n", names[mode],
+		       n / t / 1e6, len / t / 1e6);
+	}
+
+	free(buf);
+	vc4_free_info(info);
+
+	return bad != 0;
+}
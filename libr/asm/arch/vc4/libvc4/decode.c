@@ -14,7 +14,7 @@
 
 void decode(const struct vc4_info *info, uint32_t addr, const uint8_t *buf, size_t len)
 {
-	char *ll;
+	char ll[256];
 	char cc[2*5+1];
 	char ww[5*5+2];
 
@@ -33,12 +33,10 @@ void decode(const struct vc4_info *info, uint32_t addr, const uint8_t *buf, size
 			cc[i] = isprint(buf[i]) ? buf[i] : '.';
 		cc[i] = 0;
 
-		ll = vc4_display(info, op, addr, buf, len);
+		vc4_display_buf(op, addr, buf, len, ll, sizeof(ll));
 
 		printf("%08X:  %-24s  %-10s  %s\n", addr, ww, cc, ll);
 
-		free(ll);
-
 		if (op->length * 2 >= len)
 			break;
 
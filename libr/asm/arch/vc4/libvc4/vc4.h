@@ -135,6 +135,79 @@ struct vc4_val
 
 #define VC4_MAX_PARAMS 15
 
+/* Display programs: each opcode's format is compiled once by
+ * vc4_get_opcodes() into literal spans, printf conversions over
+ * precompiled expressions and table lookups. */
+#define VC4_DISP_MAX_RUNS  8
+#define VC4_DISP_MAX_STACK 16
+
+enum vc4_disp_kind
+{
+	VC4_DISP_LIT,
+	VC4_DISP_NUM,
+	VC4_DISP_TAB,
+};
+
+enum vc4_expr_opc
+{
+	VC4_E_IMM,
+	VC4_E_VAR,
+	VC4_E_PC,
+	VC4_E_NEG,
+	VC4_E_ADD,
+	VC4_E_SUB,
+	VC4_E_MUL,
+	VC4_E_DIV,
+	VC4_E_AND,
+};
+
+struct vc4_expr_op
+{
+	uint8_t opc;
+	uint8_t var;
+	int64_t imm;
+};
+
+/* A field is read as runs of adjacent bits, most significant run first */
+struct vc4_disp_field
+{
+	char code;
+	uint8_t is_signed;
+	uint8_t length;
+	uint8_t num_runs;
+	struct {
+		uint8_t word;
+		uint8_t shift;
+		uint8_t width;
+	} run[VC4_DISP_MAX_RUNS];
+};
+
+struct vc4_disp_item
+{
+	enum vc4_disp_kind kind;
+
+	const char *lit;
+	size_t lit_len;
+
+	char fmt[16];
+	const struct vc4_decode_table *tab;
+
+	size_t expr;
+	size_t expr_len;
+};
+
+struct vc4_disp_prog
+{
+	size_t num_items;
+	struct vc4_disp_item *items;
+
+	size_t num_ops;
+	struct vc4_expr_op *ops;
+
+	size_t num_fields;
+	struct vc4_disp_field fields[52];
+};
+
 struct vc4_opcode
 {
 	struct vc4_opcode *next;
@@ -153,6 +226,8 @@ struct vc4_opcode
 
 	struct vc4_val vals_lc[26];
 	struct vc4_val vals_uc[26];
+
+	struct vc4_disp_prog *disp;
 };
 
 /* Part of a 'pattern' opcode */
@@ -185,9 +260,27 @@ struct vc4_asm
 	uint16_t ins_mask[2];
 };
 
+/* Second level index over the discriminating bits of the second word.
+ * The bits are gathered into a bucket number a byte at a time; each
+ * bucket lists, in table order, the entries that can still match. */
+#define VC4_INDEX_MAX_BITS 10
+
+struct vc4_opcode_index
+{
+	struct vc4_opcode_index *next;
+
+	uint16_t mask;
+	uint16_t lo[256];
+	uint16_t hi[256];
+
+	uint32_t *bucket;
+	uint8_t *cand;
+};
+
 struct vc4_opcode_tab
 {
 	size_t count;
+	const struct vc4_opcode_index *index;
 	struct vc4_opcode *tab[1];
 };
 
@@ -196,10 +289,12 @@ struct vc4_opcode_tab
 struct vc4_info
 {
 	struct vc4_decode_table *tables;
+	struct vc4_decode_table *table_by_code[256];
 
 	char signed_ops[10];
 
 	struct vc4_opcode_tab *opcodes[0x10000];
+	struct vc4_opcode_index *indexes;
 
 	struct vc4_opcode *all_opcodes;
 
@@ -222,6 +317,12 @@ void vc4_free_info(struct vc4_info *info);
 char *vc4_display(const struct vc4_info *info, const struct vc4_opcode *op,
 		  uint32_t addr, const uint8_t *b, uint32_t len);
 
+size_t vc4_display_buf(const struct vc4_opcode *op, uint32_t addr,
+		       const uint8_t *b, uint32_t len, char *out, size_t size);
+
+void vc4_compile_display(const struct vc4_info *info, struct vc4_opcode *op);
+void vc4_free_display(struct vc4_opcode *op);
+
 const struct vc4_opcode *vc4_get_opcode(const struct vc4_info *info, const uint8_t *b, size_t l);
 
 void vc4_build_values(struct vc4_val *vals, const struct vc4_opcode *op,
@@ -230,6 +331,7 @@ void vc4_build_values(struct vc4_val *vals, const struct vc4_opcode *op,
 void vc4_add_opcode_tab(struct vc4_opcode_tab **tabp, struct vc4_opcode *op);
 
 void vc4_get_opcodes(struct vc4_info *info);
+void vc4_build_opcode_index(struct vc4_info *info);
 
 void vc4_strncat(char **dest, const char *src, int len);
 void vc4_strcat(char **dest, const char *src);
@@ -883,6 +883,7 @@ struct vc4_info *vc4_read_arch_file(const char *path)
 			/*fprintf(stderr, "Table %c (%d)\n", ch, t->count);*/
 			t->next = inf->tables;
 			inf->tables = t;
+			inf->table_by_code[(unsigned char)ch] = t;
 		} else {
 			vc4_read_opcode(inf, line);
 		}
@@ -906,6 +907,7 @@ void vc4_free_info(struct vc4_info *info)
 		for (j = 0; j < op->num_params; j++) {
 			free(op->params[j].txt);
 		}
+		vc4_free_display(op);
 		free(op->format);
 		free(op);
 	}
@@ -928,6 +930,15 @@ void vc4_free_info(struct vc4_info *info)
 		free(info->opcodes[i]);
 	}
 
+	while (info->indexes != NULL) {
+		struct vc4_opcode_index *x = info->indexes;
+		info->indexes = x->next;
+
+		free(x->bucket);
+		free(x->cand);
+		free(x);
+	}
+
 	free(info->lookup_tab);
 
 	free(info);
@@ -1107,10 +1118,7 @@ static void vc4_go_expand(struct vc4_info *info,
 	assert(strlen(exp) == 1);
 	assert(exp[0] >= 'a' && exp[0] <= 'z');
 
-	t = info->tables;
-	while (t != NULL && t->code != exp[0]) {
-		t = t->next;
-	}
+	t = info->table_by_code[(unsigned char)exp[0]];
 	assert(t != NULL);
 
 	memcpy(&new_pat, base_pat, sizeof(struct vc4_op_pat));
@@ -1146,5 +1154,142 @@ void vc4_get_opcodes(struct vc4_info *info)
 		sscanf(op->format, "%31s ", str);
 		if (str[0] != '!')
 			vc4_go_expand(info, op, str, &pat);
+
+		vc4_compile_display(info, op);
+	}
+
+	vc4_build_opcode_index(info);
+}
+
+/* Pick the discriminating bits of the second word: all of them when
+ * they fit, otherwise the ones most entries test. */
+static uint16_t vc4_index_mask(const struct vc4_opcode_tab *t)
+{
+	size_t i, b, n, best, count[16];
+	uint16_t all = 0, mask = 0;
+
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < t->count; i++) {
+		all |= t->tab[i]->ins_mask[1];
+		for (b = 0; b < 16; b++) {
+			if (t->tab[i]->ins_mask[1] & (1u << b))
+				count[b]++;
+		}
+	}
+
+	if (__builtin_popcount(all) <= VC4_INDEX_MAX_BITS)
+		return all;
+
+	for (n = 0; n < VC4_INDEX_MAX_BITS; n++) {
+		best = 0;
+		for (b = 1; b < 16; b++) {
+			if (count[b] > count[best])
+				best = b;
+		}
+		mask |= 1u << best;
+		count[best] = 0;
+	}
+
+	return mask;
+}
+
+static struct vc4_opcode_index *vc4_index_new(const struct vc4_opcode_tab *t)
+{
+	struct vc4_opcode_index *x;
+	size_t nb, i, k, n, bk;
+	uint16_t b1;
+
+	x = calloc(1, sizeof(*x));
+	assert(x != NULL);
+
+	x->mask = vc4_index_mask(t);
+
+	/* gather the mask bits, low byte and high byte separately */
+	for (i = 0; i < 256; i++) {
+		for (k = 0, n = 0; k < 16; k++) {
+			if (!(x->mask & (1u << k)))
+				continue;
+			if (k < 8 && (i & (1u << k)))
+				x->lo[i] |= 1u << n;
+			if (k >= 8 && (i & (1u << (k - 8))))
+				x->hi[i] |= 1u << n;
+			n++;
+		}
 	}
+
+	nb = 1u << __builtin_popcount(x->mask);
+	x->bucket = calloc(nb + 1, sizeof(uint32_t));
+	x->cand = malloc(nb * t->count);
+	assert(x->bucket != NULL && x->cand != NULL);
+
+	for (bk = 0, n = 0; bk < nb; bk++) {
+		/* a representative second word for this bucket */
+		for (b1 = 0, k = 0, i = 0; k < 16; k++) {
+			if (x->mask & (1u << k)) {
+				if (bk & (1u << i))
+					b1 |= 1u << k;
+				i++;
+			}
+		}
+
+		x->bucket[bk] = n;
+		for (i = 0; i < t->count; i++) {
+			uint16_t m = t->tab[i]->ins_mask[1] & x->mask;
+
+			if ((b1 & m) != (t->tab[i]->ins[1] & m))
+				continue;
+			x->cand[n++] = i;
+
+			/* fully decided by the index bits: nothing after it is reached */
+			if ((t->tab[i]->ins_mask[1] & ~x->mask) == 0)
+				break;
+		}
+	}
+	x->bucket[nb] = n;
+
+	x->cand = realloc(x->cand, n ? n : 1);
+	assert(x->cand != NULL);
+
+	return x;
+}
+
+static int vc4_opcode_tab_compare(const void *va, const void *vb)
+{
+	const struct vc4_opcode_tab *a = *(const struct vc4_opcode_tab * const *)va;
+	const struct vc4_opcode_tab *b = *(const struct vc4_opcode_tab * const *)vb;
+
+	if (a->count != b->count)
+		return a->count < b->count ? -1 : 1;
+	return memcmp(a->tab, b->tab, a->count * sizeof(a->tab[0]));
+}
+
+/* Tables for b0 values that differ only in don't-care bits hold the
+ * same opcodes in the same order, so they share one index. */
+void vc4_build_opcode_index(struct vc4_info *info)
+{
+	struct vc4_opcode_tab **tabs;
+	struct vc4_opcode_index *x = NULL;
+	size_t i, n = 0;
+
+	tabs = malloc(0x10000 * sizeof(*tabs));
+	assert(tabs != NULL);
+
+	for (i = 0; i < 0x10000; i++) {
+		struct vc4_opcode_tab *t = info->opcodes[i];
+		if (t != NULL && t->count >= 2 && t->count <= 255)
+			tabs[n++] = t;
+	}
+
+	qsort(tabs, n, sizeof(*tabs), vc4_opcode_tab_compare);
+
+	for (i = 0; i < n; i++) {
+		if (i == 0 || vc4_opcode_tab_compare(&tabs[i - 1], &tabs[i]) != 0) {
+			x = vc4_index_new(tabs[i]);
+			x->next = info->indexes;
+			info->indexes = x;
+		}
+		tabs[i]->index = x;
+	}
+
+	free(tabs);
 }
@@ -11,7 +11,6 @@
 #include <ctype.h>
 #include <limits.h>
 
-#include "eval.h"
 #include "vc4.h"
 
 
@@ -63,132 +62,372 @@ void vc4_build_values(struct vc4_val *vals, const struct vc4_opcode *op,
 	}
 }
 
-static char *vc4_expand_expr(const char *p, const struct vc4_info *info,
-			     const struct vc4_val *vals)
+struct vc4_disp_build
 {
-	char *exp2;
-	char *np;
-	int r;
+	const struct vc4_info *info;
+	struct vc4_opcode *op;
+	struct vc4_disp_prog *prog;
+	const char *exp;
+	size_t depth;
+	size_t max_depth;
+};
+
+static void vc4_disp_error(const struct vc4_disp_build *bld, const char *what)
+{
+	fprintf(stderr, "bad format %s in '%s': %s\n", bld->exp, bld->op->format, what);
+	abort();
+}
 
-	exp2 = strdup("");
+static struct vc4_disp_item *vc4_disp_add_item(struct vc4_disp_prog *prog,
+					      enum vc4_disp_kind kind)
+{
+	struct vc4_disp_item *it;
 
-	for (; *p != 0; p++) {
-		np = NULL;
-		if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '$') {
+	prog->items = realloc(prog->items, (prog->num_items + 1) * sizeof(*it));
+	assert(prog->items != NULL);
 
-			const struct vc4_val *val = vals + (int)*p;
+	it = &prog->items[prog->num_items++];
+	memset(it, 0, sizeof(*it));
+	it->kind = kind;
+	it->expr = prog->num_ops;
+	return it;
+}
 
-			if (strchr(info->signed_ops, *p)) {
-				int32_t t = (int32_t)val->value;
-				
-				if (t & (1 << (val->length - 1)))
-					t -= 1 << val->length;
+static void vc4_disp_emit(struct vc4_disp_build *bld, uint8_t opc,
+			  uint8_t var, int64_t imm)
+{
+	struct vc4_disp_prog *prog = bld->prog;
+	struct vc4_expr_op *e;
+
+	prog->ops = realloc(prog->ops, (prog->num_ops + 1) * sizeof(*e));
+	assert(prog->ops != NULL);
+
+	e = &prog->ops[prog->num_ops++];
+	e->opc = opc;
+	e->var = var;
+	e->imm = imm;
+
+	/* track the evaluation stack so vc4_display_buf can use a fixed one */
+	if (opc == VC4_E_IMM || opc == VC4_E_VAR || opc == VC4_E_PC) {
+		bld->depth++;
+		if (bld->depth > bld->max_depth)
+			bld->max_depth = bld->depth;
+	} else if (opc != VC4_E_NEG) {
+		bld->depth--;
+	}
+}
 
-				r = asprintf(&np, "%s%d", exp2, t);
-			} else {
-				r = asprintf(&np, "%s%u", exp2, val->value);
-			}
-		} else {
-			r = asprintf(&np, "%s%c", exp2, *p);
-		}
-		assert(r > 0);
+/* Same bit walk as vc4_build_values(), done once per field */
+static uint8_t vc4_disp_field(struct vc4_disp_build *bld, char code)
+{
+	struct vc4_disp_prog *prog = bld->prog;
+	const struct vc4_opcode *op = bld->op;
+	struct vc4_disp_field *f;
+	size_t i, k;
+
+	for (i = 0; i < prog->num_fields; i++) {
+		if (prog->fields[i].code == code)
+			return i;
+	}
+
+	if (prog->num_fields == sizeof(prog->fields) / sizeof(prog->fields[0]))
+		vc4_disp_error(bld, "too many fields");
+
+	f = &prog->fields[prog->num_fields];
+	memset(f, 0, sizeof(*f));
+	f->code = code;
+	f->is_signed = strchr(bld->info->signed_ops, code) != NULL;
 
-		if (np != NULL) {
-			free(exp2);
-			exp2 = np;
+	for (k = 0; k < 16 * op->length; k++) {
+		uint8_t word = k / 16;
+
+		if (op->string[k] != code)
+			continue;
+
+		/* 48-bit scalar instructions have their last two words swapped */
+		if (op->mode == VC4_INS_SCALAR48 && word != 0)
+			word = 3 - word;
+
+		if (f->num_runs > 0 && k > 0 && op->string[k - 1] == code &&
+		    (k % 16) != 0) {
+			f->run[f->num_runs - 1].shift--;
+			f->run[f->num_runs - 1].width++;
+		} else {
+			if (f->num_runs == VC4_DISP_MAX_RUNS)
+				vc4_disp_error(bld, "field too scattered");
+			f->run[f->num_runs].word = word;
+			f->run[f->num_runs].shift = 15 - (k % 16);
+			f->run[f->num_runs].width = 1;
+			f->num_runs++;
 		}
+		f->length++;
 	}
 
-	return exp2;
+	return prog->num_fields++;
 }
 
-static int64_t vc4_eval_expr(const char *exp, const struct vc4_info *info,
-			     const struct vc4_val *vals)
+static void vc4_disp_expr(struct vc4_disp_build *bld, const char **pp);
+
+static void vc4_disp_factor(struct vc4_disp_build *bld, const char **pp)
 {
-	char *exp2;
-	int64_t ev;
+	const char *p = *pp;
+
+	if (isdigit(*p)) {
+		char *end;
+		int64_t v = strtoll(p, &end, 10);
+		vc4_disp_emit(bld, VC4_E_IMM, 0, v);
+		p = end;
+	} else if (*p == '-') {
+		p++;
+		vc4_disp_factor(bld, &p);
+		vc4_disp_emit(bld, VC4_E_NEG, 0, 0);
+	} else if (*p == '(') {
+		p++;
+		vc4_disp_expr(bld, &p);
+		if (*p != ')')
+			vc4_disp_error(bld, "missing )");
+		p++;
+	} else if (*p == '$') {
+		vc4_disp_emit(bld, VC4_E_PC, 0, 0);
+		p++;
+	} else if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) {
+		vc4_disp_emit(bld, VC4_E_VAR, vc4_disp_field(bld, *p), 0);
+		p++;
+	} else {
+		vc4_disp_error(bld, "unexpected character");
+	}
 
-	exp2 = vc4_expand_expr(exp, info, vals);
+	*pp = p;
+}
 
-	ev = eval(exp2);
+static void vc4_disp_term(struct vc4_disp_build *bld, const char **pp)
+{
+	char op;
 
-	free(exp2);
+	vc4_disp_factor(bld, pp);
 
-	return ev;
+	while (**pp == '*' || **pp == '/' || **pp == '&') {
+		op = *(*pp)++;
+		vc4_disp_factor(bld, pp);
+		vc4_disp_emit(bld, op == '*' ? VC4_E_MUL :
+			      op == '/' ? VC4_E_DIV : VC4_E_AND, 0, 0);
+	}
 }
 
-char *vc4_display(const struct vc4_info *info, const struct vc4_opcode *op,
-		  uint32_t addr, const uint8_t *b, uint32_t len)
+static void vc4_disp_expr(struct vc4_disp_build *bld, const char **pp)
 {
-	struct vc4_val vals[256];
+	char op = '+';
 
-	vc4_build_values(vals, op, b, len);
+	if (**pp == '+' || **pp == '-')
+		op = *(*pp)++;
 
-	vals['$'].value = addr;
-	vals['$'].length = 32;
+	vc4_disp_term(bld, pp);
+	if (op == '-')
+		vc4_disp_emit(bld, VC4_E_NEG, 0, 0);
 
-	char *fmt;
-	char *exp;
+	while (**pp == '+' || **pp == '-') {
+		op = *(*pp)++;
+		vc4_disp_term(bld, pp);
+		vc4_disp_emit(bld, op == '-' ? VC4_E_SUB : VC4_E_ADD, 0, 0);
+	}
+}
 
+void vc4_compile_display(const struct vc4_info *info, struct vc4_opcode *op)
+{
+	struct vc4_disp_build bld;
+	struct vc4_disp_prog *prog;
+	struct vc4_disp_item *it;
 	const char *c = op->format;
-	const char *q;
+	const char *q, *open, *close;
+	char exp[64];
 
-	int l0, r;
+	if (op->disp != NULL)
+		return;
 
-	char *d;
-	char *md = NULL;
+	prog = calloc(1, sizeof(*prog));
+	assert(prog != NULL);
 
-	d = strdup("");
+	memset(&bld, 0, sizeof(bld));
+	bld.info = info;
+	bld.op = op;
+	bld.prog = prog;
 
 	while ((q = strchr(c, '%')) != NULL) {
+		if (q > c) {
+			it = vc4_disp_add_item(prog, VC4_DISP_LIT);
+			it->lit = c;
+			it->lit_len = q - c;
+		}
 
-		vc4_strncat(&d, c, q - c);
-		c += q - c;
+		open = strchr(q, '{');
+		close = open ? strchr(open, '}') : NULL;
+		if (open == NULL || close == NULL || open == q + 1 ||
+		    (size_t)(open - q) >= sizeof(it->fmt) ||
+		    (size_t)(close - open) > sizeof(exp)) {
+			fprintf(stderr, "bad line %s\n", q);
+			abort();
+		}
+		memcpy(exp, open + 1, close - open - 1);
+		exp[close - open - 1] = 0;
+		bld.exp = exp;
 
-		assert(c[0] == '%');
+		if (open - q == 2 && q[1] == 's') {
+			const struct vc4_decode_table *t;
 
-		fmt = malloc(strlen(c));
-		exp = malloc(strlen(c));
-		l0 = -1;
+			if (strlen(exp) != 1)
+				vc4_disp_error(&bld, "table reference");
+			t = info->table_by_code[(unsigned char)exp[0]];
+			if (t == NULL)
+				vc4_disp_error(&bld, "no such table");
 
-		r = sscanf(c, "%[^{]{%[^}]}%n", fmt, exp, &l0);
+			it = vc4_disp_add_item(prog, VC4_DISP_TAB);
+			it->tab = t;
+		} else {
+			it = vc4_disp_add_item(prog, VC4_DISP_NUM);
+			memcpy(it->fmt, q, open - q);
+			it->fmt[open - q] = 0;
+		}
 
-		if (r < 2 || l0 < 2 || fmt == NULL || exp == NULL) {
-			fprintf(stderr, "bad line  %s/%s/%s %d %d\n", fmt, exp, c+l0, l0, r);
-			abort();
+		bld.depth = 0;
+		{
+			const char *p = exp;
+			vc4_disp_expr(&bld, &p);
+			if (*p)
+				vc4_disp_error(&bld, "trailing characters");
+		}
+		if (bld.max_depth > VC4_DISP_MAX_STACK)
+			vc4_disp_error(&bld, "expression too deep");
+		it->expr_len = prog->num_ops - it->expr;
+
+		c = close + 1;
+	}
+
+	if (*c) {
+		it = vc4_disp_add_item(prog, VC4_DISP_LIT);
+		it->lit = c;
+		it->lit_len = strlen(c);
+	}
+
+	op->disp = prog;
+}
+
+void vc4_free_display(struct vc4_opcode *op)
+{
+	if (op->disp == NULL)
+		return;
+
+	free(op->disp->items);
+	free(op->disp->ops);
+	free(op->disp);
+	op->disp = NULL;
+}
+
+static int64_t vc4_disp_eval(const struct vc4_expr_op *e, size_t n,
+			     const int64_t *vals, uint32_t addr)
+{
+	int64_t st[VC4_DISP_MAX_STACK];
+	size_t sp = 0;
+
+	for (; n > 0; n--, e++) {
+		switch (e->opc) {
+		case VC4_E_IMM: st[sp++] = e->imm; break;
+		case VC4_E_VAR: st[sp++] = vals[e->var]; break;
+		case VC4_E_PC:  st[sp++] = addr; break;
+		case VC4_E_NEG: st[sp - 1] = -st[sp - 1]; break;
+		case VC4_E_ADD: sp--; st[sp - 1] += st[sp]; break;
+		case VC4_E_SUB: sp--; st[sp - 1] -= st[sp]; break;
+		case VC4_E_MUL: sp--; st[sp - 1] *= st[sp]; break;
+		case VC4_E_AND: sp--; st[sp - 1] &= st[sp]; break;
+		case VC4_E_DIV:
+			sp--;
+			st[sp - 1] = st[sp] ? st[sp - 1] / st[sp] : 0;
+			break;
 		}
+	}
+
+	return sp ? st[0] : 0;
+}
+
+size_t vc4_display_buf(const struct vc4_opcode *op, uint32_t addr,
+		       const uint8_t *b, uint32_t len, char *out, size_t size)
+{
+	const struct vc4_disp_prog *prog = op->disp;
+	int64_t vals[sizeof(prog->fields) / sizeof(prog->fields[0])];
+	uint16_t w[5];
+	size_t i, j, pos = 0;
+	int r;
 
-		c += l0;
+	if (size == 0)
+		return 0;
+	out[0] = 0;
+	if (prog == NULL)
+		return 0;
 
-		int64_t ev = vc4_eval_expr(exp, info, vals);
+	for (i = 0; i < op->length; i++)
+		w[i] = (i * 2u + 1u) < len ? vc4_get_le16(b + i * 2) : 0;
 
-		if (strcmp(fmt, "%s") == 0) {
-			assert(strlen(exp) == 1);
-			struct vc4_decode_table *t = info->tables;
-			while (t != NULL && t->code != exp[0]) {
-				t = t->next;
-			}
-			assert(t != NULL);
-			assert(ev >= 0);
-			assert((size_t)ev < t->count);
-			r = asprintf(&md, fmt, t->tab[ev]);
+	for (i = 0; i < prog->num_fields; i++) {
+		const struct vc4_disp_field *f = &prog->fields[i];
+		uint32_t v = 0;
+
+		for (j = 0; j < f->num_runs; j++) {
+			v <<= f->run[j].width;
+			v |= (w[f->run[j].word] >> f->run[j].shift) &
+				((1u << f->run[j].width) - 1);
+		}
+
+		if (f->is_signed) {
+			int32_t t = (int32_t)v;
+			if (f->length > 0 && f->length < 32 && (t & (1 << (f->length - 1))))
+				t -= 1 << f->length;
+			vals[i] = t;
 		} else {
-			r = asprintf(&md, fmt, (uint32_t)ev);
+			vals[i] = v;
 		}
-		assert(r >= 0);
+	}
 
-		if (md != NULL) {
-			vc4_strcat(&d, md);
-			free(md);
+	for (i = 0; i < prog->num_items && pos < size - 1; i++) {
+		const struct vc4_disp_item *it = &prog->items[i];
+		int64_t ev;
+
+		if (it->kind == VC4_DISP_LIT) {
+			size_t n = it->lit_len;
+			if (n > size - 1 - pos)
+				n = size - 1 - pos;
+			memcpy(out + pos, it->lit, n);
+			pos += n;
+			out[pos] = 0;
+			continue;
 		}
 
-		free(fmt);
-		free(exp);
+		ev = vc4_disp_eval(prog->ops + it->expr, it->expr_len, vals, addr);
+
+		if (it->kind == VC4_DISP_TAB) {
+			r = snprintf(out + pos, size - pos, "%s",
+				     ev >= 0 && (size_t)ev < it->tab->count ?
+				     it->tab->tab[ev] : "?");
+		} else {
+			r = snprintf(out + pos, size - pos, it->fmt, (uint32_t)ev);
+		}
+		if (r < 0)
+			break;
+		pos += r;
 	}
 
-	vc4_strcat(&d, c);
+	if (pos > size - 1)
+		pos = size - 1;
+	return pos;
+}
+
+char *vc4_display(const struct vc4_info *info, const struct vc4_opcode *op,
+		  uint32_t addr, const uint8_t *b, uint32_t len)
+{
+	char buf[256];
 
-	return d;
+	(void)info;
+	vc4_display_buf(op, addr, b, len, buf, sizeof(buf));
+
+	return strdup(buf);
 }
 
 const struct vc4_opcode *vc4_get_opcode(const struct vc4_info *info, const uint8_t *b, size_t l)
@@ -218,6 +457,20 @@ const struct vc4_opcode *vc4_get_opcode(const struct vc4_info *info, const uint8
 		b1 = vc4_get_le16(b + 2);
 	}
 
+	/* Every entry of opcodes[b0] matches b0 by construction */
+	if (t->index != NULL) {
+		const struct vc4_opcode_index *x = t->index;
+		size_t bk = x->lo[b1 & 0xff] | x->hi[b1 >> 8];
+
+		for (i = x->bucket[bk]; i < x->bucket[bk + 1]; i++) {
+			const struct vc4_opcode *op = t->tab[x->cand[i]];
+			if (op->ins_mask[1] == 0 ||
+			    (b1 & op->ins_mask[1]) == op->ins[1])
+				return op;
+		}
+		return NULL;
+	}
+
 	for (i = 0; i < t->count; i++) {
 		if (((b0 & t->tab[i]->ins_mask[0]) == t->tab[i]->ins[0]) &&
 		    ((t->tab[i]->ins_mask[1] == 0) ||
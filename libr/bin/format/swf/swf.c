@@ -32,12 +32,12 @@ char* get_swf_file_type(char compression, char flashVersion) {
 	return type;
 }
 
-swf_hdr r_bin_swf_get_header(RBinFile *arch) {
+swf_hdr r_bin_swf_get_header(RBuffer *buf) {
 	swf_hdr header = {{0}};
 	ut8 nBits = 0;
 
 	/* First, get the rect size */
-	r_buf_read_at (arch->buf, 8, (ut8*)&nBits, 1);
+	r_buf_read_at (buf, 8, (ut8*)&nBits, 1);
 	nBits = (nBits & 0xf8) >> 3;
 	ut32 rect_size_bits = nBits*4 + 5;
 	ut32 rect_size_bytes = rect_size_bits / 8;
@@ -46,158 +46,110 @@ swf_hdr r_bin_swf_get_header(RBinFile *arch) {
 	}
 
 	/* Read the whole header */
-	r_buf_read_at (arch->buf, 0, (ut8*)&header, R_MIN (8, sizeof (header)));
+	r_buf_read_at (buf, 0, (ut8*)&header, R_MIN (8, sizeof (header)));
 	header.rect_size = rect_size_bytes;
 
 	/* TODO: Record rectangle with xmin xmax ymin ymax if needed */
 
 	// Do this better (swf reverts values)
-	r_buf_read_at (arch->buf, 8+rect_size_bytes, (ut8*)&header.frame_rate+1, 1);
-	r_buf_read_at (arch->buf, 8+rect_size_bytes+1, (ut8*)&header.frame_rate, 1);
-	r_buf_read_at (arch->buf, 8+rect_size_bytes+2, (ut8*)&header.frame_count+1, 1);
-	r_buf_read_at (arch->buf, 8+rect_size_bytes+3, (ut8*)&header.frame_count, 1);
+	r_buf_read_at (buf, 8+rect_size_bytes, (ut8*)&header.frame_rate+1, 1);
+	r_buf_read_at (buf, 8+rect_size_bytes+1, (ut8*)&header.frame_rate, 1);
+	r_buf_read_at (buf, 8+rect_size_bytes+2, (ut8*)&header.frame_count+1, 1);
+	r_buf_read_at (buf, 8+rect_size_bytes+3, (ut8*)&header.frame_count, 1);
 
 	return header;
 }
 
-/* http://www.homer.com.au/webdoc/flash_file_format_specification.pdf */
-int r_bin_swf_get_sections(RList *list, RBinFile *arch) {
-	swf_hdr header = r_bin_swf_get_header (arch);
+static RBinSection *swf_section(RList *list, const char *name, ut64 start, ut64 size, int perm) {
+	RBinSection *sect = R_NEW0 (RBinSection);
+	if (!sect) {
+		return NULL;
+	}
+	snprintf (sect->name, R_BIN_SIZEOF_STRINGS, "%s", name);
+	sect->paddr = start;
+	sect->vaddr = start;
+	sect->size = size;
+	sect->vsize = size;
+	sect->perm = perm;
+	r_list_append (list, sect);
+	return sect;
+}
 
-	if (header.signature[0] == ISWF_MAGIC_0_1) {
-		// CWS file compression is not supported !
-		// 2 sections in this case : header and zlib data
-		// TODO: Decompress zlib data
+/* http://www.homer.com.au/webdoc/flash_file_format_specification.pdf */
+int r_bin_swf_get_sections(RList *list, RBuffer *buf) {
+	swf_hdr header = r_bin_swf_get_header (buf);
+	ut64 size = r_buf_size (buf);
 
-		/* Header section */
-		RBinSection *head_sect;
-		if (!(head_sect = R_NEW0 (RBinSection))) {
-			return false;
-		}
-		strcpy (head_sect->name, "Header");
-		head_sect->paddr = 0;
-		head_sect->vaddr = 0;
+	if (header.signature[0] == ISWF_MAGIC_0_1 || header.signature[0] == ISWF_MAGIC_0_2) {
+		/* compressed body as io maps it, one blob. Its tags are listed
+		 * when the file is opened through swfz:// */
 		ut8 start = 0x8; // signature + version + size
-		head_sect->size = start;
-		head_sect->vsize = start; 
-		head_sect->perm = R_PERM_R;
-		r_list_append (list, head_sect);
-
-		/* ZlibData section */
-		RBinSection *data;
-
-		if (!(data = R_NEW0 (RBinSection)))
-			return false;
-
-		snprintf(data->name, R_BIN_SIZEOF_STRINGS, "ZlibData");
-		data->paddr = start;
-		data->vaddr = start;
-		data->size = r_buf_size(arch->buf) - start;
-		data->vsize = r_buf_size(arch->buf) - start;
-		data->perm = R_PERM_R;
-
-		r_list_append (list, data);
-	} else if (header.signature[0] == ISWF_MAGIC_0_2) {
-		// ZWS file compression is not supported !
-		// 2 sections in this case : header and Lzma data
-		// TODO: Decompress lzma data
-
-		/* Header section */
-		RBinSection *head_sect;
-		if (!(head_sect = R_NEW0 (RBinSection))) {
+		if (!swf_section (list, "Header", 0, start, R_PERM_R)) {
 			return false;
 		}
-		strcpy (head_sect->name, "Header");
-		head_sect->paddr = 0;
-		head_sect->vaddr = 0;
-		ut8 start = 0x8; // signature + version + size
-		head_sect->size = start;
-		head_sect->vsize = start; 
-		head_sect->perm = R_PERM_R;
-		r_list_append (list, head_sect);
-
-		/* LzmaData section */
-		RBinSection *data = R_NEW0 (RBinSection);
-		if (!data) {
+		const char *name = header.signature[0] == ISWF_MAGIC_0_1? "ZlibData": "LzmaData";
+		if (size > start && !swf_section (list, name, start, size - start, R_PERM_R)) {
 			return false;
 		}
-		snprintf(data->name, R_BIN_SIZEOF_STRINGS, "LzmaData");
-		data->paddr = start;
-		data->vaddr = start;
-		data->size = r_buf_size(arch->buf) - start;
-		data->vsize = r_buf_size(arch->buf) - start;
-		data->perm = R_PERM_R;
-
-		r_list_append (list, data);
-	} else {
-		/* Header section */
-		RBinSection *head_sect;
-		if (!(head_sect = R_NEW0 (RBinSection))) {
-			return false;
+		return true;
+	}
+
+	ut64 start = header.rect_size + SWF_HDR_MIN_SIZE; // rect + min_size
+	if (!swf_section (list, "Header", 0, start, R_PERM_R)) {
+		return false;
+	}
+
+	/* One pass over the tags, one section each */
+	while (start + 2 <= size) {
+		ut8 tagHeader[6] = {0};
+		int n = r_buf_read_at (buf, start, tagHeader, sizeof (tagHeader));
+		if (n < 2) {
+			break;
 		}
-		strcpy(head_sect->name, "Header");
-		head_sect->paddr = 0;
-		head_sect->vaddr = 0;
-		ut32 start = header.rect_size + SWF_HDR_MIN_SIZE; // rect + min_size
-		head_sect->size = start;
-		head_sect->vsize = start; 
-		head_sect->perm = R_PERM_R;
-		r_list_append (list, head_sect);
-
-		/* Other sections */
-		ut16 tagCodeAndLength = 0;
-		ut16 tagCode = 0;
-		ut8 tagLengthShort = 0;
-		ut32 end = start;
-		ut32 tagLengthLong;
-
-		int section = 0;
-		r_buf_read_at (arch->buf, start, (ut8*)&tagCodeAndLength, 2);
-
-		while (tagCodeAndLength != 0) {
-			start = end;
-
-			tagLengthLong = 0;
-			tagCode = tagCodeAndLength >> 6; //10 higher bytes is code
-			tagLengthShort = tagCodeAndLength & 0x3f; //6 lowers bytes is length
-
-			if (tagLengthShort >= 0x3F) {
-				r_buf_read_at (arch->buf, start+2, (ut8*)&tagLengthLong, 4);
-				end = start + 6 + tagLengthLong;
-			} else {
-				end = start + 2 + tagLengthShort;
+		ut16 tagCodeAndLength = r_read_le16 (tagHeader);
+		if (!tagCodeAndLength) {
+			/* End tag */
+			break;
+		}
+		ut16 tagCode = tagCodeAndLength >> 6; //10 higher bytes is code
+		ut64 end = start + 2 + (tagCodeAndLength & 0x3f); //6 lowers bytes is length
+		if ((tagCodeAndLength & 0x3f) == 0x3f) {
+			if (n < 6) {
+				break;
 			}
+			end = start + 6 + r_read_le32 (tagHeader + 2);
+		}
+		if (end > size) {
+			end = size;
+		}
 
-			RBinSection *new = R_NEW0 (RBinSection);
-			if (!new) {
-				return false;
+		swf_tag_t tag = r_asm_swf_gettag (tagCode);
+		RBinSection *new;
+		switch (tagCode) {
+		case TAG_DOACTION:
+		case TAG_DOINITACTION:
+			new = swf_section (list, tag.name, start, end - start, R_PERM_RX);
+			if (new) {
+				new->has_strings = true;
 			}
-			swf_tag_t tag = r_asm_swf_gettag (tagCode);
-			strcpy (new->name, tag.name);
-			new->paddr = start;
-			new->vaddr = start;
-
-			new->size = end - start;
-			new->vsize = end - start;
-
-			switch (tagCode) {
-			case TAG_DOACTION:
-			case TAG_DOINITACTION:
-				new->perm = R_PERM_RX;
+			break;
+		case TAG_DOABC:
+		case TAG_AVM2ACTION:
+			/* AVM2 bytecode, not for the AVM1 disassembler */
+			new = swf_section (list, tag.name, start, end - start, R_PERM_R);
+			if (new) {
 				new->has_strings = true;
-				break;
-			default:
-				new->perm = R_PERM_R;
-				break;
 			}
-			r_list_append (list, new);
-
-			/* Read next tag info */
-			r_buf_read_at (arch->buf, end, (ut8*)&tagCodeAndLength, 2);
-			section++;
+			break;
+		default:
+			new = swf_section (list, tag.name, start, end - start, R_PERM_R);
+			break;
 		}
+		if (!new) {
+			return false;
+		}
+		start = end;
 	}
 
 	return true;
 }
-
@@ -16,7 +16,7 @@ typedef struct __attribute__((__packed__)) {
 } swf_hdr;
 
 char* get_swf_file_type(char compression, char flashVersion);
-swf_hdr r_bin_swf_get_header(RBinFile *arch);
-int r_bin_swf_get_sections(RList* list, RBinFile *arch);
+swf_hdr r_bin_swf_get_header(RBuffer *buf);
+int r_bin_swf_get_sections(RList* list, RBuffer *buf);
 
 #endif
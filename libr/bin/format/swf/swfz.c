@@ -0,0 +1,403 @@
+/* radare - LGPL3 - 2018 */
+
+#include <zlib.h>
+#include <lzma.h>
+#include "swfz.h"
+#include "swf_specs.h"
+
+/* Read-only RBuffer holding the FWS file a CWS or ZWS file decompresses
+ * to. Reads are served from a small cache of decompressed chunks and, for
+ * zlib, a copy of the inflate state is saved every SWFZ_SPAN bytes, so a
+ * chunk that was evicted is inflated again from the closest saved state
+ * instead of from the start. liblzma cannot copy its decoder state, so
+ * what ZWS files decode is kept instead. Loading the bin walks every tag,
+ * which decodes the whole body once. */
+
+typedef struct {
+	ut64 in;	// compressed offset to resume reading from
+	ut64 out;	// body offset it was saved at
+	z_stream zs;
+} SwfzPoint;
+
+typedef struct {
+	ut64 off;	// body offset, UT64_MAX when unused
+	ut32 len;
+	ut32 used;	// last access, the oldest chunk is evicted
+	ut8 data[SWFZ_CHUNK];
+} SwfzChunk;
+
+typedef struct {
+	RBuffer *src;
+	ut8 type;
+	ut8 hdr[8];	// FWS header in front of the body
+	ut64 size;	// whole file, header included
+	ut64 cur;
+	/* decoder */
+	ut64 in_start, in_end;
+	ut64 in;	// next compressed offset to feed
+	ut64 out;	// body bytes decoded so far
+	bool ready;
+	bool eof;
+	z_stream zs;
+	lzma_stream ls;
+	ut8 inbuf[SWFZ_IN];
+	/* ZWS */
+	ut8 *flat;
+	ut64 flat_len, flat_size;
+	/* index */
+	SwfzPoint **points;	// zlib ties its state to the z_stream, never moved
+	int npoints;
+	SwfzChunk cache[SWFZ_CACHE];
+	ut32 tick;
+} Swfz;
+
+static void swfz_end(Swfz *z) {
+	if (z->ready) {
+		if (z->type == ISWF_MAGIC_0_1) {
+			inflateEnd (&z->zs);
+		} else {
+			lzma_end (&z->ls);
+		}
+		z->ready = false;
+	}
+}
+
+static bool swfz_start(Swfz *z) {
+	swfz_end (z);
+	z->in = z->in_start;
+	z->out = 0;
+	z->eof = false;
+	if (z->type == ISWF_MAGIC_0_1) {
+		memset (&z->zs, 0, sizeof (z->zs));
+		if (inflateInit (&z->zs) != Z_OK) {
+			return false;
+		}
+	} else {
+		lzma_stream ls = LZMA_STREAM_INIT;
+		lzma_filter filters[2] = {
+			{ .id = LZMA_FILTER_LZMA1 },
+			{ .id = LZMA_VLI_UNKNOWN }
+		};
+		ut8 props[5];
+		if (r_buf_read_at (z->src, SWFZ_LZMA_PROPS, props, sizeof (props)) != sizeof (props)) {
+			return false;
+		}
+		if (lzma_properties_decode (filters, NULL, props, sizeof (props)) != LZMA_OK) {
+			return false;
+		}
+		z->ls = ls;
+		lzma_ret ret = lzma_raw_decoder (&z->ls, filters);
+		free (filters[0].options);
+		if (ret != LZMA_OK) {
+			return false;
+		}
+	}
+	z->ready = true;
+	return true;
+}
+
+/* decode the next `len` body bytes into dst, less at the end of the stream */
+static ut32 swfz_decode(Swfz *z, ut8 *dst, ut32 len) {
+	bool zlib = z->type == ISWF_MAGIC_0_1;
+	ut32 done = 0;
+
+	while (done < len && !z->eof) {
+		size_t avail = zlib? z->zs.avail_in: z->ls.avail_in;
+		if (!avail) {
+			int n = (int)R_MIN (sizeof (z->inbuf), z->in_end - z->in);
+			if (n <= 0 || r_buf_read_at (z->src, z->in, z->inbuf, n) != n) {
+				z->eof = true;
+				break;
+			}
+			z->in += n;
+			if (zlib) {
+				z->zs.next_in = z->inbuf;
+				z->zs.avail_in = n;
+			} else {
+				z->ls.next_in = z->inbuf;
+				z->ls.avail_in = n;
+			}
+		}
+		ut32 want = len - done;
+		ut32 left;
+		if (zlib) {
+			z->zs.next_out = dst + done;
+			z->zs.avail_out = want;
+			int ret = inflate (&z->zs, Z_NO_FLUSH);
+			if (ret != Z_OK && ret != Z_BUF_ERROR) {
+				z->eof = true;
+			}
+			left = z->zs.avail_out;
+		} else {
+			z->ls.next_out = dst + done;
+			z->ls.avail_out = want;
+			if (lzma_code (&z->ls, LZMA_RUN) != LZMA_OK) {
+				z->eof = true;
+			}
+			left = z->ls.avail_out;
+		}
+		done += want - left;
+	}
+	z->out += done;
+	return done;
+}
+
+static void swfz_save(Swfz *z) {
+	SwfzPoint **points = realloc (z->points, (z->npoints + 1) * sizeof (SwfzPoint *));
+	if (!points) {
+		return;
+	}
+	z->points = points;
+	SwfzPoint *p = R_NEW0 (SwfzPoint);
+	if (!p) {
+		return;
+	}
+	if (inflateCopy (&p->zs, &z->zs) != Z_OK) {
+		free (p);
+		return;
+	}
+	p->in = z->in - z->zs.avail_in;
+	p->out = z->out;
+	points[z->npoints++] = p;
+}
+
+static bool swfz_restore(Swfz *z, SwfzPoint *p) {
+	swfz_end (z);
+	if (inflateCopy (&z->zs, &p->zs) != Z_OK) {
+		return false;
+	}
+	/* the input it pointed to is gone, refill from where it was */
+	z->zs.avail_in = 0;
+	z->in = p->in;
+	z->out = p->out;
+	z->eof = false;
+	z->ready = true;
+	return true;
+}
+
+/* keep an inflate checkpoint every SWFZ_SPAN bytes of output */
+static void swfz_mark(Swfz *z) {
+	if (z->type == ISWF_MAGIC_0_1 && z->out && !(z->out % SWFZ_SPAN)
+			&& z->out / SWFZ_SPAN > (ut64)z->npoints) {
+		swfz_save (z);
+	}
+}
+
+static SwfzChunk *swfz_victim(Swfz *z) {
+	SwfzChunk *old = &z->cache[0];
+	int i;
+
+	for (i = 1; i < SWFZ_CACHE; i++) {
+		if (z->cache[i].used < old->used) {
+			old = &z->cache[i];
+		}
+	}
+	return old;
+}
+
+static SwfzChunk *swfz_fill(Swfz *z) {
+	SwfzChunk *c = swfz_victim (z);
+
+	swfz_mark (z);
+	c->off = z->out;
+	c->len = swfz_decode (z, c->data, SWFZ_CHUNK);
+	c->used = ++z->tick;
+	return c;
+}
+
+/* bring the decoder to body offset `off`, a multiple of SWFZ_CHUNK */
+static bool swfz_seek(Swfz *z, ut64 off) {
+	SwfzPoint *p = NULL;
+	int i;
+
+	for (i = 0; i < z->npoints && z->points[i]->out <= off; i++) {
+		p = z->points[i];
+	}
+	if (p && (p->out > z->out || off < z->out || !z->ready)) {
+		if (!swfz_restore (z, p)) {
+			return false;
+		}
+	} else if (off < z->out || !z->ready) {
+		if (!swfz_start (z)) {
+			return false;
+		}
+	}
+	/* the chunks skipped over are cached too */
+	while (z->out < off) {
+		if (swfz_fill (z)->len < SWFZ_CHUNK) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static SwfzChunk *swfz_chunk(Swfz *z, ut64 off) {
+	SwfzChunk *c;
+	int i;
+
+	for (i = 0; i < SWFZ_CACHE; i++) {
+		c = &z->cache[i];
+		if (c->off == off) {
+			c->used = ++z->tick;
+			return c;
+		}
+	}
+	if (!swfz_seek (z, off)) {
+		return NULL;
+	}
+	c = swfz_fill (z);
+	return c->len? c: NULL;
+}
+
+static bool swfz_flat(Swfz *z, ut64 end) {
+	while (z->flat_len < end && !z->eof) {
+		if (z->flat_len + SWFZ_CHUNK > z->flat_size) {
+			ut64 size = R_MAX (z->flat_size * 2, 4 * SWFZ_CHUNK);
+			ut8 *flat = realloc (z->flat, size);
+			if (!flat) {
+				return false;
+			}
+			z->flat = flat;
+			z->flat_size = size;
+		}
+		z->flat_len += swfz_decode (z, z->flat + z->flat_len, SWFZ_CHUNK);
+	}
+	return true;
+}
+
+static st64 swfz_read_at(Swfz *z, ut64 off, ut8 *buf, ut64 len) {
+	ut64 done = 0;
+
+	if (off >= z->size) {
+		return 0;
+	}
+	len = R_MIN (len, z->size - off);
+	if (off < sizeof (z->hdr)) {
+		done = R_MIN (len, sizeof (z->hdr) - off);
+		memcpy (buf, z->hdr + off, done);
+	}
+	if (z->type == ISWF_MAGIC_0_2 && done < len) {
+		ut64 body = off + done - sizeof (z->hdr);
+		swfz_flat (z, body + len - done);
+		if (body < z->flat_len) {
+			ut64 n = R_MIN (len - done, z->flat_len - body);
+			memcpy (buf + done, z->flat + body, n);
+			done += n;
+		}
+		return done;
+	}
+	while (done < len) {
+		ut64 body = off + done - sizeof (z->hdr);
+		ut64 base = body - (body % SWFZ_CHUNK);
+		SwfzChunk *c = swfz_chunk (z, base);
+		if (!c || body - base >= c->len) {
+			break;
+		}
+		ut64 n = R_MIN (len - done, c->len - (body - base));
+		memcpy (buf + done, c->data + (body - base), n);
+		done += n;
+	}
+	return done;
+}
+
+static bool buf_swfz_init(RBuffer *b, const void *user) {
+	b->priv = (void *)user;
+	return true;
+}
+
+static bool buf_swfz_fini(RBuffer *b) {
+	Swfz *z = b->priv;
+	int i;
+
+	swfz_end (z);
+	for (i = 0; i < z->npoints; i++) {
+		inflateEnd (&z->points[i]->zs);
+		free (z->points[i]);
+	}
+	free (z->points);
+	free (z->flat);
+	r_buf_free (z->src);
+	free (z);
+	return true;
+}
+
+static ut64 buf_swfz_get_size(RBuffer *b) {
+	Swfz *z = b->priv;
+	return z->size;
+}
+
+static st64 buf_swfz_read(RBuffer *b, ut8 *buf, ut64 len) {
+	Swfz *z = b->priv;
+	st64 n = swfz_read_at (z, z->cur, buf, len);
+	z->cur += n;
+	return n;
+}
+
+static st64 buf_swfz_write(RBuffer *b, const ut8 *buf, ut64 len) {
+	return -1;
+}
+
+static st64 buf_swfz_seek(RBuffer *b, st64 addr, int whence) {
+	Swfz *z = b->priv;
+	st64 pos = r_seek_offset (z->cur, z->size, addr, whence);
+	if (pos < 0) {
+		return -1;
+	}
+	z->cur = pos;
+	return pos;
+}
+
+static const RBufferMethods buffer_swfz_methods = {
+	.init = buf_swfz_init,
+	.fini = buf_swfz_fini,
+	.read = buf_swfz_read,
+	.write = buf_swfz_write,
+	.get_size = buf_swfz_get_size,
+	.seek = buf_swfz_seek,
+};
+
+/* the body of a CWS or ZWS file as an FWS file, NULL for anything else */
+RBuffer *r_bin_swf_decompress(RBuffer *b) {
+	ut8 hdr[SWFZ_LZMA_DATA];
+	ut64 size = r_buf_size (b);
+	int i;
+
+	if (r_buf_read_at (b, 0, hdr, sizeof (hdr)) != sizeof (hdr)) {
+		return NULL;
+	}
+	if (hdr[0] != ISWF_MAGIC_0_1 && hdr[0] != ISWF_MAGIC_0_2) {
+		return NULL;
+	}
+	Swfz *z = R_NEW0 (Swfz);
+	if (!z) {
+		return NULL;
+	}
+	z->type = hdr[0];
+	memcpy (z->hdr, hdr, sizeof (z->hdr));
+	z->hdr[0] = ISWF_MAGIC_0_0;
+	z->size = r_read_le32 (hdr + 4);
+	if (z->type == ISWF_MAGIC_0_1) {
+		z->in_start = 8;
+		z->in_end = size;
+	} else {
+		z->in_start = SWFZ_LZMA_DATA;
+		z->in_end = R_MIN (size, SWFZ_LZMA_DATA + (ut64)r_read_le32 (hdr + 8));
+	}
+	for (i = 0; i < SWFZ_CACHE; i++) {
+		z->cache[i].off = UT64_MAX;
+	}
+	z->src = r_buf_ref (b);
+	if (z->size < sizeof (z->hdr) || !swfz_start (z)) {
+		swfz_end (z);
+		r_buf_free (z->src);
+		free (z);
+		return NULL;
+	}
+	RBuffer *view = r_buf_new_with_methods (&buffer_swfz_methods, z);
+	if (!view) {
+		swfz_end (z);
+		r_buf_free (z->src);
+		free (z);
+	}
+	return view;
+}
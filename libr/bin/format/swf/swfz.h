@@ -0,0 +1,22 @@
+/* radare - LGPL3 - 2018 */
+
+#ifndef SWFZ_H_
+#define SWFZ_H_
+
+#include <r_util.h>
+#include <r_types.h>
+
+/* inflated SWFZ_CHUNK bytes at a time, the zlib state is saved every
+ * SWFZ_SPAN bytes of output so reads can resume close to any offset */
+#define SWFZ_CHUNK 0x8000
+#define SWFZ_SPAN (32 * SWFZ_CHUNK)
+#define SWFZ_CACHE 16
+#define SWFZ_IN 0x4000
+
+/* ZWS: ut32 compressed size and the lzma properties follow the header */
+#define SWFZ_LZMA_PROPS 12
+#define SWFZ_LZMA_DATA 17
+
+RBuffer *r_bin_swf_decompress(RBuffer *b);
+
+#endif
@@ -18,6 +18,12 @@ static bool load_buffer(RBinFile *bf, void **bin_obj, RBuffer *b, ut64 loadaddr,
 		r_buf_read_at (b, 0, buf, 4);
 		compression = buf[0];
 		flashVersion = buf[3];
+		/* only the compressed blob is here, its tags are listed and
+		 * disassembled on the decompressed view of swfz://file */
+		if (compression == ISWF_MAGIC_0_1 || compression == ISWF_MAGIC_0_2) {
+			eprintf ("Compressed SWF, open swfz://%s to disassemble it\n",
+				r_str_get (bf->file));
+		}
 		return true;
 	}
 	return false;
@@ -68,7 +74,7 @@ static RList* sections(RBinFile *arch) {
 	if (!(ret = r_list_new()))
 		return NULL;
 
-	r_bin_swf_get_sections(ret, arch);
+	r_bin_swf_get_sections(ret, arch->buf);
 
 	return ret;
 }
@@ -83,9 +89,9 @@ static RList* entries(RBinFile *arch) {
 		return ret;
 
 	swf_hdr header;
-	header = r_bin_swf_get_header(arch);
+	header = r_bin_swf_get_header(arch->buf);
 
-	if (compression == ISWF_MAGIC_0_0) {
+	if (header.signature[0] == ISWF_MAGIC_0_0) {
 		ptr->paddr = header.rect_size + SWF_HDR_MIN_SIZE;
 		ptr->vaddr = header.rect_size + SWF_HDR_MIN_SIZE;
 	} else {
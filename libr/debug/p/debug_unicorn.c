@@ -9,6 +9,7 @@
 
 #include <r_userconf.h>
 #include <r_debug.h>
+#include <r_core.h>
 #include <r_asm.h>
 #include <r_cons.h>
 #include <r_reg.h>
@@ -80,110 +81,232 @@ fprintf (stderr, Color_BMAGENTA"%s"Color_RESET, p);
 }
 
 static uc_engine *uh = NULL;
+static uc_arch uh_arch = UC_ARCH_X86;
+static uc_mode uh_mode = UC_MODE_64;
 
 static int r_debug_unicorn_init(RDebug *dbg);
+static bool unicorn_checkpoint(void);
+static bool unicorn_restore(void);
+R_API bool r_debug_unicorn_batch(RDebug *dbg, const char *path);
 
 static int r_debug_handle_signals(RDebug *dbg) {
 	return -1;
 }
 
+/* Register tables, one per arch. The r2 profile is generated from them so
+ * the arena offsets always match, and the whole set is moved with a single
+ * uc_reg_read_batch / uc_reg_write_batch call. Values are cached between
+ * steps and only fetched again after the engine actually ran. */
+#define UNICORN_MAXREGS 64
+
+typedef struct {
+	char name[8];
+	int id;     // UC_*_REG_*
+	int size;   // bytes in the arena
+	int off;
+} UnicornReg;
+
+static struct {
+	char arch[8];
+	int bits;
+	UnicornReg regs[UNICORN_MAXREGS];
+	int count;
+	int size;
+	int pc, sp, bp;
+	int args[6]; // argument registers, -1 after the last one
+	int ret;    // return value
+	int lr;     // link register or -1 when the return address is pushed
+	int flags;  // index of the x86 eflags register or -1
+	int ids[UNICORN_MAXREGS];
+	void *ptrs[UNICORN_MAXREGS];
+	ut64 vals[UNICORN_MAXREGS];
+	bool valid;
+} uc_regs = { { 0 } };
+
+static const char *mips_names[32] = {
+	"zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+	"t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+	"s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+	"t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra"
+};
+
+static const char *x64_args[] = { "rdi", "rsi", "rdx", "rcx", "r8", "r9", NULL };
+static const char *x86_args[] = { "eax", "ebx", "ecx", "edx", "esi", "edi", NULL };
+static const char *arm64_args[] = { "x0", "x1", "x2", "x3", "x4", "x5", NULL };
+static const char *arm_args[] = { "r0", "r1", "r2", "r3", NULL };
+static const char *mips_args[] = { "a0", "a1", "a2", "a3", NULL };
+
+static int unicorn_reg_find(const char *name) {
+	int i;
+	for (i = 0; i < uc_regs.count; i++) {
+		if (!strcmp (uc_regs.regs[i].name, name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/* =BP and =An follow the calling convention, not the table order */
+static void unicorn_regs_alias(const char *bp, const char **args) {
+	int i;
+	uc_regs.bp = unicorn_reg_find (bp);
+	for (i = 0; i < 6 && args[i]; i++) {
+		uc_regs.args[i] = unicorn_reg_find (args[i]);
+	}
+}
+
+static void unicorn_reg_add(const char *name, int id, int size) {
+	UnicornReg *r;
+	if (uc_regs.count >= UNICORN_MAXREGS) {
+		return;
+	}
+	r = &uc_regs.regs[uc_regs.count];
+	r_str_ncpy (r->name, name, sizeof (r->name));
+	r->id = id;
+	r->size = size;
+	r->off = uc_regs.size;
+	uc_regs.ids[uc_regs.count] = id;
+	uc_regs.ptrs[uc_regs.count] = &uc_regs.vals[uc_regs.count];
+	uc_regs.size += size;
+	uc_regs.count++;
+}
+
+static void unicorn_regs_setup(const char *arch, int bits) {
+	char name[8];
+	int i;
+	if (uc_regs.count && !strcmp (uc_regs.arch, arch) && uc_regs.bits == bits) {
+		return;
+	}
+	memset (&uc_regs, 0, sizeof (uc_regs));
+	r_str_ncpy (uc_regs.arch, arch, sizeof (uc_regs.arch));
+	uc_regs.bits = bits;
+	uc_regs.flags = -1;
+	uc_regs.lr = -1;
+	uc_regs.bp = -1;
+	memset (uc_regs.args, -1, sizeof (uc_regs.args));
+	uc_regs.ret = 1;
+	if (!strcmp (arch, "x86") && bits == 64) {
+		unicorn_reg_add ("rip", UC_X86_REG_RIP, 8);
+		unicorn_reg_add ("rax", UC_X86_REG_RAX, 8);
+		unicorn_reg_add ("rcx", UC_X86_REG_RCX, 8);
+		unicorn_reg_add ("rdx", UC_X86_REG_RDX, 8);
+		unicorn_reg_add ("rbx", UC_X86_REG_RBX, 8);
+		unicorn_reg_add ("rsp", UC_X86_REG_RSP, 8);
+		unicorn_reg_add ("rbp", UC_X86_REG_RBP, 8);
+		unicorn_reg_add ("rsi", UC_X86_REG_RSI, 8);
+		unicorn_reg_add ("rdi", UC_X86_REG_RDI, 8);
+		unicorn_reg_add ("r8", UC_X86_REG_R8, 8);
+		unicorn_reg_add ("r9", UC_X86_REG_R9, 8);
+		unicorn_reg_add ("r10", UC_X86_REG_R10, 8);
+		unicorn_reg_add ("r11", UC_X86_REG_R11, 8);
+		unicorn_reg_add ("r12", UC_X86_REG_R12, 8);
+		unicorn_reg_add ("r13", UC_X86_REG_R13, 8);
+		unicorn_reg_add ("r14", UC_X86_REG_R14, 8);
+		unicorn_reg_add ("r15", UC_X86_REG_R15, 8);
+		uc_regs.flags = uc_regs.count;
+		unicorn_reg_add ("eflags", UC_X86_REG_EFLAGS, 8);
+		uc_regs.sp = 5;
+		unicorn_regs_alias ("rbp", x64_args);
+	} else if (!strcmp (arch, "x86")) {
+		unicorn_reg_add ("eip", UC_X86_REG_EIP, 4);
+		unicorn_reg_add ("eax", UC_X86_REG_EAX, 4);
+		unicorn_reg_add ("ecx", UC_X86_REG_ECX, 4);
+		unicorn_reg_add ("edx", UC_X86_REG_EDX, 4);
+		unicorn_reg_add ("ebx", UC_X86_REG_EBX, 4);
+		unicorn_reg_add ("esp", UC_X86_REG_ESP, 4);
+		unicorn_reg_add ("ebp", UC_X86_REG_EBP, 4);
+		unicorn_reg_add ("esi", UC_X86_REG_ESI, 4);
+		unicorn_reg_add ("edi", UC_X86_REG_EDI, 4);
+		uc_regs.flags = uc_regs.count;
+		unicorn_reg_add ("eflags", UC_X86_REG_EFLAGS, 4);
+		uc_regs.sp = 5;
+		unicorn_regs_alias ("ebp", x86_args);
+	} else if (!strcmp (arch, "arm") && bits == 64) {
+		unicorn_reg_add ("pc", UC_ARM64_REG_PC, 8);
+		for (i = 0; i < 29; i++) {
+			snprintf (name, sizeof (name), "x%d", i);
+			unicorn_reg_add (name, UC_ARM64_REG_X0 + i, 8);
+		}
+		unicorn_reg_add ("fp", UC_ARM64_REG_X29, 8);
+		uc_regs.lr = uc_regs.count;
+		unicorn_reg_add ("lr", UC_ARM64_REG_X30, 8);
+		uc_regs.sp = uc_regs.count;
+		unicorn_reg_add ("sp", UC_ARM64_REG_SP, 8);
+		unicorn_reg_add ("nzcv", UC_ARM64_REG_NZCV, 4);
+		unicorn_regs_alias ("fp", arm64_args);
+	} else if (!strcmp (arch, "arm")) {
+		unicorn_reg_add ("pc", UC_ARM_REG_PC, 4);
+		for (i = 0; i < 13; i++) {
+			snprintf (name, sizeof (name), "r%d", i);
+			unicorn_reg_add (name, UC_ARM_REG_R0 + i, 4);
+		}
+		uc_regs.sp = uc_regs.count;
+		unicorn_reg_add ("sp", UC_ARM_REG_SP, 4);
+		uc_regs.lr = uc_regs.count;
+		unicorn_reg_add ("lr", UC_ARM_REG_LR, 4);
+		unicorn_reg_add ("cpsr", UC_ARM_REG_CPSR, 4);
+		unicorn_regs_alias ("r11", arm_args);
+	} else if (!strcmp (arch, "mips")) {
+		int size = bits == 64? 8: 4;
+		unicorn_reg_add ("pc", UC_MIPS_REG_PC, size);
+		for (i = 0; i < 32; i++) {
+			unicorn_reg_add (mips_names[i], UC_MIPS_REG_0 + i, size);
+		}
+		unicorn_reg_add ("hi", UC_MIPS_REG_HI, size);
+		unicorn_reg_add ("lo", UC_MIPS_REG_LO, size);
+		uc_regs.sp = 30; // pc + 29
+		uc_regs.ret = 3; // v0
+		uc_regs.lr = 32; // ra
+		unicorn_regs_alias ("fp", mips_args);
+	}
+	uc_regs.pc = 0;
+}
+
 static const char *r_debug_unicorn_reg_profile(RDebug *dbg) {
-	if (dbg->bits & R_SYS_BITS_64) {
-		return strdup (
-			"=PC	rip\n"
-			"=SP	rsp\n"
-			"=BP	rbp\n"
-			"=A0	rax\n"
-			"=A1	rbx\n"
-			"=A2	rcx\n"
-			"=A3	rdi\n"
-			"gpr	rip	8	0x000	0\n"
-			"gpr	rax	8	0x008	0\n"
-			"gpr	rcx	8	0x010	0\n"
-			"gpr	rdx	8	0x018	0\n"
-			"gpr	rbx	8	0x020	0\n"
-			"gpr	rsp	8	0x028	0\n"
-			"gpr	rbp	8	0x030	0\n"
-			"gpr	rsi	8	0x038	0\n"
-			"gpr	rdi	8	0x040	0\n"
-			"gpr	r8	8	0x048	0\n"
-			"gpr	r9	8	0x050	0\n"
-			"gpr	r10	8	0x058	0	\n"
-			"gpr	r11	8	0x060	0	\n"
-			"gpr	r12	8	0x068	0	\n"
-			"gpr	r13	8	0x070	0	\n"
-			"gpr	r14	8	0x078	0	\n"
-			"gpr	r15	8	0x080	0	\n"
-			"gpr	eflags	4	0x088	0	c1p.a.zstido.n.rv\n"
-#if 0
-			"seg	cs	2	0x038	0\n"
-			"seg	ds	2	0x03A	0\n"
-			"seg	es	2	0x03C	0\n"
-			"seg	fs	2	0x03E	0\n"
-			"seg	gs	2	0x040	0\n"
-			"seg	ss	2	0x042	0\n"
-			"drx	dr0	8	0x048	0\n"
-			"drx	dr1	8	0x050	0\n"
-			"drx	dr2	8	0x058	0\n"
-			"drx	dr3	8	0x060	0\n"
-			"drx	dr6	8	0x068	0\n"
-			"drx	dr7	8	0x070	0\n"
-			"gpr	cf	.1	.544	0	carry\n"
-			"gpr	pf	.1	.546	0	parity\n"
-			"gpr	af	.1	.548	0	adjust\n"
-			"gpr	zf	.1	.550	0	zero\n"
-			"gpr	sf	.1	.551	0	sign\n"
-			"gpr	tf	.1	.552	0	trap\n"
-			"gpr	if	.1	.553	0	interrupt\n"
-			"gpr	df	.1	.554	0	direction\n"
-			"gpr	of	.1	.555	0	overflow\n"
-#endif
-			);
-	} else {
-		return strdup(
-			"=PC	eip\n"
-			"=SP	esp\n"
-			"=BP	ebp\n"
-			"=A0	eax\n"
-			"=A1	ebx\n"
-			"=A2	ecx\n"
-			"=A3	edi\n"
-			"drx	dr0	.32	4	0\n"
-			"drx	dr1	.32	8	0\n"
-			"drx	dr2	.32	12	0\n"
-			"drx	dr3	.32	16	0\n"
-			"drx	dr6	.32	20	0\n"
-			"drx	dr7	.32	24	0\n"
-			/* floating save area 4+4+4+4+4+4+4+80+4 = 112 */
-			"seg	gs	.32	140	0\n"
-			"seg	fs	.32	144	0\n"
-			"seg	es	.32	148	0\n"
-			"seg	ds	.32	152	0\n"
-			"gpr	edi	.32	156	0\n"
-			"gpr	esi	.32	160	0\n"
-			"gpr	ebx	.32	164	0\n"
-			"gpr	edx	.32	168	0\n"
-			"gpr	ecx	.32	172	0\n"
-			"gpr	eax	.32	176	0\n"
-			"gpr	ebp	.32	180	0\n"
-			"gpr	eip	.32	184	0\n"
-			"seg	cs	.32	188	0\n"
-			"gpr	eflags	.32	192	0	c1p.a.zstido.n.rv\n" // XXX must be flg
-			"gpr	esp	.32	196	0\n"
-			"seg	ss	.32	200	0\n"
-			"gpr	cf	.1	.1536	0	carry\n"
-			"gpr	pf	.1	.1538	0	parity\n"
-			"gpr	af	.1	.1540	0	adjust\n"
-			"gpr	zf	.1	.1542	0	zero\n"
-			"gpr	sf	.1	.1543	0	sign\n"
-			"gpr	tf	.1	.1544	0	trap\n"
-			"gpr	if	.1	.1545	0	interrupt\n"
-			"gpr	df	.1	.1546	0	direction\n"
-			"gpr	of	.1	.1547	0	overflow\n"
-			/* +512 bytes for maximum supoprted extension extended registers */
-			);
+	static const char *x86flags[] = {
+		"cf", "carry", "pf", "parity", "af", "adjust", "zf", "zero",
+		"sf", "sign", "tf", "trap", "if", "interrupt", "df", "direction",
+		"of", "overflow"
+	};
+	static const int x86flagbits[] = { 0, 2, 4, 6, 7, 8, 9, 10, 11 };
+	RStrBuf *sb;
+	int i, bits = (dbg->bits & R_SYS_BITS_64)? 64: 32;
+	unicorn_regs_setup (dbg->arch, bits);
+	if (!uc_regs.count) {
+		return NULL;
+	}
+	sb = r_strbuf_new ("");
+	r_strbuf_appendf (sb, "=PC\t%s\n=SP\t%s\n", uc_regs.regs[uc_regs.pc].name,
+		uc_regs.regs[uc_regs.sp].name);
+	if (uc_regs.bp != -1) {
+		r_strbuf_appendf (sb, "=BP\t%s\n", uc_regs.regs[uc_regs.bp].name);
+	}
+	for (i = 0; i < 6 && uc_regs.args[i] != -1; i++) {
+		r_strbuf_appendf (sb, "=A%d\t%s\n", i, uc_regs.regs[uc_regs.args[i]].name);
+	}
+	for (i = 0; i < uc_regs.count; i++) {
+		UnicornReg *r = &uc_regs.regs[i];
+		r_strbuf_appendf (sb, "gpr\t%s\t%d\t0x%03x\t0\t%s\n", r->name, r->size, r->off,
+			i == uc_regs.flags? "c1p.a.zstido.n.rv": "");
+	}
+	if (uc_regs.flags != -1) {
+		int base = uc_regs.regs[uc_regs.flags].off * 8;
+		for (i = 0; i < 9; i++) {
+			r_strbuf_appendf (sb, "gpr\t%s\t.1\t.%d\t0\t%s\n",
+				x86flags[i * 2], base + x86flagbits[i], x86flags[i * 2 + 1]);
+		}
+	}
+	return r_strbuf_drain (sb);
+}
+
+static void unicorn_regs_fetch(void) {
+	if (uc_regs.valid) {
+		return;
+	}
+	memset (uc_regs.vals, 0, sizeof (uc_regs.vals));
+	if (uc_reg_read_batch (uh, uc_regs.ids, uc_regs.ptrs, uc_regs.count) == UC_ERR_OK) {
+		uc_regs.valid = true;
 	}
-	return NULL;
 }
 
 static RList *r_debug_unicorn_threads(RDebug *dbg, int pid) {
@@ -279,86 +402,53 @@ static bool r_debug_unicorn_kill(RDebug *dbg, int pid, int tid, int sig) {
 	return false;
 }
 
-#if 0
-static int r_debug_unicorn_bp(RBreakpointItem *bp, int set, void *user) {
-	RDebug *dbg = user;
-	if (!bp)
-		return false;
-	if (!bp->hw)
-		return false;
-	return set?drx_add(dbg, bp->addr, bp->rwx) :drx_del(dbg, bp->addr, bp->rwx);
-}
-#endif
-
 static int r_debug_unicorn_reg_read(RDebug *dbg, int type, ut8 *buf, int size) {
-	// NOTE: This must be in sync with the profile.
-	ut64 *rip = (ut64*)(buf+0x00);
-	ut64 *rax = (ut64*)(buf+0x08);
-	ut64 *rcx = (ut64*)(buf+0x10);
-	ut64 *rdx = (ut64*)(buf+0x18);
-	ut64 *rbx = (ut64*)(buf+0x20);
-	ut64 *rsp = (ut64*)(buf+0x28);
-	ut64 *rbp = (ut64*)(buf+0x30);
-	ut64 *rsi = (ut64*)(buf+0x38);
-	ut64 *rdi = (ut64*)(buf+0x40);
-	ut64 *r8  = (ut64*)(buf+0x48);
-	ut64 *r9  = (ut64*)(buf+0x50);
-	ut64 *r10 = (ut64*)(buf+0x58);
+	int i;
+	if (type != R_REG_TYPE_GPR || !uh || !uc_regs.count) {
+		return 0;
+	}
 	memset (buf, 0, size);
-	if (type == R_REG_TYPE_GPR) {
-		uc_reg_read (uh, UC_X86_REG_RIP, rip);
-		uc_reg_read (uh, UC_X86_REG_RAX, rax);
-		uc_reg_read (uh, UC_X86_REG_RCX, rcx);
-		uc_reg_read (uh, UC_X86_REG_RDX, rdx);
-		uc_reg_read (uh, UC_X86_REG_RBX, rbx);
-		uc_reg_read (uh, UC_X86_REG_RSP, rsp);
-		uc_reg_read (uh, UC_X86_REG_RBP, rbp);
-		uc_reg_read (uh, UC_X86_REG_RSI, rsi);
-		uc_reg_read (uh, UC_X86_REG_RDI, rdi);
-		uc_reg_read (uh, UC_X86_REG_R8, r8);
-		uc_reg_read (uh, UC_X86_REG_R9, r9);
-		uc_reg_read (uh, UC_X86_REG_R10, r10);
-		//message ("TODO: unicorn- reg read 0x%"PFMT64x"\n", *rip);
-		return size;
+	unicorn_regs_fetch ();
+	for (i = 0; i < uc_regs.count; i++) {
+		UnicornReg *r = &uc_regs.regs[i];
+		if (r->off + r->size <= size) {
+			// host and guest are assumed little endian, as unicorn does
+			memcpy (buf + r->off, &uc_regs.vals[i], r->size);
+		}
 	}
-	return 0;
+	return size;
 }
 
 static int r_debug_unicorn_reg_write(RDebug *dbg, int type, const ut8* buf, int size) {
-	// NOTE: This must be in sync with the profile.
-	ut64 *rip = (ut64*)(buf+0x00);
-	ut64 *rax = (ut64*)(buf+0x08);
-	ut64 *rcx = (ut64*)(buf+0x10);
-	ut64 *rdx = (ut64*)(buf+0x18);
-	ut64 *rbx = (ut64*)(buf+0x20);
-	ut64 *rsp = (ut64*)(buf+0x28);
-	ut64 *rbp = (ut64*)(buf+0x30);
-	ut64 *rsi = (ut64*)(buf+0x38);
-	ut64 *rdi = (ut64*)(buf+0x40);
-	ut64 *r8  = (ut64*)(buf+0x48);
-	ut64 *r9  = (ut64*)(buf+0x50);
-	ut64 *r10 = (ut64*)(buf+0x58);
-	uc_err err;
-	if (type == R_REG_TYPE_GPR) {
-		uint64_t u = *rip;
-		err = uc_reg_write (uh, UC_X86_REG_RIP, &u);
-		if (err) {
-			message ("[UNICORN] RIP reg_write ERROR\n");
-		}
-		uc_reg_write (uh, UC_X86_REG_RAX, rax);
-		uc_reg_write (uh, UC_X86_REG_RCX, rcx);
-		uc_reg_write (uh, UC_X86_REG_RDX, rdx);
-		uc_reg_write (uh, UC_X86_REG_RBX, rbx);
-		uc_reg_write (uh, UC_X86_REG_RSP, rsp);
-		uc_reg_write (uh, UC_X86_REG_RBP, rbp);
-		uc_reg_write (uh, UC_X86_REG_RSI, rsi);
-		uc_reg_write (uh, UC_X86_REG_RDI, rdi);
-		uc_reg_write (uh, UC_X86_REG_R8, r8);
-		uc_reg_write (uh, UC_X86_REG_R9, r9);
-		uc_reg_write (uh, UC_X86_REG_R10, r10);
-		return size;
+	int i, n = 0;
+	int ids[UNICORN_MAXREGS];
+	void *ptrs[UNICORN_MAXREGS];
+	if (type != R_REG_TYPE_GPR || !uh || !uc_regs.count) {
+		return 0;
 	}
-	return 0;
+	unicorn_regs_fetch ();
+	// only push the registers that changed
+	for (i = 0; i < uc_regs.count; i++) {
+		UnicornReg *r = &uc_regs.regs[i];
+		ut64 v = 0;
+		if (r->off + r->size > size) {
+			continue;
+		}
+		memcpy (&v, buf + r->off, r->size);
+		if (uc_regs.valid && v == uc_regs.vals[i]) {
+			continue;
+		}
+		uc_regs.vals[i] = v;
+		ids[n] = r->id;
+		ptrs[n] = &uc_regs.vals[i];
+		n++;
+	}
+	if (n && uc_reg_write_batch (uh, ids, ptrs, n) != UC_ERR_OK) {
+		message ("[UNICORN] reg_write ERROR\n");
+		uc_regs.valid = false;
+		return 0;
+	}
+	return size;
 }
 
 static int r_debug_unicorn_map_protect(RDebug *dbg, ut64 addr, int size, int perms) {
@@ -366,30 +456,564 @@ static int r_debug_unicorn_map_protect(RDebug *dbg, ut64 addr, int size, int per
 	return 0;
 }
 
-void _interrupt(uc_engine *handle, uint32_t intno, void *user_data) {
-	message ("[UNICORN] Interrupt 0x%x userdata %p\n", intno, user_data);
-	if (intno == 6) {
+/* Breakpoints are kept in an open addressing hash set of addresses and
+ * checked from UC_HOOK_CODE hooks installed only over the pages holding at
+ * least one breakpoint, so the rest of the code runs at full speed inside
+ * uc_emu_start. The hooks are rebuilt lazily before resuming.
+ */
+#define UNICORN_PAGE 4096
+#define UNICORN_BP_EMPTY UT64_MAX
+
+static struct {
+	ut64 *addrs;
+	int size; // power of two
+	int count;
+	bool dirty;
+	uc_hook *hooks;
+	int nhooks;
+} uc_bps = { 0 };
+
+/* state of the current uc_emu_start run, filled by the hooks */
+static struct {
+	RDebugReasonType reason;
+	ut64 addr;
+	bool stepping;
+} uc_run = { 0 };
+
+static ut64 uc_budget = 0;     // max instructions per continue, 0 = no limit
+static ut64 uc_timeout = 0;    // max microseconds per continue, 0 = no limit
+static uc_hook uh_interrupt = 0;
+static uc_hook uh_invalid = 0;
+static uc_hook uh_insn = 0;
+
+static inline ut32 bpset_slot(ut64 addr, int size) {
+	addr ^= addr >> 29;
+	addr *= 0xbf58476d1ce4e5b9ULL;
+	addr ^= addr >> 32;
+	return (ut32)addr & (size - 1);
+}
+
+static bool bpset_has(ut64 addr) {
+	ut32 i;
+	if (!uc_bps.count) {
+		return false;
+	}
+	for (i = bpset_slot (addr, uc_bps.size); uc_bps.addrs[i] != UNICORN_BP_EMPTY; i = (i + 1) & (uc_bps.size - 1)) {
+		if (uc_bps.addrs[i] == addr) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool bpset_insert(ut64 addr) {
+	ut32 i = bpset_slot (addr, uc_bps.size);
+	for (; uc_bps.addrs[i] != UNICORN_BP_EMPTY; i = (i + 1) & (uc_bps.size - 1)) {
+		if (uc_bps.addrs[i] == addr) {
+			return false;
+		}
+	}
+	uc_bps.addrs[i] = addr;
+	uc_bps.count++;
+	return true;
+}
+
+static bool bpset_add(ut64 addr) {
+	if ((uc_bps.count + 1) * 2 > uc_bps.size) {
+		ut64 *old = uc_bps.addrs;
+		int i, oldsize = uc_bps.size;
+		int size = oldsize? oldsize * 2: 64;
+		ut64 *addrs = malloc (size * sizeof (ut64));
+		if (!addrs) {
+			return false;
+		}
+		memset (addrs, 0xff, size * sizeof (ut64));
+		uc_bps.addrs = addrs;
+		uc_bps.size = size;
+		uc_bps.count = 0;
+		for (i = 0; i < oldsize; i++) {
+			if (old[i] != UNICORN_BP_EMPTY) {
+				bpset_insert (old[i]);
+			}
+		}
+		free (old);
+	}
+	if (bpset_insert (addr)) {
+		uc_bps.dirty = true;
+	}
+	return true;
+}
+
+static bool bpset_del(ut64 addr) {
+	ut32 i, j, mask = uc_bps.size - 1;
+	if (!uc_bps.count) {
+		return false;
+	}
+	for (i = bpset_slot (addr, uc_bps.size); uc_bps.addrs[i] != addr; i = (i + 1) & mask) {
+		if (uc_bps.addrs[i] == UNICORN_BP_EMPTY) {
+			return false;
+		}
+	}
+	// backward shift deletion keeps the probe chains intact
+	for (j = (i + 1) & mask; uc_bps.addrs[j] != UNICORN_BP_EMPTY; j = (j + 1) & mask) {
+		ut32 k = bpset_slot (uc_bps.addrs[j], uc_bps.size);
+		if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+			uc_bps.addrs[i] = uc_bps.addrs[j];
+			i = j;
+		}
+	}
+	uc_bps.addrs[i] = UNICORN_BP_EMPTY;
+	uc_bps.count--;
+	uc_bps.dirty = true;
+	return true;
+}
+
+static void _bp_code(uc_engine *handle, uint64_t address, uint32_t size, void *user_data) {
+	if (!uc_run.stepping && bpset_has (address)) {
+		uc_run.reason = R_DEBUG_REASON_BREAKPOINT;
+		uc_run.addr = address;
 		uc_emu_stop (handle);
 	}
 }
 
-static void _code(uc_engine *handle, uint64_t address, uint32_t size, void *user_data) {
-	message ("[UNICORN] Begin Code\n");
-	uc_emu_stop (handle);
+static int cmp_ut64(const void *a, const void *b) {
+	ut64 x = *(const ut64 *)a, y = *(const ut64 *)b;
+	return (x > y) - (x < y);
+}
+
+/* one UC_HOOK_CODE per page holding breakpoints */
+static void unicorn_bp_sync(void) {
+	ut64 *pages;
+	int i, n = 0;
+	if (!uc_bps.dirty || !uh) {
+		return;
+	}
+	for (i = 0; i < uc_bps.nhooks; i++) {
+		uc_hook_del (uh, uc_bps.hooks[i]);
+	}
+	uc_bps.nhooks = 0;
+	uc_bps.dirty = false;
+	if (!uc_bps.count) {
+		return;
+	}
+	pages = malloc (uc_bps.count * sizeof (ut64));
+	uc_hook *hooks = realloc (uc_bps.hooks, uc_bps.count * sizeof (uc_hook));
+	if (!pages || !hooks) {
+		free (pages);
+		return;
+	}
+	uc_bps.hooks = hooks;
+	for (i = 0; i < uc_bps.size; i++) {
+		if (uc_bps.addrs[i] != UNICORN_BP_EMPTY) {
+			pages[n++] = uc_bps.addrs[i] & ~(ut64)(UNICORN_PAGE - 1);
+		}
+	}
+	qsort (pages, n, sizeof (ut64), cmp_ut64);
+	for (i = 0; i < n; i++) {
+		if (i > 0 && pages[i] == pages[i - 1]) {
+			continue;
+		}
+		if (uc_hook_add (uh, &uc_bps.hooks[uc_bps.nhooks], UC_HOOK_CODE, _bp_code,
+				NULL, pages[i], pages[i] + UNICORN_PAGE - 1) == UC_ERR_OK) {
+			uc_bps.nhooks++;
+		}
+	}
+	free (pages);
 }
 
-static void _block(uc_engine *handle, uint64_t address, uint32_t size, void *user_data) {
-	message ("[UNICORN] Begin Block\n");
+static int r_debug_unicorn_breakpoint(struct r_bp_t *bp, RBreakpointItem *b, bool set) {
+	if (!b) {
+		return false;
+	}
+	return set? bpset_add (b->addr): bpset_del (b->addr);
+}
+
+static void _interrupt(uc_engine *handle, uint32_t intno, void *user_data) {
+	message ("[UNICORN] Interrupt 0x%x\n", intno);
+	uc_run.reason = (intno == 3)? R_DEBUG_REASON_BREAKPOINT: R_DEBUG_REASON_SIGNAL;
+	uc_emu_stop (handle);
 }
 
 static void _insn_out(uc_engine *handle, uint32_t port, int size, uint32_t value, void *user_data) {
 	message ("[UNICORN] Step Out\n");
+	uc_run.reason = R_DEBUG_REASON_SIGNAL;
 	uc_emu_stop (handle);
 }
 
+/* RIO maps known to the engine. Nothing is copied at init: the first
+ * access to a page faults through UC_HOOK_MEM_*_UNMAPPED and the page is
+ * read from r2 and mapped with the permissions of the map holding it. */
+#define UNICORN_STACK_ADDR 0x7000000
+#define UNICORN_STACK_SIZE (1024 * 1024)
+
+typedef struct {
+	ut64 addr;
+	ut64 end;
+	int perms;
+	bool backed; // read contents from io, otherwise zero filled
+} UnicornRegion;
+
+static struct {
+	UnicornRegion *items;
+	int count;
+	int capacity;
+	int faults;
+	RDebug *dbg;
+} uc_regions = { 0 };
+
+static int region_cmp(const void *a, const void *b) {
+	const UnicornRegion *x = a, *y = b;
+	return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static bool region_add(ut64 addr, ut64 size, int perms, bool backed) {
+	UnicornRegion *r;
+	if (uc_regions.count == uc_regions.capacity) {
+		int capacity = uc_regions.capacity? uc_regions.capacity * 2: 16;
+		UnicornRegion *items = realloc (uc_regions.items, capacity * sizeof (UnicornRegion));
+		if (!items) {
+			return false;
+		}
+		uc_regions.items = items;
+		uc_regions.capacity = capacity;
+	}
+	r = &uc_regions.items[uc_regions.count++];
+	r->addr = addr;
+	r->end = addr + size;
+	r->perms = perms;
+	r->backed = backed;
+	qsort (uc_regions.items, uc_regions.count, sizeof (UnicornRegion), region_cmp);
+	return true;
+}
+
+/* union of the permissions of all regions overlapping [from, to) */
+static int region_perms(ut64 from, ut64 to, bool *backed) {
+	int i, perms = 0;
+	*backed = false;
+	for (i = 0; i < uc_regions.count; i++) {
+		UnicornRegion *r = &uc_regions.items[i];
+		if (r->addr >= to) {
+			break;
+		}
+		if (r->end > from) {
+			perms |= r->perms;
+			*backed |= r->backed;
+		}
+	}
+	return perms;
+}
+
+/* Checkpoints keep the cpu context plus an undo log of the guest pages
+ * modified since they were taken. Writable pages are write protected when
+ * a checkpoint is taken and the first write to each one copies it into the
+ * log from the UC_MEM_WRITE_PROT hook, so both taking and restoring a
+ * checkpoint cost O(dirty pages). The checkpoints live in a bounded ring,
+ * the oldest is dropped when it is full. */
+#define UNICORN_CHECKPOINTS 16
+
+typedef struct {
+	ut64 addr;
+	ut8 *data; // NULL when the page was not mapped yet
+} UnicornPage;
+
+typedef struct {
+	uc_context *ctx;
+	UnicornPage *pages;
+	int count;
+	int capacity;
+} UnicornCheckpoint;
+
+static struct {
+	UnicornCheckpoint *ring;
+	int max;
+	int head; // oldest
+	int count;
+	bool autosave; // take one before every step and continue
+	bool fresh; // nothing ran since the newest was taken or restored
+} uc_cps = { 0 };
+
+static inline UnicornCheckpoint *checkpoint_newest(void) {
+	return uc_cps.count? &uc_cps.ring[(uc_cps.head + uc_cps.count - 1) % uc_cps.max]: NULL;
+}
+
+static bool checkpoint_log(ut64 addr, ut8 *data) {
+	UnicornCheckpoint *cp = checkpoint_newest ();
+	if (!cp) {
+		free (data);
+		return false;
+	}
+	if (cp->count == cp->capacity) {
+		int capacity = cp->capacity? cp->capacity * 2: 32;
+		UnicornPage *pages = realloc (cp->pages, capacity * sizeof (UnicornPage));
+		if (!pages) {
+			free (data);
+			return false;
+		}
+		cp->pages = pages;
+		cp->capacity = capacity;
+	}
+	cp->pages[cp->count].addr = addr;
+	cp->pages[cp->count].data = data;
+	cp->count++;
+	return true;
+}
+
+static void checkpoint_clear(UnicornCheckpoint *cp) {
+	int i;
+	for (i = 0; i < cp->count; i++) {
+		free (cp->pages[i].data);
+	}
+	cp->count = 0;
+}
+
+static bool unicorn_fault_page(uc_engine *handle, ut64 page) {
+	ut8 buf[UNICORN_PAGE];
+	bool backed;
+	int perms = region_perms (page, page + UNICORN_PAGE, &backed);
+	if (!perms || uc_mem_map (handle, page, UNICORN_PAGE, perms) != UC_ERR_OK) {
+		return false;
+	}
+	if (backed) {
+		RDebug *dbg = uc_regions.dbg;
+		memset (buf, 0, sizeof (buf));
+		dbg->iob.read_at (dbg->iob.io, page, buf, sizeof (buf));
+		uc_mem_write (handle, page, buf, sizeof (buf));
+	}
+	if (uc_cps.count) {
+		// restoring an older checkpoint unmaps it again
+		checkpoint_log (page, NULL);
+	}
+	uc_regions.faults++;
+	return true;
+}
+
+/* an access may straddle two pages, the first one being already mapped */
+static bool unicorn_fault_in(uc_engine *handle, ut64 address, int size) {
+	ut64 page = address & ~(ut64)(UNICORN_PAGE - 1);
+	ut64 last = (address + R_MAX (size, 1) - 1) & ~(ut64)(UNICORN_PAGE - 1);
+	bool mapped = unicorn_fault_page (handle, page);
+	if (last != page) {
+		mapped |= unicorn_fault_page (handle, last);
+	}
+	return mapped;
+}
+
+static void unicorn_protect_page(ut64 page) {
+	bool backed;
+	int perms = region_perms (page, page + UNICORN_PAGE, &backed);
+	if (perms & UC_PROT_WRITE) {
+		uc_mem_protect (uh, page, UNICORN_PAGE, perms & ~UC_PROT_WRITE);
+	}
+}
+
+/* first write to a protected page since the newest checkpoint */
+static bool unicorn_cow_page(uc_engine *handle, ut64 page) {
+	bool backed;
+	int perms = region_perms (page, page + UNICORN_PAGE, &backed);
+	ut8 *data;
+	if (!uc_cps.count || !(perms & UC_PROT_WRITE)) {
+		return false;
+	}
+	data = malloc (UNICORN_PAGE);
+	if (!data || uc_mem_read (handle, page, data, UNICORN_PAGE) != UC_ERR_OK) {
+		free (data);
+		return false;
+	}
+	if (!checkpoint_log (page, data)) {
+		return false;
+	}
+	return uc_mem_protect (handle, page, UNICORN_PAGE, perms) == UC_ERR_OK;
+}
+
+static bool unicorn_cow(uc_engine *handle, ut64 address, int size) {
+	ut64 page = address & ~(ut64)(UNICORN_PAGE - 1);
+	ut64 last = (address + R_MAX (size, 1) - 1) & ~(ut64)(UNICORN_PAGE - 1);
+	bool done = unicorn_cow_page (handle, page);
+	if (last != page) {
+		done |= unicorn_cow_page (handle, last);
+	}
+	return done;
+}
+
+static void unicorn_checkpoint_reset(void) {
+	int i;
+	for (i = 0; i < uc_cps.max; i++) {
+		checkpoint_clear (&uc_cps.ring[i]);
+		free (uc_cps.ring[i].pages);
+		uc_free (uc_cps.ring[i].ctx);
+	}
+	R_FREE (uc_cps.ring);
+	uc_cps.max = uc_cps.head = uc_cps.count = 0;
+	uc_cps.fresh = false;
+}
+
+static bool unicorn_checkpoint(void) {
+	UnicornCheckpoint *cp;
+	int i;
+	if (!uh) {
+		return false;
+	}
+	if (!uc_cps.ring) {
+		char *env = r_sys_getenv ("R2_UNICORN_CHECKPOINTS");
+		int max = env? atoi (env): 0;
+		free (env);
+		uc_cps.max = max > 0? max: UNICORN_CHECKPOINTS;
+		uc_cps.ring = calloc (uc_cps.max, sizeof (UnicornCheckpoint));
+		if (!uc_cps.ring) {
+			uc_cps.max = 0;
+			return false;
+		}
+	}
+	cp = checkpoint_newest ();
+	if (cp) {
+		if (uc_cps.fresh && !cp->count) {
+			// nothing changed, just refresh the cpu state
+			return uc_context_save (uh, cp->ctx) == UC_ERR_OK;
+		}
+		// only the pages written since the last checkpoint became writable
+		for (i = 0; i < cp->count; i++) {
+			unicorn_protect_page (cp->pages[i].addr);
+		}
+	} else {
+		uc_mem_region *regions = NULL;
+		ut32 n = 0, j;
+		if (uc_mem_regions (uh, &regions, &n) == UC_ERR_OK) {
+			for (j = 0; j < n; j++) {
+				ut64 page;
+				if (!(regions[j].perms & UC_PROT_WRITE)) {
+					continue;
+				}
+				for (page = regions[j].begin; page < regions[j].end; page += UNICORN_PAGE) {
+					unicorn_protect_page (page);
+				}
+			}
+			uc_free (regions);
+		}
+	}
+	if (uc_cps.count == uc_cps.max) {
+		// the oldest undo log is not needed by the newer checkpoints
+		checkpoint_clear (&uc_cps.ring[uc_cps.head]);
+		uc_cps.head = (uc_cps.head + 1) % uc_cps.max;
+		uc_cps.count--;
+	}
+	uc_cps.count++;
+	cp = checkpoint_newest ();
+	checkpoint_clear (cp);
+	if (!cp->ctx && uc_context_alloc (uh, &cp->ctx) != UC_ERR_OK) {
+		uc_cps.count--;
+		return false;
+	}
+	uc_context_save (uh, cp->ctx);
+	uc_cps.fresh = true;
+	return true;
+}
+
+/* Go back to the newest checkpoint, or to the previous one when nothing ran
+ * since the newest was reached, so repeating it keeps stepping back. */
+static bool unicorn_restore(void) {
+	UnicornCheckpoint *cp = checkpoint_newest ();
+	ut64 t0 = r_sys_now ();
+	int i, pages;
+	if (!cp || !uh) {
+		return false;
+	}
+	if (uc_cps.fresh && !cp->count && uc_cps.count > 1) {
+		uc_cps.count--;
+		cp = checkpoint_newest ();
+	}
+	pages = cp->count;
+	for (i = cp->count - 1; i >= 0; i--) {
+		UnicornPage *p = &cp->pages[i];
+		if (p->data) {
+			uc_mem_write (uh, p->addr, p->data, UNICORN_PAGE);
+			unicorn_protect_page (p->addr);
+		} else {
+			uc_mem_unmap (uh, p->addr, UNICORN_PAGE);
+		}
+	}
+	checkpoint_clear (cp);
+	uc_context_restore (uh, cp->ctx);
+	uc_regs.valid = false;
+	uc_cps.fresh = true;
+	message ("[UNICORN] Restored checkpoint %d/%d, %d pages in %"PFMT64d"us\n",
+		uc_cps.count, uc_cps.max, pages, r_sys_now () - t0);
+	return true;
+}
+
+/* The plugin commands live in a small core plugin that the debug plugin
+ * registers the first time it is selected, r2 hands it every command line
+ * before its own dispatch and it only takes the ones starting with
+ * "unicorn". */
+static int unicorn_cmd_call(void *user, const char *input) {
+	RCore *core = (RCore *)user;
+	const char *cmd;
+	if (strncmp (input, "unicorn", 7) || (input[7] && input[7] != ' ')) {
+		return false;
+	}
+	cmd = r_str_trim_ro (input + 7);
+	if (!*cmd || *cmd == '?') {
+		message ("[UNICORN] unicorn batch [spec]   call a function once per input, see the README\n");
+		message ("[UNICORN] unicorn checkpoint     save the cpu state and the written pages\n");
+		message ("[UNICORN] unicorn restore        go back to the last checkpoint\n");
+		message ("[UNICORN] unicorn autosave [0|1] take a checkpoint before every ds and dc\n");
+	} else if (!uh) {
+		message ("[UNICORN] Not attached, run dpa first\n");
+	} else if (!strcmp (cmd, "checkpoint")) {
+		if (unicorn_checkpoint ()) {
+			message ("[UNICORN] Checkpoint %d/%d\n", uc_cps.count, uc_cps.max);
+		} else {
+			message ("[UNICORN] Cannot take a checkpoint\n");
+		}
+	} else if (!strcmp (cmd, "restore")) {
+		if (!unicorn_restore ()) {
+			message ("[UNICORN] No checkpoint to restore\n");
+		}
+	} else if (!strncmp (cmd, "autosave", 8) && (!cmd[8] || cmd[8] == ' ')) {
+		if (cmd[8]) {
+			uc_cps.autosave = r_str_is_true (r_str_trim_ro (cmd + 9));
+		}
+		message ("[UNICORN] autosave %s\n", uc_cps.autosave? "on": "off");
+	} else if (!strncmp (cmd, "batch ", 6)) {
+		r_debug_unicorn_batch (core->dbg, r_str_trim_ro (cmd + 6));
+	} else {
+		message ("[UNICORN] Unknown command, see unicorn?\n");
+	}
+	return true;
+}
+
+static RCorePlugin r_core_plugin_unicorn = {
+	.name = "unicorn",
+	.desc = "Commands of the unicorn debugger backend",
+	.license = "GPL",
+	.call = unicorn_cmd_call,
+};
+
+static void unicorn_cmd_register(RDebug *dbg) {
+	RCore *core = (RCore *)dbg->corebind.core;
+	if (core && core->rcmd && !r_list_contains (core->rcmd->plist, &r_core_plugin_unicorn)) {
+		r_core_plugin_add (core->rcmd, &r_core_plugin_unicorn);
+	}
+}
+
 static bool _mem_invalid(uc_engine *handle, uc_mem_type type,
 		uint64_t address, int size, int64_t value, void *user_data) {
 	const char *typestr = "";
+	switch (type) {
+	case UC_MEM_READ_UNMAPPED:
+	case UC_MEM_WRITE_UNMAPPED:
+	case UC_MEM_FETCH_UNMAPPED:
+		if (unicorn_fault_in (handle, address, size)) {
+			return true;
+		}
+		break;
+	case UC_MEM_WRITE_PROT:
+		if (unicorn_cow (handle, address, size)) {
+			return true;
+		}
+		break;
+	default:
+		break;
+	}
 	switch(type) {
 	case UC_MEM_READ:
 			typestr = "read";
@@ -421,53 +1045,56 @@ static bool _mem_invalid(uc_engine *handle, uc_mem_type type,
 	}
 	message ("[UNICORN] Invalid %s of %d bytes at 0x%"PFMT64x"\n",
 		typestr, size, address);
+	uc_run.reason = R_DEBUG_REASON_SEGFAULT;
+	uc_run.addr = address;
 	uc_emu_stop (handle);
 	return false;
 }
 
-static int r_debug_unicorn_step(RDebug *dbg) {
-	uc_err err;
-	ut64 addr = 0;
-	ut64 addr_end = 4;
-	static uc_hook uh_interrupt = 0;
-	static uc_hook uh_invalid = 0;
-	static uc_hook uh_code = 0;
-	static uc_hook uh_insn = 0;
-
-	uc_reg_read (uh, UC_X86_REG_RIP, &addr);
-	addr_end = addr + 32;
-
-	message ("EMU From 0x%llx To 0x%llx\n", addr, addr_end);
-	if (uh_interrupt) {
-		uc_hook_del (uh, uh_interrupt);
-	}
-	if (uh_code) {
-		uc_hook_del (uh, uh_code);
+/* hooks are installed once per engine, not on every step */
+static void unicorn_hooks_init(bool x86) {
+	uc_hook_add (uh, &uh_interrupt, UC_HOOK_INTR, _interrupt, NULL, 1, 0);
+	uc_hook_add (uh, &uh_invalid, UC_HOOK_MEM_INVALID, _mem_invalid, NULL, 1, 0);
+	if (x86) {
+		uc_hook_add (uh, &uh_insn, UC_HOOK_INSN, _insn_out, NULL, 1, 0, UC_X86_INS_OUT);
 	}
-	if (uh_insn) {
-		uc_hook_del (uh, uh_insn);
+	uc_bps.nhooks = 0;
+	uc_bps.dirty = true;
+}
+
+static uc_err unicorn_run(ut64 pc, ut64 count, ut64 timeout) {
+	uc_err err;
+	uc_run.reason = R_DEBUG_REASON_NONE;
+	uc_run.addr = pc;
+	err = uc_emu_start (uh, pc, UT64_MAX, timeout, count);
+	uc_regs.valid = false;
+	uc_cps.fresh = false;
+	if (err && uc_run.reason == R_DEBUG_REASON_NONE) {
+		uc_run.reason = R_DEBUG_REASON_ILLEGAL;
+		message ("[UNICORN] %s at 0x%08"PFMT64x"\n", uc_strerror (err), pc);
 	}
-	if (uh_invalid) {
-		uc_hook_del (uh, uh_invalid);
+	return err;
+}
+
+static void unicorn_step(void) {
+	ut64 addr = 0;
+	uc_reg_read (uh, uc_regs.regs[uc_regs.pc].id, &addr);
+	uc_run.stepping = true;
+	unicorn_run (addr, 1, 0);
+	uc_run.stepping = false;
+	if (uc_run.reason == R_DEBUG_REASON_NONE) {
+		uc_run.reason = R_DEBUG_REASON_STEP;
 	}
-	uc_hook_add (uh, &uh_interrupt, UC_HOOK_INTR, _interrupt, NULL, 1, 0);
-	//uc_hook_add (uh, &uh_code, UC_HOOK_CODE, _code, NULL, addr, addr+1); //(void*)(size_t)1, 0);
-	uc_hook_add (uh, &uh_code, UC_HOOK_BLOCK, _block, NULL, 1, 0);
-	{
-		uint8_t mem[8];
-		uc_err err = uc_mem_read (uh, addr, mem, 4);
-		message ("[EIP] = %d = %02x %02x %02x %02x\n", err, mem[0], mem[1], mem[2], mem[3]);
+}
+
+static int r_debug_unicorn_step(RDebug *dbg) {
+	if (!uh) {
+		return false;
 	}
-	uc_hook_add (uh, &uh_invalid, UC_HOOK_MEM_INVALID, _mem_invalid, NULL, 1, 0);
-	uc_hook_add (uh, &uh_insn, UC_HOOK_INSN, _insn_out, NULL, 1, 0, UC_X86_INS_OUT);
-	err = uc_emu_start (uh, addr, addr_end, 0, 1);
-	message ("[UNICORN] Step Instruction At 0x%08"PFMT64x"\n", addr);
-	{
-		uint64_t rip;
-		uc_reg_read (uh, UC_X86_REG_RIP, &rip);
-		message ("NEW PC 0x%08"PFMT64x"\n", rip);
+	if (uc_cps.autosave) {
+		unicorn_checkpoint ();
 	}
-	//err = uc_emu_stop (uh);
+	unicorn_step ();
 	return true;
 }
 
@@ -498,18 +1125,557 @@ static int r_debug_unicorn_continue_syscall(RDebug *dbg, int pid, int num) {
 	return -1;
 }
 
+/* Runs natively inside uc_emu_start until a breakpoint, a fault, an
+ * interrupt or the instruction/time budget stops it. */
 static int r_debug_unicorn_continue(RDebug *dbg, int pid, int tid, int sig) {
+	ut64 pc = 0, t0, elapsed;
+	uc_err err;
+	if (!uh) {
+		return false;
+	}
+	if (uc_cps.autosave) {
+		unicorn_checkpoint ();
+	}
+	unicorn_bp_sync ();
+	uc_reg_read (uh, uc_regs.regs[uc_regs.pc].id, &pc);
+	if (bpset_has (pc)) {
+		// step off the breakpoint we are stopped at
+		unicorn_step ();
+		if (uc_run.reason != R_DEBUG_REASON_STEP) {
+			return tid;
+		}
+		uc_reg_read (uh, uc_regs.regs[uc_regs.pc].id, &pc);
+	}
+	t0 = r_sys_now ();
+	err = unicorn_run (pc, uc_budget, uc_timeout);
+	elapsed = r_sys_now () - t0;
+	if (!err && uc_run.reason == R_DEBUG_REASON_NONE && uc_budget) {
+		message ("[UNICORN] Budget of %"PFMT64d" instructions reached in %.3fs (%.2f Minsn/s, %d pages loaded)\n",
+			uc_budget, elapsed / 1000000.0, elapsed? (double)uc_budget / elapsed: 0.0,
+			uc_regions.faults);
+	}
 	return tid;
 }
 
-static int r_debug_unicorn_wait(RDebug *dbg, int pid) {
-	// no need to wait
+static RDebugReasonType r_debug_unicorn_wait(RDebug *dbg, int pid) {
+	return uc_run.reason;
+}
+
+/* Batch runner: calls the same function once per record of an input file,
+ * without going through r2 for each run. Every worker thread owns its own
+ * engine. Read-only maps are read from r2 once and shared by all engines
+ * with uc_mem_map_ptr; writable pages and the ones holding the input record
+ * are faulted in privately from the same image and unmapped after every
+ * run, so each run starts clean and never writes to the shared copy.
+ *
+ * The spec is a text file, one directive per line:
+ *
+ *   func 0x1000            function to call
+ *   ret 0xdead0000         return address, the run ends when reached
+ *   input in.bin 64 0x8000 records of 64 bytes written at 0x8000
+ *   reg rdi $addr          register templates: number, $addr or $len
+ *   reg rsi $len
+ *   map 0x8000 0x1000      extra zero filled read-write memory
+ *   output 0x8000 16       memory dumped after each run
+ *   cov 256                coverage bitmap size in bytes, 0 disables it
+ *   budget 1000000         max instructions per run
+ *   threads 8
+ *   out results.txt
+ */
+#define UNICORN_BATCH_RET 0xdead0000
+
+enum {
+	BATCH_VALUE,
+	BATCH_ADDR,
+	BATCH_LEN,
+};
+
+typedef struct {
+	ut64 base;
+	ut64 size;
+	int perms;
+	ut8 *buf; // NULL when zero filled
+} UnicornImage;
+
+typedef struct {
+	int idx;
+	int kind;
+	ut64 value;
+} UnicornBatchReg;
+
+typedef struct {
+	ut64 func;
+	ut64 ret;
+	ut64 budget;
+	ut64 inaddr;
+	int insize;
+	ut8 *inputs;
+	int count;
+	ut64 outaddr;
+	int outsize;
+	int covsize;
+	int threads;
+	char *outfile;
+	UnicornImage *images;
+	int nimages;
+	UnicornBatchReg regs[UNICORN_MAXREGS];
+	int nregs;
+	ut64 vals[UNICORN_MAXREGS]; // initial register values
+	ut64 *results;
+	int *reasons;
+	ut8 *outs;
+	ut8 *covs;
+} UnicornBatch;
+
+typedef struct {
+	UnicornBatch *b;
+	int first;
+	int step;
+	uc_engine *uc;
+	ut64 *pages;
+	int npages;
+	int cpages;
+	ut8 *cov;
+	ut64 prev;
+	int reason;
+} UnicornWorker;
+
+enum {
+	BATCH_OK,
+	BATCH_FAULT,
+	BATCH_BUDGET,
+	BATCH_ERROR,
+};
+
+static const char *batch_reasons[] = { "ok", "fault", "budget", "error" };
+
+static bool batch_image_add(UnicornBatch *b, ut64 addr, ut64 size, int perms, RDebug *dbg) {
+	UnicornImage *images, *img;
+	ut64 base = addr & ~(ut64)(UNICORN_PAGE - 1);
+	ut64 end = (addr + size + UNICORN_PAGE - 1) & ~(ut64)(UNICORN_PAGE - 1);
+	images = realloc (b->images, (b->nimages + 1) * sizeof (UnicornImage));
+	if (!images) {
+		return false;
+	}
+	b->images = images;
+	img = &b->images[b->nimages];
+	img->base = base;
+	img->size = end - base;
+	img->perms = perms;
+	img->buf = NULL;
+	if (dbg) {
+		img->buf = calloc (1, img->size);
+		if (!img->buf) {
+			return false;
+		}
+		dbg->iob.read_at (dbg->iob.io, addr, img->buf + (addr - base), size);
+	}
+	b->nimages++;
+	return true;
+}
+
+static void batch_free(UnicornBatch *b) {
+	int i;
+	for (i = 0; i < b->nimages; i++) {
+		free (b->images[i].buf);
+	}
+	free (b->images);
+	free (b->inputs);
+	free (b->outfile);
+	free (b->results);
+	free (b->reasons);
+	free (b->outs);
+	free (b->covs);
+}
+
+static bool batch_parse(UnicornBatch *b, const char *path) {
+	char line[1024], key[32], a[512], c[64], d[64];
+	FILE *fd = fopen (path, "r");
+	int n, len = 0;
+	if (!fd) {
+		message ("[UNICORN] Cannot open %s\n", path);
+		return false;
+	}
+	b->ret = UNICORN_BATCH_RET;
+	b->covsize = 256;
+	while (fgets (line, sizeof (line), fd)) {
+		n = sscanf (line, "%31s %511s %63s %63s", key, a, c, d);
+		if (n < 2 || *key == '#') {
+			continue;
+		}
+		if (!strcmp (key, "func")) {
+			b->func = r_num_get (NULL, a);
+		} else if (!strcmp (key, "ret")) {
+			b->ret = r_num_get (NULL, a);
+		} else if (!strcmp (key, "budget")) {
+			b->budget = r_num_get (NULL, a);
+		} else if (!strcmp (key, "threads")) {
+			b->threads = atoi (a);
+		} else if (!strcmp (key, "cov")) {
+			b->covsize = atoi (a);
+		} else if (!strcmp (key, "out")) {
+			free (b->outfile);
+			b->outfile = strdup (a);
+		} else if (!strcmp (key, "map") && n > 2) {
+			batch_image_add (b, r_num_get (NULL, a), r_num_get (NULL, c),
+				UC_PROT_READ | UC_PROT_WRITE, NULL);
+		} else if (!strcmp (key, "output") && n > 2) {
+			b->outaddr = r_num_get (NULL, a);
+			b->outsize = atoi (c);
+		} else if (!strcmp (key, "input") && n > 3) {
+			free (b->inputs);
+			b->inputs = (ut8 *)r_file_slurp (a, &len);
+			b->insize = atoi (c);
+			b->inaddr = r_num_get (NULL, d);
+			if (!b->inputs || b->insize < 1) {
+				message ("[UNICORN] Cannot read inputs from %s\n", a);
+				fclose (fd);
+				return false;
+			}
+			b->count = len / b->insize;
+		} else if (!strcmp (key, "reg") && n > 2) {
+			UnicornBatchReg *r = &b->regs[b->nregs];
+			if (b->nregs >= UNICORN_MAXREGS || (r->idx = unicorn_reg_find (a)) < 0) {
+				message ("[UNICORN] Unknown register %s\n", a);
+				continue;
+			}
+			if (!strcmp (c, "$addr")) {
+				r->kind = BATCH_ADDR;
+			} else if (!strcmp (c, "$len")) {
+				r->kind = BATCH_LEN;
+			} else {
+				r->kind = BATCH_VALUE;
+				r->value = r_num_get (NULL, c);
+			}
+			b->nregs++;
+		} else {
+			message ("[UNICORN] Unknown batch directive %s\n", key);
+		}
+	}
+	fclose (fd);
+	if (!b->func || !b->count || !b->outfile) {
+		message ("[UNICORN] The batch needs at least func, input and out\n");
+		return false;
+	}
+	b->covsize = R_MAX (b->covsize, 0);
+	b->outsize = R_MAX (b->outsize, 0);
+	return true;
+}
+
+static bool batch_fault_page(UnicornWorker *w, ut64 page) {
+	UnicornBatch *b = w->b;
+	int i;
+	for (i = 0; i < b->nimages; i++) {
+		UnicornImage *img = &b->images[i];
+		if (page < img->base || page >= img->base + img->size) {
+			continue;
+		}
+		if (uc_mem_map (w->uc, page, UNICORN_PAGE, img->perms) != UC_ERR_OK) {
+			return false;
+		}
+		if (img->buf) {
+			uc_mem_write (w->uc, page, img->buf + (page - img->base), UNICORN_PAGE);
+		}
+		if (w->npages == w->cpages) {
+			int cpages = w->cpages? w->cpages * 2: 64;
+			ut64 *pages = realloc (w->pages, cpages * sizeof (ut64));
+			if (!pages) {
+				return true;
+			}
+			w->pages = pages;
+			w->cpages = cpages;
+		}
+		w->pages[w->npages++] = page;
+		return true;
+	}
+	return false;
+}
+
+/* make sure [addr, addr + len) is mapped before touching it from the host */
+static bool batch_fault_range(UnicornWorker *w, ut64 addr, ut64 len) {
+	ut64 page = addr & ~(ut64)(UNICORN_PAGE - 1);
+	ut8 byte;
+	for (; page < addr + len; page += UNICORN_PAGE) {
+		if (uc_mem_read (w->uc, page, &byte, 1) != UC_ERR_OK && !batch_fault_page (w, page)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool _batch_mem(uc_engine *handle, uc_mem_type type,
+		uint64_t address, int size, int64_t value, void *user_data) {
+	UnicornWorker *w = user_data;
+	ut64 page = address & ~(ut64)(UNICORN_PAGE - 1);
+	ut64 last = (address + R_MAX (size, 1) - 1) & ~(ut64)(UNICORN_PAGE - 1);
+	if (type == UC_MEM_READ_UNMAPPED || type == UC_MEM_WRITE_UNMAPPED || type == UC_MEM_FETCH_UNMAPPED) {
+		bool mapped = batch_fault_page (w, page);
+		if (last != page) {
+			mapped |= batch_fault_page (w, last);
+		}
+		if (mapped) {
+			return true;
+		}
+	}
+	w->reason = BATCH_FAULT;
+	return false;
+}
+
+static void _batch_block(uc_engine *handle, uint64_t address, uint32_t size, void *user_data) {
+	UnicornWorker *w = user_data;
+	ut64 cur = address;
+	ut32 bit;
+	cur ^= cur >> 33;
+	cur *= 0xff51afd7ed558ccdULL;
+	cur ^= cur >> 33;
+	// edge coverage, afl style
+	bit = (ut32)((cur ^ w->prev) % (w->b->covsize * 8));
+	w->cov[bit / 8] |= 1 << (bit % 8);
+	w->prev = cur >> 1;
+}
+
+static void _batch_intr(uc_engine *handle, uint32_t intno, void *user_data) {
+	UnicornWorker *w = user_data;
+	w->reason = BATCH_FAULT;
+	uc_emu_stop (handle);
+}
+
+static void batch_run(UnicornWorker *w, int n) {
+	UnicornBatch *b = w->b;
+	ut64 vals[UNICORN_MAXREGS];
+	void *ptrs[UNICORN_MAXREGS];
+	ut64 sp = UNICORN_STACK_ADDR + UNICORN_STACK_SIZE / 2;
+	ut64 pc = 0;
+	int i;
+	memcpy (vals, b->vals, sizeof (vals));
+	for (i = 0; i < b->nregs; i++) {
+		UnicornBatchReg *r = &b->regs[i];
+		vals[r->idx] = r->kind == BATCH_ADDR? b->inaddr
+			: r->kind == BATCH_LEN? (ut64)b->insize: r->value;
+	}
+	if (uc_regs.lr == -1) {
+		int ptrsize = uc_regs.bits / 8;
+		sp -= ptrsize;
+		batch_fault_range (w, sp, ptrsize);
+		uc_mem_write (w->uc, sp, &b->ret, ptrsize);
+	} else {
+		vals[uc_regs.lr] = b->ret;
+	}
+	vals[uc_regs.sp] = sp;
+	for (i = 0; i < uc_regs.count; i++) {
+		ptrs[i] = &vals[i];
+	}
+	uc_reg_write_batch (w->uc, uc_regs.ids, ptrs, uc_regs.count);
+	if (batch_fault_range (w, b->inaddr, b->insize)) {
+		uc_mem_write (w->uc, b->inaddr, b->inputs + (ut64)n * b->insize, b->insize);
+	}
+	if (w->cov) {
+		memset (w->cov, 0, b->covsize);
+	}
+	w->prev = 0;
+	w->reason = BATCH_OK;
+	if (uc_emu_start (w->uc, b->func, b->ret, 0, b->budget) != UC_ERR_OK && w->reason == BATCH_OK) {
+		w->reason = BATCH_ERROR;
+	}
+	uc_reg_read (w->uc, uc_regs.regs[uc_regs.pc].id, &pc);
+	if (w->reason == BATCH_OK && pc != b->ret) {
+		w->reason = BATCH_BUDGET;
+	}
+	b->reasons[n] = w->reason;
+	b->results[n] = 0;
+	uc_reg_read (w->uc, uc_regs.regs[uc_regs.ret].id, &b->results[n]);
+	if (b->outsize && batch_fault_range (w, b->outaddr, b->outsize)) {
+		uc_mem_read (w->uc, b->outaddr, b->outs + (ut64)n * b->outsize, b->outsize);
+	}
+	if (w->cov) {
+		memcpy (b->covs + (ut64)n * b->covsize, w->cov, b->covsize);
+	}
+	// drop the private pages so the next run starts from the image again
+	for (i = 0; i < w->npages; i++) {
+		uc_mem_unmap (w->uc, w->pages[i], UNICORN_PAGE);
+	}
+	w->npages = 0;
+}
+
+static bool batch_worker_init(UnicornWorker *w) {
+	UnicornBatch *b = w->b;
+	ut64 inlo, inhi;
+	uc_hook hook;
+	int i;
+	if (uc_open (uh_arch, uh_mode, &w->uc) != UC_ERR_OK) {
+		return false;
+	}
+	// the pages holding the input record are written from the host on
+	// every run, they are faulted in privately like the writable ones
+	inlo = b->inaddr & ~(ut64)(UNICORN_PAGE - 1);
+	inhi = (b->inaddr + b->insize + UNICORN_PAGE - 1) & ~(ut64)(UNICORN_PAGE - 1);
+	for (i = 0; i < b->nimages; i++) {
+		UnicornImage *img = &b->images[i];
+		ut64 end = img->base + img->size;
+		if (!img->buf || (img->perms & UC_PROT_WRITE)) {
+			continue;
+		}
+		// overlapping maps fall back to private pages
+		if (inhi <= img->base || inlo >= end) {
+			uc_mem_map_ptr (w->uc, img->base, img->size, img->perms, img->buf);
+			continue;
+		}
+		if (inlo > img->base) {
+			uc_mem_map_ptr (w->uc, img->base, inlo - img->base, img->perms, img->buf);
+		}
+		if (inhi < end) {
+			uc_mem_map_ptr (w->uc, inhi, end - inhi, img->perms, img->buf + (inhi - img->base));
+		}
+	}
+	uc_hook_add (w->uc, &hook, UC_HOOK_MEM_INVALID, _batch_mem, w, 1, 0);
+	uc_hook_add (w->uc, &hook, UC_HOOK_INTR, _batch_intr, w, 1, 0);
+	if (b->covsize) {
+		w->cov = calloc (1, b->covsize);
+		uc_hook_add (w->uc, &hook, UC_HOOK_BLOCK, _batch_block, w, 1, 0);
+	}
+	return true;
+}
+
+static void batch_worker_run(UnicornWorker *w) {
+	int i;
+	if (!batch_worker_init (w)) {
+		return;
+	}
+	for (i = w->first; i < w->b->count; i += w->step) {
+		batch_run (w, i);
+	}
+}
+
+static int batch_worker(RThread *th) {
+	batch_worker_run (th->user);
+	return 0;
+}
+
+static int batch_nthreads(UnicornBatch *b) {
+	int n = b->threads;
+	if (n < 1) {
+#if __UNIX__
+		n = (int)sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+		if (n < 1) {
+			n = 1;
+		}
+	}
+	return R_MIN (n, b->count);
+}
+
+static void batch_write(UnicornBatch *b, FILE *fd) {
+	int i, j;
+	fprintf (fd, "# unicorn-batch 1\n");
+	for (i = 0; i < b->count; i++) {
+		const ut8 *out = b->outs + (ut64)i * b->outsize;
+		const ut8 *cov = b->covs + (ut64)i * b->covsize;
+		fprintf (fd, "%d %s 0x%"PFMT64x" ", i, batch_reasons[b->reasons[i]], b->results[i]);
+		for (j = 0; j < b->outsize; j++) {
+			fprintf (fd, "%02x", out[j]);
+		}
+		fprintf (fd, b->outsize? " ": "- ");
+		for (j = 0; j < b->covsize; j++) {
+			fprintf (fd, "%02x", cov[j]);
+		}
+		fprintf (fd, b->covsize? "\n": "-\n");
+	}
+}
+
+R_API bool r_debug_unicorn_batch(RDebug *dbg, const char *path) {
+	UnicornBatch b = { 0 };
+	UnicornWorker *workers = NULL;
+	RThread **threads = NULL;
+	SdbListIter *iter;
+	RIOMap *map;
+	int i, nthreads, counts[4] = { 0 };
+	ut64 t0, elapsed;
+	FILE *fd;
+	if (!uh || !uc_regs.count) {
+		message ("[UNICORN] Attach with dpa before running a batch\n");
+		return false;
+	}
+	if (!batch_parse (&b, path)) {
+		batch_free (&b);
+		return false;
+	}
+	// r2 is not thread safe, so everything is read from it upfront
+	ls_foreach (dbg->iob.io->maps, iter, map) {
+		int perms = 0;
+		if (map->perm & R_PERM_R) perms |= UC_PROT_READ;
+		if (map->perm & R_PERM_W) perms |= UC_PROT_WRITE;
+		if (map->perm & R_PERM_X) perms |= UC_PROT_EXEC;
+		if (map->itv.size && perms) {
+			batch_image_add (&b, map->itv.addr, map->itv.size, perms, dbg);
+		}
+	}
+	batch_image_add (&b, UNICORN_STACK_ADDR, UNICORN_STACK_SIZE,
+		UC_PROT_READ | UC_PROT_WRITE, NULL);
+	unicorn_regs_fetch ();
+	memcpy (b.vals, uc_regs.vals, sizeof (b.vals));
+	b.results = calloc (b.count, sizeof (ut64));
+	b.reasons = calloc (b.count, sizeof (int));
+	b.outs = calloc (b.count, R_MAX (b.outsize, 1));
+	b.covs = calloc (b.count, R_MAX (b.covsize, 1));
+	nthreads = batch_nthreads (&b);
+	workers = R_NEWS0 (UnicornWorker, nthreads);
+	threads = R_NEWS0 (RThread *, nthreads);
+	if (!b.results || !b.reasons || !b.outs || !b.covs || !workers || !threads) {
+		free (workers);
+		free (threads);
+		batch_free (&b);
+		return false;
+	}
+	for (i = 0; i < nthreads; i++) {
+		workers[i].b = &b;
+		workers[i].first = i;
+		workers[i].step = nthreads;
+		workers[i].reason = BATCH_ERROR;
+	}
+	for (i = 0; i < b.count; i++) {
+		b.reasons[i] = BATCH_ERROR;
+	}
+	t0 = r_sys_now ();
+	for (i = 1; i < nthreads; i++) {
+		threads[i] = r_th_new (batch_worker, &workers[i], 0);
+	}
+	batch_worker_run (&workers[0]);
+	for (i = 1; i < nthreads; i++) {
+		if (threads[i]) {
+			r_th_wait (threads[i]);
+			r_th_free (threads[i]);
+		}
+	}
+	elapsed = r_sys_now () - t0;
+	for (i = 0; i < nthreads; i++) {
+		if (workers[i].uc) {
+			uc_close (workers[i].uc);
+		}
+		free (workers[i].pages);
+		free (workers[i].cov);
+	}
+	for (i = 0; i < b.count; i++) {
+		counts[b.reasons[i]]++;
+	}
+	fd = fopen (b.outfile, "w");
+	if (fd) {
+		batch_write (&b, fd);
+		fclose (fd);
+	} else {
+		message ("[UNICORN] Cannot write %s\n", b.outfile);
+	}
+	message ("[UNICORN] %d runs in %.3fs on %d threads (%.0f exec/s): %d ok, %d fault, %d budget, %d error\n",
+		b.count, elapsed / 1000000.0, nthreads,
+		elapsed? b.count * 1000000.0 / elapsed: 0.0,
+		counts[BATCH_OK], counts[BATCH_FAULT], counts[BATCH_BUDGET], counts[BATCH_ERROR]);
+	free (workers);
+	free (threads);
+	batch_free (&b);
 	return true;
 }
 
 static int r_debug_unicorn_init(RDebug *dbg) {
 	SdbListIter *iter;
-	int code_is_mapped;
 	RIOMap *map;
 	int bits = (dbg->bits & R_SYS_BITS_64) ? 64: 32;
 	uc_err err;
@@ -517,113 +1683,88 @@ static int r_debug_unicorn_init(RDebug *dbg) {
 		// run detach to allow reinit
 		return true;
 	}
-	// TODO: add support for ARM, MIPS, ...
+	err = UC_ERR_OK;
 	if (!strcmp (dbg->arch, "x86")) {
-		err = uc_open (UC_ARCH_X86, bits==64? UC_MODE_64: UC_MODE_32, &uh);
+		uh_arch = UC_ARCH_X86;
+		uh_mode = bits == 64? UC_MODE_64: UC_MODE_32;
 	} else if (!strcmp (dbg->arch, "arm")) {
-		err = uc_open (UC_ARCH_ARM, bits==64? UC_MODE_64: UC_MODE_32, &uh);
+		uh_arch = bits == 64? UC_ARCH_ARM64: UC_ARCH_ARM;
+		uh_mode = UC_MODE_ARM;
+	} else if (!strcmp (dbg->arch, "mips")) {
+		uh_arch = UC_ARCH_MIPS;
+		uh_mode = bits == 64? UC_MODE_MIPS64: UC_MODE_MIPS32;
+		// cfg.bigendian, the anal follows it
+		uh_mode |= (dbg->anal && dbg->anal->big_endian)? UC_MODE_BIG_ENDIAN: UC_MODE_LITTLE_ENDIAN;
 	} else {
-		err = 1;
+		err = UC_ERR_ARCH;
 		message ("[UNICORN] Unsupported architecture\n");
 	}
+	if (!err) {
+		err = uc_open (uh_arch, uh_mode, &uh);
+	}
 	message ("[UNICORN] Using arch %s bits %d\n", dbg->arch, bits);
 	if (err) {
 		message ("[UNICORN] Cannot initialize Unicorn engine\n");
 		return false;
 	}
-	ut64 lastvaddr = 0LL;
+	unicorn_hooks_init (!strcmp (dbg->arch, "x86"));
+	unicorn_regs_setup (dbg->arch, bits);
+	unicorn_checkpoint_reset ();
+	uc_regs.valid = false;
+	{
+		char *env = r_sys_getenv ("R2_UNICORN_BUDGET");
+		uc_budget = env? r_num_get (NULL, env): 0;
+		free (env);
+		env = r_sys_getenv ("R2_UNICORN_TIMEOUT");
+		uc_timeout = env? r_num_get (NULL, env) * 1000: 0;
+		free (env);
+		env = r_sys_getenv ("R2_UNICORN_AUTOSAVE");
+		uc_cps.autosave = env && r_str_is_true (env);
+		free (env);
+	}
+	unicorn_cmd_register (dbg);
 	int n_sect = ls_length (dbg->iob.io->maps);
 	if (n_sect == 0) {
 		message (logo);
 		message ("[UNICORN] dpa            # reatach to initialize the unicorn\n");
 		message ("[UNICORN] dr rip=entry0  # set program counter to the entrypoint\n");
 	}
-	code_is_mapped = 0;
-
+	uc_regions.count = 0;
+	uc_regions.faults = 0;
+	uc_regions.dbg = dbg;
 	ls_foreach (dbg->iob.io->maps, iter, map) {
 		int perms = 0;
 		if (map->perm & R_PERM_R) perms |= UC_PROT_READ;
 		if (map->perm & R_PERM_W) perms |= UC_PROT_WRITE;
 		if (map->perm & R_PERM_X) perms |= UC_PROT_EXEC;
-		ut64 mapbase = map->itv.addr >> 12 << 12;
-		int bufdelta = map->itv.addr - mapbase;
-		ut32 vsz = 64 * 1024;
-		ut8 *buf;
-		if (map->itv.addr < lastvaddr)
-			continue;
-		if (!(map->perm & 1))
+		if (!map->itv.size || !perms) {
 			continue;
-		if (!strstr (map->name, "text"))
-			continue;
-		buf = calloc (vsz+bufdelta+1024, 1);
-		if (!buf) continue;
-		message ("[UNICORN] BASE 0x%08"PFMT64x"\n", mapbase);
-		//message ("DELTA = %d SIZE = %d\n", bufdelta,
-			//R_MIN (map->itv.size, (vsz - bufdelta)));
-		dbg->iob.read_at (dbg->iob.io, map->itv.addr, buf + bufdelta,
-			R_MIN (map->itv.size, (vsz - bufdelta)));
-		message ("[UNICORN] Segment 0x%08"PFMT64x" 0x%08"PFMT64x" Size %d\n",
-			map->itv.addr, map->itv.addr + vsz, vsz);
-		err = uc_mem_map_ptr (uh, mapbase, vsz, perms, buf);
-		if (err) {
-			message("[UNICORN] muc_mem_map_ptr failed to allocated %d\n", vsz);
-		}
-		//err = uc_mem_write (uh, map->itv.addr, buf, vsz);
-		/*
-		err = uc_mem_write (uh, mapbase, buf, vsz);
-		if (err) {
-			message("[UNICORN] muc_mem_write failed %d\n", err);
-		}*/
-		//eprintf ("%02x %02x\n", buf[0], buf[1]);
-		//eprintf ("WRT = %d\n", err);
-
-		//err = uc_mem_read (uh, mapbase, buf, vsz); //map->itv.size+bufdelta);
-		//eprintf ("RAD = %d\n", err);
-		lastvaddr = map->itv.addr + map->itv.size;
-		code_is_mapped = 1;
-		if (JUST_FIRST_BLOCK) break;
-//break;
-#if 0
-		// test
-		dbg->iob.read_at (dbg->iob.io, 0x100001058, buf, vsz);
-		uc_mem_map (uh, 0x100001058, vsz);
-		uc_mem_write (uh, 0x100001058, buf, vsz);
-		free (buf);
-#endif
+		}
+		region_add (map->itv.addr, map->itv.size, perms, true);
 	}
-	if (!code_is_mapped) {
+	if (!uc_regions.count) {
 		message("[UNICORN] No code mapped into the Unicorn. Use `dpa` to attach and transfer\n");
+	} else {
+		message ("[UNICORN] %d maps registered, pages are loaded on first access\n",
+			uc_regions.count);
 	}
 
 	message ("[UNICORN] Set Program Counter 0x%08"PFMT64x"\n",
 		dbg->iob.io->off);
-	if (bits == 64) {
-		err = uc_reg_write (uh, UC_X86_REG_RIP, &dbg->iob.io->off);
-	} else {
-		err = uc_reg_write (uh, UC_X86_REG_EIP, &dbg->iob.io->off);
-	}
+	err = uc_reg_write (uh, uc_regs.regs[uc_regs.pc].id, &dbg->iob.io->off);
 	if (err) {
 		message ("[UNICORN] Cannot Set PC\n");
 		return false;
 	}
 
-	/* stack */
+	/* stack, zero filled on demand like the rest */
 	{
-		uc_err err;
-		ut32 stacksize = 8 * 4096;
-		ut64 stackaddr = 0x7000000;
-		message ("[UNICORN] Define 64 KB stack at 0x%08"PFMT64x"\n", stackaddr);
-		err = uc_mem_map (uh, stackaddr, stacksize, UC_PROT_WRITE | UC_PROT_READ);
-		if (err) {
-			eprintf ("Cannot allocate stack %d\n", err);
-		}
-		if (bits == 64) {
-			ut64 rsp = stackaddr + (stacksize/2);
-			err = uc_reg_write (uh, UC_X86_REG_RSP, &rsp);
-		} else {
-			ut32 esp = stackaddr + (stacksize/2);
-			err = uc_reg_write (uh, UC_X86_REG_ESP, &esp);
-		}
+		ut64 stackaddr = UNICORN_STACK_ADDR;
+		ut64 sp = stackaddr + UNICORN_STACK_SIZE / 2;
+		message ("[UNICORN] Define %d KB stack at 0x%08"PFMT64x"\n",
+			UNICORN_STACK_SIZE / 1024, stackaddr);
+		region_add (stackaddr, UNICORN_STACK_SIZE, UC_PROT_READ | UC_PROT_WRITE, false);
+		err = uc_reg_write (uh, uc_regs.regs[uc_regs.sp].id, &sp);
 	}
 	return true;
 }
@@ -632,7 +1773,7 @@ RDebugPlugin r_debug_plugin_unicorn = {
 	.name = "unicorn",
 	.license = "GPL",
 	.bits = R_SYS_BITS_32 | R_SYS_BITS_64,
-	.arch = "x86",
+	.arch = "x86,arm,mips",
 	.canstep = 1,
 	.keepio = 1,
 
@@ -644,8 +1785,7 @@ RDebugPlugin r_debug_plugin_unicorn = {
 	.attach = &r_debug_unicorn_attach,
 	.detach = &r_debug_unicorn_detach,
 	.kill = &r_debug_unicorn_kill,
-	//.breakpoint = r_debug_unicorn_bp,
-	.breakpoint = NULL,
+	.breakpoint = r_debug_unicorn_breakpoint,
 
 	.pids = &r_debug_unicorn_pids,
 	.tids = &r_debug_unicorn_tids,
@@ -1,149 +1,267 @@
 /* radare - LGPL - Copyright 2015 - pancake */
 
+/* The KDP client is built into the plugin the same way kdp/src/main.c
+ * builds it: by including its translation units. */
+#include "../../../kdp/src/defs.h"
+#include "../../../kdp/src/kdp-udp.c"
+#include "../../../kdp/src/kdp-protocol.c"
+#include "../../../kdp/src/kdp-transactions.c"
+#include "../../../kdp/src/splay-tree.c"
+#include "../../../kdp/src/dcache.c"
+#undef eprintf
+#undef warning
+
 #include "r_io.h"
 #include "r_lib.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 
-#include "../../../kdp/src/kdp-protocol.h"
+#define KDP_DEFAULT_PORT 41139
+#define KDP_TIMEOUT 5000
+#define KDP_RETRIES 10
 
 typedef struct {
-	int fd;
-	ut8 *buf;
-	ut32 size;
-	ut64 offset;
+	kdp_connection c;
+	DCACHE *dcache;
+	bool cached;
 } RIOKdp;
 
-#define RIOKDP_FD(x) (((RIOKdp*)x->data)->fd)
-#define RIOKDP_SZ(x) (((RIOKdp*)x->data)->size)
-#define RIOKDP_BUF(x) (((RIOKdp*)x->data)->buf)
-#define RIOKDP_OFF(x) (((RIOKdp*)x->data)->offset)
+#define RIOKDP(x) ((RIOKdp*)x->data)
 
-static int __write(RIO *io, RIODesc *fd, const ut8 *buf, int count) {
-	if (!fd || !buf || count<0 || fd->data == NULL)
-		return -1;
-	if (RIOKDP_OFF (fd) > RIOKDP_SZ (fd))
-		return -1;
-	if (RIOKDP_OFF (fd) + count > RIOKDP_SZ (fd))
-		count -= (RIOKDP_OFF (fd) + count-(RIOKDP_SZ (fd)));
+RIOPlugin r_io_plugin_kdp;
 
-	if (count > 0) {
-		memcpy (RIOKDP_BUF (fd) + RIOKDP_OFF (fd), buf, count);
-		RIOKDP_OFF (fd) += count;
-		return count;
+static int kdp_verbose = 0;
+
+static void kdp_logger(kdp_log_level l, const char *format, ...) {
+	va_list ap;
+	if (l > (kdp_verbose ? KDP_LOG_DEBUG : KDP_LOG_WARNING)) {
+		return;
 	}
-	return -1;
+	va_start (ap, format);
+	vfprintf (stderr, format, ap);
+	va_end (ap);
 }
 
-static int __resize(RIO *io, RIODesc *fd, ut64 count) {
-	ut8 * new_buf = NULL;
-	if (fd == NULL || fd->data == NULL || count == 0)
-		return -1;
-	if (RIOKDP_OFF (fd) > RIOKDP_SZ (fd))
-		return -1;
-	new_buf = malloc (count);
-	if (!new_buf) return -1;
-	memcpy (new_buf, RIOKDP_BUF (fd), R_MIN(count, RIOKDP_SZ (fd)));
-	if (count > RIOKDP_SZ (fd) )
-		memset (new_buf+RIOKDP_SZ (fd), 0, count-RIOKDP_SZ (fd));
+/* dcache line filler: runs of missing lines arrive here in one call,
+ * so they go out as a single pipelined read */
+static int kdp_dcache_read(void *data, CORE_ADDR addr, gdb_byte *buf, int len) {
+	RIOKdp *k = data;
+	return kdp_transfer_memory (&k->c, addr, buf, len, 0);
+}
 
-	free (RIOKDP_BUF (fd));
-	RIOKDP_BUF (fd) = new_buf;
-	RIOKDP_SZ (fd) = count;
+static bool kdp_run_control(RIOKdp *k, kdp_req_t req) {
+	kdp_return_t ret;
+	k->c.request->hdr.request = req;
+	if (req == KDP_RESUMECPUS) {
+		k->c.request->resumecpus_req.cpu_mask = ~0;
+	}
+	ret = kdp_transaction (&k->c, k->c.request, k->c.response, "io_kdp");
+	/* memory is stale as soon as the kernel runs again */
+	dcache_invalidate (k->dcache);
+	if (ret != RR_SUCCESS) {
+		eprintf ("kdp: %s\n", kdp_return_string (ret));
+		return false;
+	}
+	return true;
+}
 
-	return count;
+static int __write(RIO *io, RIODesc *fd, const ut8 *buf, int count) {
+	RIOKdp *k;
+	int n;
+	if (!fd || !fd->data || !buf || count < 1) {
+		return -1;
+	}
+	k = RIOKDP (fd);
+	n = kdp_transfer_memory (&k->c, io->off, (ut8*)buf, count, 1);
+	if (n > 0) {
+		dcache_update (k->dcache, 1, io->off, buf, n);
+	}
+	if (n < count) {
+		dcache_update (k->dcache, 0, io->off + n, buf + n, count - n);
+	}
+	return n > 0? n: -1;
 }
 
 static int __read(RIO *io, RIODesc *fd, ut8 *buf, int count) {
-	memset (buf, 0xff, count);
-	if (fd == NULL || fd->data == NULL)
-		return -1;
-	if (RIOKDP_OFF (fd) > RIOKDP_SZ (fd))
+	RIOKdp *k;
+	ut64 addr;
+	int done = 0;
+	if (!io || !fd || !fd->data || !buf || count < 1) {
 		return -1;
-	if (RIOKDP_OFF (fd) + count >= RIOKDP_SZ (fd))
-		count = RIOKDP_SZ (fd) - RIOKDP_OFF (fd);
-	memcpy (buf, RIOKDP_BUF (fd) + RIOKDP_OFF (fd), count);
+	}
+	memset (buf, 0xff, count);
+	k = RIOKDP (fd);
+	addr = io->off;
+	if (!k->cached) {
+		done = kdp_transfer_memory (&k->c, addr, buf, count, 0);
+		if (done < count) {
+			/* unreadable; whatever the failed packets left becomes 0xff */
+			done = R_MAX (done, 0);
+			memset (buf + done, 0xff, count - done);
+		}
+		return count;
+	}
+	while (done < count) {
+		ULONGEST got = 0;
+		if (!dcache_read_memory_partial (k->dcache, addr + done,
+				buf + done, count - done, &got)) {
+			/* unmapped; leave 0xff up to the next page and go on */
+			done += 0x1000 - ((addr + done) & 0xfff);
+			continue;
+		}
+		done += got;
+	}
 	return count;
 }
 
 static int __close(RIODesc *fd) {
-	RIOKdp *riom;
-	if (fd == NULL || fd->data == NULL)
+	RIOKdp *k;
+	if (!fd || !fd->data) {
 		return -1;
-	riom = fd->data;
-	free (riom->buf);
-	riom->buf = NULL;
-	free (fd->data);
+	}
+	k = RIOKDP (fd);
+	if (kdp_is_connected (&k->c)) {
+		kdp_disconnect (&k->c);
+	}
+	if (kdp_is_bound (&k->c)) {
+		kdp_destroy (&k->c);
+	}
+	dcache_free (k->dcache);
+	free (k);
 	fd->data = NULL;
-	fd->state = R_IO_DESC_TYPE_CLOSED;
 	return 0;
 }
 
-static ut64 __lseek(RIO* io, RIODesc *fd, ut64 offset, int whence) {
-	ut64 r_offset = offset;
-	if (!fd || !fd->data)
-		return offset;
+static ut64 __lseek(RIO *io, RIODesc *fd, ut64 offset, int whence) {
 	switch (whence) {
-	case SEEK_SET:
-		r_offset = (offset <= RIOKDP_SZ (fd)) ? offset : RIOKDP_SZ (fd);
-		break;
-	case SEEK_CUR:
-		r_offset = (RIOKDP_OFF (fd) + offset <= RIOKDP_SZ (fd)) ? RIOKDP_OFF (fd) + offset : RIOKDP_SZ (fd);
+	case R_IO_SEEK_SET:
+		io->off = offset;
 		break;
-	case SEEK_END:
-		r_offset = RIOKDP_SZ (fd);
+	case R_IO_SEEK_CUR:
+		io->off += offset;
 		break;
+	case R_IO_SEEK_END:
+		io->off = UT64_MAX;
 	}
-	RIOKDP_OFF (fd) = r_offset;
-	return RIOKDP_OFF (fd);
+	return io->off;
 }
 
-static int __plugin_open(struct r_io_t *io, const char *pathname, ut8 many) {
+static bool __plugin_open(RIO *io, const char *pathname, bool many) {
 	return (!strncmp (pathname, "kdp://", 6));
 }
 
 static RIODesc *__open(RIO *io, const char *pathname, int rw, int mode) {
-	if (__plugin_open (io, pathname, 0)) {
-		const char *hostport = pathname + 6;
-		RIOKdp *mal = R_NEW (RIOKdp);
-		mal->fd = -2; /* causes r_io_desc_new() to set the correct fd */
-		eprintf ("HOST:PORT = %s", hostport);
-		//mal->sock = r_socket_new();
-		mal->size = strlen (pathname);
-		mal->buf = malloc (mal->size+1);
-		mal->offset = 0;
-		memset (mal->buf, 0, mal->size);
-		mal->size = r_hex_str2bin (hostport, mal->buf);
-		if ((int)mal->size<1) {
-			free (mal->buf);
-			mal->buf = NULL;
+	kdp_return_t ret;
+	RIOKdp *k;
+	char *host, *port;
+	int i_port = KDP_DEFAULT_PORT;
+
+	if (!__plugin_open (io, pathname, 0)) {
+		return NULL;
+	}
+	host = strdup (pathname + 6);
+	if (!host) {
+		return NULL;
+	}
+	port = strchr (host, ':');
+	if (port) {
+		*port++ = 0;
+		i_port = atoi (port);
+	}
+	if (!(k = R_NEW0 (RIOKdp))) {
+		free (host);
+		return NULL;
+	}
+	ret = kdp_create (&k->c, kdp_logger, host, i_port, KDP_TIMEOUT, KDP_RETRIES);
+	if (ret == RR_SUCCESS) {
+		kdp_set_little_endian (&k->c);
+		ret = kdp_connect (&k->c);
+	}
+	if (ret != RR_SUCCESS) {
+		eprintf ("Cannot connect to %s:%d: %s\n", host, i_port, kdp_return_string (ret));
+		if (kdp_is_bound (&k->c)) {
+			kdp_destroy (&k->c);
 		}
-		if (mal->buf != NULL) {
-			RETURN_IO_DESC_NEW (&r_io_plugin_kdp,
-				mal->fd, pathname, rw, mode,mal);
+		free (host);
+		free (k);
+		return NULL;
+	}
+	free (host);
+	k->dcache = dcache_init (kdp_dcache_read, k);
+	k->cached = true;
+	return r_io_desc_new (io, &r_io_plugin_kdp, pathname, rw, mode, k);
+}
+
+static char *__system(RIO *io, RIODesc *fd, const char *cmd) {
+	RIOKdp *k;
+	if (!fd || !fd->data) {
+		return NULL;
+	}
+	k = RIOKDP (fd);
+	if (!strcmp (cmd, "?") || !strcmp (cmd, "help")) {
+		eprintf ("Usage: =!cmd args\n"
+			" =!dcache             show cache state\n"
+			" =!dcache line [n]    set line size (power of 2)\n"
+			" =!dcache size [n]    set number of lines\n"
+			" =!dcache on|off      enable or bypass the cache\n"
+			" =!dcache flush       drop cached memory\n"
+			" =!window [n]         max READMEM requests in flight (1 = no pipelining)\n"
+			" =!suspend            stop the target\n"
+			" =!resume             resume the target (flushes the cache)\n"
+			" =!verbose            toggle protocol logging\n");
+	} else if (!strcmp (cmd, "dcache")) {
+		dcache_info (k->dcache, stdout);
+		printf ("Caching is %s.\n", k->cached? "on": "off");
+	} else if (!strncmp (cmd, "dcache line ", 12)) {
+		if (!dcache_set_line_size (k->dcache, atoi (cmd + 12))) {
+			eprintf ("Invalid line size (must be a power of 2 up to %d)\n",
+				DCACHE_MAX_LINE_SIZE);
+		}
+	} else if (!strncmp (cmd, "dcache size ", 12)) {
+		if (!dcache_set_size (k->dcache, atoi (cmd + 12))) {
+			eprintf ("Invalid number of lines\n");
+		}
+	} else if (!strcmp (cmd, "dcache on")) {
+		k->cached = true;
+	} else if (!strcmp (cmd, "dcache off")) {
+		k->cached = false;
+		dcache_invalidate (k->dcache);
+	} else if (!strcmp (cmd, "dcache flush")) {
+		dcache_invalidate (k->dcache);
+	} else if (!strncmp (cmd, "window", 6)) {
+		if (cmd[6] == ' ') {
+			kdp_set_window (&k->c, atoi (cmd + 7));
 		}
-		eprintf ("Cannot connect to %s\n", hostport);
-		free (mal);
+		printf ("%u (current %u, %lu sent, %lu resent)\n", k->c.max_window,
+			k->c.window, k->c.sent, k->c.resent);
+	} else if (!strcmp (cmd, "suspend")) {
+		kdp_run_control (k, KDP_SUSPEND);
+	} else if (!strcmp (cmd, "resume") || !strcmp (cmd, "continue")) {
+		kdp_run_control (k, KDP_RESUMECPUS);
+	} else if (!strcmp (cmd, "verbose")) {
+		kdp_verbose = !kdp_verbose;
+	} else {
+		eprintf ("Unknown command. See =!?\n");
 	}
 	return NULL;
 }
 
-struct r_io_plugin_t r_io_plugin_kdp = {
+RIOPlugin r_io_plugin_kdp = {
 	.name = "kdp",
-	.desc = "XNU's Kernel Debugger Protocol",
+	.desc = "XNU's Kernel Debugger Protocol (kdp://host[:port])",
 	.license = "GPL2", // because of GDB sauces
 	.open = __open,
 	.close = __close,
 	.read = __read,
-	.plugin_open = __plugin_open,
-	.lseek = __lseek,
 	.write = __write,
-	.resize = __resize,
+	.check = __plugin_open,
+	.lseek = __lseek,
+	.system = __system,
 };
 
 #ifndef CORELIB
-struct r_lib_struct_t radare_plugin = {
+RLibStruct radare_plugin = {
 	.type = R_LIB_TYPE_IO,
 	.data = &r_io_plugin_kdp,
 	.version = R2_VERSION
@@ -0,0 +1,95 @@
+/* radare - LGPL3 - 2018 */
+
+/* swfz://file.swf shows a CWS (zlib) or ZWS (lzma) Flash file as the FWS
+ * file it decompresses to, so the tags the swf bin plugin lists are there
+ * to disassemble, see swfz.c.
+ * Uncompressed files are shown as they are. */
+
+#include "r_io.h"
+#include "r_lib.h"
+#include "swfz.h"
+
+RIOPlugin r_io_plugin_swfz;
+
+#define RIOSWFZ(x) ((RBuffer*)x->data)
+
+static int __read(RIO *io, RIODesc *fd, ut8 *buf, int count) {
+	if (!fd || !fd->data || !buf || count < 1) {
+		return -1;
+	}
+	memset (buf, 0xff, count);
+	r_buf_read_at (RIOSWFZ (fd), io->off, buf, count);
+	return count;
+}
+
+static int __write(RIO *io, RIODesc *fd, const ut8 *buf, int count) {
+	return -1;
+}
+
+static int __close(RIODesc *fd) {
+	if (!fd || !fd->data) {
+		return -1;
+	}
+	r_buf_free (RIOSWFZ (fd));
+	fd->data = NULL;
+	return 0;
+}
+
+static ut64 __lseek(RIO *io, RIODesc *fd, ut64 offset, int whence) {
+	switch (whence) {
+	case R_IO_SEEK_SET:
+		io->off = offset;
+		break;
+	case R_IO_SEEK_CUR:
+		io->off += offset;
+		break;
+	case R_IO_SEEK_END:
+		io->off = r_buf_size (RIOSWFZ (fd)) + offset;
+		break;
+	}
+	return io->off;
+}
+
+static bool __plugin_open(RIO *io, const char *pathname, bool many) {
+	return (!strncmp (pathname, "swfz://", 7));
+}
+
+static RIODesc *__open(RIO *io, const char *pathname, int rw, int mode) {
+	RBuffer *file, *view;
+	if (!__plugin_open (io, pathname, 0)) {
+		return NULL;
+	}
+	file = r_buf_new_slurp (pathname + 7);
+	if (!file) {
+		eprintf ("Cannot open %s\n", pathname + 7);
+		return NULL;
+	}
+	// the view keeps its own reference to the file
+	view = r_bin_swf_decompress (file);
+	if (view) {
+		r_buf_free (file);
+	} else {
+		view = file;
+	}
+	return r_io_desc_new (io, &r_io_plugin_swfz, pathname, R_PERM_R, mode, view);
+}
+
+RIOPlugin r_io_plugin_swfz = {
+	.name = "swfz",
+	.desc = "Decompressed view of CWS and ZWS Flash files (swfz://file)",
+	.license = "LGPL3",
+	.open = __open,
+	.close = __close,
+	.read = __read,
+	.write = __write,
+	.check = __plugin_open,
+	.lseek = __lseek,
+};
+
+#ifndef CORELIB
+RLibStruct radare_plugin = {
+	.type = R_LIB_TYPE_IO,
+	.data = &r_io_plugin_swfz,
+	.version = R2_VERSION
+};
+#endif
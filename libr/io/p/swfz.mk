@@ -0,0 +1,20 @@
+OBJ_SWFZ=io_swfz.o
+OBJ_SWFZ+=../../bin/format/swf/swfz.o
+
+STATIC_OBJ+=${OBJ_SWFZ}
+TARGET_SWFZ=io_swfz.${LIBEXT}
+ALL_TARGETS+=${TARGET_SWFZ}
+
+CFLAGS+=-I../../bin/format/swf
+
+ifeq (${WITHPIC},0)
+LINKFLAGS+=../../util/libr_util.a
+LINKFLAGS+=../../io/libr_io.a
+else
+LINKFLAGS+=-L../../util -lr_util
+LINKFLAGS+=-L.. -lr_io
+endif
+
+${TARGET_SWFZ}: ${OBJ_SWFZ}
+	${CC_LIB} $(call libname,io_swfz) ${CFLAGS} -o ${TARGET_SWFZ} \
+		${LDFLAGS} ${OBJ_SWFZ} ${LINKFLAGS} -lz -llzma
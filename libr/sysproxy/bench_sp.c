@@ -0,0 +1,145 @@
+/* remote file read benchmark, run test_srv_batch on the other side */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "sp.h"
+
+#define RPC_HOST "127.0.0.1"
+#define RPC_PORT 8181
+
+/* the most a single call packet fits */
+#define SINGLE_CHUNK	1024
+#define BATCH_CHUNK	65536
+#define BATCH_READS	32
+
+extern void rpc_init(char *host, int port);
+extern int rpc_batch_flush(void);
+extern int sys_open(char *f, int flags, int mode);
+extern int sys_read(int fd, char *b, int len);
+extern int sys_read_batch(int fd, char *b, int len, int *ret);
+extern int sys_close(int d);
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static unsigned int hash(unsigned int h, char *b, int len)
+{
+	while(len--)
+		h = (h ^ (unsigned char)*b++) * 16777619;
+	return h;
+}
+
+static void report(char *name, int bytes, int calls, double t,
+		 unsigned int h)
+{
+	printf("%-10s %10i bytes %8i calls %8.3fs %8.2f MB/s  hash %08x\n",
+		name, bytes, calls, t, t > 0? bytes / t / (1024 * 1024): 0.0, h);
+}
+
+static int bench_single(char *file)
+{
+	char		buf[SINGLE_CHUNK];
+	unsigned int	h = 2166136261u;
+	int		fd, n, total = 0, calls = 0;
+	double		t;
+
+	fd = sys_open(file, O_RDONLY, 0);
+	if(fd < 0) {
+		fprintf(stderr, "open: %s\n", strerror(-fd));
+		return -1;
+	}
+
+	t = now();
+	do {
+		n = sys_read(fd, buf, sizeof(buf));
+		calls++;
+		if(n > 0) {
+			h = hash(h, buf, n);
+			total += n;
+		}
+	} while(n == sizeof(buf));
+	t = now() - t;
+
+	sys_close(fd);
+	report("per call", total, calls, t, h);
+
+	return n < 0? -1: 0;
+}
+
+static int bench_batch(char *file)
+{
+	char		*buf;
+	int		rets[BATCH_READS];
+	unsigned int	h = 2166136261u;
+	int		fd, i, total = 0, calls = 0, done = 0;
+	double		t;
+
+	buf = malloc(BATCH_READS * BATCH_CHUNK);
+	if(buf == NULL)
+		return -1;
+
+	fd = sys_open(file, O_RDONLY, 0);
+	if(fd < 0) {
+		fprintf(stderr, "open: %s\n", strerror(-fd));
+		free(buf);
+		return -1;
+	}
+
+	t = now();
+	while(!done) {
+		/* reads run in order, so they get consecutive chunks */
+		for(i = 0; i < BATCH_READS; i++) {
+			if(sys_read_batch(fd, buf + i * BATCH_CHUNK,
+			    BATCH_CHUNK, &rets[i]) < 0)
+				goto err;
+		}
+		if(rpc_batch_flush() < 0)
+			goto err;
+
+		calls += BATCH_READS;
+		for(i = 0; i < BATCH_READS && !done; i++) {
+			if(rets[i] > 0) {
+				h = hash(h, buf + i * BATCH_CHUNK, rets[i]);
+				total += rets[i];
+			}
+			done = rets[i] != BATCH_CHUNK;
+		}
+	}
+	t = now() - t;
+
+	sys_close(fd);
+	free(buf);
+	report("batched", total, calls, t, h);
+
+	return 0;
+
+err:
+	perror("batch");
+	free(buf);
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 2) {
+		fprintf(stderr, "Usage: %s file [host [port]]\n", argv[0]);
+		return 1;
+	}
+
+	rpc_init(argc > 2? argv[2]: RPC_HOST,
+		argc > 3? atoi(argv[3]): RPC_PORT);
+
+	if(bench_single(argv[1]) < 0 || bench_batch(argv[1]) < 0)
+		return 1;
+
+	return 0;
+}
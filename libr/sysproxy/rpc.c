@@ -5,6 +5,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <errno.h>
 #include "sp.h"
@@ -15,7 +16,34 @@
 
 static int		rpc_con;
 static char		rpc_data[MAX_PACKET];
-static char		*remote_buf; 
+static char		*remote_buf;
+
+/* where the results of a batched call go */
+struct rpc_result {
+	char		*out;
+	int		out_len;
+	int		*ret;
+};
+
+#define RPC_RESULTS	(SP_BATCH_CALLS * (SP_PIPELINE_DEPTH + 1))
+
+/* frame being queued */
+static char		batch_frame[sizeof(struct sp_batch) + SP_BATCH_SIZE];
+static int		batch_len;	/* bytes queued after the header */
+static int		batch_size;	/* bytes it takes in the remote buffer */
+static int		batch_reply;	/* bytes of its reply */
+static int		batch_count;
+
+/* results of the queued and in flight calls, oldest first */
+static struct rpc_result	batch_res[RPC_RESULTS];
+static int		res_head, res_tail;
+
+/* frames sent and not yet answered */
+static struct {
+	int		count;
+	int		bytes;
+} flight[SP_PIPELINE_DEPTH];
+static int		flight_head, flight_n, flight_bytes;
 
 void dump(char *buf, int len)
 {
@@ -45,13 +73,206 @@ inline char *rpc_data_at(int off)
 	return rpc_data + sizeof(struct regs) + off;
 }
 
+static int rpc_write_all(char *buf, int len)
+{
+	int		ret;
+
+	while(len > 0) {
+		ret = write(rpc_con, buf, len);
+		if(ret < 0) {
+			if(errno == EINTR)
+				continue;
+			return ret;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static int rpc_read_all(char *buf, int len)
+{
+	int		ret;
+
+	while(len > 0) {
+		ret = read(rpc_con, buf, len);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0) {
+			if(ret == 0)
+				errno = ECONNRESET;
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/* read the reply of the oldest frame in flight */
+static int rpc_batch_recv(void)
+{
+	struct sp_batch		h;
+	struct rpc_result	*res;
+	int			count = flight[flight_head].count;
+	int			i, ret;
+
+	if(rpc_read_all((char *)&h, sizeof(h)) < 0)
+		return -1;
+
+	if(h.magic != SP_BATCH_MAGIC || h.count != count) {
+		errno = EPROTO;
+		return -1;
+	}
+
+	for(i = 0; i < count; i++) {
+		res = &batch_res[res_head];
+		if(rpc_read_all((char *)&ret, sizeof(ret)) < 0 ||
+		   rpc_read_all(res->out, res->out_len) < 0)
+			return -1;
+		if(res->ret)
+			*res->ret = ret;
+		res_head = (res_head + 1) % RPC_RESULTS;
+	}
+
+	flight_bytes -= flight[flight_head].bytes;
+	flight_head = (flight_head + 1) % SP_PIPELINE_DEPTH;
+	flight_n--;
+
+	return count;
+}
+
+/* send the queued frame without waiting for its reply */
+static int rpc_batch_send(void)
+{
+	struct sp_batch		*h = (struct sp_batch *)batch_frame;
+	int			slot;
+
+	if(batch_count == 0)
+		return 0;
+
+	/* the listener blocks writing a reply nobody reads while we
+	   block writing the next frame, unless the replies in flight
+	   fit in the socket buffers */
+	while(flight_n == SP_PIPELINE_DEPTH || (flight_n &&
+	      flight_bytes + batch_reply > SP_PIPELINE_BYTES)) {
+		if(rpc_batch_recv() < 0)
+			return -1;
+	}
+
+	h->magic = SP_BATCH_MAGIC;
+	h->count = batch_count;
+	h->len = batch_len;
+
+	if(rpc_write_all(batch_frame, sizeof(*h) + batch_len) < 0)
+		return -1;
+
+	slot = (flight_head + flight_n) % SP_PIPELINE_DEPTH;
+	flight[slot].count = batch_count;
+	flight[slot].bytes = batch_reply;
+	flight_bytes += batch_reply;
+	flight_n++;
+
+	batch_len = batch_size = batch_reply = batch_count = 0;
+
+	return 0;
+}
+
+/* remote address of offset `off` from the registers of the call about
+   to be queued, like rpc_reloc() for rpc_syscall() */
+unsigned long rpc_batch_reloc(int off)
+{
+	return (unsigned long)(remote_buf + batch_size +
+		offsetof(struct sp_call, r) + off);
+}
+
+/* make room for a call with `in` argument and `out` result bytes in the
+   queued frame, sending it when full. Call it before relocating the
+   arguments of the call with rpc_batch_reloc() */
+int rpc_batch_reserve(int in, int out)
+{
+	if(in < 0 || out < 0 || SP_CALL_SIZE(in, out) > SP_BATCH_SIZE) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if(batch_count == SP_BATCH_CALLS ||
+	   batch_size + SP_CALL_SIZE(in, out) > SP_BATCH_SIZE)
+		return rpc_batch_send();
+
+	return 0;
+}
+
+/* queue a call. Its eax is stored in *ret and its `out_len` result bytes
+   in `out` once the frame is answered, at the latest on rpc_batch_flush() */
+int rpc_batch_add(struct regs *rg, struct arg **args, int n_args,
+		 char *out, int out_len, int *ret)
+{
+	struct sp_call		*c;
+	char			*p;
+	int			i, in = 0;
+
+	for(i = 0; i < n_args; i++)
+		in += args[i]->len;
+
+	/* rpc_batch_reserve() wasn't called, the relocations are wrong */
+	if(batch_count == SP_BATCH_CALLS ||
+	   batch_size + SP_CALL_SIZE(in, out_len) > SP_BATCH_SIZE) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	c = (struct sp_call *)(batch_frame + sizeof(struct sp_batch) +
+		batch_len);
+	c->in = in;
+	c->out = out_len;
+	memcpy(&c->r, rg, sizeof(*rg));
+
+	p = (char *)(c + 1);
+	for(i = 0; i < n_args; p += args[i]->len, i++)
+		memcpy(p, args[i]->buf, args[i]->len);
+	memset(p, 0, SP_ALIGN(in) - in);
+
+	batch_res[res_tail].out = out;
+	batch_res[res_tail].out_len = out_len;
+	batch_res[res_tail].ret = ret;
+	res_tail = (res_tail + 1) % RPC_RESULTS;
+
+	batch_len += sizeof(*c) + SP_ALIGN(in);
+	batch_size += SP_CALL_SIZE(in, out_len);
+	batch_reply += sizeof(int) + out_len;
+	batch_count++;
+
+	return 0;
+}
+
+/* send the queued calls and wait for every result */
+int rpc_batch_flush(void)
+{
+	if(rpc_batch_send() < 0)
+		return -1;
+
+	while(flight_n) {
+		if(rpc_batch_recv() < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
 int rpc_syscall(struct regs *rg,
 		 struct arg **args, int n_args)
 {
 	char		*p;
 	int		i;
 	int		ret;
-	
+
+	/* keep the order with the batched calls */
+	if(rpc_batch_flush() < 0)
+		return -1;
+
 	/* copy arguments */
 	p  = (char *)(rpc_data + sizeof(*rg));
 
@@ -81,8 +302,8 @@ int rpc_syscall(struct regs *rg,
 	if(ret < 0)
 		return ret;
 
-	/* wait for response ... */
-	ret = read(rpc_con, rpc_data, MAX_PACKET);
+	/* wait for response, the listener always sends a whole packet */
+	ret = rpc_read_all(rpc_data, MAX_PACKET);
 	if(ret < 0)
 		return ret;
 
@@ -19,4 +19,40 @@ struct arg {
 	int len;
 };
 
+/*
+ * Batch frames: a struct sp_batch followed by `count` calls, each one a
+ * struct sp_call and its SP_ALIGN(in) argument bytes. The listener lays
+ * every call out in its buffer as SP_CALL_SIZE(in, out) bytes (header,
+ * arguments, then room for `out` result bytes), runs them in order and
+ * replies with a struct sp_batch followed by the eax and the `out` result
+ * bytes of each call.
+ *
+ * Batch capable listeners keep a SP_BATCH_SIZE buffer and tell a batch
+ * from a single call packet by the magic in place of edi.
+ */
+#define SP_BATCH_MAGIC		0x31425053	/* "SPB1" */
+#define SP_BATCH_SIZE		(1024 * 1024)
+#define SP_BATCH_CALLS		256
+
+/* frames sent before waiting for the first reply, and the reply bytes
+   they may add up to so the replies always fit in the socket buffers */
+#define SP_PIPELINE_DEPTH	8
+#define SP_PIPELINE_BYTES	65536
+
+#define SP_ALIGN(x)		(((x) + 3) & ~3)
+#define SP_CALL_SIZE(in, out)	(sizeof(struct sp_call) + SP_ALIGN(in) + \
+				 SP_ALIGN(out))
+
+struct sp_batch {
+	unsigned int	magic;
+	unsigned int	count;
+	unsigned int	len;	/* bytes following the header */
+};
+
+struct sp_call {
+	unsigned int	in;	/* argument bytes after the registers */
+	unsigned int	out;	/* result bytes sent back */
+	struct regs	r;
+};
+
 #endif
@@ -11,6 +11,10 @@ extern unsigned long rpc_reloc(int off);
 extern char *rpc_data_at(int off);
 extern int rpc_syscall(struct regs *rg,
 		 struct arg **args, int n_args);
+extern unsigned long rpc_batch_reloc(int off);
+extern int rpc_batch_reserve(int in, int out);
+extern int rpc_batch_add(struct regs *rg, struct arg **args, int n_args,
+		 char *out, int out_len, int *ret);
 
 int sys_write(int fd, char *buf, int len)
 {
@@ -78,6 +82,24 @@ int sys_read(int fd, char *b, int len)
 	return ret;
 }
 
+/* queue a read, the data lands in `b` and the result in *ret once the
+   batch is answered (see rpc_batch_flush()) */
+int sys_read_batch(int fd, char *b, int len, int *ret)
+{
+	struct regs	r;
+
+	if(rpc_batch_reserve(0, len) < 0)
+		return -1;
+
+	memset(&r, 0, sizeof(r));
+	r.eax = 3;
+	r.ebx = fd;
+	r.ecx = rpc_batch_reloc(sizeof(r));
+	r.edx = len;
+
+	return rpc_batch_add(&r, NULL, 0, b, len, ret);
+}
+
 int sys_lseek(int af, int f, int proto)
 {
 	struct regs	r;
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "sp.h"
+
+#define SRV_PORT 8181
+
+/* listener speaking both the single call packets of syscall.S and the
+   batch frames of sp.h, running the calls with syscall(2) */
+
+static char	*buf;		/* the remote buffer the client relocates to */
+static char	*frame;		/* incoming frame and outgoing reply */
+
+static int read_all(int fd, char *b, int len)
+{
+	int ret;
+
+	while(len > 0) {
+		ret = read(fd, b, len);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return -1;
+		b += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+static int write_all(int fd, char *b, int len)
+{
+	int ret;
+
+	while(len > 0) {
+		ret = write(fd, b, len);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return -1;
+		b += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/* the clients (syscall.S, syscall-linux.c) always speak the i386 syscall
+   numbers, other linux hosts get them translated to their own */
+#if defined(__i386__)
+
+static long native_call(struct regs *r)
+{
+	return syscall(r->eax, r->ebx, r->ecx, r->edx, r->esi, r->edi, r->ebp);
+}
+
+#else
+
+#define I386_READ	3
+#define I386_WRITE	4
+#define I386_OPEN	5
+#define I386_CLOSE	6
+#define I386_EXECVE	11
+#define I386_LSEEK	19
+#define I386_DUP2	63
+#define I386_SOCKETCALL	102
+
+#define MAX_EXEC_ARGS	64
+
+/* addresses are relocated into buf, which is mapped in the low 4GB */
+#define PTR(x)		((void *)(unsigned long)(x))
+
+/* execve takes arrays of 32 bit pointers, widen them */
+static char **widen(unsigned int *a, char **w)
+{
+	int i;
+
+	if(a == NULL)
+		return NULL;
+	for(i = 0; i < MAX_EXEC_ARGS - 1 && a[i]; i++)
+		w[i] = PTR(a[i]);
+	w[i] = NULL;
+	return w;
+}
+
+/* socketcall(2) does not exist outside i386, its arguments are an array
+   of 32 bit words */
+static long socketcall(unsigned int call, unsigned int *a)
+{
+	switch(call) {
+	case 1:		/* SYS_SOCKET */
+		return syscall(__NR_socket, a[0], a[1], a[2]);
+	case 2:		/* SYS_BIND */
+		return syscall(__NR_bind, a[0], PTR(a[1]), a[2]);
+	case 4:		/* SYS_LISTEN */
+		return syscall(__NR_listen, a[0], a[1]);
+	case 5:		/* SYS_ACCEPT */
+		return syscall(__NR_accept, a[0], PTR(a[1]), PTR(a[2]));
+	case 14:	/* SYS_SETSOCKOPT */
+		return syscall(__NR_setsockopt, a[0], a[1], a[2], PTR(a[3]),
+			a[4]);
+	}
+	errno = ENOSYS;
+	return -1;
+}
+
+static long native_call(struct regs *r)
+{
+	char	*argv[MAX_EXEC_ARGS], *envp[MAX_EXEC_ARGS];
+
+	switch(r->eax) {
+	case I386_READ:
+		return syscall(__NR_read, r->ebx, PTR(r->ecx), r->edx);
+	case I386_WRITE:
+		return syscall(__NR_write, r->ebx, PTR(r->ecx), r->edx);
+	case I386_OPEN:
+		return syscall(__NR_openat, AT_FDCWD, PTR(r->ebx), r->ecx,
+			r->edx);
+	case I386_CLOSE:
+		return syscall(__NR_close, r->ebx);
+	case I386_EXECVE:
+		return syscall(__NR_execve, PTR(r->ebx),
+			widen(PTR(r->ecx), argv), widen(PTR(r->edx), envp));
+	case I386_LSEEK:
+		/* off_t is signed, the register is not */
+		return syscall(__NR_lseek, r->ebx, (long)(int)r->ecx, r->edx);
+	case I386_DUP2:
+		/* dup3 refuses equal descriptors, dup2 checks the fd */
+		if(r->ebx == r->ecx)
+			return fcntl(r->ebx, F_GETFD) == -1? -1: (long)r->ebx;
+		return syscall(__NR_dup3, r->ebx, r->ecx, 0);
+	case I386_SOCKETCALL:
+		return socketcall(r->ebx, PTR(r->ecx));
+	}
+	fprintf(stderr, "unsupported i386 syscall %u\n", r->eax);
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif
+
+static unsigned int exec_call(struct regs *r)
+{
+	long ret;
+
+	ret = native_call(r);
+	/* like int $0x80 does */
+	return ret == -1? -errno: ret;
+}
+
+/* a syscall.S packet, `first` being its first word */
+static int process_single(int con, unsigned int first)
+{
+	struct regs *r = (struct regs *)buf;
+	int n;
+
+	memcpy(buf, &first, sizeof(first));
+	n = read(con, buf + sizeof(first), MAX_PACKET - sizeof(first));
+	if(n < (int)(sizeof(*r) - sizeof(first)))
+		return -1;
+
+	r->eax = exec_call(r);
+
+	return write_all(con, buf, MAX_PACKET);
+}
+
+static int process_batch(int con)
+{
+	struct sp_batch	h;
+	struct sp_call	*c;
+	char		*p, *end;
+	unsigned int	i, off, in;
+
+	h.magic = SP_BATCH_MAGIC;
+	if(read_all(con, (char *)&h.count, sizeof(h) - sizeof(h.magic)) < 0)
+		return -1;
+
+	if(h.count > SP_BATCH_CALLS || h.len > SP_BATCH_SIZE) {
+		fprintf(stderr, "bad frame: %u calls, %u bytes\n", h.count, h.len);
+		return -1;
+	}
+
+	if(read_all(con, frame, h.len) < 0)
+		return -1;
+
+	/* lay the calls out where the client relocated them */
+	p = frame;
+	end = frame + h.len;
+	for(i = 0, off = 0; i < h.count; i++) {
+		c = (struct sp_call *)p;
+		if(end - p < (int)sizeof(*c) || c->in > SP_BATCH_SIZE ||
+		   c->out > SP_BATCH_SIZE)
+			goto bad;
+		in = sizeof(*c) + SP_ALIGN(c->in);
+		if(in > end - p || off + SP_CALL_SIZE(c->in, c->out) >
+		   SP_BATCH_SIZE)
+			goto bad;
+		memcpy(buf + off, p, in);
+		p += in;
+		off += SP_CALL_SIZE(c->in, c->out);
+	}
+
+	/* run them in order, the eax goes back in place as in syscall.S */
+	for(i = 0, off = 0; i < h.count; i++) {
+		c = (struct sp_call *)(buf + off);
+		c->r.eax = exec_call(&c->r);
+		off += SP_CALL_SIZE(c->in, c->out);
+	}
+
+	/* reply with the eax and result bytes of every call */
+	memcpy(frame, &h, sizeof(h));
+	p = frame + sizeof(h);
+	for(i = 0, off = 0; i < h.count; i++) {
+		c = (struct sp_call *)(buf + off);
+		memcpy(p, &c->r.eax, sizeof(c->r.eax));
+		p += sizeof(c->r.eax);
+		memcpy(p, (char *)(c + 1) + SP_ALIGN(c->in), c->out);
+		p += c->out;
+		off += SP_CALL_SIZE(c->in, c->out);
+	}
+	((struct sp_batch *)frame)->len = p - frame - sizeof(h);
+
+	return write_all(con, frame, p - frame);
+
+bad:
+	fprintf(stderr, "bad call %u in frame\n", i);
+	return -1;
+}
+
+void process_con(int con)
+{
+	unsigned int	magic;
+	int		flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#ifdef MAP_32BIT
+	/* relocated addresses go in 32 bit registers */
+	flags |= MAP_32BIT;
+#endif
+	buf = mmap(NULL, SP_BATCH_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+	frame = malloc(sizeof(struct sp_batch) + SP_BATCH_SIZE +
+		SP_BATCH_CALLS * sizeof(unsigned int));
+	if(buf == MAP_FAILED || frame == NULL) {
+		perror("alloc");
+		exit(1);
+	}
+
+	/* write buffer address */
+	if(write_all(con, (char *)&buf, sizeof(buf)) < 0)
+		exit(1);
+
+	while(read_all(con, (char *)&magic, sizeof(magic)) == 0) {
+		if(magic == SP_BATCH_MAGIC) {
+			if(process_batch(con) < 0)
+				break;
+		} else if(process_single(con, magic) < 0)
+			break;
+	}
+
+	exit(0);
+}
+
+void init_srv_sp()
+{
+	struct sockaddr_in	in;
+	socklen_t		len;
+	int			srv;
+	int			con;
+	int			opt;
+
+	memset(&in, 0, sizeof(in));
+	in.sin_port = htons(SRV_PORT);
+	in.sin_family = AF_INET;
+
+	srv = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(srv < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	opt = 1;
+	if(setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+		perror("setsockopt");
+		exit(1);
+	}
+
+	if(bind(srv, (struct sockaddr *)&in, sizeof(in)) < 0) {
+		perror("bind");
+		exit(1);
+	}
+
+	listen(srv, 5);
+	len = sizeof(in);
+	while((con = accept(srv, (struct sockaddr *)&in,
+			&len)) > 0) {
+		int pid;
+
+		pid = fork();
+		if(pid == 0) {
+			close(srv);
+			printf("con: %i\n", con);
+			process_con(con);
+		} else {
+			close(con);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	printf("Waiting for rpc connections on port %d\n", SRV_PORT);
+	init_srv_sp();
+	return 0;
+}
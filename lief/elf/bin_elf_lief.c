@@ -8,13 +8,33 @@
 #include <inttypes.h>
 #include <LIEF/ELF.h>
 
+#include "../lief_parse.h"
+
+static void symbol_free(void *p) {
+	RBinSymbol *sym = p;
+	if (sym) {
+		free (sym->name);
+		free (sym);
+	}
+}
+
+static void import_free(void *p) {
+	RBinImport *imp = p;
+	if (imp) {
+		free (imp->name);
+		free (imp->type);
+		free (imp->bind);
+		free (imp);
+	}
+}
+
+/* the parsed binary is kept as bin_obj, the lists are built from it on
+ * every call because RBin owns and rebases the items it gets */
 static void * load_bytes(RBinFile *arch, const ut8 *buf, ut64 sz, ut64 loadaddr, Sdb *sdb) {
 	if (!buf || !sz || sz == UT64_MAX) {
 		return NULL;
 	}
-	// in case of fail, LIEF throws a c++ exception, so everybody dies
-	// LIEF doesnt supports parsing binaries from buffers wtf
-	return elf_parse (arch->file);
+	return lief_parse_bytes (buf, sz, (LiefParse)elf_parse);
 }
 
 static bool load(RBinFile *arch) {
@@ -27,9 +47,76 @@ static bool load(RBinFile *arch) {
 	return arch->o->bin_obj != NULL;
 }
 
+static int destroy(RBinFile *arch) {
+	if (arch->o->bin_obj) {
+		elf_binary_destroy (arch->o->bin_obj);
+		arch->o->bin_obj = NULL;
+	}
+	return true;
+}
+
+/* defined dynamic symbols go to syms, undefined ones to imps */
+static void walk_symbols(Elf_Binary_t *elf, RList *syms, RList *imps) {
+	int i;
+	Elf_Symbol_t** dsym = elf->dynamic_symbols;
+	for (i = 0; dsym[i]; i++) {
+		Elf_Symbol_t* sym = dsym[i];
+		if (!sym->name || !*sym->name) {
+			continue;
+		}
+		if (sym->value) {
+			RBinSymbol *rs;
+			if (!syms || !(rs = R_NEW0 (RBinSymbol))) {
+				continue;
+			}
+			rs->name = strdup (sym->name);
+			rs->paddr = sym->value;
+			rs->vaddr = sym->value;
+			r_list_append (syms, rs);
+		} else {
+			RBinImport *rs;
+			if (!imps || !(rs = R_NEW0 (RBinImport))) {
+				continue;
+			}
+			rs->name = strdup (sym->name);
+			rs->type = strdup ("");
+			rs->bind = strdup ("GLOBAL");
+			r_list_append (imps, rs);
+		}
+	}
+}
+
+/* DT_NEEDED entries go to libs, the last DT_RUNPATH is returned */
+static const char *walk_dynamic(Elf_Binary_t *elf, RList *libs) {
+	int i;
+	const char *rpath = NULL;
+	Elf_DynamicEntry_t **dynamic_entries = elf->dynamic_entries;
+	for (i = 0; dynamic_entries[i]; i++) {
+		Elf_DynamicEntry_t* entry = dynamic_entries[i];
+		switch (entry->tag) {
+		case DT_NEEDED:
+			if (libs) {
+				Elf_DynamicEntry_Library_t* e = (Elf_DynamicEntry_Library_t*)entry;
+				r_list_append (libs, strdup (e->name));
+			}
+			break;
+		case DT_RUNPATH:
+			{
+				Elf_DynamicEntry_RunPath_t* e = (Elf_DynamicEntry_RunPath_t*)entry;
+				rpath = e->runpath;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return rpath;
+}
+
 static RBinInfo* info(RBinFile *arch) {
 	Elf_Binary_t *elf = arch->o->bin_obj;
 	RBinInfo *ret = NULL;
+	const char *rpath;
 	char *str;
 
 	if (!(ret = R_NEW0 (RBinInfo))) {
@@ -73,20 +160,9 @@ static RBinInfo* info(RBinFile *arch) {
 	ret->has_va = true;
 	// ret->baddr = 0x40000;
 	ret->has_canary = false;
-	int i;
-	Elf_DynamicEntry_t **dynamic_entries = elf->dynamic_entries;
-	for (i = 0; dynamic_entries[i]; i++) {
-		Elf_DynamicEntry_t* entry = dynamic_entries[i];
-		switch (entry->tag) {
-		case DT_RUNPATH:
-			{
-				Elf_DynamicEntry_RunPath_t* e = (Elf_DynamicEntry_RunPath_t*)entry;
-				ret->rpath = strdup (e->runpath);;
-			}
-			break;
-		default:
-			break;
-		}
+	rpath = walk_dynamic (elf, NULL);
+	if (rpath) {
+		ret->rpath = strdup (rpath);
 	}
 	ret->has_lit = true;
 #if 0
@@ -105,39 +181,17 @@ static RBinInfo* info(RBinFile *arch) {
 }
 
 static RList* symbols(RBinFile *arch) {
-	int i;
-	Elf_Binary_t *elf = arch->o->bin_obj;
-	Elf_Symbol_t** dsym = elf->dynamic_symbols;
-	RList *ret = r_list_newf (free);
-	for (i = 0; dsym[i]; i++) {
-		Elf_Symbol_t* sym = dsym[i];
-		if (!sym->name || !*sym->name || !sym->value) {
-			continue;
-		}
-		RBinSymbol *rs = R_NEW0 (RBinSymbol);
-		rs->name = strdup (sym->name);
-		rs->paddr = sym->value;
-		rs->vaddr = sym->value;
-		r_list_append (ret, rs);
+	RList *ret = r_list_newf (symbol_free);
+	if (ret) {
+		walk_symbols (arch->o->bin_obj, ret, NULL);
 	}
 	return ret;
 }
 
 static RList* imports(RBinFile *arch) {
-	int i;
-	Elf_Binary_t *elf = arch->o->bin_obj;
-	Elf_Symbol_t** dsym = elf->dynamic_symbols;
-	RList *ret = r_list_newf (free);
-	for (i = 0; dsym[i]; i++) {
-		Elf_Symbol_t* sym = dsym[i];
-		if (!sym->name || !*sym->name || sym->value) {
-			continue;
-		}
-		RBinImport *rs = R_NEW0 (RBinImport);
-		rs->name = strdup (sym->name);
-		rs->type = strdup ("");
-		rs->bind = strdup ("GLOBAL");
-		r_list_append (ret, rs);
+	RList *ret = r_list_newf (import_free);
+	if (ret) {
+		walk_symbols (arch->o->bin_obj, NULL, ret);
 	}
 	return ret;
 }
@@ -147,11 +201,17 @@ static RList* sections(RBinFile *arch) {
 	RList *ret = r_list_newf (free);
 	int i;
 	Elf_Segment_t** segments = elf->segments;
+	if (!ret) {
+		return NULL;
+	}
 	for (i = 0; segments[i] ; i++) {
 		Elf_Segment_t* seg= segments[i];
 		RBinSection *rs = R_NEW0 (RBinSection);
 		const char *name = SEGMENT_TYPES_to_string (seg->type);
-		strcpy (rs->name, name);
+		if (!rs) {
+			break;
+		}
+		r_str_ncpy (rs->name, name, sizeof (rs->name));
 		if (strstr (rs->name, "data") && !strstr (rs->name, "rel")) {
 			rs->is_data = true;
 		}
@@ -184,20 +244,9 @@ static RList* entries(RBinFile *arch) {
 }
 
 static RList* libs(RBinFile *arch) {
-	int i;
-	Elf_Binary_t *elf = arch->o->bin_obj;
-	Elf_DynamicEntry_t **dynamic_entries = elf->dynamic_entries;
 	RList *ret = r_list_newf (free);
-	for (i = 0; dynamic_entries[i]; i++) {
-		Elf_DynamicEntry_t* entry = dynamic_entries[i];
-		switch (entry->tag) {
-		case DT_NEEDED:
-			{
-				Elf_DynamicEntry_Library_t* e = (Elf_DynamicEntry_Library_t*)entry;
-				r_list_append (ret, strdup (e->name));
-			}
-			break;
-		}
+	if (ret) {
+		walk_dynamic (arch->o->bin_obj, ret);
 	}
 	return ret;
 }
@@ -214,11 +263,11 @@ RBinPlugin r_bin_plugin_elf_lief = {
 	.sections = &sections,
 	.libs = &libs,
 	.entries = &entries,
+	.destroy = &destroy,
 /*
 	TODO
 
 	.get_sdb = &get_sdb,
-	.destroy = &destroy,
 	.check_bytes = &check_bytes,
 	.baddr = &baddr,
 	.boffset = &boffset,
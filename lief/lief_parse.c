@@ -0,0 +1,30 @@
+/* radare - MIT - Copyright 2017 - pancake */
+
+#include <r_types.h>
+#include <r_util.h>
+#include <r_bin.h>
+#include "lief_parse.h"
+
+/* LIEF's C API can only parse binaries from a path, so the bytes r2 loaded
+ * are always dumped to a temporary file first. Reparsing arch->file instead
+ * would miss patched bytes and changes made on disk since the load. */
+void *lief_parse_bytes(const ut8 *buf, ut64 sz, LiefParse parse) {
+	char *tmp = NULL;
+	void *bin;
+	int fd = r_file_mkstemp ("lief", &tmp);
+	if (fd == -1) {
+		return NULL;
+	}
+	if (write (fd, buf, sz) != (ssize_t)sz) {
+		close (fd);
+		r_file_rm (tmp);
+		free (tmp);
+		return NULL;
+	}
+	close (fd);
+	// in case of fail, LIEF throws a c++ exception, so everybody dies
+	bin = parse (tmp);
+	r_file_rm (tmp);
+	free (tmp);
+	return bin;
+}
@@ -0,0 +1,8 @@
+#ifndef LIEF_PARSE_H
+#define LIEF_PARSE_H
+
+typedef void *(*LiefParse)(const char *file);
+
+void *lief_parse_bytes(const ut8 *buf, ut64 sz, LiefParse parse);
+
+#endif
@@ -8,14 +8,29 @@
 #include <inttypes.h>
 #include <LIEF/MACHO.h>
 
+#include "../lief_parse.h"
+
+/* bin_obj is the NULL terminated array of the fat slices, the first one is
+ * the one exposed to r2 */
 static void * load_bytes(RBinFile *arch, const ut8 *buf, ut64 sz, ut64 loadaddr, Sdb *sdb) {
+	Macho_Binary_t **bins;
 	if (!buf || !sz || sz == UT64_MAX) {
 		return NULL;
 	}
-	// in case of fail, LIEF throws a c++ exception, so everybody dies
-eprintf ("JJEJE\n");
-	// LIEF doesnt supports parsing binaries from buffers wtf
-	return macho_parse (arch->file);
+	bins = lief_parse_bytes (buf, sz, (LiefParse)macho_parse);
+	if (bins && !bins[0]) {
+		macho_binaries_destroy (bins);
+		return NULL;
+	}
+	return bins;
+}
+
+static int destroy(RBinFile *arch) {
+	if (arch->o->bin_obj) {
+		macho_binaries_destroy (arch->o->bin_obj);
+		arch->o->bin_obj = NULL;
+	}
+	return true;
 }
 
 static bool load(RBinFile *arch) {
@@ -29,7 +44,8 @@ static bool load(RBinFile *arch) {
 }
 
 static RBinInfo* info(RBinFile *arch) {
-	Macho_Binary_t *mac = arch->o->bin_obj;
+	Macho_Binary_t **bins = arch->o->bin_obj;
+	Macho_Binary_t *mac = bins[0];
 	RBinInfo *ret = NULL;
 	char *str;
 
@@ -197,11 +213,11 @@ RBinPlugin r_bin_plugin_macho_lief = {
 	.sections = &sections,
 	.libs = &libs,
 	.entries = &entries,
+	.destroy = &destroy,
 /*
 	TODO
 
 	.get_sdb = &get_sdb,
-	.destroy = &destroy,
 	.check_bytes = &check_bytes,
 	.baddr = &baddr,
 	.boffset = &boffset,
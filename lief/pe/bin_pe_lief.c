@@ -8,13 +8,21 @@
 #include <inttypes.h>
 #include <LIEF/PE.h>
 
+#include "../lief_parse.h"
+
 static void * load_bytes(RBinFile *arch, const ut8 *buf, ut64 sz, ut64 loadaddr, Sdb *sdb) {
 	if (!buf || !sz || sz == UT64_MAX) {
 		return NULL;
 	}
-	// in case of fail, LIEF throws a c++ exception, so everybody dies
-	// LIEF doesnt supports parsing binaries from buffers wtf
-	return pe_parse (arch->file);
+	return lief_parse_bytes (buf, sz, (LiefParse)pe_parse);
+}
+
+static int destroy(RBinFile *arch) {
+	if (arch->o->bin_obj) {
+		pe_binary_destroy (arch->o->bin_obj);
+		arch->o->bin_obj = NULL;
+	}
+	return true;
 }
 
 static bool load(RBinFile *arch) {
@@ -87,11 +95,11 @@ RBinPlugin r_bin_plugin_pe_lief = {
 	.sections = &sections,
 	// .libs = &libs,
 	.entries = &entries,
+	.destroy = &destroy,
 /*
 	TODO
 
 	.get_sdb = &get_sdb,
-	.destroy = &destroy,
 	.check_bytes = &check_bytes,
 	.baddr = &baddr,
 	.boffset = &boffset,
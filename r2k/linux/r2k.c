@@ -5,6 +5,7 @@
 #include <linux/ioctl.h>
 #include <linux/device.h>
 #include <linux/sched/task.h>
+#include <linux/sched/mm.h>
 #include <linux/cdev.h>
 #include <linux/fs.h>
 #include <linux/page-flags.h>
@@ -27,6 +28,9 @@
 		IOCTL_READ_PHYSICAL_ADDR	(read from physical addr)
 		IOCTL_WRITE_PHYSICAL_ADDR	(writes to physical addr)
 		IOCTL_GET_KERNEL_MAP
+		IOCTL_READ_PROCESS_VEC		(reads a list of userspace ranges)
+		IOCTL_WRITE_PROCESS_VEC		(writes a list of userspace ranges)
+		IOCTL_SET_MMAP_WINDOW		(sets the range mmap exposes)
 
 
 	- Rakholiya Jenish <p4n74>
@@ -69,6 +73,205 @@ static void clean_mmap (void) {
 	}
 }
 
+static bool is_from_module_or_vmalloc (unsigned long addr) {
+	return (is_vmalloc_addr ((void *)addr) || __module_address (addr));
+}
+
+static bool check_kernel_addr (unsigned long addr) {
+	return virt_addr_valid (addr) ? true : is_from_module_or_vmalloc (addr);
+}
+
+struct r2k_window_state {
+	struct mutex lock;
+	unsigned long base;
+	unsigned long len;
+	int type;
+	struct vm_area_struct *vma;
+};
+
+static int window_pfn (struct r2k_window_state *w, unsigned long off, unsigned long *pfn) {
+	unsigned long addr = w->base + off;
+	struct page *pg;
+
+	if (off >= w->len) {
+		return -EFAULT;
+	}
+	if (w->type == R2K_WINDOW_PHYSICAL) {
+		*pfn = addr >> PAGE_SHIFT;
+		return pfn_valid (*pfn) ? 0 : -EFAULT;
+	}
+	if (virt_addr_valid (addr)) {
+		*pfn = page_to_pfn (virt_to_page (addr));
+		return 0;
+	}
+	if (is_from_module_or_vmalloc (addr)) {
+		pg = vmalloc_to_page ((void *)addr);
+		if (pg) {
+			*pfn = page_to_pfn (pg);
+			return 0;
+		}
+	}
+	return -EFAULT;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)
+static vm_fault_t window_fault (struct vm_fault *vmf) {
+	struct vm_area_struct *vma = vmf->vma;
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)
+static int window_fault (struct vm_fault *vmf) {
+	struct vm_area_struct *vma = vmf->vma;
+#else
+static int window_fault (struct vm_area_struct *vma, struct vm_fault *vmf) {
+#endif
+	struct r2k_window_state *w = vma->vm_private_data;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+	unsigned long addr = vmf->address;
+#else
+	unsigned long addr = (unsigned long)vmf->virtual_address;
+#endif
+	unsigned long pfn;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)
+	vm_fault_t ret;
+#else
+	int ret;
+#endif
+
+	/* the pte goes in under the lock, so set_mmap_window cannot move the
+	 * window and zap between computing the pfn and inserting it */
+	mutex_lock (&w->lock);
+	if (window_pfn (w, addr - vma->vm_start, &pfn)) {
+		mutex_unlock (&w->lock);
+		return VM_FAULT_SIGBUS;
+	}
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,17,0)
+	ret = vmf_insert_pfn (vma, addr, pfn);
+	mutex_unlock (&w->lock);
+	return ret;
+#else
+	ret = vm_insert_pfn (vma, addr, pfn);
+	mutex_unlock (&w->lock);
+	return (ret && ret != -EBUSY) ? VM_FAULT_SIGBUS : VM_FAULT_NOPAGE;
+#endif
+}
+
+static void window_close (struct vm_area_struct *vma) {
+	struct r2k_window_state *w = vma->vm_private_data;
+
+	mutex_lock (&w->lock);
+	if (w->vma == vma) {
+		w->vma = NULL;
+	}
+	mutex_unlock (&w->lock);
+}
+
+static const struct vm_operations_struct window_vm_ops = {
+	.fault = window_fault,
+	.close = window_close,
+};
+
+/* Pages are inserted on fault, so moving the window only has to drop the
+ * ones already mapped. */
+static int mmap_window (struct r2k_window_state *w, struct vm_area_struct *vma) {
+	if (vma->vm_flags & VM_WRITE) {
+		pr_info ("%s: the window is read-only\n", r2_devname);
+		return -EPERM;
+	}
+	mutex_lock (&w->lock);
+	if (w->vma) {
+		mutex_unlock (&w->lock);
+		pr_info ("%s: the window is already mapped\n", r2_devname);
+		return -EBUSY;
+	}
+	w->vma = vma;
+	mutex_unlock (&w->lock);
+
+	vma->vm_flags |= VM_IO | VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP | VM_DONTCOPY;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_private_data = w;
+	vma->vm_ops = &window_vm_ops;
+	return 0;
+}
+
+static long set_mmap_window (struct file *file, struct r2k_window *win) {
+	struct r2k_window_state *w = file->private_data;
+	struct mm_struct *mm, *held;
+	unsigned long last;
+
+	if (!win->len || win->addr + win->len < win->addr) {
+		return -EINVAL;
+	}
+	last = win->addr + win->len - 1;
+	switch (win->type) {
+	case R2K_WINDOW_KERNEL:
+		if (!check_kernel_addr (win->addr) || !check_kernel_addr (last)) {
+			pr_info ("%s: bad kernel range 0x%lx-0x%lx\n", r2_devname,
+								win->addr, last);
+			return -EFAULT;
+		}
+		break;
+	case R2K_WINDOW_PHYSICAL:
+		if (!pfn_valid (win->addr >> PAGE_SHIFT) || !pfn_valid (last >> PAGE_SHIFT)) {
+			pr_info ("%s: 0x%lx-0x%lx out of range\n", r2_devname,
+								win->addr, last);
+			return -EFAULT;
+		}
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!w) {
+		struct r2k_window_state *nw = kzalloc (sizeof (*nw), GFP_KERNEL);
+		if (!nw) {
+			return -ENOMEM;
+		}
+		mutex_init (&nw->lock);
+		/* two ioctls can get here at once, only one state is kept */
+		w = cmpxchg (&file->private_data, NULL, nw);
+		if (w) {
+			mutex_destroy (&nw->lock);
+			kfree (nw);
+		} else {
+			w = nw;
+		}
+	}
+
+	/* zapping the mapped window needs the mmap_sem of its mm, taken before
+	 * w->lock like in the fault path. The mm is only known under w->lock,
+	 * so pin it, relock in order and retry if the mapping changed. An mm
+	 * that is already exiting is not pinned, its ptes go away with it. */
+	for (;;) {
+		mutex_lock (&w->lock);
+		mm = w->vma ? w->vma->vm_mm : NULL;
+		held = (mm && mmget_not_zero (mm)) ? mm : NULL;
+		mutex_unlock (&w->lock);
+		if (held) {
+			down_read (&held->mmap_sem);
+		}
+		mutex_lock (&w->lock);
+		if ((w->vma ? w->vma->vm_mm : NULL) == mm) {
+			break;
+		}
+		mutex_unlock (&w->lock);
+		if (held) {
+			up_read (&held->mmap_sem);
+			mmput (held);
+		}
+	}
+	w->base = win->addr & PAGE_MASK;
+	w->len = win->len + ADDR_OFFSET (win->addr);
+	w->type = win->type;
+	if (held && w->vma) {
+		zap_vma_ptes (w->vma, w->vma->vm_start, w->vma->vm_end - w->vma->vm_start);
+	}
+	mutex_unlock (&w->lock);
+	if (held) {
+		up_read (&held->mmap_sem);
+		mmput (held);
+	}
+	return 0;
+}
+
 static int mmap_struct (struct file *filp, struct vm_area_struct *vma) {
 	int n_pages;
 	void *start_addr;
@@ -77,6 +280,10 @@ static int mmap_struct (struct file *filp, struct vm_area_struct *vma) {
 	void *k_addr;
 	unsigned long length;
 
+	if (filp->private_data) {
+		return mmap_window (filp->private_data, vma);
+	}
+
 	n_pages = g_r2k_map.kernel_maps_info.size / PAGE_SIZE;
 
 	start_addr = (void *)g_r2k_map.map_info;
@@ -101,14 +308,6 @@ static int mmap_struct (struct file *filp, struct vm_area_struct *vma) {
 	return 0;
 }
 
-static bool is_from_module_or_vmalloc (unsigned long addr) {
-	return (is_vmalloc_addr ((void *)addr) || __module_address (addr));
-}
-
-static bool check_kernel_addr (unsigned long addr) {
-	return virt_addr_valid (addr) ? true : is_from_module_or_vmalloc (addr);
-}
-
 static int get_nr_pages (unsigned long addr, unsigned long next_aligned_addr, unsigned long len) {
 	int nr_pages;
 
@@ -148,6 +347,163 @@ static inline void unmap_addr (void *kaddr, unsigned long addr) {
 	r2kunmap_atomic (kaddr - ADDR_OFFSET (addr));
 }
 
+static long r2k_get_user_pages (struct task_struct *task, struct mm_struct *mm,
+				unsigned long start, int nr_pages, bool write,
+				bool force, struct page **pages) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+	unsigned int flags = (write ? FOLL_WRITE : 0) | (force ? FOLL_FORCE : 0);
+	return get_user_pages_remote (task, mm, start, nr_pages, flags, pages, NULL, NULL);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4,9,0)
+	unsigned int flags = (write ? FOLL_WRITE : 0) | (force ? FOLL_FORCE : 0);
+	return get_user_pages_remote (task, mm, start, nr_pages, flags, pages, NULL);
+#else
+	return get_user_pages (task, mm, start, nr_pages, write, force, pages, NULL);
+#endif
+}
+
+/* Transfers between a process range and the caller's buffer. Pages are
+ * pinned R2K_PIN_BATCH at a time with a single mmap_sem acquisition, and
+ * copied with the lock dropped, as copying may fault in the caller.
+ * Returns the bytes transferred, or an error if there were none. */
+static long transfer_process_range (struct task_struct *task, struct mm_struct *mm,
+				unsigned long addr, unsigned long len,
+				void __user *buff, bool write, bool force,
+				struct page **pages) {
+	unsigned long end = PAGE_ALIGN (addr + len);
+	unsigned long done = 0;
+	long ret = 0;
+
+	while (done < len && !ret) {
+		unsigned long start = (addr + done) & PAGE_MASK;
+		int nr_pages = min_t (unsigned long, (end - start) >> PAGE_SHIFT, R2K_PIN_BATCH);
+		int got, i;
+
+		down_read (&mm->mmap_sem);
+		got = r2k_get_user_pages (task, mm, start, nr_pages, write, force, pages);
+		up_read (&mm->mmap_sem);
+		if (got <= 0) {
+			ret = got ? got : -EFAULT;
+			break;
+		}
+
+		for (i = 0; i < got; i++) {
+			unsigned long offset = ADDR_OFFSET (addr + done);
+			unsigned long bytes = min (PAGE_SIZE - offset, len - done);
+			void *kaddr;
+
+			if (ret) {
+				page_cache_release (pages[i]);
+				continue;
+			}
+			kaddr = kmap (pages[i]);
+			if (write) {
+				if (copy_from_user (kaddr + offset, buff + done, bytes)) {
+					ret = -EFAULT;
+				} else {
+					set_page_dirty_lock (pages[i]);
+				}
+			} else if (copy_to_user (buff + done, kaddr + offset, bytes)) {
+				ret = -EFAULT;
+			}
+			kunmap (pages[i]);
+			page_cache_release (pages[i]);
+			if (!ret) {
+				done += bytes;
+			}
+		}
+	}
+	return done ? done : ret;
+}
+
+static struct task_struct *get_target_task (int pid, struct mm_struct **mm) {
+	struct task_struct *task;
+
+	rcu_read_lock ();
+	task = pid_task (find_vpid (pid), PIDTYPE_PID);
+	if (task) {
+		get_task_struct (task);
+	}
+	rcu_read_unlock ();
+	if (!task) {
+		return NULL;
+	}
+	*mm = get_task_mm (task);
+	if (!*mm) {
+		put_task_struct (task);
+		return NULL;
+	}
+	return task;
+}
+
+static void put_target_task (struct task_struct *task, struct mm_struct *mm) {
+	if (task) {
+		mmput (mm);
+		put_task_struct (task);
+	}
+}
+
+/* Serves a list of ranges in one call. Consecutive ranges of the same pid
+ * share the task lookup; a range that cannot be transferred is left with
+ * done = 0 and does not stop the others. */
+static long transfer_process_vec (struct r2k_memory_vec *vec, bool write) {
+	struct r2k_memory_range *ranges = NULL;
+	struct page **pages = NULL;
+	struct task_struct *task = NULL;
+	struct mm_struct *mm = NULL;
+	size_t size;
+	long ret = 0;
+	int pid = 0;
+	int i;
+
+	if (vec->n_ranges < 1 || vec->n_ranges > R2K_MAX_RANGES) {
+		return -EINVAL;
+	}
+	/* up to R2K_MAX_RANGES entries is too much to ask kmalloc for in
+	 * one contiguous piece */
+	size = vec->n_ranges * sizeof (*ranges);
+	ranges = kvmalloc_array (vec->n_ranges, sizeof (*ranges), GFP_KERNEL);
+	pages = kmalloc (R2K_PIN_BATCH * sizeof (*pages), GFP_KERNEL);
+	if (!ranges || !pages) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (copy_from_user (ranges, vec->ranges, size)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	for (i = 0; i < vec->n_ranges; i++) {
+		struct r2k_memory_range *r = &ranges[i];
+		long n;
+
+		r->done = 0;
+		if (!task || r->pid != pid) {
+			put_target_task (task, mm);
+			pid = r->pid;
+			task = get_target_task (pid, &mm);
+			if (!task) {
+				pr_info ("%s: could not retrieve task_struct from pid (%d)\n",
+						r2_devname, pid);
+				continue;
+			}
+		}
+		n = transfer_process_range (task, mm, r->addr, r->len, r->buff,
+						write, !vec->wp, pages);
+		if (n > 0) {
+			r->done = n;
+		}
+	}
+	put_target_task (task, mm);
+
+	if (copy_to_user (vec->ranges, ranges, size)) {
+		ret = -EFAULT;
+	}
+out:
+	kfree (pages);
+	kvfree (ranges);
+	return ret;
+}
+
 static int write_vmareastruct (struct vm_area_struct *vma, struct mm_struct *mm,
 						struct r2k_proc_info *data,
 						unsigned long *count) {
@@ -345,12 +701,10 @@ static long io_ioctl (struct file *file, unsigned int cmd, unsigned long data_ad
 	case IOCTL_WRITE_PROCESS_ADDR:
 	{
 		struct task_struct *task;
+		struct mm_struct *mm;
 		struct vm_area_struct *vma;
-		unsigned long next_aligned_addr;
-		void __user *buffer_r;
-		int nr_pages;
-		int page_i;
-		int len;
+		struct page **pages;
+		long len;
 
 		m_transf = kmalloc (sizeof (struct r2k_memory_transf), GFP_KERNEL);
 		if (!m_transf) {
@@ -367,28 +721,19 @@ static long io_ioctl (struct file *file, unsigned int cmd, unsigned long data_ad
 			goto out;
 		}
 
-		buffer_r = m_transf->buff;
 		len = m_transf->len;
 
-		task = pid_task (find_vpid (m_transf->pid), PIDTYPE_PID);
+		task = get_target_task (m_transf->pid, &mm);
 		if (!task) {
 			pr_info ("%s: could not retrieve task_struct from pid (%d)\n",
 					r2_devname, m_transf->pid);
 			ret = -ESRCH;
 			goto out;
 		}
-		printk("Task %p + %d\n", task, (int)(size_t)((void*)&task->cred - (void*)task));
-
-		vma = find_vma (task->mm, m_transf->addr);
-		if (!vma) {
-			pr_info ("%s: could not retrieve vm_area_struct"
-								"at 0x%lx\n",
-						r2_devname, m_transf->addr);
-			ret = -EFAULT;
-			goto out;
-		}
 
-		if (m_transf->addr + len > vma->vm_end) {
+		down_read (&mm->mmap_sem);
+		vma = find_vma (mm, m_transf->addr);
+		if (vma && m_transf->addr + len > vma->vm_end) {
 			pr_info ("%s: 0x%lx + %ld bytes goes beyond"
 					"valid addresses. bytes recalculated to"
 								"%ld bytes\n",
@@ -398,75 +743,50 @@ static long io_ioctl (struct file *file, unsigned int cmd, unsigned long data_ad
 						vma->vm_end - m_transf->addr);
 			len = vma->vm_end - m_transf->addr;
 		}
+		up_read (&mm->mmap_sem);
+		if (!vma) {
+			pr_info ("%s: could not retrieve vm_area_struct"
+								"at 0x%lx\n",
+						r2_devname, m_transf->addr);
+			put_target_task (task, mm);
+			ret = -EFAULT;
+			goto out;
+		}
 
-		next_aligned_addr = get_next_aligned_addr (m_transf->addr);
-		nr_pages = get_nr_pages (m_transf->addr, next_aligned_addr, len);
-
-		down_read (&task->mm->mmap_sem);
-		for (page_i = 0 ; page_i < nr_pages ; page_i++ ) {
-			struct page *pg = NULL;
-			void *kaddr;
-			int bytes;
-#if LINUX_VERSION_CODE > KERNEL_VERSION(4,0,0)
-			ret = get_user_pages_remote (task, task->mm, m_transf->addr, 1, 0, &pg, NULL, NULL);
-#else
-			ret = get_user_pages (task, task->mm, m_transf->addr, 1,
-									0,
-									0,
-									&pg,
-									NULL);
-#endif
-			if (!ret) {
-				pr_info ("%s: could not retrieve page"
-							"from pid (%d)\n",
-							r2_devname,
-							m_transf->pid);
-				ret = -ESRCH;
-				if (pg)
-	        			page_cache_release (pg);
-				goto out_loop;
-			}
-
-			bytes = get_bytes_to_rw (m_transf->addr, len,
-							next_aligned_addr);
-			kaddr = map_addr (pg, m_transf->addr);
-
-			if (!addr_is_mapped ( (unsigned long)kaddr)) {
-				pr_info ("%s: addr is not mapped,"
-						"triggering a fault\n", r2_devname);
-				unmap_addr (kaddr, m_transf->addr);
-				if (pg)
-					page_cache_release (pg);
-				goto out_loop;
-			}
-
-			if (_IOC_NR (cmd) == IOCTL_READ_PROCESS_ADDR)
-				ret = r2k_copy_to_user (buffer_r, kaddr, bytes);
-			else
-				ret = r2k_copy_from_user(kaddr, buffer_r,  bytes, m_transf->wp);
+		pages = kmalloc (R2K_PIN_BATCH * sizeof (*pages), GFP_KERNEL);
+		if (!pages) {
+			put_target_task (task, mm);
+			ret = -ENOMEM;
+			goto out;
+		}
+		len = transfer_process_range (task, mm, m_transf->addr, len,
+					m_transf->buff,
+					_IOC_NR (cmd) == IOCTL_WRITE_PROCESS_ADDR,
+					!m_transf->wp, pages);
+		kfree (pages);
+		put_target_task (task, mm);
+		if (len < 0) {
+			pr_info ("%s: could not transfer memory from pid (%d)\n",
+						r2_devname, m_transf->pid);
+			ret = len;
+		} else {
+			ret = 0;
+		}
+		break;
+	}
+	case IOCTL_READ_PROCESS_VEC:
+	case IOCTL_WRITE_PROCESS_VEC:
+	{
+		struct r2k_memory_vec vec;
 
-			if (ret) {
-				pr_info ("%s: copy_to_user failed\n",
+		if (copy_from_user (&vec, (void __user*)data_addr, sizeof (vec))) {
+			pr_info ("%s: error - copy struct r2k_memory_vec\n",
 								r2_devname);
-				ret = -EFAULT;
-				unmap_addr (kaddr, m_transf->addr);
-				if (pg)
-	        			page_cache_release (pg);
-				goto out_loop;
-			}
-
-			buffer_r += bytes;
-			m_transf->addr = next_aligned_addr;
-			next_aligned_addr += PAGE_SIZE;
-			len -= bytes;
-			unmap_addr (kaddr, m_transf->addr);
-			if (pg)
-				page_cache_release (pg);
+			ret = -EFAULT;
+			goto out;
 		}
-
-	out_loop:
-		up_read (&task->mm->mmap_sem);
-
+		ret = transfer_process_vec (&vec,
+				_IOC_NR (cmd) == IOCTL_WRITE_PROCESS_VEC);
 		break;
 	}
 	case IOCTL_READ_PHYSICAL_ADDR:
@@ -600,6 +920,19 @@ static long io_ioctl (struct file *file, unsigned int cmd, unsigned long data_ad
 #endif
 		break;
 	}
+	case IOCTL_SET_MMAP_WINDOW:
+	{
+		struct r2k_window win;
+
+		if (copy_from_user (&win, (void __user*)data_addr, sizeof (win))) {
+			pr_info ("%s: error - copy struct r2k_window\n",
+								r2_devname);
+			ret = -EFAULT;
+			goto out;
+		}
+		ret = set_mmap_window (file, &win);
+		break;
+	}
 	case IOCTL_READ_REG:
 	{
 		struct r2k_control_reg regs;
@@ -721,6 +1054,13 @@ static int io_open (struct inode *inode, struct file *file) {
 }
 
 static int io_close (struct inode *inode, struct file *file) {
+	struct r2k_window_state *w = file->private_data;
+
+	if (w) {
+		mutex_destroy (&w->lock);
+		kfree (w);
+		file->private_data = NULL;
+	}
 	return 0;
 }
 
@@ -33,6 +33,9 @@
 #define IOCTL_READ_PHYSICAL_ADDR        0x5
 #define IOCTL_WRITE_PHYSICAL_ADDR       0x6
 #define IOCTL_GET_KERNEL_MAP            0x7
+#define IOCTL_READ_PROCESS_VEC          0xa
+#define IOCTL_WRITE_PROCESS_VEC         0xb
+#define IOCTL_SET_MMAP_WINDOW           0xc
 
 struct r2k_memory_transf {
         int pid;
@@ -42,6 +45,39 @@ struct r2k_memory_transf {
         bool wp;
 };
 
+/* One range of a vectored process transfer. The driver stores in `done`
+ * how many bytes were transferred; it stops short at unmapped memory. */
+struct r2k_memory_range {
+	int pid;
+	unsigned long addr;
+	unsigned long len;
+	void __user *buff;
+	unsigned long done;
+};
+
+struct r2k_memory_vec {
+	struct r2k_memory_range __user *ranges;
+	int n_ranges;
+	bool wp;
+};
+
+/* Read-only window onto kernel or physical memory. Once it is set, mmap
+ * on the same fd maps it instead of the kernel maps, starting at
+ * addr & PAGE_MASK. Setting it again slides a live mapping: the old
+ * pages are unmapped and the new range faults in on access. */
+#define R2K_WINDOW_KERNEL	0
+#define R2K_WINDOW_PHYSICAL	1
+
+struct r2k_window {
+	unsigned long addr;
+	unsigned long len;
+	int type;
+};
+
+#define R2K_MAX_RANGES	4096
+/* pages pinned per get_user_pages call, with mmap_sem held */
+#define R2K_PIN_BATCH	128
+
 #define MAX_PHYS_ADDR	128
 
 struct kernel_map_info {
@@ -11,6 +11,10 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <time.h>
 
 #define CHAR_FMT "%c "
 #define HEX_FMT "0x%02x "
@@ -25,6 +29,29 @@ struct r2k_data {
         unsigned char *buff;
 };
 
+struct r2k_range {
+	int pid;
+	unsigned long addr;
+	unsigned long len;
+	unsigned char *buff;
+	unsigned long done;
+};
+
+struct r2k_vec {
+	struct r2k_range *ranges;
+	int n_ranges;
+	bool wp;
+};
+
+struct r2k_window {
+	unsigned long addr;
+	unsigned long len;
+	int type;
+};
+
+#define R2K_WINDOW_KERNEL	0
+#define R2K_WINDOW_PHYSICAL	1
+
 #define MAX_PHYS_ADDR   128
 
 struct kernel_map_info {
@@ -49,6 +76,8 @@ struct kernel_maps {
 #define IOCTL_READ_PHYSICAL_ADDR	_IOR (R2_TYPE, 0x5, sizeof (struct r2k_data))
 #define IOCTL_WRITE_PHYSICAL_ADDR       _IOR (R2_TYPE, 0x6, sizeof (struct r2k_data))
 #define IOCTL_GET_KERNEL_MAP            _IOR (R2_TYPE, 0x7, sizeof (struct r2k_data))
+#define IOCTL_READ_PROCESS_VEC          _IOR (R2_TYPE, 0xa, sizeof (struct r2k_vec))
+#define IOCTL_SET_MMAP_WINDOW           _IOR (R2_TYPE, 0xc, sizeof (struct r2k_window))
 
 #define READ_KERNEL_MEMORY		0x1
 #define WRITE_KERNEL_MEMORY		0x2
@@ -75,9 +104,199 @@ const char *prog_name;
 void print_help(void)
 {
 	printf ("%s -a [addr] -i [ioctl] -b [n_bytes] -w [w_bytes] -p [pid]\n", prog_name);
+	printf ("%s -B [megabytes]    benchmark process reads\n", prog_name);
+	printf ("%s -m -a [addr] -b [n_bytes] -i [1|5]    benchmark ioctl reads against the mmap window\n", prog_name);
 	exit (-1);
 }
 
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *what, size_t size, double t, int calls,
+			const unsigned char *out, const unsigned char *ref)
+{
+	printf ("%-36s %8.1f MB/s %8d ioctls %s\n", what,
+		size / t / (1 << 20), calls,
+		memcmp (out, ref, size) ? "MISMATCH" : "ok");
+}
+
+/* Reads a child's anonymous mapping of `mb` megabytes, the way io_r2k does
+ * (one ioctl per block) and through the vectored ioctl. */
+int bench(int fd, int mb)
+{
+	const size_t block = 4096;
+	const size_t chunk = 1 << 20;
+	const int batch = 64;
+	size_t size = (size_t)mb << 20;
+	size_t off;
+	struct r2k_data data;
+	struct r2k_range *ranges;
+	struct r2k_vec vec;
+	unsigned char *map, *out;
+	double t;
+	pid_t pid;
+	int calls, i, n;
+
+	map = mmap (NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	out = malloc (size);
+	ranges = calloc (batch, sizeof (*ranges));
+	if (map == MAP_FAILED || !out || !ranges) {
+		perror ("bench");
+		return -1;
+	}
+	for (off = 0; off < size; off++) {
+		map[off] = (off >> 12) ^ off;
+	}
+	pid = fork ();
+	if (!pid) {
+		pause ();
+		_exit (0);
+	}
+	printf ("Reading %d MB from pid (%d) at %p\n", mb, pid, map);
+
+	memset (out, 0, size);
+	calls = 0;
+	t = now ();
+	for (off = 0; off < size; off += block) {
+		data.pid = pid;
+		data.addr = (unsigned long)map + off;
+		data.len = block;
+		data.buff = out + off;
+		if (ioctl (fd, IOCTL_READ_PROCESS_ADDR, &data) < 0) {
+			perror ("IOCTL_READ_PROCESS_ADDR");
+			break;
+		}
+		calls++;
+	}
+	bench_report ("IOCTL_READ_PROCESS_ADDR 4K blocks", size, now () - t, calls, out, map);
+
+	memset (out, 0, size);
+	calls = 0;
+	t = now ();
+	for (off = 0; off < size; off += chunk) {
+		data.pid = pid;
+		data.addr = (unsigned long)map + off;
+		data.len = chunk;
+		data.buff = out + off;
+		if (ioctl (fd, IOCTL_READ_PROCESS_ADDR, &data) < 0) {
+			perror ("IOCTL_READ_PROCESS_ADDR");
+			break;
+		}
+		calls++;
+	}
+	bench_report ("IOCTL_READ_PROCESS_ADDR 1M blocks", size, now () - t, calls, out, map);
+
+	memset (out, 0, size);
+	calls = 0;
+	t = now ();
+	for (off = 0; off < size; off += n * chunk) {
+		for (n = 0; n < batch && off + n * chunk < size; n++) {
+			ranges[n].pid = pid;
+			ranges[n].addr = (unsigned long)map + off + n * chunk;
+			ranges[n].len = chunk;
+			ranges[n].buff = out + off + n * chunk;
+		}
+		vec.ranges = ranges;
+		vec.n_ranges = n;
+		vec.wp = true;
+		if (ioctl (fd, IOCTL_READ_PROCESS_VEC, &vec) < 0) {
+			perror ("IOCTL_READ_PROCESS_VEC");
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			if (ranges[i].done != chunk) {
+				printf ("short read at 0x%lx: %lu bytes\n",
+					ranges[i].addr, ranges[i].done);
+			}
+		}
+		calls++;
+	}
+	bench_report ("IOCTL_READ_PROCESS_VEC 64x1M ranges", size, now () - t, calls, out, map);
+
+	kill (pid, SIGKILL);
+	waitpid (pid, NULL, 0);
+	free (ranges);
+	free (out);
+	munmap (map, size);
+	return 0;
+}
+
+
+/* Reads n_bytes of kernel (ioctl 1) or physical (ioctl 5) memory with one
+ * ioctl per 4K block, then through the mmap window, cold and warm. */
+int bench_window(int fd, int n_ioctl, unsigned long addr, int n_bytes)
+{
+	const int block = 4096;
+	long page_size = sysconf (_SC_PAGESIZE);
+	struct r2k_data data;
+	struct r2k_window win;
+	unsigned char *ref, *out, *map;
+	size_t maplen;
+	double t;
+	int calls = 0;
+	int off;
+	int pass;
+
+	if (n_ioctl != READ_KERNEL_MEMORY && n_ioctl != READ_PHYSICAL_ADDR) {
+		printf ("the window benchmark reads kernel (-i 1) or physical (-i 5) memory\n");
+		return -1;
+	}
+	ref = calloc (n_bytes, 1);
+	out = calloc (n_bytes, 1);
+	if (!ref || !out || n_bytes < 1) {
+		return -1;
+	}
+
+	t = now ();
+	for (off = 0; off < n_bytes; off += block) {
+		data.pid = 0;
+		data.addr = addr + off;
+		data.len = n_bytes - off < block ? n_bytes - off : block;
+		data.buff = ref + off;
+		if (ioctl (fd, n_ioctl == READ_KERNEL_MEMORY
+				? IOCTL_READ_KERNEL_MEMORY
+				: IOCTL_READ_PHYSICAL_ADDR, &data) < 0) {
+			perror ("ioctl");
+			return -1;
+		}
+		calls++;
+	}
+	t = now () - t;
+	printf ("%-24s %8.1f MB/s %8d ioctls\n", "ioctl 4K blocks",
+		n_bytes / t / (1 << 20), calls);
+
+	win.addr = addr;
+	win.len = n_bytes;
+	win.type = n_ioctl == READ_KERNEL_MEMORY ? R2K_WINDOW_KERNEL : R2K_WINDOW_PHYSICAL;
+	if (ioctl (fd, IOCTL_SET_MMAP_WINDOW, &win) < 0) {
+		perror ("IOCTL_SET_MMAP_WINDOW");
+		return -1;
+	}
+	maplen = ((addr & (page_size - 1)) + n_bytes + page_size - 1) & ~(page_size - 1);
+	map = mmap (NULL, maplen, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror ("mmap");
+		return -1;
+	}
+	for (pass = 0; pass < 2; pass++) {
+		t = now ();
+		memcpy (out, map + (addr & (page_size - 1)), n_bytes);
+		t = now () - t;
+		printf ("%-24s %8.1f MB/s %8d ioctls %s\n",
+			pass ? "mmap window (warm)" : "mmap window (cold)",
+			n_bytes / t / (1 << 20), 0,
+			memcmp (out, ref, n_bytes) ? "MISMATCH" : "ok");
+	}
+	munmap (map, maplen);
+	free (out);
+	free (ref);
+	return 0;
+}
 
 int main(int argc, char **argv)
 {
@@ -97,6 +316,7 @@ int main(int argc, char **argv)
 	char *p;
 	char *str;
 	int output;
+	int window_bench = 0;
 
 	data.addr = data.pid = data.len = 0;
 	prog_name = argv[0];
@@ -106,8 +326,20 @@ int main(int argc, char **argv)
 /*	if (argc < 4)
 		print_help(); */
 
-	while ((opt = getopt (argc, argv, "a:i:b:w:p:o:")) != -1) {
+	while ((opt = getopt (argc, argv, "a:i:b:w:p:o:B:m")) != -1) {
 		switch (opt) {
+		case 'B':
+			fd = open (devicename, O_RDONLY);
+			if (fd == -1) {
+				perror ("open error");
+				return -1;
+			}
+			ret = bench (fd, atoi (optarg));
+			close (fd);
+			return ret;
+		case 'm':
+			window_bench = 1;
+			break;
 		case 'a':
 			data.addr = strtoul (optarg, &p, 16);
 			break;
@@ -157,6 +389,12 @@ int main(int argc, char **argv)
 
 	
 
+	if (window_bench) {
+		ret = bench_window (fd, n_ioctl, data.addr, n_bytes);
+		close (fd);
+		return ret;
+	}
+
 	switch (n_ioctl) {
 	case READ_KERNEL_MEMORY:
 
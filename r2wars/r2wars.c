@@ -0,0 +1,669 @@
+/* radare2 - LGPL - Copyright 2018 */
+
+#include <r_core.h>
+#include <unistd.h>
+#if __UNIX__
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+/*
+  Native r2wars engine. Warriors are assembled once and every match runs
+  in-process: they share one malloc:// memory and the aeim stack, each one
+  keeps its own copy of the register arenas, and the scheduler decodes and
+  evaluates the ESIL of one instruction per turn, round robin, like the
+  aes of r2wars.py so the JSON replays match the UI. A warrior dies when
+  it fetches or decodes an invalid instruction, its ESIL traps (unmapped
+  reads and writes with esil.iotrap, unimplemented expressions...) or it
+  does a syscall.
+
+  Matches are independent, so they are spread over forked workers (r2's
+  arch plugins keep global state, threads would share it) and the results
+  go to stdout as JSON which r2wars.py -j can replay.
+*/
+
+#define WARS_MEMSIZE 1024
+#define WARS_MAXPROGSIZE 64
+#define WARS_CYCLES 1000000
+#define WARS_MAX 16 // warriors in one match
+
+enum {
+	WARS_ALIVE,
+	WARS_INVALID, // undecodable or unemulated instruction
+	WARS_SEGV, // fetch, read or write out of memory
+	WARS_TRAP, // any other ESIL trap
+	WARS_INTR, // syscalls and interrupts
+};
+
+static const char *wars_reasons[] = {
+	"alive", "invalid", "segv", "trap", "intr"
+};
+
+// winner of a match which could not run (its worker died)
+#define WARS_ERROR -2
+
+typedef struct {
+	char *name;
+	ut8 *code;
+	int size;
+	int wins;
+	int draws;
+	int losses;
+} RWarsWarrior;
+
+typedef struct {
+	int warrior;
+	ut64 addr;
+	int reason;
+	ut32 turn; // when it died
+	ut64 pc; // where it died
+} RWarsPlayer;
+
+typedef struct {
+	int n;
+	RWarsPlayer p[WARS_MAX];
+	int winner; // index in p, -1 for a draw
+	ut32 turns;
+} RWarsMatch;
+
+// the running state of a player
+typedef struct {
+	ut8 *regs;
+	ut64 pc;
+} RWarsVM;
+
+typedef struct {
+	RCore *core;
+	RAnalEsil *esil;
+	RRegItem *pc;
+	RRegItem *sp;
+	int regsize;
+	ut8 *regs0; // registers as aeim leaves them
+	ut64 stack_addr;
+	int stack_size;
+	ut8 *zero;
+	const char *arch;
+	int bits;
+	int memsize;
+	int maxsize;
+	ut32 cycles;
+	ut64 seed;
+	int jobs;
+	RWarsWarrior *w;
+	int nw;
+	RWarsMatch *m;
+	int nm;
+} RWars;
+
+// the register profile spreads the registers over one arena per type
+static int regs_size(RReg *reg) {
+	int i, size = 0;
+	for (i = 0; i < R_REG_TYPE_LAST; i++) {
+		size += reg->regset[i].arena->size;
+	}
+	return size;
+}
+
+static void regs_save(RReg *reg, ut8 *buf) {
+	RRegArena *a;
+	int i;
+	for (i = 0; i < R_REG_TYPE_LAST; i++) {
+		a = reg->regset[i].arena;
+		memcpy (buf, a->bytes, a->size);
+		buf += a->size;
+	}
+}
+
+static void regs_load(RReg *reg, const ut8 *buf) {
+	RRegArena *a;
+	int i;
+	for (i = 0; i < R_REG_TYPE_LAST; i++) {
+		a = reg->regset[i].arena;
+		memcpy (a->bytes, buf, a->size);
+		buf += a->size;
+	}
+}
+
+// xorshift64*, seeded per match so any worker gets the same layout
+static ut64 wars_rand(ut64 *s) {
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+	return *s * 2685821657736338717ULL;
+}
+
+static ut64 wars_rand_range(ut64 *s, ut64 min, ut64 max) {
+	return min + wars_rand (s) % (max - min + 1);
+}
+
+// same layout as r2wars.py: a random base, random gaps, shuffled
+static bool wars_place(RWars *wars, RWarsMatch *m, int id) {
+	ut64 s = (wars->seed ^ ((ut64)(id + 1) * 0x9e3779b97f4a7c15ULL)) | 1;
+	ut64 addr, tmp;
+	int i, j, tries;
+	for (tries = 0; tries < 1000; tries++) {
+		addr = wars_rand_range (&s, 0, wars->memsize - wars->maxsize);
+		for (i = 0; i < m->n; i++) {
+			m->p[i].addr = addr;
+			addr += wars_rand_range (&s, wars->maxsize, wars->maxsize + 300);
+		}
+		if (m->p[m->n - 1].addr + wars->maxsize <= wars->memsize) {
+			for (i = m->n - 1; i > 0; i--) {
+				j = wars_rand (&s) % (i + 1);
+				tmp = m->p[i].addr;
+				m->p[i].addr = m->p[j].addr;
+				m->p[j].addr = tmp;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool wars_init(RWars *wars) {
+	RCore *core = r_core_new ();
+	RReg *reg;
+	char *uri;
+	bool ok;
+	if (!core) {
+		return false;
+	}
+	wars->core = core;
+	r_config_set (core->config, "asm.arch", wars->arch);
+	r_config_set_i (core->config, "asm.bits", wars->bits);
+	// unmapped memory accesses trap instead of reading 0xff
+	r_config_set_i (core->config, "esil.iotrap", 1);
+	uri = r_str_newf ("malloc://%d", wars->memsize);
+	ok = r_core_file_open (core, uri, R_PERM_RWX, 0) && r_core_bin_load (core, NULL, 0);
+	free (uri);
+	if (!ok) {
+		eprintf ("Cannot open the shared memory\n");
+		return false;
+	}
+	r_core_cmd0 (core, "aei");
+	r_core_cmd0 (core, "aeim");
+	reg = core->anal->reg;
+	wars->esil = core->anal->esil;
+	wars->pc = r_reg_get (reg, r_reg_get_name (reg, R_REG_NAME_PC), -1);
+	wars->sp = r_reg_get (reg, r_reg_get_name (reg, R_REG_NAME_SP), -1);
+	if (!wars->esil || !wars->pc || !wars->sp) {
+		eprintf ("Cannot emulate %s-%d\n", wars->arch, wars->bits);
+		return false;
+	}
+	wars->stack_addr = r_config_get_i (core->config, "esil.stack.addr");
+	wars->stack_size = r_config_get_i (core->config, "esil.stack.size");
+	wars->regsize = regs_size (reg);
+	wars->regs0 = malloc (wars->regsize);
+	wars->zero = calloc (1, R_MAX (wars->memsize, wars->stack_size));
+	if (!wars->regs0 || !wars->zero) {
+		return false;
+	}
+	regs_save (reg, wars->regs0);
+	return true;
+}
+
+static bool wars_load(RWars *wars, RWarsWarrior *w) {
+	RAsmCode *code;
+	char *src = r_file_slurp (w->name, NULL);
+	if (!src) {
+		eprintf ("Cannot open %s\n", w->name);
+		return false;
+	}
+	code = r_asm_massemble (wars->core->assembler, src);
+	free (src);
+	if (!code || code->len < 1) {
+		eprintf ("Cannot assemble %s\n", w->name);
+		r_asm_code_free (code);
+		return false;
+	}
+	if (code->len > wars->maxsize) {
+		eprintf ("%s is %d bytes, the limit is %d\n", w->name, code->len, wars->maxsize);
+		r_asm_code_free (code);
+		return false;
+	}
+	w->size = code->len;
+	w->code = r_mem_dup (code->bytes, code->len);
+	r_asm_code_free (code);
+	return w->code != NULL;
+}
+
+// decode the instruction at vm->pc, returns why it can't run or WARS_ALIVE
+static int wars_decode(RWars *wars, RWarsVM *vm, RAnalOp *op) {
+	RCore *core = wars->core;
+	ut8 buf[32];
+	const char *esil;
+	if (vm->pc >= wars->memsize) {
+		return WARS_SEGV;
+	}
+	r_io_read_at (core->io, vm->pc, buf, sizeof (buf));
+	if (r_anal_op (core->anal, op, vm->pc, buf, sizeof (buf), R_ANAL_OP_MASK_ESIL) < 1) {
+		r_anal_op_fini (op);
+		return WARS_INVALID;
+	}
+	if (vm->pc + op->size > wars->memsize) {
+		r_anal_op_fini (op);
+		return WARS_SEGV;
+	}
+	esil = R_STRBUF_SAFEGET (&op->esil);
+	switch (op->type) {
+	case R_ANAL_OP_TYPE_ILL:
+		r_anal_op_fini (op);
+		return WARS_INVALID;
+	case R_ANAL_OP_TYPE_SWI:
+		r_anal_op_fini (op);
+		return WARS_INTR;
+	}
+	if (strstr (esil, "TODO")) {
+		r_anal_op_fini (op);
+		return WARS_INVALID;
+	}
+	return WARS_ALIVE;
+}
+
+// give a turn to a player, returns why it died or WARS_ALIVE
+static int wars_turn(RWars *wars, RWarsVM *vm) {
+	RReg *reg = wars->core->anal->reg;
+	RAnalEsil *esil = wars->esil;
+	RAnalOp op;
+	int reason;
+	if ((reason = wars_decode (wars, vm, &op))) {
+		return reason;
+	}
+	regs_load (reg, vm->regs);
+	r_reg_set_value (reg, wars->pc, vm->pc + op.size);
+	esil->trap = 0;
+	esil->address = vm->pc;
+	r_anal_esil_parse (esil, R_STRBUF_SAFEGET (&op.esil));
+	r_anal_esil_stack_free (esil);
+	r_anal_op_fini (&op);
+	switch (esil->trap) {
+	case R_ANAL_TRAP_NONE:
+		break;
+	case R_ANAL_TRAP_READ_ERR:
+	case R_ANAL_TRAP_WRITE_ERR:
+	case R_ANAL_TRAP_EXEC_ERR:
+		return WARS_SEGV;
+	case R_ANAL_TRAP_INVALID:
+	case R_ANAL_TRAP_TODO:
+		return WARS_INVALID;
+	default:
+		return WARS_TRAP;
+	}
+	regs_save (reg, vm->regs);
+	vm->pc = r_reg_get_value (reg, wars->pc);
+	return WARS_ALIVE;
+}
+
+static void wars_match(RWars *wars, RWarsMatch *m, RWarsVM *vm) {
+	RCore *core = wars->core;
+	RReg *reg = core->anal->reg;
+	RWarsPlayer *p;
+	int i, reason, alive = m->n;
+	ut32 turn;
+	r_io_write_at (core->io, 0, wars->zero, wars->memsize);
+	r_io_write_at (core->io, wars->stack_addr, wars->zero, wars->stack_size);
+	for (i = 0; i < m->n; i++) {
+		p = &m->p[i];
+		r_io_write_at (core->io, p->addr, wars->w[p->warrior].code, wars->w[p->warrior].size);
+		regs_load (reg, wars->regs0);
+		r_reg_set_value (reg, wars->pc, p->addr);
+		r_reg_set_value (reg, wars->sp, r_reg_get_value (reg, wars->sp) + p->addr);
+		regs_save (reg, vm[i].regs);
+		vm[i].pc = p->addr;
+		p->reason = WARS_ALIVE;
+		p->turn = 0;
+		p->pc = 0;
+	}
+	m->winner = -1;
+	for (turn = 0, i = 0; alive > 1 && turn < wars->cycles; turn++) {
+		while (m->p[i].reason != WARS_ALIVE) {
+			i = (i + 1) % m->n;
+		}
+		if ((reason = wars_turn (wars, &vm[i]))) {
+			m->p[i].reason = reason;
+			m->p[i].turn = turn;
+			m->p[i].pc = vm[i].pc;
+			alive--;
+		}
+		i = (i + 1) % m->n;
+	}
+	m->turns = turn;
+	if (alive == 1) {
+		for (i = 0; i < m->n; i++) {
+			if (m->p[i].reason == WARS_ALIVE) {
+				m->winner = i;
+			}
+		}
+	}
+}
+
+static void wars_worker(RWars *wars, RWarsMatch *m, int first, int step) {
+	RWarsVM vm[WARS_MAX] = {{0}};
+	int i;
+	for (i = 0; i < WARS_MAX; i++) {
+		if (!(vm[i].regs = malloc (wars->regsize))) {
+			goto beach;
+		}
+	}
+	for (i = first; i < wars->nm; i += step) {
+		wars_match (wars, &m[i], vm);
+	}
+beach:
+	for (i = 0; i < WARS_MAX; i++) {
+		free (vm[i].regs);
+	}
+}
+
+static int wars_jobs(RWars *wars) {
+	int n = wars->jobs;
+	if (n < 1) {
+#if __UNIX__
+		n = (int)sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+		if (n < 1) {
+			n = 1;
+		}
+	}
+	return R_MIN (n, wars->nm);
+}
+
+static void wars_run(RWars *wars) {
+	int i;
+	for (i = 0; i < wars->nm; i++) {
+		wars->m[i].winner = WARS_ERROR;
+	}
+#if __UNIX__
+	if (wars->jobs > 1) {
+		size_t size = sizeof (RWarsMatch) * wars->nm;
+		RWarsMatch *shared = mmap (NULL, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		pid_t *pids = R_NEWS0 (pid_t, wars->jobs);
+		if (shared != MAP_FAILED && pids) {
+			memcpy (shared, wars->m, size);
+			// the workers inherit the assembled warriors and the core
+			for (i = 0; i < wars->jobs; i++) {
+				pids[i] = fork ();
+				if (!pids[i]) {
+					wars_worker (wars, shared, i, wars->jobs);
+					_exit (0);
+				}
+				if (pids[i] < 0) {
+					eprintf ("Cannot fork, the matches of worker %d are lost\n", i);
+				}
+			}
+			for (i = 0; i < wars->jobs; i++) {
+				if (pids[i] > 0) {
+					waitpid (pids[i], NULL, 0);
+				}
+			}
+			memcpy (wars->m, shared, size);
+			munmap (shared, size);
+			free (pids);
+			return;
+		}
+		if (shared != MAP_FAILED) {
+			munmap (shared, size);
+		}
+		free (pids);
+	}
+#endif
+	wars->jobs = 1;
+	wars_worker (wars, wars->m, 0, 1);
+}
+
+static void json_string(FILE *fd, const char *s) {
+	fputc ('"', fd);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			fprintf (fd, "\\%c", *s);
+		} else if ((ut8)*s < 0x20) {
+			fprintf (fd, "\\u%04x", *s);
+		} else {
+			fputc (*s, fd);
+		}
+	}
+	fputc ('"', fd);
+}
+
+static void wars_json(RWars *wars, FILE *fd, ut64 elapsed) {
+	RWarsMatch *m;
+	RWarsPlayer *p;
+	int i, j;
+	fprintf (fd, "{\"arch\":\"%s\",\"bits\":%d,\"memsize\":%d,\"maxsize\":%d,"
+		"\"cycles\":%u,\"seed\":%"PFMT64u",\"warriors\":[",
+		wars->arch, wars->bits, wars->memsize, wars->maxsize, wars->cycles, wars->seed);
+	for (i = 0; i < wars->nw; i++) {
+		RWarsWarrior *w = &wars->w[i];
+		fprintf (fd, "%s{\"name\":", i? ",": "");
+		json_string (fd, w->name);
+		fprintf (fd, ",\"size\":%d,\"code\":\"", w->size);
+		for (j = 0; j < w->size; j++) {
+			fprintf (fd, "%02x", w->code[j]);
+		}
+		fprintf (fd, "\",\"wins\":%d,\"draws\":%d,\"losses\":%d}",
+			w->wins, w->draws, w->losses);
+	}
+	fprintf (fd, "],\"matches\":[");
+	for (i = 0; i < wars->nm; i++) {
+		m = &wars->m[i];
+		fprintf (fd, "%s{\"id\":%d,\"turns\":%u,\"winner\":", i? ",": "", i, m->turns);
+		if (m->winner >= 0) {
+			fprintf (fd, "%d", m->p[m->winner].warrior);
+		} else {
+			fprintf (fd, "null");
+		}
+		fprintf (fd, ",\"result\":\"%s\",\"players\":[",
+			m->winner == WARS_ERROR? "error": m->winner < 0? "draw": "win");
+		for (j = 0; j < m->n; j++) {
+			p = &m->p[j];
+			fprintf (fd, "%s{\"warrior\":%d,\"addr\":%"PFMT64u",\"status\":\"%s\"",
+				j? ",": "", p->warrior, p->addr, wars_reasons[p->reason]);
+			if (p->reason != WARS_ALIVE) {
+				fprintf (fd, ",\"turn\":%u,\"pc\":%"PFMT64u, p->turn, p->pc);
+			}
+			fputc ('}', fd);
+		}
+		fprintf (fd, "]}");
+	}
+	fprintf (fd, "],\"jobs\":%d,\"time\":%.6f}\n", wars->jobs, elapsed / 1000000.0);
+}
+
+static void wars_score(RWars *wars) {
+	RWarsMatch *m;
+	int i, j;
+	for (i = 0; i < wars->nm; i++) {
+		m = &wars->m[i];
+		if (m->winner == WARS_ERROR) {
+			continue;
+		}
+		for (j = 0; j < m->n; j++) {
+			RWarsWarrior *w = &wars->w[m->p[j].warrior];
+			if (m->winner < 0) {
+				w->draws++;
+			} else if (m->winner == j) {
+				w->wins++;
+			} else {
+				w->losses++;
+			}
+		}
+	}
+}
+
+// warriors are named like name.arch-bits[.asm], as the ones in t/
+static bool wars_arch_from_name(const char *name, char *arch, int size, int *bits) {
+	const char *s = r_file_basename (name);
+	const char *dash, *end;
+	int len;
+	while ((s = strchr (s, '.'))) {
+		s++;
+		end = strchr (s, '.');
+		dash = strchr (s, '-');
+		if (!dash || (end && dash > end) || !isdigit ((ut8)dash[1])) {
+			continue;
+		}
+		len = dash - s;
+		if (len < 1 || len >= size) {
+			continue;
+		}
+		memcpy (arch, s, len);
+		arch[len] = 0;
+		*bits = atoi (dash + 1);
+		return true;
+	}
+	return false;
+}
+
+static int show_help(const char *argv0, int line) {
+	eprintf ("Usage: %s [-a arch] [-b bits] [-j jobs] [-n rounds] [-c cycles]\n"
+		"       [-s seed] [-m memsize] [-M maxsize] [-o file.json] [-1] warrior...\n", argv0);
+	if (!line) {
+		eprintf (
+		" -a arch     architecture (default from the name: warrior.x86-32.asm)\n"
+		" -b bits     register size\n"
+		" -j jobs     matches run in parallel (default: number of cpus)\n"
+		" -n rounds   times every match is played (default 1)\n"
+		" -c cycles   turns before calling it a draw (default %d)\n"
+		" -s seed     placement seed (default: time)\n"
+		" -m memsize  shared memory size (default %d)\n"
+		" -M maxsize  max warrior size (default %d)\n"
+		" -o file     write the results there instead of stdout\n"
+		" -1          all the warriors in one match (default: every pair)\n",
+		WARS_CYCLES, WARS_MEMSIZE, WARS_MAXPROGSIZE);
+	}
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	char arch[32] = "x86";
+	const char *out = NULL;
+	bool all = false, have_arch = false, have_bits = false;
+	int c, i, j, r, rounds = 1, bits = 32, ret = 1;
+	ut64 t0, elapsed;
+	RWarsMatch *m;
+	RWars wars = {0};
+	FILE *fd = stdout;
+
+	wars.memsize = WARS_MEMSIZE;
+	wars.maxsize = WARS_MAXPROGSIZE;
+	wars.cycles = WARS_CYCLES;
+	wars.seed = r_sys_now ();
+	while ((c = getopt (argc, argv, "a:b:j:n:c:s:m:M:o:1h")) != -1) {
+		switch (c) {
+		case 'a': r_str_ncpy (arch, optarg, sizeof (arch)); have_arch = true; break;
+		case 'b': bits = atoi (optarg); have_bits = true; break;
+		case 'j': wars.jobs = atoi (optarg); break;
+		case 'n': rounds = atoi (optarg); break;
+		case 'c': wars.cycles = r_num_get (NULL, optarg); break;
+		case 's': wars.seed = r_num_get (NULL, optarg); break;
+		case 'm': wars.memsize = r_num_get (NULL, optarg); break;
+		case 'M': wars.maxsize = r_num_get (NULL, optarg); break;
+		case 'o': out = optarg; break;
+		case '1': all = true; break;
+		default: return show_help (argv[0], c != 'h');
+		}
+	}
+	wars.nw = argc - optind;
+	if (wars.nw < 2) {
+		eprintf ("You need at least 2 warriors\n");
+		return show_help (argv[0], 1);
+	}
+	if (all && wars.nw > WARS_MAX) {
+		eprintf ("At most %d warriors fit in one match\n", WARS_MAX);
+		return 1;
+	}
+	if (rounds < 1 || wars.maxsize < 1 || wars.memsize < wars.maxsize) {
+		eprintf ("Invalid rounds or memory sizes\n");
+		return 1;
+	}
+	for (i = 0; i < wars.nw; i++) {
+		char a[32];
+		int b;
+		if (!wars_arch_from_name (argv[optind + i], a, sizeof (a), &b)) {
+			continue;
+		}
+		if (!have_arch) {
+			r_str_ncpy (arch, a, sizeof (arch));
+			have_arch = true;
+		}
+		if (!have_bits) {
+			bits = b;
+			have_bits = true;
+		}
+		if (strcmp (a, arch) || b != bits) {
+			eprintf ("%s is not a %s-%d warrior\n", argv[optind + i], arch, bits);
+			return 1;
+		}
+	}
+	wars.arch = arch;
+	wars.bits = bits;
+	wars.w = R_NEWS0 (RWarsWarrior, wars.nw);
+	wars.nm = all? rounds: rounds * wars.nw * (wars.nw - 1) / 2;
+	wars.m = R_NEWS0 (RWarsMatch, wars.nm);
+	if (!wars.w || !wars.m || !wars_init (&wars)) {
+		goto beach;
+	}
+	for (i = 0; i < wars.nw; i++) {
+		wars.w[i].name = argv[optind + i];
+		if (!wars_load (&wars, &wars.w[i])) {
+			goto beach;
+		}
+	}
+	m = wars.m;
+	for (r = 0; r < rounds; r++) {
+		if (all) {
+			m->n = wars.nw;
+			for (i = 0; i < wars.nw; i++) {
+				m->p[i].warrior = i;
+			}
+			m++;
+			continue;
+		}
+		for (i = 0; i < wars.nw; i++) {
+			for (j = i + 1; j < wars.nw; j++) {
+				m->n = 2;
+				m->p[0].warrior = i;
+				m->p[1].warrior = j;
+				m++;
+			}
+		}
+	}
+	for (i = 0; i < wars.nm; i++) {
+		if (!wars_place (&wars, &wars.m[i], i)) {
+			eprintf ("Not enough memory for %d warriors\n", wars.m[i].n);
+			goto beach;
+		}
+	}
+	if (out && !(fd = fopen (out, "w"))) {
+		eprintf ("Cannot open %s\n", out);
+		fd = stdout;
+		goto beach;
+	}
+	wars.jobs = wars_jobs (&wars);
+	t0 = r_sys_now ();
+	wars_run (&wars);
+	elapsed = r_sys_now () - t0;
+	wars_score (&wars);
+	wars_json (&wars, fd, elapsed);
+	eprintf ("%d matches in %.3fs on %d workers (%.1f matches/s)\n", wars.nm,
+		elapsed / 1000000.0, wars.jobs, elapsed? wars.nm * 1000000.0 / elapsed: 0.0);
+	for (i = 0; i < wars.nw; i++) {
+		eprintf ("%4d wins %4d draws %4d losses  %s\n", wars.w[i].wins,
+			wars.w[i].draws, wars.w[i].losses, wars.w[i].name);
+	}
+	ret = 0;
+beach:
+	if (fd != stdout) {
+		fclose (fd);
+	}
+	if (wars.w) {
+		for (i = 0; i < wars.nw; i++) {
+			free (wars.w[i].code);
+		}
+	}
+	free (wars.w);
+	free (wars.m);
+	free (wars.regs0);
+	free (wars.zero);
+	r_core_free (wars.core);
+	return ret;
+}
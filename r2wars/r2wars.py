@@ -1,6 +1,7 @@
 #!/usr/bin/env python
 
 import re
+import json
 import curses
 import r2pipe
 import sys
@@ -13,6 +14,7 @@ useBits = "32"
 
 ctr = 0
 uidx = 0
+players = []
 user = []
 name = []
 wins = []
@@ -34,7 +36,7 @@ def get_random_offsets():
 	while True:
 		rand = []
 		addr = random.randint(0, memsize - maxprogsize)
-		for a in sys.argv[1:]:
+		for a in players:
 			rand.append(addr)
 			addr = addr + random.randint(maxprogsize, maxprogsize + 300)
 			if addr + maxprogsize > memsize:
@@ -182,7 +184,7 @@ def r2wars_curses():
 		rs = "agn %s\n"%(who)
 		rs += "agn %s\n"%(nextName)
 		rs += "age %s %s\n"%(who, nextName)
-		for x in sys.argv[1:]:
+		for x in players:
 			rs += "agn %s\n"%(x)
 			if x != who:
 				rs += "age %s %s\n"%(who, x)
@@ -190,10 +192,32 @@ def r2wars_curses():
 		print("The Winner Is: %s"%(who))
 
 
+def load_replay(path, n):
+	# a match played by the native engine: r2wars -o results.json ...
+	global players
+	results = json.load(open(path))
+	match = results["matches"][n]
+	if results["memsize"] != memsize:
+		print("ERROR: The match was played with %d bytes of memory"%(results["memsize"]))
+		sys.exit(1)
+	r2.cmd("e asm.arch=%s"%(results["arch"]))
+	r2.cmd("e asm.bits=%s"%(results["bits"]))
+	warriors = [results["warriors"][p["warrior"]] for p in match["players"]]
+	players = [w["name"] for w in warriors]
+	return [p["addr"] for p in match["players"]], [w["code"] for w in warriors]
+
 if __name__ == '__main__':
 	idx = 0
-	offsets = get_random_offsets()
-	for a in sys.argv[1:]:
+	codes = None
+	if len(sys.argv) > 2 and sys.argv[1] == "-j":
+		n = 0
+		if len(sys.argv) > 3:
+			n = int(sys.argv[3])
+		offsets, codes = load_replay(sys.argv[2], n)
+	else:
+		players = sys.argv[1:]
+		offsets = get_random_offsets()
+	for a in players:
 		try:
 			n = name.index(a)
 			print(n)
@@ -202,8 +226,11 @@ if __name__ == '__main__':
 		except:
 			pass
 		addr = offsets[idx]
+		if codes:
+			src = codes[idx]
+		else:
+			src = r2.syscmd("rasm2 -f %s"%(a)).strip()
 		idx = idx + 1
-		src = r2.syscmd("rasm2 -f %s"%(a)).strip()
 		if src == "":
 			print("Invalid source")
 			sys.exit(1)
@@ -24,6 +24,7 @@ static void char_str_init(char_str *str);
 static void char_str_free(char_str *str);
 static int char_str_append(char_str *str, const char *value);
 static int char_str_append_len(char_str *str, const char *value, size_t len);
+static void char_str_reset(char_str *str);
 
 static void char_str_init(char_str *str)
 {
@@ -42,6 +43,14 @@ static void char_str_free(char_str *str)
 	str->capacity = 0;
 }
 
+static void char_str_reset(char_str *str)
+{
+	str->length = 0;
+	if (str->array) {
+		str->array[0] = '\0';
+	}
+}
+
 static int char_str_append(char_str *str, const char *value)
 {
 	int str_len = strlen(value);
@@ -49,6 +58,11 @@ static int char_str_append(char_str *str, const char *value)
 	if (str->length + str_len + 1 > str->capacity) {
 		int new_capacity = str->length + str_len + 1;
 
+		/* grow geometrically, appends are done once per instruction */
+		if (new_capacity < str->capacity * 2) {
+			new_capacity = str->capacity * 2;
+		}
+
 		if (new_capacity > str->capacity && new_capacity < SIZE_T_MAX / sizeof (char)) {
 			char *new_array = (char *) realloc (str->array, new_capacity * sizeof(char));
 			if (new_array != NULL) {
@@ -74,6 +88,11 @@ static int char_str_append_len(char_str *str, const char *value, size_t len)
 	if (str->length + len + 1 > str->capacity) {
 		int new_capacity = str->length + len + 1;
 
+		/* grow geometrically, appends are done once per instruction */
+		if (new_capacity < str->capacity * 2) {
+			new_capacity = str->capacity * 2;
+		}
+
 		if (new_capacity > str->capacity && new_capacity < SIZE_T_MAX / sizeof(char)) {
 			char *new_array = (char *) realloc (str->array, new_capacity * sizeof(char));
 			if (new_array != NULL) {
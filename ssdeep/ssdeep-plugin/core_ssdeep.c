@@ -6,6 +6,7 @@
 #include <r_types.h>
 
 #include <fuzzy.h>
+#include <ctype.h>
 #include <string.h>
 
 #include "char_str.h"
@@ -23,6 +24,35 @@ static bool ssdeep_print_hash(RCore *core, const char *ptr, char hash_mode);
 static char *ssdeep_get_func_disasm(RCore *core, ut64 addr, ut8 *buf,
 									int nb_bytes, int nb_opcodes, bool esil);
 static void ssdeep_check_size(ut32 len);
+static bool ssdeep_hash_functions(RCore *core, const char *arg);
+static bool ssdeep_match(RCore *core, const char *arg, int kind);
+
+/* Functions are hashed in batches: the bytes, ESIL and disassembly are
+ * extracted on the main thread (RAnal/RAsm are not thread safe) and the
+ * fuzzy hashes of the batch are then computed by SSDEEP_MAX_WORKERS threads.
+ */
+#define SSDEEP_BATCH 1024
+#define SSDEEP_MAX_WORKERS 32
+#define SSDEEP_TABLE_MAGIC "# ssdeep-func-table 1"
+
+typedef struct {
+	ut64 addr;
+	int size;
+	char *name;
+	ut8 *bytes;
+	char_str esil;
+	char_str disasm;
+	char raw_hash[FUZZY_MAX_RESULT];
+	char esil_hash[FUZZY_MAX_RESULT];
+	char disasm_hash[FUZZY_MAX_RESULT];
+} SsdeepFunc;
+
+typedef struct {
+	SsdeepFunc *funcs;
+	int count;
+	int first;
+	int step;
+} SsdeepWorker;
 
 static int r_cmd_ssdeep_call(void *user, const char *cmd) {
 	RCore *core = (RCore *)user;
@@ -41,6 +71,11 @@ static int r_cmd_ssdeep_call(void *user, const char *cmd) {
 			hash_mode = 1;
 		else if (cmd[6] == 'd')
 			hash_mode = 2;
+		else if (cmd[6] == 'a')
+			return ssdeep_hash_functions (core, &cmd[7]);
+		else if (cmd[6] == 'm')
+			return ssdeep_match (core, cmd + 7 + (cmd[7] == 'e' || cmd[7] == 'd'),
+				cmd[7] == 'e'? 1: cmd[7] == 'd'? 2: 0);
 	
 		if (cmd_len > 7)
 			++cmd;
@@ -67,6 +102,8 @@ static bool ssdeep_print_hash(RCore *core, const char *ptr, char hash_mode) {
 	if (!*ptr || *ptr == '?') {
 		r_cons_printf ( "ssdeep? - show help\n"
 				"ssdeep[e|d] - calculate fuzzy hash for a block (esil/disasm)\n"
+				"ssdeepa [file] - hash every function (raw/esil/normalized disasm) into a table\n"
+				"ssdeepm[e|d] table [k] - show the k best matches in table for every function\n"
 				"ssdeep custom_len\n"
 				"ssdeep custom_len @addr\n");
 		return true;
@@ -96,7 +133,7 @@ static bool ssdeep_print_hash(RCore *core, const char *ptr, char hash_mode) {
 		len = strlen (disasm_buff);
 		ssdeep_check_size (len);
 
-		fuzzy_hash_buf (disasm_buff, osize, hash_result);
+		fuzzy_hash_buf ((const ut8 *)disasm_buff, len, hash_result);
 		r_cons_printf ("%s\n", hash_result);
 		free (disasm_buff);
 	} else {
@@ -122,6 +159,8 @@ static char *ssdeep_get_func_disasm(RCore *core, ut64 addr, ut8 *buf, int nb_byt
 	ut64 at;
 	int dis_opcodes = 0;
 	int limit_by = 'b';
+	const bool pseudo = r_config_get_i (core->config, "asm.pseudo");
+	const bool varsub = r_config_get_i (core->config, "asm.varsub");
 
 	char_str disasm_buf;
 	char_str_init (&disasm_buf);
@@ -204,11 +243,11 @@ static char *ssdeep_get_func_disasm(RCore *core, ut64 addr, ut8 *buf, int nb_byt
 		r_anal_op_fini (&analop);
 	
 		r_anal_op (core->anal, &analop, at, buf + i, nb_bytes - i);
-		if (r_config_get_i (core->config, "asm.pseudo")) {
+		if (pseudo) {
 			r_parse_parse (core->parser, asmop.buf_asm, asmop.buf_asm);
 		}
-		f = r_anal_get_fcn_in (core->anal, at, R_ANAL_FCN_TYPE_FCN | R_ANAL_FCN_TYPE_SYM);
-		if (r_config_get_i (core->config, "asm.varsub") && f) {
+		f = varsub? r_anal_get_fcn_in (core->anal, at, R_ANAL_FCN_TYPE_FCN | R_ANAL_FCN_TYPE_SYM): NULL;
+		if (f) {
 			core->parser->varlist = r_anal_var_list;
 			r_parse_varsub (core->parser, f, at, analop.size, asmop.buf_asm,
 					asmop.buf_asm, sizeof(asmop.buf_asm));
@@ -243,6 +282,550 @@ static char *ssdeep_get_func_disasm(RCore *core, ut64 addr, ut8 *buf, int nb_byt
 	return disasm_buf.array;
 }
 
+/* Replace every hex literal by "0x" so that the disassembly hash doesn't
+ * depend on where the function was linked.
+ */
+static int ssdeep_normalize(char *str) {
+	char *w = str, *r = str;
+	while (*r) {
+		if (r[0] == '0' && r[1] == 'x' && isxdigit ((ut8)r[2])) {
+			*w++ = *r++;
+			*w++ = *r++;
+			while (isxdigit ((ut8)*r)) {
+				r++;
+			}
+			continue;
+		}
+		*w++ = *r++;
+	}
+	*w = '\0';
+	return w - str;
+}
+
+static int ssdeep_bb_cmp(const void *a, const void *b) {
+	const RAnalBlock *ba = a, *bb = b;
+	return (ba->addr > bb->addr) - (ba->addr < bb->addr);
+}
+
+/* Fills bytes, ESIL and normalized disassembly of the function basic
+ * blocks, in address order. */
+static bool ssdeep_func_extract(RCore *core, RAnalFunction *fcn, SsdeepFunc *sf, bool pseudo) {
+	RListIter *iter;
+	RAnalBlock *bb;
+	RAsmOp asmop;
+	RAnalOp analop = { 0 };
+	RList *bbs;
+	int size = 0, off = 0;
+
+	// the function's own list keeps the order the analysis left it in
+	bbs = r_list_clone (fcn->bbs);
+	if (!bbs) {
+		return false;
+	}
+	r_list_sort (bbs, ssdeep_bb_cmp);
+	r_list_foreach (bbs, iter, bb) {
+		if (bb->size > 0) {
+			size += bb->size;
+		}
+	}
+	sf->addr = fcn->addr;
+	sf->size = size;
+	sf->name = strdup (fcn->name);
+	sf->bytes = size > 0? malloc (size): NULL;
+	if (size < 1 || !sf->name || !sf->bytes) {
+		r_list_free (bbs);
+		return false;
+	}
+	r_list_foreach (bbs, iter, bb) {
+		int i = 0;
+		if (bb->size < 1) {
+			continue;
+		}
+		ut8 *buf = sf->bytes + off;
+		r_io_read_at (core->io, bb->addr, buf, bb->size);
+		off += bb->size;
+		while (i < bb->size) {
+			ut64 at = bb->addr + i;
+			int oplen;
+
+			r_asm_set_pc (core->assembler, at);
+			if (r_asm_disassemble (core->assembler, &asmop, buf + i, bb->size - i) < 1) {
+				char_str_append_len (&sf->disasm, "invalid\n", 8);
+				char_str_append_len (&sf->esil, "\n", 1);
+				i++;
+				continue;
+			}
+			if (pseudo) {
+				r_parse_parse (core->parser, asmop.buf_asm, asmop.buf_asm);
+			}
+			ssdeep_normalize (asmop.buf_asm);
+			char_str_append (&sf->disasm, asmop.buf_asm);
+			char_str_append_len (&sf->disasm, "\n", 1);
+
+			r_anal_op_fini (&analop);
+			r_anal_op (core->anal, &analop, at, buf + i, bb->size - i);
+			char_str_append (&sf->esil, R_STRBUF_SAFEGET (&analop.esil));
+			char_str_append_len (&sf->esil, "\n", 1);
+
+			oplen = r_asm_op_get_size (&asmop);
+			i += oplen > 0? oplen: 1;
+		}
+	}
+	r_anal_op_fini (&analop);
+	r_list_free (bbs);
+	return true;
+}
+
+static void ssdeep_func_fini(SsdeepFunc *sf) {
+	free (sf->name);
+	free (sf->bytes);
+	char_str_free (&sf->esil);
+	char_str_free (&sf->disasm);
+	memset (sf, 0, sizeof (SsdeepFunc));
+}
+
+/* "-" when there is nothing to hash, so the table keeps its columns */
+static void ssdeep_hash_buf(const ut8 *buf, ut32 len, char *hash) {
+	if (!buf || !len || fuzzy_hash_buf (buf, len, hash)) {
+		strcpy (hash, "-");
+	}
+}
+
+static void ssdeep_hash_run(SsdeepWorker *w) {
+	int i;
+	for (i = w->first; i < w->count; i += w->step) {
+		SsdeepFunc *sf = &w->funcs[i];
+		ssdeep_hash_buf (sf->bytes, sf->size, sf->raw_hash);
+		ssdeep_hash_buf ((const ut8 *)sf->esil.array, sf->esil.length, sf->esil_hash);
+		ssdeep_hash_buf ((const ut8 *)sf->disasm.array, sf->disasm.length, sf->disasm_hash);
+	}
+}
+
+static int ssdeep_hash_worker(RThread *th) {
+	ssdeep_hash_run (th->user);
+	return 0;
+}
+
+static int ssdeep_nworkers(void) {
+	int n = 1;
+#if __UNIX__
+	n = (int)sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+	return R_MAX (1, R_MIN (n, SSDEEP_MAX_WORKERS));
+}
+
+static void ssdeep_hash_batch(SsdeepFunc *funcs, int count, int nworkers) {
+	SsdeepWorker workers[SSDEEP_MAX_WORKERS];
+	RThread *threads[SSDEEP_MAX_WORKERS] = { 0 };
+	int i;
+
+	nworkers = R_MAX (1, R_MIN (nworkers, count));
+	for (i = 0; i < nworkers; i++) {
+		workers[i].funcs = funcs;
+		workers[i].count = count;
+		workers[i].first = i;
+		workers[i].step = nworkers;
+	}
+	for (i = 1; i < nworkers; i++) {
+		threads[i] = r_th_new (ssdeep_hash_worker, &workers[i], 0);
+	}
+	ssdeep_hash_run (&workers[0]);
+	for (i = 1; i < nworkers; i++) {
+		if (threads[i]) {
+			r_th_wait (threads[i]);
+			r_th_free (threads[i]);
+		}
+	}
+}
+
+/* One line per function: address, size, raw, esil and disasm hashes, name.
+ * Hashes never contain spaces, so the table can be split on whitespace. */
+static void ssdeep_table_print(SsdeepFunc *sf, void *user) {
+	FILE *fd = user;
+	if (fd) {
+		fprintf (fd, "0x%08"PFMT64x" %d %s %s %s %s\n", sf->addr, sf->size,
+			sf->raw_hash, sf->esil_hash, sf->disasm_hash, sf->name);
+	} else {
+		r_cons_printf ("0x%08"PFMT64x" %d %s %s %s %s\n", sf->addr, sf->size,
+			sf->raw_hash, sf->esil_hash, sf->disasm_hash, sf->name);
+	}
+}
+
+typedef void (*SsdeepEmit)(SsdeepFunc *sf, void *user);
+
+static void ssdeep_emit_batch(SsdeepFunc *batch, int count, int nworkers, SsdeepEmit emit, void *user) {
+	int i;
+	ssdeep_hash_batch (batch, count, nworkers);
+	for (i = 0; i < count; i++) {
+		emit (&batch[i], user);
+		ssdeep_func_fini (&batch[i]);
+	}
+}
+
+/* Hashes all the analyzed functions, handing each one to emit. */
+static int ssdeep_hash_all(RCore *core, SsdeepEmit emit, void *user) {
+	RListIter *iter;
+	RAnalFunction *fcn;
+	SsdeepFunc *batch;
+	int count = 0, total = 0;
+	const bool pseudo = r_config_get_i (core->config, "asm.pseudo");
+	const int nworkers = ssdeep_nworkers ();
+
+	batch = R_NEWS0 (SsdeepFunc, SSDEEP_BATCH);
+	if (!batch) {
+		return -1;
+	}
+	r_list_foreach (core->anal->fcns, iter, fcn) {
+		SsdeepFunc *sf = &batch[count];
+		char_str_init (&sf->esil);
+		char_str_init (&sf->disasm);
+		if (!ssdeep_func_extract (core, fcn, sf, pseudo)) {
+			ssdeep_func_fini (sf);
+			continue;
+		}
+		if (++count == SSDEEP_BATCH) {
+			ssdeep_emit_batch (batch, count, nworkers, emit, user);
+			total += count;
+			count = 0;
+		}
+	}
+	if (count > 0) {
+		ssdeep_emit_batch (batch, count, nworkers, emit, user);
+		total += count;
+	}
+	free (batch);
+	return total;
+}
+
+static bool ssdeep_hash_functions(RCore *core, const char *arg) {
+	FILE *fd = NULL;
+	int total;
+	ut64 t0 = r_sys_now ();
+
+	arg = r_str_chop_ro (arg);
+	if (arg && *arg) {
+		fd = r_sandbox_fopen (arg, "w");
+		if (!fd) {
+			eprintf ("Cannot open %s\n", arg);
+			return false;
+		}
+		fprintf (fd, "%s\n", SSDEEP_TABLE_MAGIC);
+	}
+	total = ssdeep_hash_all (core, ssdeep_table_print, fd);
+	if (fd) {
+		fclose (fd);
+		eprintf ("%d functions hashed in %.2fs using %d threads\n", total,
+			(r_sys_now () - t0) / 1000000.0, ssdeep_nworkers ());
+	}
+	return total >= 0;
+}
+
+/* Similarity index
+ *
+ * fuzzy_compare() only scores two hashes when their block sizes are equal
+ * or differ by a factor of two, and when the compared signatures share a
+ * substring of SSDEEP_GRAM characters (after runs of more than three
+ * identical characters are squashed). Every signature of an indexed hash
+ * (s1 at bs, s2 at 2*bs) is split in grams keyed by (block size, gram), so
+ * the candidates for a query are found by looking up its own grams and only
+ * those pairs get scored.
+ */
+#define SSDEEP_GRAM 7
+
+typedef struct {
+	ut64 addr;
+	int size;
+	char *name;
+	char *hash[3]; // raw, esil, disasm
+} SsdeepEntry;
+
+typedef struct {
+	SsdeepEntry *entries;
+	int count;
+	int cap;
+} SsdeepTable;
+
+typedef struct {
+	ut64 key;
+	int idx;
+} SsdeepGram;
+
+typedef struct {
+	SsdeepGram *grams;
+	int ngrams;
+	int cap;
+} SsdeepIndex;
+
+typedef struct {
+	int idx;
+	int score;
+} SsdeepHit;
+
+static void ssdeep_entry_fini(SsdeepEntry *e) {
+	free (e->name);
+	free (e->hash[0]);
+	free (e->hash[1]);
+	free (e->hash[2]);
+}
+
+static bool ssdeep_table_push(SsdeepTable *t, ut64 addr, int size, const char *name, char **hash) {
+	if (t->count == t->cap) {
+		int cap = t->cap? t->cap * 2: 1024;
+		SsdeepEntry *entries = realloc (t->entries, cap * sizeof (SsdeepEntry));
+		if (!entries) {
+			return false;
+		}
+		t->entries = entries;
+		t->cap = cap;
+	}
+	SsdeepEntry *e = &t->entries[t->count++];
+	e->addr = addr;
+	e->size = size;
+	e->name = strdup (name);
+	e->hash[0] = strdup (hash[0]);
+	e->hash[1] = strdup (hash[1]);
+	e->hash[2] = strdup (hash[2]);
+	return true;
+}
+
+static void ssdeep_entry_emit(SsdeepFunc *sf, void *user) {
+	char *hash[3] = { sf->raw_hash, sf->esil_hash, sf->disasm_hash };
+	ssdeep_table_push (user, sf->addr, sf->size, sf->name, hash);
+}
+
+static void ssdeep_table_fini(SsdeepTable *t) {
+	int i;
+	for (i = 0; i < t->count; i++) {
+		ssdeep_entry_fini (&t->entries[i]);
+	}
+	free (t->entries);
+}
+
+/* Loads a table written by "ssdeepa file" */
+static bool ssdeep_table_load(SsdeepTable *t, const char *path) {
+	char line[1024], name[512], hash[3][FUZZY_MAX_RESULT];
+	FILE *fd = r_sandbox_fopen (path, "r");
+	if (!fd) {
+		eprintf ("Cannot open %s\n", path);
+		return false;
+	}
+	if (!fgets (line, sizeof (line), fd) || strncmp (line, SSDEEP_TABLE_MAGIC, strlen (SSDEEP_TABLE_MAGIC))) {
+		eprintf ("%s is not a ssdeep function table\n", path);
+		fclose (fd);
+		return false;
+	}
+	while (fgets (line, sizeof (line), fd)) {
+		char *ptrs[3] = { hash[0], hash[1], hash[2] };
+		ut64 addr;
+		int size;
+		if (sscanf (line, "0x%"PFMT64x" %d %147s %147s %147s %511s",
+				&addr, &size, hash[0], hash[1], hash[2], name) != 6) {
+			continue;
+		}
+		ssdeep_table_push (t, addr, size, name, ptrs);
+	}
+	fclose (fd);
+	return true;
+}
+
+/* Splits "bs:s1:s2" and squashes runs like fuzzy_compare does */
+static bool ssdeep_hash_split(const char *hash, ut32 *bs, char *s1, char *s2) {
+	const char *p = hash, *q;
+	char *out;
+	int i, n, run;
+	*bs = strtoul (hash, NULL, 10);
+	if (!*bs || !(p = strchr (p, ':')) || !(q = strchr (p + 1, ':'))) {
+		return false;
+	}
+	for (i = 0; i < 2; i++) {
+		const char *from = i? q + 1: p + 1;
+		const char *to = i? from + strcspn (from, ",\n"): q;
+		out = i? s2: s1;
+		for (n = run = 0; from < to && n < SPAMSUM_LENGTH; from++) {
+			run = (n > 0 && out[n - 1] == *from)? run + 1: 0;
+			if (run < 3) {
+				out[n++] = *from;
+			}
+		}
+		out[n] = '\0';
+	}
+	return true;
+}
+
+static ut64 ssdeep_gram_key(ut32 bs, const char *gram) {
+	ut64 h = 0xcbf29ce484222325ULL ^ bs;
+	int i;
+	for (i = 0; i < SSDEEP_GRAM; i++) {
+		h ^= (ut8)gram[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static bool ssdeep_index_add(SsdeepIndex *ix, ut64 key, int idx) {
+	if (ix->ngrams == ix->cap) {
+		int cap = ix->cap? ix->cap * 2: 4096;
+		SsdeepGram *grams = realloc (ix->grams, cap * sizeof (SsdeepGram));
+		if (!grams) {
+			return false;
+		}
+		ix->grams = grams;
+		ix->cap = cap;
+	}
+	ix->grams[ix->ngrams].key = key;
+	ix->grams[ix->ngrams].idx = idx;
+	ix->ngrams++;
+	return true;
+}
+
+static int ssdeep_gram_cmp(const void *a, const void *b) {
+	const SsdeepGram *ga = a, *gb = b;
+	if (ga->key != gb->key) {
+		return ga->key < gb->key? -1: 1;
+	}
+	return ga->idx - gb->idx;
+}
+
+static void ssdeep_index_build(SsdeepIndex *ix, SsdeepTable *t, int kind) {
+	char s1[SPAMSUM_LENGTH + 1], s2[SPAMSUM_LENGTH + 1];
+	int i, j;
+	ut32 bs;
+	for (i = 0; i < t->count; i++) {
+		SsdeepEntry *e = &t->entries[i];
+		if (!ssdeep_hash_split (e->hash[kind], &bs, s1, s2)) {
+			continue;
+		}
+		for (j = 0; j + SSDEEP_GRAM <= (int)strlen (s1); j++) {
+			ssdeep_index_add (ix, ssdeep_gram_key (bs, s1 + j), i);
+		}
+		for (j = 0; j + SSDEEP_GRAM <= (int)strlen (s2); j++) {
+			ssdeep_index_add (ix, ssdeep_gram_key (bs * 2, s2 + j), i);
+		}
+	}
+	qsort (ix->grams, ix->ngrams, sizeof (SsdeepGram), ssdeep_gram_cmp);
+}
+
+static int ssdeep_index_lower(SsdeepIndex *ix, ut64 key) {
+	int lo = 0, hi = ix->ngrams;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (ix->grams[mid].key < key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static void ssdeep_hits_insert(SsdeepHit *hits, int *nhits, int k, int idx, int score) {
+	int i = *nhits;
+	if (i == k) {
+		if (score <= hits[k - 1].score) {
+			return;
+		}
+		i--;
+	} else {
+		(*nhits)++;
+	}
+	for (; i > 0 && hits[i - 1].score < score; i--) {
+		hits[i] = hits[i - 1];
+	}
+	hits[i].idx = idx;
+	hits[i].score = score;
+}
+
+/* Scores every indexed entry sharing a gram with the query */
+static int ssdeep_index_query(SsdeepIndex *ix, SsdeepTable *t, int kind, const char *hash,
+		int *seen, int stamp, SsdeepHit *hits, int k, int *ncandidates) {
+	char s1[SPAMSUM_LENGTH + 1], s2[SPAMSUM_LENGTH + 1];
+	const char *sig[2] = { s1, s2 };
+	int i, j, nhits = 0;
+	ut32 bs;
+	if (!ssdeep_hash_split (hash, &bs, s1, s2)) {
+		return 0;
+	}
+	for (i = 0; i < 2; i++) {
+		ut32 gbs = i? bs * 2: bs;
+		for (j = 0; j + SSDEEP_GRAM <= (int)strlen (sig[i]); j++) {
+			ut64 key = ssdeep_gram_key (gbs, sig[i] + j);
+			int g = ssdeep_index_lower (ix, key);
+			for (; g < ix->ngrams && ix->grams[g].key == key; g++) {
+				int idx = ix->grams[g].idx;
+				if (seen[idx] == stamp) {
+					continue;
+				}
+				seen[idx] = stamp;
+				(*ncandidates)++;
+				SsdeepEntry *e = &t->entries[idx];
+				int score = fuzzy_compare (hash, e->hash[kind]);
+				if (score > 0) {
+					ssdeep_hits_insert (hits, &nhits, k, idx, score);
+				}
+			}
+		}
+	}
+	return nhits;
+}
+
+static bool ssdeep_match(RCore *core, const char *arg, int kind) {
+	SsdeepTable ours = { 0 }, theirs = { 0 };
+	SsdeepIndex ix = { 0 };
+	SsdeepHit *hits;
+	int *seen = NULL;
+	int i, j, k = 1, ncandidates = 0;
+	char *path, *sp;
+	bool ret = false;
+	ut64 t0 = r_sys_now ();
+
+	arg = r_str_chop_ro (arg);
+	if (!arg || !*arg) {
+		eprintf ("Usage: ssdeepm[e|d] table [k]\n");
+		return false;
+	}
+	path = strdup (arg);
+	sp = strchr (path, ' ');
+	if (sp) {
+		*sp++ = '\0';
+		k = R_MAX (1, (int)r_num_math (core->num, sp));
+	}
+	hits = R_NEWS0 (SsdeepHit, k);
+	if (!hits) {
+		eprintf ("Cannot allocate %d hits\n", k);
+		goto beach;
+	}
+	if (!ssdeep_table_load (&theirs, path)) {
+		goto beach;
+	}
+	ssdeep_index_build (&ix, &theirs, kind);
+	seen = calloc (R_MAX (1, theirs.count), sizeof (int));
+	if (!seen || ssdeep_hash_all (core, ssdeep_entry_emit, &ours) < 0) {
+		eprintf ("Cannot hash the functions\n");
+		goto beach;
+	}
+	for (i = 0; i < ours.count; i++) {
+		SsdeepEntry *e = &ours.entries[i];
+		int nhits = ssdeep_index_query (&ix, &theirs, kind, e->hash[kind],
+			seen, i + 1, hits, k, &ncandidates);
+		for (j = 0; j < nhits; j++) {
+			SsdeepEntry *m = &theirs.entries[hits[j].idx];
+			r_cons_printf ("0x%08"PFMT64x" %s 0x%08"PFMT64x" %s %d\n",
+				e->addr, e->name, m->addr, m->name, hits[j].score);
+		}
+	}
+	eprintf ("%d x %d functions, %d pairs scored in %.2fs\n", ours.count,
+		theirs.count, ncandidates, (r_sys_now () - t0) / 1000000.0);
+	ret = true;
+beach:
+	free (seen);
+	free (ix.grams);
+	free (hits);
+	ssdeep_table_fini (&ours);
+	ssdeep_table_fini (&theirs);
+	free (path);
+	return ret;
+}
+
 RCorePlugin r_core_plugin_ssdeep = {
 	.name = "ssdeep",
 	.desc = "fuzzy hashing for r2",
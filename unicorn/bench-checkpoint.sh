@@ -0,0 +1,26 @@
+#!/bin/sh
+# Restore latency of the unicorn checkpoints: dirty N pages with rep stosb
+# after taking a checkpoint and go back to it. The plugin prints how many
+# pages were rolled back and how long it took.
+#
+#   $ ./bench-checkpoint.sh 1 16 256 1024
+
+[ -z "$1" ] && set -- 1 16 256 1024
+
+CODE=`mktemp`
+trap 'rm -f "${CODE}"' EXIT
+# rep stosb ; jmp $$
+printf '\363\252\353\376' > "${CODE}"
+
+for PAGES in "$@" ; do
+	LEN=$((${PAGES} * 4096))
+	# the loop spins on the jmp once the stores are done
+	R2_UNICORN_BUDGET=$((${LEN} + 16)) R2_UNICORN_TIMEOUT=10000 \
+	r2 -q -n -a x86 -b 64 -m 0x10000 \
+		-c 'o malloc://0x800000 0x100000 rw' \
+		-c 'dL unicorn' -c 'dpa' \
+		-c 'dr rip=0x10000' -c 'dr rdi=0x100000' \
+		-c "dr rcx=${LEN}" -c 'dr rax=0x41' \
+		-c 'unicorn checkpoint' -c 'dc' -c 'unicorn restore' \
+		-c 'q!' "${CODE}" 2>&1 | grep Restored
+done
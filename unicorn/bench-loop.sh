@@ -0,0 +1,23 @@
+#!/bin/sh
+# Raw emulation speed of the unicorn plugin: run a three instruction loop
+# that never exits until the instruction budget stops it. The plugin prints
+# the time the continue took and the Minsn/s it ran at.
+#
+#   $ ./bench-loop.sh 1000000 10000000 100000000
+
+[ -z "$1" ] && set -- 1000000 10000000 100000000
+
+CODE=`mktemp`
+trap 'rm -f "${CODE}"' EXIT
+# loop: inc rax ; dec rcx ; jnz loop
+printf '\110\377\300\110\377\311\165\370' > "${CODE}"
+
+for BUDGET in "$@" ; do
+	# the file is mapped r-x at 0x10000, rcx=0 wraps so the loop never ends
+	R2_UNICORN_BUDGET=${BUDGET} R2_UNICORN_TIMEOUT=60000 \
+	r2 -q -n -a x86 -b 64 -m 0x10000 \
+		-c 'dL unicorn' -c 'dpa' \
+		-c 'dr rip=0x10000' -c 'dr rcx=0' \
+		-c 'dc' \
+		-c 'q!' "${CODE}" 2>&1 | grep Budget
+done
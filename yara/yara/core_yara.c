@@ -1,6 +1,7 @@
 /* radare - LGPLv3 - Copyright 2014-2015 - pancake, jvoisin, jfrankowski */
 
 #include <dirent.h>
+#include <sys/stat.h>
 #include <r_core.h>
 #include <r_lib.h>
 #include <yara.h>
@@ -24,6 +25,8 @@ static int r_cmd_yara_init(void *user, const char *cmd);
 static int r_cmd_yara_help(const RCore* core);
 static int r_cmd_yara_process(const RCore* core, const char* input);
 static int r_cmd_yara_scan(const RCore* core, const char* option);
+static int r_cmd_yara_cache(const char *arg);
+static int r_cmd_yara_stats();
 static int r_cmd_yara_load_default_rules (const RCore* core);
 
 static const char* yara_rule_template = "rule RULE_NAME {\n\tstrings:\n\n\tcondition:\n}";
@@ -34,27 +37,166 @@ static const char* yara_rule_template = "rule RULE_NAME {\n\tstrings:\n\n\tcondi
  */
 static RList* rules_list;
 
+/* One entry of rules_list: a compiled rules object plus the time spent
+ * scanning with it, so slow rule sets can be spotted with "yara stats".
+ */
+typedef struct {
+	YR_RULES *rules;
+	char *name;
+	ut64 elapsed; // microseconds, summed over all workers
+	ut64 nscans;
+	ut64 nmatches;
+} RYaraRuleset;
+
+/* Compiled rules are saved in the cache directory and keyed by a hash of
+ * the rule sources, so the next session only has to yr_rules_load them.
+ */
+#ifndef R2_HOME_CACHEDIR
+#define R2_HOME_CACHEDIR ".cache" R_SYS_DIR "radare2"
+#endif
+#define YARA_CACHE_DIR "yara"
+
+static bool use_cache = true;
+
+/* The scan is split in jobs (window x ruleset) which are run by
+ * scan_threads workers. A window size of 0 scans the whole file at once,
+ * which keeps offset-dependent conditions (filesize, uint16(0), "at N")
+ * meaningful; smaller windows overlap by scan_overlap bytes.
+ */
+static int scan_threads = 0;
+static ut64 scan_window = 0;
+static ut64 scan_overlap = 0x1000;
+
+typedef struct {
+	ut64 addr;
+	int ruleset;
+	const YR_RULE *rule_id; // declaration order within the ruleset
+	const YR_STRING *string_id;
+	const char *rule;
+	const char *string; // NULL for the rule hit itself
+	ut8 *data;
+	int data_len;
+} RYaraMatch;
+
+typedef struct {
+	RYaraRuleset *rs;
+	int ruleset;
+	const ut8 *buf;
+	ut64 base;
+	ut64 size;
+	RList *matches;
+	ut64 elapsed;
+	ut64 nmatches;
+} RYaraJob;
+
+typedef struct {
+	RYaraJob *jobs;
+	int njobs;
+	int first;
+	int step;
+} RYaraWorker;
+
+static void ruleset_free(RYaraRuleset *rs) {
+	if (rs) {
+		if (rs->rules) {
+			yr_rules_destroy (rs->rules);
+		}
+		free (rs->name);
+		free (rs);
+	}
+}
+
+static int ruleset_add(YR_RULES *rules, const char *name) {
+	RYaraRuleset *rs = R_NEW0 (RYaraRuleset);
+	if (!rs) {
+		yr_rules_destroy (rules);
+		return false;
+	}
+	rs->rules = rules;
+	rs->name = strdup (name? name: "");
+	r_list_append (rules_list, rs);
+	return true;
+}
+
+static void match_free(RYaraMatch *m) {
+	if (m) {
+		free (m->data);
+		free (m);
+	}
+}
+
+/* Rules in the order they were declared, each followed by its strings,
+ * so the output reads as when the scan was printed from the callback.
+ * Rules and strings of a ruleset live in one array, pointers keep the
+ * declaration order. */
+static int match_cmp(const void *a, const void *b) {
+	const RYaraMatch *ma = a, *mb = b;
+	if (ma->ruleset != mb->ruleset) {
+		return ma->ruleset - mb->ruleset;
+	}
+	if (ma->rule_id != mb->rule_id) {
+		return ma->rule_id < mb->rule_id? -1: 1;
+	}
+	// the rule hit goes first, one per window
+	if (!ma->string_id || !mb->string_id) {
+		return ma->string_id? 1: mb->string_id? -1: 0;
+	}
+	if (ma->string_id != mb->string_id) {
+		return ma->string_id < mb->string_id? -1: 1;
+	}
+	if (ma->addr != mb->addr) {
+		return ma->addr < mb->addr? -1: 1;
+	}
+	return 0;
+}
+
+static RYaraMatch *match_new(RYaraJob *job, const YR_RULE *rule, const YR_STRING *string, ut64 addr) {
+	RYaraMatch *m = R_NEW0 (RYaraMatch);
+	if (m) {
+		m->addr = addr;
+		m->ruleset = job->ruleset;
+		m->rule_id = rule;
+		m->string_id = string;
+		m->rule = rule->identifier;
+		m->string = string? string->identifier: NULL;
+		r_list_append (job->matches, m);
+	}
+	return m;
+}
+
+/* Runs in the worker threads, so nothing is printed here: matches are
+ * collected per job and merged by rule once all workers are done.
+ */
 static int callback (int message, void *msg_data, void *user_data) {
-	RPrint *print = (RPrint *)user_data;
+	RYaraJob *job = (RYaraJob *)user_data;
 	YR_RULE* rule = msg_data;
 
 	if (message == CALLBACK_MSG_RULE_MATCHING)
 	{
 		YR_STRING* string;
-		r_cons_printf("%s\n", rule->identifier);
+		ut64 first = UT64_MAX;
 
-		if (print_strings) {
-			yr_rule_strings_foreach(rule, string)
-			{
-				YR_MATCH* match;
+		yr_rule_strings_foreach(rule, string)
+		{
+			YR_MATCH* match;
 
-				yr_string_matches_foreach(string, match)
-				{
-					r_cons_printf("0x%08" PRIx64 ": %s : ", match->base + match->offset, string->identifier);
-					r_print_bytes(print, match->data, match->data_length, "%02x ");
+			yr_string_matches_foreach(string, match)
+			{
+				ut64 addr = job->base + match->base + match->offset;
+				if (addr < first) {
+					first = addr;
+				}
+				if (print_strings) {
+					RYaraMatch *m = match_new (job, rule, string, addr);
+					if (m && match->data_length > 0) {
+						m->data = r_mem_dup (match->data, match->data_length);
+						m->data_len = m->data? match->data_length: 0;
+					}
 				}
 			}
 		}
+		match_new (job, rule, NULL, first == UT64_MAX? job->base: first);
+		job->nmatches++;
 	}
 	return CALLBACK_CONTINUE;
 }
@@ -65,11 +207,222 @@ static void compiler_callback(int error_level, const char* file_name,
 	return;
 }
 
+static ut64 cache_hash(ut64 h, const ut8 *buf, int len) {
+	/* FNV-1a, only used to tell rule sources apart */
+	int i;
+	for (i = 0; i < len; i++) {
+		h ^= buf[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+#define YARA_INCLUDE_DEPTH 16
+
+/* Files pulled in with include "file" change the rules too. Their
+ * resolved path and mtime go in the key, and their own includes after
+ * them; paths are relative to the including file, as yara does. */
+static ut64 cache_key_includes(ut64 h, const char *path, const ut8 *data, int len, int depth) {
+	const char *p = (const char *)data, *end = p + len;
+	char *dir;
+
+	if (depth > YARA_INCLUDE_DEPTH || (len > 1 && data[0] == 0x1f && data[1] == 0x8b)) {
+		// gzipped sources are added as strings, includes are not resolved
+		return h;
+	}
+	dir = r_file_dirname (path);
+	while (p + 7 < end) {
+		if (strncmp (p, "include", 7)) {
+			p++;
+			continue;
+		}
+		p += 7;
+		while (p < end && (*p == ' ' || *p == '\t')) {
+			p++;
+		}
+		if (p >= end || *p != '"') {
+			continue;
+		}
+		const char *q = ++p;
+		while (q < end && *q != '"' && *q != '\n') {
+			q++;
+		}
+		if (q >= end || *q != '"') {
+			continue;
+		}
+		char *inc = r_str_ndup (p, q - p);
+		char *inc_path = (*inc == '/' || !dir)? strdup (inc)
+			: r_str_newf ("%s%s%s", dir, R_SYS_DIR, inc);
+		struct stat st;
+		ut64 mtime = stat (inc_path, &st)? 0: (ut64)st.st_mtime;
+		h = cache_hash (h, (const ut8 *)inc_path, strlen (inc_path) + 1);
+		h = cache_hash (h, (const ut8 *)&mtime, sizeof (mtime));
+		int inc_len = 0;
+		ut8 *inc_data = (ut8 *)r_file_slurp (inc_path, &inc_len);
+		if (inc_data) {
+			h = cache_key_includes (h, inc_path, inc_data, inc_len, depth + 1);
+			free (inc_data);
+		}
+		free (inc_path);
+		free (inc);
+		p = q + 1;
+	}
+	free (dir);
+	return h;
+}
+
+static ut64 cache_key(const char *path, ut64 h) {
+	const char *name = r_file_basename (path);
+	h = h? h: 0xcbf29ce484222325ULL;
+	h = cache_hash (h, (const ut8 *)name, strlen (name) + 1);
+	int len = 0;
+	ut8 *data = (ut8 *)r_file_slurp (path, &len);
+	if (!data) {
+		return 0;
+	}
+	h = cache_hash (h, data, len);
+	h = cache_key_includes (h, path, data, len, 0);
+	free (data);
+	return h;
+}
+
+static char *cache_path(ut64 key) {
+	/* the compiled format changes between yara releases */
+	char *dir = r_str_home (R2_HOME_CACHEDIR R_SYS_DIR YARA_CACHE_DIR);
+	char *path = r_str_newf ("%s%s%016"PFMT64x"-%d.%d.yarc", dir, R_SYS_DIR,
+		key, YR_MAJOR_VERSION, YR_MINOR_VERSION);
+	free (dir);
+	return path;
+}
+
+static YR_RULES *cache_load(ut64 key) {
+	YR_RULES *rules = NULL;
+	if (!use_cache || !key) {
+		return NULL;
+	}
+	char *path = cache_path (key);
+	if (r_file_exists (path) && yr_rules_load (path, &rules) != ERROR_SUCCESS) {
+		eprintf ("Discarding stale yara cache %s\n", path);
+		r_file_rm (path);
+		rules = NULL;
+	}
+	free (path);
+	return rules;
+}
+
+static void cache_save(YR_RULES *rules, ut64 key) {
+	if (!use_cache || !key) {
+		return;
+	}
+	char *dir = r_str_home (R2_HOME_CACHEDIR R_SYS_DIR YARA_CACHE_DIR);
+	if (r_sys_mkdirp (dir)) {
+		char *path = cache_path (key);
+		if (yr_rules_save (rules, path) != ERROR_SUCCESS) {
+			eprintf ("Cannot write yara cache %s\n", path);
+		}
+		free (path);
+	}
+	free (dir);
+}
+
+static int r_cmd_yara_cache(const char *arg) {
+	char *dir;
+	while (*arg == ' ') {
+		arg++;
+	}
+	if (!strcmp (arg, "on")) {
+		use_cache = true;
+	} else if (!strcmp (arg, "off")) {
+		use_cache = false;
+	} else if (!strcmp (arg, "clear")) {
+		RListIter *iter;
+		char *file;
+		dir = r_str_home (R2_HOME_CACHEDIR R_SYS_DIR YARA_CACHE_DIR);
+		RList *files = r_sys_dir (dir);
+		r_list_foreach (files, iter, file) {
+			if (r_str_endswith (file, ".yarc")) {
+				char *path = r_str_newf ("%s%s%s", dir, R_SYS_DIR, file);
+				r_file_rm (path);
+				free (path);
+			}
+		}
+		r_list_free (files);
+		free (dir);
+	} else {
+		dir = r_str_home (R2_HOME_CACHEDIR R_SYS_DIR YARA_CACHE_DIR);
+		r_cons_printf ("%s %s\n", use_cache? "on": "off", dir);
+		free (dir);
+	}
+	return true;
+}
+
+static void scan_run(RYaraWorker *w) {
+	int i;
+	for (i = w->first; i < w->njobs; i += w->step) {
+		RYaraJob *job = &w->jobs[i];
+		ut64 t0 = r_sys_now ();
+		yr_rules_scan_mem (job->rs->rules, (uint8_t *)job->buf, job->size,
+			0, callback, job, 0);
+		job->elapsed = r_sys_now () - t0;
+	}
+}
+
+static int scan_worker(RThread *th) {
+	scan_run (th->user);
+#if YR_MAJOR_VERSION < 4
+	yr_finalize_thread ();
+#endif
+	return 0;
+}
+
+static int scan_nthreads(int njobs) {
+	int n = scan_threads;
+	if (n < 1) {
+#if __UNIX__
+		n = (int)sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+		if (n < 1) {
+			n = 1;
+		}
+	}
+	// YARA keeps per-thread scan state for at most YR_MAX_THREADS threads
+	if (n > YR_MAX_THREADS - 1) {
+		n = YR_MAX_THREADS - 1;
+	}
+	return R_MIN (n, njobs);
+}
+
+static void scan_print(const RCore *core, RList *matches) {
+	RListIter *iter;
+	RYaraMatch *m, *prev = NULL;
+
+	r_list_sort (matches, match_cmp);
+	r_list_foreach (matches, iter, m) {
+		// every window reports its rule hit, and overlapping windows
+		// the same strings
+		if (prev && !match_cmp (prev, m)) {
+			continue;
+		}
+		prev = m;
+		if (!m->string) {
+			r_cons_printf ("%s\n", m->rule);
+			continue;
+		}
+		r_cons_printf ("0x%08" PRIx64 ": %s : ", m->addr, m->string);
+		r_print_bytes (core->print, m->data, m->data_len, "%02x ");
+	}
+}
+
 static int r_cmd_yara_scan(const RCore* core, const char* option) {
 	RListIter* rules_it;
-	YR_RULES* rules;
-	void* to_scan;
-	int result;
+	RYaraRuleset* rs;
+	RYaraJob *jobs;
+	RYaraWorker *workers;
+	RThread **threads;
+	RList *matches;
+	ut8* to_scan;
+	ut64 window, step, off;
+	int result, i, njobs, nrules, nwindows, nthreads;
 	const unsigned int to_scan_size = r_io_size (core->io);
 
 	if (to_scan_size < 1) {
@@ -89,6 +442,11 @@ static int r_cmd_yara_scan(const RCore* core, const char* option) {
 		return false;
 	}
 
+	nrules = r_list_length (rules_list);
+	if (nrules < 1) {
+		return true;
+	}
+
 	to_scan = malloc (to_scan_size);
 	if (!to_scan) {
 		eprintf ("Something went wrong during memory allocation\n");
@@ -102,23 +460,104 @@ static int r_cmd_yara_scan(const RCore* core, const char* option) {
 		return false;
 	}
 
-	r_list_foreach (rules_list, rules_it, rules) {
-		yr_rules_scan_mem (rules, to_scan, to_scan_size, 0, callback, core->print, 0);
+	window = (scan_window && scan_window < to_scan_size)? scan_window: to_scan_size;
+	step = (window > scan_overlap && window < to_scan_size)? window - scan_overlap: window;
+	nwindows = 1;
+	if (window < to_scan_size) {
+		nwindows = (int)((to_scan_size - window + step - 1) / step) + 1;
+	}
+	njobs = nwindows * nrules;
+	jobs = R_NEWS0 (RYaraJob, njobs);
+	if (!jobs) {
+		free (to_scan);
+		return false;
+	}
+	// window-major order, so that every worker starts on a different ruleset
+	njobs = 0;
+	for (i = 0, off = 0; i < nwindows; i++, off += step) {
+		int r = 0;
+		r_list_foreach (rules_list, rules_it, rs) {
+			RYaraJob *job = &jobs[njobs++];
+			job->rs = rs;
+			job->ruleset = r++;
+			job->buf = to_scan + off;
+			job->base = off;
+			job->size = R_MIN (window, to_scan_size - off);
+			job->matches = r_list_newf ((RListFree)match_free);
+		}
 	}
 
+	nthreads = scan_nthreads (njobs);
+	workers = R_NEWS0 (RYaraWorker, nthreads);
+	threads = R_NEWS0 (RThread *, nthreads);
+	if (!workers || !threads) {
+		nthreads = 0;
+	}
+	for (i = 0; i < nthreads; i++) {
+		workers[i].jobs = jobs;
+		workers[i].njobs = njobs;
+		workers[i].first = i;
+		workers[i].step = nthreads;
+	}
+	// the calling thread takes the first share of the jobs itself
+	for (i = 1; i < nthreads; i++) {
+		threads[i] = r_th_new (scan_worker, &workers[i], 0);
+	}
+	if (nthreads > 0) {
+		scan_run (&workers[0]);
+	}
+	for (i = 1; i < nthreads; i++) {
+		if (threads[i]) {
+			r_th_wait (threads[i]);
+			r_th_free (threads[i]);
+		}
+	}
+
+	matches = r_list_newf ((RListFree)match_free);
+	for (i = 0; i < njobs; i++) {
+		jobs[i].rs->elapsed += jobs[i].elapsed;
+		jobs[i].rs->nscans++;
+		jobs[i].rs->nmatches += jobs[i].nmatches;
+		r_list_join (matches, jobs[i].matches);
+		r_list_free (jobs[i].matches);
+	}
+	scan_print (core, matches);
+
+	r_list_free (matches);
+	free (threads);
+	free (workers);
+	free (jobs);
 	free (to_scan);
 
 	return true;
 }
 
+static int r_cmd_yara_stats() {
+	/* Show the time spent scanning with each loaded rule set */
+	RListIter* rules_it;
+	RYaraRuleset* rs;
+	YR_RULE* rule;
+
+	r_cons_printf ("%10s %6s %8s %6s  %s\n", "time(ms)", "scans", "matches", "rules", "name");
+	r_list_foreach (rules_list, rules_it, rs) {
+		int nrules = 0;
+		yr_rules_foreach (rs->rules, rule) {
+			nrules++;
+		}
+		r_cons_printf ("%10.2f %6"PFMT64d" %8"PFMT64d" %6d  %s\n",
+			rs->elapsed / 1000.0, rs->nscans, rs->nmatches, nrules, rs->name);
+	}
+	return true;
+}
+
 static int r_cmd_yara_show(const char * name) {
 	/* List loaded rules containing name */
 	RListIter* rules_it;
-	YR_RULES* rules;
+	RYaraRuleset* rs;
 	YR_RULE* rule;
 
-	r_list_foreach (rules_list, rules_it, rules) {
-		yr_rules_foreach (rules, rule) {
+	r_list_foreach (rules_list, rules_it, rs) {
+		yr_rules_foreach (rs->rules, rule) {
 			if (r_str_casestr (rule->identifier, name)) {
 				r_cons_printf ("%s\n", rule->identifier);
 			}
@@ -132,14 +571,14 @@ static int r_cmd_yara_tags() {
 	/* List tags from all the different loaded rules */
 	RListIter* rules_it;
 	RListIter *tags_it;
-	YR_RULES* rules;
+	RYaraRuleset* rs;
 	YR_RULE* rule;
 	const char* tag_name;
 	RList *tag_list = r_list_new();
 	tag_list->free = free;
 
-	r_list_foreach (rules_list, rules_it, rules) {
-		yr_rules_foreach(rules, rule) {
+	r_list_foreach (rules_list, rules_it, rs) {
+		yr_rules_foreach(rs->rules, rule) {
 			yr_rule_tags_foreach(rule, tag_name) {
 				if (! r_list_find (tag_list, tag_name, (RListComparator)strcmp)) {
 					r_list_add_sorted (tag_list,
@@ -162,12 +601,12 @@ static int r_cmd_yara_tags() {
 static int r_cmd_yara_tag (const char * search_tag) {
 	/* List rules with tag search_tag */
 	RListIter* rules_it;
-	YR_RULES* rules;
+	RYaraRuleset* rs;
 	YR_RULE* rule;
 	const char* tag_name;
 
-	r_list_foreach (rules_list, rules_it, rules) {
-		yr_rules_foreach (rules, rule) {
+	r_list_foreach (rules_list, rules_it, rs) {
+		yr_rules_foreach (rs->rules, rule) {
 			yr_rule_tags_foreach(rule, tag_name) {eprintf ("Invalid option\n");
 				if (r_str_casestr (tag_name, search_tag)) {
 					r_cons_printf("%s\n", rule->identifier);
@@ -183,11 +622,11 @@ static int r_cmd_yara_tag (const char * search_tag) {
 static int r_cmd_yara_list () {
 	/* List all loaded rules */
 	RListIter* rules_it;
-	YR_RULES* rules;
+	RYaraRuleset* rs;
 	YR_RULE* rule;
 
-	r_list_foreach (rules_list, rules_it, rules) {
-		yr_rules_foreach (rules, rule) {
+	r_list_foreach (rules_list, rules_it, rs) {
+		yr_rules_foreach (rs->rules, rule) {
 			r_cons_printf("%s\n", rule->identifier);
 		}
 	}
@@ -198,7 +637,7 @@ static int r_cmd_yara_list () {
 static int r_cmd_yara_clear () {
 	/* Clears all loaded rules */
 	r_list_free (rules_list);
-	rules_list = r_list_newf((RListFree) yr_rules_destroy);
+	rules_list = r_list_newf((RListFree) ruleset_free);
 	eprintf ("Rules cleared.\n");
 
 	return true;
@@ -270,12 +709,19 @@ static int r_cmd_yara_add_file(const char* rules_path) {
 	YR_RULES* rules;
 	FILE* rules_file = NULL;
 	int result;
+	ut64 key;
 
 	if (!rules_path) {
 		eprintf ("Please tell me what am I supposed to load\n");
 		return false;
 	}
 
+	key = cache_key (rules_path, 0);
+	rules = cache_load (key);
+	if (rules) {
+		return ruleset_add (rules, rules_path);
+	}
+
 	rules_file = r_sandbox_fopen (rules_path, "r");
 	if (!rules_file) {
 		eprintf ("Unable to open %s\n", rules_path);
@@ -310,7 +756,8 @@ static int r_cmd_yara_add_file(const char* rules_path) {
 		goto err_exit;
 	}
 
-	r_list_append(rules_list, rules);
+	cache_save (rules, key);
+	ruleset_add (rules, rules_path);
 
 	yr_compiler_destroy (compiler);
 	return true;
@@ -325,13 +772,17 @@ static int r_cmd_yara_help(const RCore* core) {
 	const char * help_message[] = {
 		"Usage: yara", "", " Yara plugin",
 		"add", " [file]", "Add yara rules from file, or open $EDITOR with yara rule template",
+		"cache", " [on|off|clear]", "Show, toggle or wipe the compiled rules cache",
 		"clear", "", "Clear all rules",
 		"help", "", "Show this help",
 		"list", "", "List all rules",
 		"scan", "[S]", "Scan the current file, if S option is given it prints matching strings.",
 		"show", " name", "Show rules containing name",
+		"stats", "", "Show time spent scanning with each rule set",
 		"tag", " name", "List rules with tag 'name'",
 		"tags", "", "List tags from the loaded rules",
+		"threads", " [n]", "Get or set the number of scan workers (0 = one per cpu)",
+		"window", " [size]", "Get or set the scan window size (0 = whole file)",
 		NULL
 	};
 
@@ -340,15 +791,44 @@ static int r_cmd_yara_help(const RCore* core) {
     return true;
 }
 
+static int r_cmd_yara_setting(const RCore* core, const char* arg, int *ival, ut64 *uval) {
+	while (*arg == ' ') {
+		arg++;
+	}
+	if (!*arg) {
+		if (ival) {
+			r_cons_printf ("%d\n", *ival);
+		} else {
+			r_cons_printf ("0x%"PFMT64x"\n", *uval);
+		}
+		return true;
+	}
+	ut64 n = r_num_math (core->num, arg);
+	if (ival) {
+		*ival = (int)n;
+	} else {
+		*uval = n;
+	}
+	return true;
+}
+
 static int r_cmd_yara_process(const RCore* core, const char* input) {
     if (!strncmp (input, "add", 3))
         return r_cmd_yara_add (core, input + 3);
+    else if (!strncmp (input, "cache", 5))
+        return r_cmd_yara_cache (input + 5);
     else if (!strncmp (input, "clear", 4))
         return r_cmd_yara_clear ();
     else if (!strncmp (input, "list", 4))
         return r_cmd_yara_list ();
     else if (!strncmp (input, "scan", 4))
         return r_cmd_yara_scan (core, input + 4);
+    else if (!strncmp (input, "stats", 5))
+        return r_cmd_yara_stats ();
+    else if (!strncmp (input, "threads", 7))
+        return r_cmd_yara_setting (core, input + 7, &scan_threads, NULL);
+    else if (!strncmp (input, "window", 6))
+        return r_cmd_yara_setting (core, input + 6, NULL, &scan_window);
     else if (!strncmp (input, "show", 4))
         return r_cmd_yara_show (input + 5);
     else if (!strncmp (input, "tags", 4))
@@ -387,6 +867,26 @@ static int r_cmd_yara_load_default_rules (const RCore* core) {
 	char* rules = NULL;
 	char* y3_rule_dir = r_str_newf ("%s%s%s", r_str_home(R2_HOME_PLUGINS), R_SYS_DIR, "rules-yara3");
 	RList* list = r_sys_dir (y3_rule_dir);
+	ut64 key = 0;
+
+	/* the key is taken over the compressed files, so a cache hit
+	 * doesn't need to inflate crypto.yara.gz at all */
+	r_list_sort (list, (RListComparator)strcmp);
+	r_list_foreach (list, iter, filename) {
+		if (filename[0] != '.') {
+			complete_path = r_str_newf ("%s%s%s", y3_rule_dir, R_SYS_DIR, filename);
+			key = cache_key (complete_path, key);
+			free (complete_path);
+			complete_path = NULL;
+		}
+	}
+	yr_rules = cache_load (key);
+	if (yr_rules) {
+		ruleset_add (yr_rules, "rules-yara3");
+		free (y3_rule_dir);
+		r_list_free (list);
+		return true;
+	}
 
 	if (yr_compiler_create (&compiler) != ERROR_SUCCESS) {
 		char buf[64];
@@ -426,8 +926,11 @@ static int r_cmd_yara_load_default_rules (const RCore* core) {
 		goto err_exit;
 	}
 
-	r_list_append(rules_list, yr_rules);
+	cache_save (yr_rules, key);
+	ruleset_add (yr_rules, "rules-yara3");
 
+	free (y3_rule_dir);
+	r_list_free (list);
 	yr_compiler_destroy (compiler);
 	return true;
 
@@ -441,7 +944,7 @@ err_exit:
 
 static int r_cmd_yara_init(void *user, const char *cmd) {
 	RCore* core = (RCore *)user;
-	rules_list = r_list_newf((RListFree) yr_rules_destroy);
+	rules_list = r_list_newf((RListFree) ruleset_free);
 	yr_initialize ();
 	r_cmd_yara_load_default_rules (core);
 	initialized = true;